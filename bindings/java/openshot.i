@@ -40,6 +40,7 @@
 #endif
 #%shared_ptr(juce::AudioBuffer<float>)
 #%shared_ptr(openshot::Frame)
+#%shared_ptr(openshot::FrameStream)
 
 /* Instantiate the required template specializations */
 %template() std::map<std::string, int>;
@@ -54,13 +55,17 @@
 
 %{
 #include "OpenShotVersion.h"
+#include "FrameStream.h"
 #include "ReaderBase.h"
 #include "WriterBase.h"
 #include "AudioDevices.h"
 #include "AudioWaveformer.h"
 #include "CacheBase.h"
+#include "CacheCompressed.h"
 #include "CacheDisk.h"
+#include "CacheManager.h"
 #include "CacheMemory.h"
+#include "CacheTiered.h"
 #include "ChannelLayouts.h"
 #include "ChunkReader.h"
 #include "ChunkWriter.h"
@@ -88,6 +93,8 @@
 #include "QtTextReader.h"
 #include "KeyFrame.h"
 #include "RendererBase.h"
+#include "RenditionWriter.h"
+#include "SegmentedExporter.h"
 #include "Settings.h"
 #include "TimelineBase.h"
 #include "Timeline.h"
@@ -109,19 +116,24 @@
 %template(PointsVector) std::vector<openshot::Point>;
 %template(FieldVector) std::vector<openshot::Field>;
 %template(MappedFrameVector) std::vector<openshot::MappedFrame>;
+%template(PassThroughRangeVector) std::vector<openshot::PassThroughRange>;
 %template(MetadataMap) std::map<std::string, std::string>;
 
 /* Deprecated */
 %template(AudioDeviceInfoVector) std::vector<openshot::AudioDeviceInfo>;
 
 %include "OpenShotVersion.h"
+%include "FrameStream.h"
 %include "ReaderBase.h"
 %include "WriterBase.h"
 %include "AudioDevices.h"
 %include "AudioWaveformer.h"
 %include "CacheBase.h"
+%include "CacheCompressed.h"
 %include "CacheDisk.h"
+%include "CacheManager.h"
 %include "CacheMemory.h"
+%include "CacheTiered.h"
 %include "ChannelLayouts.h"
 %include "ChunkReader.h"
 %include "ChunkWriter.h"
@@ -149,6 +161,8 @@
 %include "QtTextReader.h"
 %include "KeyFrame.h"
 %include "RendererBase.h"
+%include "RenditionWriter.h"
+%include "SegmentedExporter.h"
 %include "Settings.h"
 %include "TimelineBase.h"
 %include "Timeline.h"
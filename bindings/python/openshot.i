@@ -40,6 +40,7 @@
 #endif
 %shared_ptr(juce::AudioBuffer<float>)
 %shared_ptr(openshot::Frame)
+%shared_ptr(openshot::FrameStream)
 
 /* Rename operators to avoid wrapping name collisions */
 %rename(__eq__) operator==;
@@ -59,13 +60,17 @@
 
 %{
 #include "OpenShotVersion.h"
+#include "FrameStream.h"
 #include "ReaderBase.h"
 #include "WriterBase.h"
 #include "AudioDevices.h"
 #include "AudioWaveformer.h"
 #include "CacheBase.h"
+#include "CacheCompressed.h"
 #include "CacheDisk.h"
+#include "CacheManager.h"
 #include "CacheMemory.h"
+#include "CacheTiered.h"
 #include "ChannelLayouts.h"
 #include "ChunkReader.h"
 #include "ChunkWriter.h"
@@ -93,6 +98,8 @@
 #include "QtTextReader.h"
 #include "KeyFrame.h"
 #include "RendererBase.h"
+#include "RenditionWriter.h"
+#include "SegmentedExporter.h"
 #include "Settings.h"
 #include "TimelineBase.h"
 #include "Timeline.h"
@@ -142,6 +149,7 @@
 %template(PointsVector) std::vector<openshot::Point>;
 %template(FieldVector) std::vector<openshot::Field>;
 %template(MappedFrameVector) std::vector<openshot::MappedFrame>;
+%template(PassThroughRangeVector) std::vector<openshot::PassThroughRange>;
 %template(MetadataMap) std::map<std::string, std::string>;
 
 /* Deprecated */
@@ -280,13 +288,17 @@
 }
 
 %include "OpenShotVersion.h"
+%include "FrameStream.h"
 %include "ReaderBase.h"
 %include "WriterBase.h"
 %include "AudioDevices.h"
 %include "AudioWaveformer.h"
 %include "CacheBase.h"
+%include "CacheCompressed.h"
 %include "CacheDisk.h"
+%include "CacheManager.h"
 %include "CacheMemory.h"
+%include "CacheTiered.h"
 %include "ChannelLayouts.h"
 %include "ChunkReader.h"
 %include "ChunkWriter.h"
@@ -314,6 +326,8 @@
 %include "QtTextReader.h"
 %include "KeyFrame.h"
 %include "RendererBase.h"
+%include "RenditionWriter.h"
+%include "SegmentedExporter.h"
 %include "Settings.h"
 %include "TimelineBase.h"
 %include "Timeline.h"
@@ -40,6 +40,7 @@
 #endif
 %shared_ptr(juce::AudioBuffer<float>)
 %shared_ptr(openshot::Frame)
+%shared_ptr(openshot::FrameStream)
 
 /* Instantiate the required template specializations */
 %template() std::map<std::string, int>;
@@ -62,13 +63,17 @@
   #undef RSHIFT
 #endif
 #include "OpenShotVersion.h"
+#include "FrameStream.h"
 #include "ReaderBase.h"
 #include "WriterBase.h"
 #include "AudioDevices.h"
 #include "AudioWaveformer.h"
 #include "CacheBase.h"
+#include "CacheCompressed.h"
 #include "CacheDisk.h"
+#include "CacheManager.h"
 #include "CacheMemory.h"
+#include "CacheTiered.h"
 #include "ChannelLayouts.h"
 #include "ChunkReader.h"
 #include "ChunkWriter.h"
@@ -96,6 +101,8 @@
 #include "QtTextReader.h"
 #include "KeyFrame.h"
 #include "RendererBase.h"
+#include "RenditionWriter.h"
+#include "SegmentedExporter.h"
 #include "Settings.h"
 #include "TimelineBase.h"
 #include "Timeline.h"
@@ -127,19 +134,24 @@
 %template(PointsVector) std::vector<openshot::Point>;
 %template(FieldVector) std::vector<openshot::Field>;
 %template(MappedFrameVector) std::vector<openshot::MappedFrame>;
+%template(PassThroughRangeVector) std::vector<openshot::PassThroughRange>;
 %template(MetadataMap) std::map<std::string, std::string>;
 
 /* Deprecated */
 %template(AudioDeviceInfoVector) std::vector<openshot::AudioDeviceInfo>;
 
 %include "OpenShotVersion.h"
+%include "FrameStream.h"
 %include "ReaderBase.h"
 %include "WriterBase.h"
 %include "AudioDevices.h"
 %include "AudioWaveformer.h"
 %include "CacheBase.h"
+%include "CacheCompressed.h"
 %include "CacheDisk.h"
+%include "CacheManager.h"
 %include "CacheMemory.h"
+%include "CacheTiered.h"
 %include "ChannelLayouts.h"
 %include "ChunkReader.h"
 %include "ChunkWriter.h"
@@ -188,6 +200,8 @@
 %include "QtTextReader.h"
 %include "KeyFrame.h"
 %include "RendererBase.h"
+%include "RenditionWriter.h"
+%include "SegmentedExporter.h"
 %include "Settings.h"
 %include "TimelineBase.h"
 %include "Timeline.h"
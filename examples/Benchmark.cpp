@@ -0,0 +1,552 @@
+/**
+ * @file
+ * @brief Source file for Benchmark Executable (performance tests for libopenshot)
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+#include "CacheCompressed.h"
+#include "CacheMemory.h"
+#include "Clip.h"
+#include "ColorChain.h"
+#include "Compositor.h"
+#include "FFmpegReader.h"
+#include "FFmpegWriter.h"
+#include "Frame.h"
+#include "KeyFrame.h"
+#include "RenditionWriter.h"
+#include "Settings.h"
+#include "Timeline.h"
+#include "effects/Blur.h"
+#include "effects/Brightness.h"
+#include "effects/Hue.h"
+#include "effects/Negate.h"
+#include "effects/Saturation.h"
+
+using namespace openshot;
+
+// Run a function many times, and return the average duration (in milliseconds)
+static double time_ms(std::function<void()> function, int iterations)
+{
+	// Warm up
+	function();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+		function();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// Print a single benchmark result
+static void print_result(std::string name, double baseline_ms, double optimized_ms)
+{
+	std::cout << "  " << std::left << std::setw(40) << name
+			  << std::right << std::fixed << std::setprecision(3)
+			  << std::setw(10) << baseline_ms << " ms"
+			  << std::setw(10) << optimized_ms << " ms"
+			  << std::setw(8) << std::setprecision(2) << (baseline_ms / optimized_ms) << "x" << std::endl;
+}
+
+// Compare QPainter with the SIMD compositor (at 1080p and 4K)
+static void benchmark_compositor()
+{
+	std::cout << "Compositor (" << Compositor::InstructionSet() << "): QPainter vs Compositor" << std::endl;
+
+	std::vector<std::pair<int, int>> sizes = { {1920, 1080}, {3840, 2160} };
+	for (auto size : sizes) {
+		int width = size.first;
+		int height = size.second;
+
+		// Semi-transparent source image (with a gradient), and an opaque background
+		QImage source(width, height, QImage::Format_RGBA8888_Premultiplied);
+		for (int y = 0; y < height; y++) {
+			uchar* row = source.scanLine(y);
+			for (int x = 0; x < width; x++) {
+				int alpha = (x * 255) / width;
+				row[x * 4 + 0] = (alpha * ((x + y) % 256)) / 255;
+				row[x * 4 + 1] = (alpha * (y % 256)) / 255;
+				row[x * 4 + 2] = (alpha * (x % 256)) / 255;
+				row[x * 4 + 3] = alpha;
+			}
+		}
+		QImage background(width, height, QImage::Format_RGBA8888_Premultiplied);
+		background.fill(QColor(20, 40, 200, 255));
+
+		std::vector<std::pair<std::string, QTransform>> transforms = {
+			{ "identity", QTransform() },
+			{ "translate", QTransform().translate(width / 8, height / 8) },
+			{ "scale 0.5 (picture-in-picture)", QTransform().translate(width / 4, height / 4).scale(0.5, 0.5) },
+			{ "scale 1.25", QTransform().translate(-width / 8.0, -height / 8.0).scale(1.25, 1.25) },
+			{ "rotate 15", QTransform().translate(width / 2, height / 2).rotate(15).translate(-width / 2, -height / 2) },
+		};
+
+		std::cout << " " << width << "x" << height << std::endl;
+		for (auto transform : transforms) {
+			QImage canvas = background.copy();
+
+			double painter_ms = time_ms([&]() {
+				QPainter painter(&canvas);
+				painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
+				painter.setTransform(transform.second);
+				painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+				painter.drawImage(0, 0, source);
+				painter.end();
+			}, 10);
+
+			double compositor_ms = time_ms([&]() {
+				Compositor::Composite(&canvas, &source, transform.second);
+			}, 10);
+
+			print_result(transform.first, painter_ms, compositor_ms);
+		}
+	}
+}
+
+// Mean latency of random seeks, with and without a seek index
+static void benchmark_seek()
+{
+	std::cout << "FFmpegReader: random seek (no index vs seek index)" << std::endl;
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Same random frames for both readers
+	std::vector<int64_t> frames;
+	{
+		FFmpegReader r(path.str());
+		std::mt19937 generator(1);
+		std::uniform_int_distribution<int64_t> distribution(1, r.info.video_length);
+		for (int i = 0; i < 50; i++)
+			frames.push_back(distribution(generator));
+	}
+
+	// Mean duration of each random GetFrame (the final cache is cleared, so each frame is a seek)
+	auto mean_seek_ms = [&](FFmpegReader& r) {
+		double total_ms = 0.0;
+		for (int64_t number : frames) {
+			r.GetCache()->Clear();
+			auto start = std::chrono::high_resolution_clock::now();
+			r.GetFrame(number);
+			auto end = std::chrono::high_resolution_clock::now();
+			total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+		return total_ms / frames.size();
+	};
+
+	Settings::Instance()->ENABLE_SEEK_INDEX = false;
+	FFmpegReader baseline(path.str());
+	baseline.Open();
+	double baseline_ms = mean_seek_ms(baseline);
+	baseline.Close();
+
+	Settings::Instance()->ENABLE_SEEK_INDEX = true;
+	FFmpegReader indexed(path.str());
+	auto start = std::chrono::high_resolution_clock::now();
+	indexed.BuildSeekIndex();
+	auto end = std::chrono::high_resolution_clock::now();
+	indexed.Open();
+	double indexed_ms = mean_seek_ms(indexed);
+	indexed.Close();
+	Settings::Instance()->ENABLE_SEEK_INDEX = false;
+
+	print_result("mean random seek (720p, 50 seeks)", baseline_ms, indexed_ms);
+	std::cout << "  (index scan: " << std::fixed << std::setprecision(3)
+			  << std::chrono::duration<double, std::milli>(end - start).count() << " ms)" << std::endl;
+}
+
+// Frames per GB (and compress / decompress time) of CacheMemory vs CacheCompressed, with 1080p frames
+static void benchmark_cache_compressed()
+{
+	std::cout << "CacheCompressed: frames per GB (CacheMemory vs CacheCompressed)" << std::endl;
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Decode frames, and scale them to 1080p
+	std::vector<std::shared_ptr<Frame>> frames;
+	FFmpegReader r(path.str());
+	r.Open();
+	for (int64_t number = 300; number < 348; number++) {
+		auto decoded = r.GetFrame(number);
+		auto f = std::make_shared<Frame>(number, 1920, 1080, "#000000");
+		f->AddImage(std::make_shared<QImage>(decoded->GetImage()->scaled(
+			1920, 1080, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(QImage::Format_RGBA8888_Premultiplied)));
+		frames.push_back(f);
+	}
+	r.Close();
+
+	CacheMemory memory;
+	CacheCompressed compressed;
+	double memory_add_ms = time_ms([&]() {
+		memory.Clear();
+		for (auto f : frames)
+			memory.Add(f);
+	}, 3) / frames.size();
+	double compressed_add_ms = time_ms([&]() {
+		compressed.Clear();
+		for (auto f : frames)
+			compressed.Add(f);
+	}, 3) / frames.size();
+	double memory_get_ms = time_ms([&]() {
+		for (auto f : frames)
+			memory.GetFrame(f->number)->GetImage();
+	}, 3) / frames.size();
+	double compressed_get_ms = time_ms([&]() {
+		for (auto f : frames)
+			compressed.GetFrame(f->number)->GetImage();
+	}, 3) / frames.size();
+
+	double gigabyte = 1024.0 * 1024.0 * 1024.0;
+	double memory_frames_per_gb = gigabyte / (double(memory.GetBytes()) / memory.Count());
+	double compressed_frames_per_gb = gigabyte / (double(compressed.GetBytes()) / compressed.Count());
+	std::cout << "  " << std::left << std::setw(40) << "frames per GB (1080p)"
+			  << std::right << std::fixed << std::setprecision(0)
+			  << std::setw(13) << memory_frames_per_gb
+			  << std::setw(13) << compressed_frames_per_gb
+			  << std::setw(8) << std::setprecision(2) << (compressed_frames_per_gb / memory_frames_per_gb) << "x" << std::endl;
+	print_result("add (per frame)", memory_add_ms, compressed_add_ms);
+	print_result("get (per frame)", memory_get_ms, compressed_get_ms);
+}
+
+// Hit rate (and render time of misses) of a replayed editing session, LRU vs Greedy-Dual-Size eviction
+static void benchmark_cache_eviction()
+{
+	std::cout << "CacheMemory: replayed edit session (LRU vs Greedy-Dual-Size)" << std::endl;
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Mixed-effect timeline: a plain clip (0 to 5 seconds), and a blurred clip (5 to 10 seconds)
+	Timeline t(640, 360, Fraction(24, 1), 44100, 2, LAYOUT_STEREO);
+	Clip plain(path.str());
+	plain.Position(0.0);
+	plain.End(5.0);
+	Clip blurred(path.str());
+	blurred.Position(5.0);
+	blurred.Start(5.0);
+	blurred.End(10.0);
+	Blur blur(Keyframe(20.0), Keyframe(20.0), Keyframe(6.0), Keyframe(3.0));
+	blurred.AddEffect(&blur);
+	t.AddClip(&plain);
+	t.AddClip(&blurred);
+	t.Open();
+
+	// Measure the render time of each frame
+	const int64_t frame_count = 240;
+	std::vector<int64_t> render_times(frame_count + 1, 0);
+	int64_t frame_bytes = 0;
+	for (int64_t number = 1; number <= frame_count; number++) {
+		auto f = t.GetFrame(number);
+		render_times[number] = f->GetRenderTime();
+		frame_bytes = f->GetBytes();
+	}
+	t.Close();
+
+	// Editing session: play 200 random 1 second ranges
+	std::vector<int64_t> trace;
+	std::mt19937 generator(1);
+	std::uniform_int_distribution<int64_t> distribution(1, frame_count - 24);
+	for (int i = 0; i < 200; i++) {
+		int64_t start = distribution(generator);
+		for (int64_t number = start; number < start + 24; number++)
+			trace.push_back(number);
+	}
+
+	// Replay the session on a cache of 48 frames (re-rendering each miss)
+	auto replay = [&](CacheEvictionPolicy policy, int64_t& hits) {
+		CacheMemory c(frame_bytes * 48);
+		c.SetEvictionPolicy(policy);
+		double render_ms = 0.0;
+		hits = 0;
+		for (int64_t number : trace) {
+			if (c.GetFrame(number)) {
+				c.MoveToFront(number);
+				hits++;
+				continue;
+			}
+			render_ms += render_times[number] / 1000.0;
+			auto f = std::make_shared<Frame>(number, 640, 360, "#000000");
+			f->AddColor(640, 360, "#000000");
+			f->SetRenderTime(render_times[number]);
+			c.Add(f);
+		}
+		return render_ms;
+	};
+
+	int64_t lru_hits = 0, cost_aware_hits = 0;
+	double lru_ms = replay(CACHE_EVICTION_LRU, lru_hits);
+	double cost_aware_ms = replay(CACHE_EVICTION_GREEDY_DUAL_SIZE, cost_aware_hits);
+	std::cout << "  " << std::left << std::setw(40) << "hit rate (4800 requests)"
+			  << std::right << std::fixed << std::setprecision(1)
+			  << std::setw(12) << (100.0 * lru_hits / trace.size()) << " %"
+			  << std::setw(10) << (100.0 * cost_aware_hits / trace.size()) << " %" << std::endl;
+	print_result("render time of misses", lru_ms, cost_aware_ms);
+}
+
+// Add, GetFrame, and Remove of 100k (blank) frames, with half of the frames evicted
+static void benchmark_cache_memory()
+{
+	std::cout << "CacheMemory: 100k frames (add, get, remove)" << std::endl;
+
+	const int64_t frame_count = 100000;
+	std::vector<std::shared_ptr<Frame>> frames;
+	frames.reserve(frame_count);
+	for (int64_t i = 1; i <= frame_count; i++) {
+		auto f = std::make_shared<Frame>();
+		f->number = i;
+		frames.push_back(f);
+	}
+	CacheMemory c(frames.front()->GetBytes() * frame_count / 2);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto& f : frames)
+		c.Add(f);
+	auto added = std::chrono::high_resolution_clock::now();
+	for (int64_t i = 1; i <= frame_count; i++)
+		c.GetFrame(i);
+	auto got = std::chrono::high_resolution_clock::now();
+	for (int64_t i = frame_count / 2 + 1; i <= frame_count; i += 2)
+		c.Remove(i);
+	c.Remove(1, frame_count);
+	auto removed = std::chrono::high_resolution_clock::now();
+
+	auto print_time = [](std::string name, std::chrono::high_resolution_clock::duration duration) {
+		std::cout << "  " << std::left << std::setw(40) << name
+				  << std::right << std::fixed << std::setprecision(3)
+				  << std::setw(10) << std::chrono::duration<double, std::milli>(duration).count() << " ms" << std::endl;
+	};
+	print_time("add (100k frames)", added - start);
+	print_time("get (100k frames)", got - added);
+	print_time("remove (100k frames)", removed - got);
+}
+
+// Value of a keyframe (searching for the surrounding points, and interpolating), as GetValue did before
+// constant keyframes, batches, and lookup tables
+static double search_value(const std::vector<Point>& points, int64_t index)
+{
+	auto candidate = std::lower_bound(points.begin(), points.end(), static_cast<double>(index), IsPointBeforeX);
+	if (candidate == points.end())
+		return points.back().co.Y;
+	if (candidate == points.begin() || candidate->co.X == index)
+		return candidate->co.Y;
+	return InterpolateBetween(*(candidate - 1), *candidate, index, 0.01);
+}
+
+// Keyframe evaluation of typical curves (GetValue search vs constant / batch / lookup table)
+static void benchmark_keyframe()
+{
+	std::cout << "Keyframe: values of 1800 frames (search + interpolate vs optimized)" << std::endl;
+
+	// Typical curves: a constant property, a linear fade, and an eased (bezier) animation
+	Keyframe constant(1.0);
+	Keyframe linear;
+	linear.AddPoint(1, 0.0, LINEAR);
+	linear.AddPoint(30, 1.0, LINEAR);
+	linear.AddPoint(1770, 1.0, LINEAR);
+	linear.AddPoint(1800, 0.0, LINEAR);
+	Keyframe bezier;
+	for (int point = 0; point <= 10; point++)
+		bezier.AddPoint(1 + point * 180, (point % 2) ? 1.0 : -1.0, BEZIER);
+
+	const int64_t frame_count = 1800;
+	std::vector<double> values(frame_count);
+	volatile double sink = 0.0;
+	std::vector<std::pair<std::string, Keyframe*>> curves = {
+		{ "constant", &constant }, { "linear (4 points)", &linear }, { "bezier (11 points)", &bezier } };
+
+	for (auto curve : curves) {
+		Keyframe& keyframe = *curve.second;
+		std::vector<Point> points;
+		for (int64_t index = 0; index < keyframe.GetCount(); index++)
+			points.push_back(keyframe.GetPoint(index));
+
+		double search_ms = time_ms([&]() {
+			for (int64_t frame = 1; frame <= frame_count; frame++)
+				sink = sink + search_value(points, frame);
+		}, 100);
+		double get_value_ms = time_ms([&]() {
+			for (int64_t frame = 1; frame <= frame_count; frame++)
+				sink = sink + keyframe.GetValue(frame);
+		}, 100);
+		double get_values_ms = time_ms([&]() {
+			keyframe.GetValues(1, frame_count, values.data());
+			sink = sink + values.back();
+		}, 100);
+
+		Keyframe table = keyframe;
+		table.SetLookupRange(1, frame_count);
+		double lookup_ms = time_ms([&]() {
+			for (int64_t frame = 1; frame <= frame_count; frame++)
+				sink = sink + table.GetValue(frame);
+		}, 100);
+
+		print_result(curve.first + ": GetValue", search_ms, get_value_ms);
+		print_result(curve.first + ": GetValues", search_ms, get_values_ms);
+		print_result(curve.first + ": lookup table", search_ms, lookup_ms);
+	}
+}
+
+// Chain of color effects on a 4K frame (one pass per effect vs a single fused pass)
+static void benchmark_color_effects()
+{
+	std::cout << "Color effects: 4 effects at 3840x2160 (sequential vs fused)" << std::endl;
+
+	auto frame = std::make_shared<Frame>(1, 3840, 2160, "#000000");
+	frame->AddColor(3840, 2160, "#4080c0");
+	Brightness brightness(Keyframe(0.1), Keyframe(10.0));
+	Saturation saturation(Keyframe(1.5), Keyframe(1.0), Keyframe(1.0), Keyframe(1.0));
+	Hue hue(Keyframe(0.25));
+	Negate negate;
+	std::vector<EffectBase*> effects = { &brightness, &saturation, &hue, &negate };
+
+	double sequential_ms = time_ms([&]() {
+		for (EffectBase* effect : effects)
+			effect->GetFrame(frame, 1);
+	}, 10);
+	double fused_ms = time_ms([&]() {
+		std::vector<ColorOperator> operators;
+		for (EffectBase* effect : effects)
+			operators.push_back(effect->GetColorOperator(1));
+		ColorChain::Apply(frame->GetImage().get(), operators);
+	}, 10);
+
+	print_result("brightness, saturation, hue, negate", sequential_ms, fused_ms);
+}
+
+// Export of a timeline (encoding on the caller's thread vs the encoding pipeline)
+static void benchmark_writer_pipeline()
+{
+	std::cout << "FFmpegWriter: export 120 frames of a 720p timeline (synchronous vs pipelined)" << std::endl;
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	auto export_ms = [&](int pipeline_frames) {
+		Timeline t(1280, 720, Fraction(24, 1), 44100, 2, LAYOUT_STEREO);
+		Clip clip(path.str());
+		Blur blur(Keyframe(4.0), Keyframe(4.0), Keyframe(3.0), Keyframe(1.0));
+		clip.AddEffect(&blur);
+		t.AddClip(&clip);
+		t.Open();
+
+		FFmpegWriter w("benchmark-pipeline.mp4");
+		w.SetPipeline(pipeline_frames);
+		w.SetAudioOptions(true, "aac", 44100, 2, LAYOUT_STEREO, 128000);
+		w.SetVideoOptions(true, "libx264", Fraction(24, 1), 1280, 720, Fraction(1, 1), false, false, 3000000);
+		w.Open();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int64_t number = 1; number <= 120; number++)
+			w.WriteFrame(t.GetFrame(number));
+		w.WriteTrailer();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		w.Close();
+		t.Close();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	print_result("export (pipeline of 8 frames)", export_ms(0), export_ms(8));
+}
+
+// Compare writing 3 renditions one after another with the RenditionWriter (shared pyramid, parallel encoders)
+static void benchmark_renditions()
+{
+	std::cout << "RenditionWriter: export 120 frames of a 720p timeline to 720p, 360p, and 180p (sequential vs parallel)" << std::endl;
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	auto export_ms = [&](bool parallel) {
+		Timeline t(1280, 720, Fraction(24, 1), 44100, 2, LAYOUT_STEREO);
+		Clip clip(path.str());
+		t.AddClip(&clip);
+		t.Open();
+
+		std::vector<std::unique_ptr<FFmpegWriter>> writers;
+		for (int height : { 720, 360, 180 }) {
+			std::stringstream output;
+			output << "benchmark-rendition-" << height << ".mp4";
+			writers.emplace_back(new FFmpegWriter(output.str()));
+			writers.back()->SetAudioOptions(true, "aac", 44100, 2, LAYOUT_STEREO, 128000);
+			writers.back()->SetVideoOptions(true, "libx264", Fraction(24, 1), height * 16 / 9, height, Fraction(1, 1), false, false, height * 4000);
+		}
+
+		RenditionWriter renditions;
+		for (auto& w : writers) {
+			renditions.AddRendition(w.get());
+			w->Open();
+		}
+		if (parallel)
+			renditions.Open();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int64_t number = 1; number <= 120; number++) {
+			std::shared_ptr<Frame> f = t.GetFrame(number);
+			if (parallel)
+				renditions.WriteFrame(f);
+			else
+				for (auto& w : writers)
+					w->WriteFrame(f);
+		}
+		if (parallel)
+			renditions.Close();
+		else
+			for (auto& w : writers)
+				w->Close();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		t.Close();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	print_result("export (3 renditions)", export_ms(false), export_ms(true));
+}
+
+int main(int argc, char* argv[]) {
+	// Optional benchmark name filter (i.e. openshot-benchmark compositor)
+	std::string filter = (argc > 1) ? argv[1] : "";
+
+	std::vector<std::pair<std::string, std::function<void()>>> benchmarks = {
+		{ "compositor", benchmark_compositor },
+		{ "seek", benchmark_seek },
+		{ "cache_compressed", benchmark_cache_compressed },
+		{ "cache_eviction", benchmark_cache_eviction },
+		{ "cache_memory", benchmark_cache_memory },
+		{ "keyframe", benchmark_keyframe },
+		{ "color_effects", benchmark_color_effects },
+		{ "writer_pipeline", benchmark_writer_pipeline },
+		{ "renditions", benchmark_renditions },
+	};
+
+	for (auto benchmark : benchmarks) {
+		if (filter.empty() || benchmark.first == filter) {
+			benchmark.second();
+			std::cout << std::endl;
+		}
+	}
+
+	return 0;
+}
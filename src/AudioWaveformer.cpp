@@ -11,6 +11,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "AudioWaveformer.h"
+#include "FrameStream.h"
 
 
 using namespace std;
@@ -73,9 +74,14 @@ AudioWaveformData AudioWaveformer::ExtractSamples(int channel, int num_per_secon
             channel_count = reader->info.channels;
         }
 
+        // Read frames ahead (in order), while samples are processed
+        shared_ptr<openshot::FrameStream> stream = reader->GetFrames(1, reader->info.video_length);
         for (auto f = 1; f <= reader->info.video_length; f++) {
             // Get next frame
-            shared_ptr<openshot::Frame> frame = reader->GetFrame(f);
+            shared_ptr<openshot::Frame> frame = stream->Next();
+            if (!frame) {
+                break;
+            }
 
             // Cache channels for this frame, to reduce # of calls to frame->GetAudioSamples
             float* channels[channel_count];
@@ -0,0 +1,93 @@
+/**
+ * @file
+ * @brief Source file for BufferPool class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "BufferPool.h"
+
+using namespace openshot;
+
+// Constructor for a pool of buffers
+BufferPool::BufferPool(size_t max_idle_buffers) :
+	buffer_size(0), max_idle_buffers(max_idle_buffers)
+{
+}
+
+// Destructor (buffers which are still used by images are deleted by the images)
+BufferPool::~BufferPool()
+{
+	Clear();
+}
+
+// Get an (uninitialized) buffer, or allocate a new one
+uint8_t* BufferPool::Acquire(size_t size)
+{
+	{
+		const std::lock_guard<std::mutex> lock(poolMutex);
+		if (size != buffer_size) {
+			// Image size changed (unused buffers are the wrong size)
+			for (uint8_t* buffer : idle_buffers)
+				delete[] buffer;
+			idle_buffers.clear();
+			buffer_size = size;
+		} else if (!idle_buffers.empty()) {
+			uint8_t* buffer = idle_buffers.back();
+			idle_buffers.pop_back();
+			return buffer;
+		}
+	}
+
+	// Not zero-filled (every pixel is written by the caller)
+	return new uint8_t[size];
+}
+
+// Return a buffer to the pool (or delete it)
+void BufferPool::Release(uint8_t* buffer, size_t size)
+{
+	{
+		const std::lock_guard<std::mutex> lock(poolMutex);
+		if (size == buffer_size && idle_buffers.size() < max_idle_buffers) {
+			idle_buffers.push_back(buffer);
+			return;
+		}
+	}
+	delete[] buffer;
+}
+
+// Delete all unused buffers
+void BufferPool::Clear()
+{
+	const std::lock_guard<std::mutex> lock(poolMutex);
+	for (uint8_t* buffer : idle_buffers)
+		delete[] buffer;
+	idle_buffers.clear();
+}
+
+// QImage cleanup function (returns the buffer to its pool)
+void BufferPool::ReleaseBuffer(void* info)
+{
+	PooledBuffer* pooled = static_cast<PooledBuffer*>(info);
+	std::shared_ptr<BufferPool> pool = pooled->pool.lock();
+	if (pool)
+		pool->Release(pooled->data, pooled->size);
+	else
+		delete[] pooled->data;
+	delete pooled;
+}
+
+// Wrap a buffer in a QImage (which returns the buffer to the pool when destroyed)
+std::shared_ptr<QImage> BufferPool::WrapImage(uint8_t* buffer, size_t size, int width, int height, int bytes_per_line,
+											  QImage::Format format)
+{
+	PooledBuffer* pooled = new PooledBuffer{shared_from_this(), buffer, size};
+	return std::make_shared<QImage>(
+		buffer, width, height, bytes_per_line, format,
+		(QImageCleanupFunction) &BufferPool::ReleaseBuffer, (void*) pooled);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file
+ * @brief Header file for BufferPool class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_BUFFER_POOL_H
+#define OPENSHOT_BUFFER_POOL_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QImage>
+
+namespace openshot {
+
+	/**
+	 * @brief This class is a pool of (uninitialized) pixel buffers of the same size.
+	 *
+	 * Buffers are wrapped in a QImage, and returned to the pool when the image is destroyed, so
+	 * producing an image for each frame does not allocate a new buffer for each frame. The pool must
+	 * be owned by a shared_ptr, and images remain valid after the pool is destroyed.
+	 *
+	 * @code
+	 * auto pool = std::make_shared<openshot::BufferPool>(8);
+	 * uint8_t* buffer = pool->Acquire(width * height * 4);
+	 * std::shared_ptr<QImage> image = pool->WrapImage(buffer, width * height * 4, width, height, width * 4,
+	 *                                                 QImage::Format_RGBA8888_Premultiplied);
+	 * @endcode
+	 */
+	class BufferPool : public std::enable_shared_from_this<BufferPool> {
+	private:
+		/// Pooled buffer wrapped by a QImage (deleted by the QImage cleanup function)
+		struct PooledBuffer {
+			std::weak_ptr<BufferPool> pool;
+			uint8_t* data;
+			size_t size;
+		};
+
+		std::mutex poolMutex;
+		std::vector<uint8_t*> idle_buffers;
+		size_t buffer_size;
+		size_t max_idle_buffers;
+
+		/// QImage cleanup function (returns the buffer to its pool)
+		static void ReleaseBuffer(void* info);
+
+	public:
+		/// @brief Constructor
+		/// @param max_idle_buffers The max # of unused buffers to keep
+		BufferPool(size_t max_idle_buffers);
+
+		/// Destructor (buffers which are still used by images are deleted by the images)
+		~BufferPool();
+
+		/// Get an (uninitialized) buffer, or allocate a new one
+		uint8_t* Acquire(size_t size);
+
+		/// Return a buffer to the pool (or delete it)
+		void Release(uint8_t* buffer, size_t size);
+
+		/// Delete all unused buffers
+		void Clear();
+
+		/// @brief Wrap a buffer (from Acquire) in a QImage, which returns the buffer to the pool when destroyed
+		/// @param buffer The buffer
+		/// @param size The size of the buffer (passed to Acquire)
+		/// @param width The width of the image
+		/// @param height The height of the image
+		/// @param bytes_per_line The bytes per line of the image
+		/// @param format The pixel format of the image
+		std::shared_ptr<QImage> WrapImage(uint8_t* buffer, size_t size, int width, int height, int bytes_per_line,
+										  QImage::Format format);
+	};
+
+}
+
+#endif
@@ -10,9 +10,11 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <chrono>
 #include <sstream>
 
 #include "CacheBase.h"
+#include "CacheManager.h"
 
 using namespace std;
 using namespace openshot;
@@ -21,7 +23,8 @@ using namespace openshot;
 CacheBase::CacheBase() : CacheBase::CacheBase(0) { }
 
 // Constructor that sets the max frames to cache
-CacheBase::CacheBase(int64_t max_bytes) : max_bytes(max_bytes) {
+CacheBase::CacheBase(int64_t max_bytes) : max_bytes(max_bytes), cache_level(CACHE_LEVEL_READER), memory_usage(0),
+	stats_hits(0), stats_misses(0), stats_inserts(0), stats_evictions(0), stats_evicted_bytes(0), stats_lock_wait(0) {
 	// Init the mutex
 	cacheMutex = new std::recursive_mutex();
 }
@@ -34,24 +37,80 @@ void CacheBase::SetMaxBytesFromInfo(int64_t number_of_frames, int width, int hei
 	SetMaxBytes(bytes);
 }
 
+// Lock the cache mutex (measuring the time spent waiting for other threads, if statistics are enabled)
+std::unique_lock<std::recursive_mutex> CacheBase::LockCache()
+{
+	if (!Settings::Instance()->ENABLE_CACHE_STATS)
+		return std::unique_lock<std::recursive_mutex>(*cacheMutex);
+
+	// Only measure the time if the mutex is held by another thread
+	std::unique_lock<std::recursive_mutex> lock(*cacheMutex, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		auto start = std::chrono::steady_clock::now();
+		lock.lock();
+		stats_lock_wait.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	}
+	return lock;
+}
+
+// Get the statistics of this cache
+Json::Value CacheBase::GetStats()
+{
+	int64_t hits = stats_hits.load(std::memory_order_relaxed);
+	int64_t misses = stats_misses.load(std::memory_order_relaxed);
+
+	// Use strings, since int64_ts are not supported in JSON
+	Json::Value root;
+	root["type"] = cache_type;
+	root["level"] = cache_level;
+	root["hits"] = std::to_string(hits);
+	root["misses"] = std::to_string(misses);
+	root["hit_rate"] = (hits + misses > 0) ? double(hits) / (hits + misses) : 0.0;
+	root["inserts"] = std::to_string(stats_inserts.load(std::memory_order_relaxed));
+	root["evictions"] = std::to_string(stats_evictions.load(std::memory_order_relaxed));
+	root["evicted_bytes"] = std::to_string(stats_evicted_bytes.load(std::memory_order_relaxed));
+	root["lock_wait_ms"] = stats_lock_wait.load(std::memory_order_relaxed) / 1000000.0;
+	root["frames"] = std::to_string(Count());
+	root["bytes"] = std::to_string(GetBytes());
+	return root;
+}
+
+// Reset the statistics of this cache to zero
+void CacheBase::ResetStats()
+{
+	stats_hits = 0;
+	stats_misses = 0;
+	stats_inserts = 0;
+	stats_evictions = 0;
+	stats_evicted_bytes = 0;
+	stats_lock_wait = 0;
+}
+
+// Update the bytes of frames held in memory (and the CacheManager total)
+void CacheBase::UpdateMemoryUsage(int64_t bytes)
+{
+	int64_t previous_bytes = memory_usage.exchange(bytes);
+	if (bytes != previous_bytes)
+		CacheManager::Instance()->Resize(bytes - previous_bytes);
+}
+
 // Calculate ranges of frames
 void CacheBase::CalculateRanges() {
 	// Only calculate when something has changed
 	if (needs_range_processing) {
 
 		// Create a scoped lock, to protect the cache from multiple threads
-		const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-		// Sort ordered frame #s, and calculate JSON ranges
-		std::sort(ordered_frame_numbers.begin(), ordered_frame_numbers.end());
+		const auto lock = LockCache();
 
+		// Calculate JSON ranges (frame #s are already sorted)
 		// Clear existing JSON variable
 		Json::Value ranges = Json::Value(Json::arrayValue);
 
 		// Increment range version
 		range_version++;
 
-		std::vector<int64_t>::iterator itr_ordered;
+		std::set<int64_t>::iterator itr_ordered;
 
         int64_t starting_frame = 0;
         int64_t ending_frame = 0;
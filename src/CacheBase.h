@@ -14,12 +14,16 @@
 #define OPENSHOT_CACHE_BASE_H
 
 #include <map>
+#include <set>
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <algorithm>
 
+#include "Enums.h"
 #include "Json.h"
+#include "Settings.h"
 
 namespace openshot {
 	class Frame;
@@ -33,15 +37,27 @@ namespace openshot {
 	 */
 	class CacheBase
 	{
+		friend class CacheManager;
+
 	protected:
 		std::string cache_type; ///< This is a friendly type name of the derived cache instance
 		int64_t max_bytes; ///< This is the max number of bytes to cache (0 = no limit)
 
 		bool needs_range_processing; ///< Something has changed, and the range data needs to be re-calculated
 		std::string json_ranges; ///< JSON ranges of frame numbers
-		std::vector<int64_t> ordered_frame_numbers; ///< Ordered list of frame numbers used by cache
+		std::set<int64_t> ordered_frame_numbers; ///< Sorted frame numbers used by cache
 		std::map<int64_t, int64_t> frame_ranges;	///< This map holds the ranges of frames, useful for quickly displaying the contents of the cache
 		int64_t range_version; ///< The version of the JSON range data (incremented with each change)
+		openshot::CacheLevel cache_level; ///< The level of this cache in the frame pipeline (used by the CacheManager)
+		std::atomic<int64_t> memory_usage; ///< Bytes of frames held in memory (included in the CacheManager total)
+
+		// Statistics (only counted when Settings::ENABLE_CACHE_STATS is true)
+		std::atomic<int64_t> stats_hits; ///< Number of GetFrame calls which found a frame
+		std::atomic<int64_t> stats_misses; ///< Number of GetFrame calls which found no frame
+		std::atomic<int64_t> stats_inserts; ///< Number of new frames added
+		std::atomic<int64_t> stats_evictions; ///< Number of frames removed to stay under the max bytes (or the global memory limit)
+		std::atomic<int64_t> stats_evicted_bytes; ///< Bytes of evicted frames
+		std::atomic<int64_t> stats_lock_wait; ///< Nanoseconds spent waiting for the cache mutex (held by other threads)
         
 		/// Mutex for multiple threads
 		std::recursive_mutex *cacheMutex;
@@ -49,6 +65,34 @@ namespace openshot {
 		/// Calculate ranges of frames
 		void CalculateRanges();
 
+		/// @brief Lock the cache mutex (measuring the time spent waiting for other threads, if statistics are enabled)
+		/// @returns The lock (which is released when it goes out of scope)
+		std::unique_lock<std::recursive_mutex> LockCache();
+
+		/// Count a GetFrame call (if statistics are enabled)
+		void RecordLookup(bool hit) {
+			if (Settings::Instance()->ENABLE_CACHE_STATS)
+				(hit ? stats_hits : stats_misses).fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/// Count a new frame (if statistics are enabled)
+		void RecordInsert() {
+			if (Settings::Instance()->ENABLE_CACHE_STATS)
+				stats_inserts.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/// Count an evicted frame, and its bytes (if statistics are enabled)
+		void RecordEviction(int64_t bytes) {
+			if (Settings::Instance()->ENABLE_CACHE_STATS) {
+				stats_evictions.fetch_add(1, std::memory_order_relaxed);
+				stats_evicted_bytes.fetch_add(bytes, std::memory_order_relaxed);
+			}
+		}
+
+		/// @brief Update the bytes of frames held in memory (and the CacheManager total)
+		/// @param bytes The total bytes of frames this cache now holds in memory
+		void UpdateMemoryUsage(int64_t bytes);
+
 	public:
 		/// Default constructor, no max bytes
 		CacheBase();
@@ -96,6 +140,30 @@ namespace openshot {
 		/// Gets the maximum bytes value
 		int64_t GetMaxBytes() { return max_bytes; };
 
+		/// Gets the level of this cache in the frame pipeline
+		openshot::CacheLevel GetLevel() { return cache_level; };
+
+		/// Gets the bytes of frames held in memory (which count towards the global memory limit)
+		int64_t GetMemoryUsage() { return memory_usage; };
+
+		/// @brief Get the statistics of this cache (hits, misses, inserts, evictions, evicted bytes, and lock wait time).
+		/// Statistics are only counted when Settings::ENABLE_CACHE_STATS is true.
+		Json::Value GetStats();
+
+		/// Get the microseconds since the least recently used frame in memory was used (-1 = nothing to evict)
+		virtual int64_t GetOldestAge() { return -1; };
+
+		/// @brief Remove (or move out of memory) the least recently used frame in memory (used by the CacheManager).
+		/// The most recently used frame is never evicted. Returns false if no frame was evicted.
+		virtual bool EvictOldest() { return false; };
+
+		/// Reset the statistics of this cache to zero
+		void ResetStats();
+
+		/// @brief Set the level of this cache in the frame pipeline
+		/// @param level Frames of lower levels are evicted first, when all caches exceed the global memory limit
+		void SetLevel(openshot::CacheLevel level) { cache_level = level; };
+
 		/// @brief Set maximum bytes to a different amount
 		/// @param number_of_bytes The maximum bytes to allow in the cache. Once exceeded, the cache will purge the oldest frames.
 		void SetMaxBytes(int64_t number_of_bytes) { max_bytes = number_of_bytes; };
@@ -0,0 +1,403 @@
+/**
+ * @file
+ * @brief Source file for CacheCompressed class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "CacheCompressed.h"
+#include "CacheManager.h"
+#include "Exceptions.h"
+#include "Frame.h"
+
+using namespace std;
+using namespace openshot;
+
+// Default constructor, no max bytes
+CacheCompressed::CacheCompressed() : CacheBase(0), total_bytes(0), buffers(std::make_shared<BufferPool>(8)) {
+	// Set cache type name
+	cache_type = "CacheCompressed";
+	range_version = 0;
+	needs_range_processing = false;
+
+	// Include in the global memory limit
+	CacheManager::Instance()->Register(this);
+}
+
+// Constructor that sets the max bytes to cache
+CacheCompressed::CacheCompressed(int64_t max_bytes) : CacheBase(max_bytes), total_bytes(0), buffers(std::make_shared<BufferPool>(8)) {
+	// Set cache type name
+	cache_type = "CacheCompressed";
+	range_version = 0;
+	needs_range_processing = false;
+
+	// Include in the global memory limit
+	CacheManager::Instance()->Register(this);
+}
+
+// Default destructor
+CacheCompressed::~CacheCompressed()
+{
+	// Stop evicting frames from this cache
+	CacheManager::Instance()->Unregister(this);
+	Clear();
+
+	// remove mutex
+	delete cacheMutex;
+}
+
+// Compress a frame's image (and copy its audio)
+CacheCompressed::CompressedFrame CacheCompressed::Compress(std::shared_ptr<Frame> frame)
+{
+	CompressedFrame compressed;
+
+	// Copy properties and audio (without the image)
+	int channels = frame->has_audio_data ? frame->GetAudioChannelsCount() : 0;
+	int samples = frame->has_audio_data ? frame->GetAudioSamplesCount() : 0;
+	compressed.frame = std::make_shared<Frame>(frame->number, frame->GetWidth(), frame->GetHeight(), "#000000", samples, frame->GetAudioChannelsCount());
+	compressed.frame->SampleRate(frame->SampleRate());
+	compressed.frame->ChannelsLayout(frame->ChannelsLayout());
+	compressed.frame->SetPixelRatio(frame->GetPixelRatio().num, frame->GetPixelRatio().den);
+	compressed.bytes = int64_t(channels) * samples * sizeof(float);
+	for (int channel = 0; channel < channels; channel++)
+		compressed.frame->AddAudio(true, channel, 0, frame->GetAudioSamples(channel), samples, 1.0);
+
+	// Compress image (if any)
+	std::shared_ptr<QImage> image = frame->GetImage();
+	if (image) {
+		compressed.image = std::make_shared<const ImageCodec::EncodedImage>(ImageCodec::Encode(*image));
+		compressed.bytes += compressed.image->GetBytes();
+	}
+	return compressed;
+}
+
+// Decompress a frame (into a new Frame object)
+std::shared_ptr<Frame> CacheCompressed::Decompress(const CompressedFrame& compressed)
+{
+	// Copy properties and audio
+	auto frame = std::make_shared<Frame>(*compressed.frame);
+	const std::shared_ptr<const ImageCodec::EncodedImage>& image = compressed.image;
+	if (!image || image->width == 0 || image->height == 0)
+		return frame;
+
+	// Decompress image into a pooled buffer
+	const size_t buffer_size = size_t(image->width) * image->height * 4;
+	uint8_t* buffer = buffers->Acquire(buffer_size);
+	if (!ImageCodec::Decode(*image, buffer)) {
+		buffers->Release(buffer, buffer_size);
+		return std::shared_ptr<Frame>();
+	}
+
+	// Wrap buffer (which is returned to the pool when the image is destroyed)
+	frame->AddImage(buffers->WrapImage(buffer, buffer_size, image->width, image->height,
+									   image->width * 4, QImage::Format_RGBA8888_Premultiplied));
+	return frame;
+}
+
+// Decompress a list of frames
+std::vector<std::shared_ptr<Frame>> CacheCompressed::Decompress(const std::vector<CompressedFrame>& compressed_frames)
+{
+	std::vector<std::shared_ptr<Frame>> decompressed_frames;
+	decompressed_frames.reserve(compressed_frames.size());
+	for (const CompressedFrame& compressed : compressed_frames)
+		decompressed_frames.push_back(Decompress(compressed));
+	return decompressed_frames;
+}
+
+// Add a Frame to the cache
+void CacheCompressed::Add(std::shared_ptr<Frame> frame)
+{
+	int64_t frame_number = frame->number;
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		// Freshen frame if it already exists
+		if (frames.Touch(frame_number))
+			return;
+	}
+
+	// Compress frame (without locking the cache)
+	CompressedFrame compressed = Compress(frame);
+
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		// Frame was added by another thread
+		if (frames.Touch(frame_number))
+			return;
+
+		// Add frame to queue and map
+		total_bytes += compressed.bytes;
+		frames.Add(frame_number, compressed);
+		RecordInsert();
+		ordered_frame_numbers.insert(frame_number);
+		needs_range_processing = true;
+
+		// Clean up old frames
+		CleanUp();
+
+		// Update global memory usage
+		UpdateMemoryUsage(total_bytes);
+	}
+
+	// Evict frames from all caches (if over the global memory limit)
+	CacheManager::Instance()->CleanUp();
+}
+
+// Check if frame is already contained in cache
+bool CacheCompressed::Contains(int64_t frame_number) {
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return frames.Contains(frame_number);
+}
+
+// Get a frame from the cache (or NULL shared_ptr if no frame is found)
+std::shared_ptr<Frame> CacheCompressed::GetFrame(int64_t frame_number)
+{
+	CompressedFrame compressed;
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		// Does frame exists in cache?
+		CompressedFrame* cached = frames.Find(frame_number);
+		RecordLookup(cached != nullptr);
+		if (!cached)
+			// no Frame found
+			return std::shared_ptr<Frame>();
+
+		// Copy the compressed frame (the image is shared, not copied)
+		compressed = *cached;
+	}
+
+	// return a decompressed Frame object (without locking the cache)
+	return Decompress(compressed);
+}
+
+// @brief Get an array of all Frames
+std::vector<std::shared_ptr<openshot::Frame>> CacheCompressed::GetFrames()
+{
+	std::vector<CompressedFrame> compressed_frames;
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		// Loop through frames (sorted by frame number)
+		compressed_frames.reserve(ordered_frame_numbers.size());
+		for (int64_t frame_number : ordered_frame_numbers) {
+			CompressedFrame* cached = frames.Find(frame_number);
+			if (cached)
+				compressed_frames.push_back(*cached);
+		}
+	}
+
+	// Decompress frames (without locking the cache)
+	return Decompress(compressed_frames);
+}
+
+// Get the smallest frame number (or NULL shared_ptr if no frame is found)
+std::shared_ptr<Frame> CacheCompressed::GetSmallestFrame()
+{
+	CompressedFrame compressed;
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		// Return frame (if any)
+		CompressedFrame* cached = ordered_frame_numbers.empty() ? nullptr : frames.Find(*ordered_frame_numbers.begin());
+		if (!cached)
+			return NULL;
+		compressed = *cached;
+	}
+
+	// Decompress frame (without locking the cache)
+	return Decompress(compressed);
+}
+
+// Gets the total compressed bytes
+int64_t CacheCompressed::GetBytes()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return total_bytes;
+}
+
+// Remove a specific frame
+void CacheCompressed::Remove(int64_t frame_number)
+{
+	Remove(frame_number, frame_number);
+}
+
+// Remove range of frames
+void CacheCompressed::Remove(int64_t start_frame_number, int64_t end_frame_number)
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+	if (start_frame_number > end_frame_number)
+		return;
+
+	// Loop through cached frame numbers in this range
+	auto itr_ordered = ordered_frame_numbers.lower_bound(start_frame_number);
+	auto itr_end = ordered_frame_numbers.upper_bound(end_frame_number);
+	while (itr_ordered != itr_end)
+	{
+		// erase frame
+		CompressedFrame* compressed = frames.Find(*itr_ordered);
+		if (compressed)
+			total_bytes -= compressed->bytes;
+		frames.Remove(*itr_ordered);
+		itr_ordered = ordered_frame_numbers.erase(itr_ordered);
+	}
+	UpdateMemoryUsage(total_bytes);
+
+	// Needs range processing (since cache has changed)
+	needs_range_processing = true;
+}
+
+// Move frame to front of queue (so it lasts longer)
+void CacheCompressed::MoveToFront(int64_t frame_number)
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	frames.Touch(frame_number);
+}
+
+// Clear the cache of all frames
+void CacheCompressed::Clear()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	frames.Clear();
+	ordered_frame_numbers.clear();
+	total_bytes = 0;
+	UpdateMemoryUsage(0);
+	buffers->Clear();
+	needs_range_processing = true;
+}
+
+// Count the frames in the queue
+int64_t CacheCompressed::Count()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// Return the number of frames in the cache
+	return frames.Count();
+}
+
+// Get the microseconds since the least recently used frame was used (-1 = nothing to evict)
+int64_t CacheCompressed::GetOldestAge()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// The most recently used frame is never evicted
+	return (frames.Count() > 1) ? frames.OldestAge() : -1;
+}
+
+// Remove the least recently used frame (used by the CacheManager)
+bool CacheCompressed::EvictOldest()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	if (frames.Count() <= 1)
+		return false;
+	EvictOldestFrame();
+	return true;
+}
+
+// Remove the least recently used frame
+void CacheCompressed::EvictOldestFrame()
+{
+	int64_t frame_number = frames.Oldest();
+	RecordEviction(frames.Find(frame_number)->bytes);
+	Remove(frame_number);
+}
+
+// Clean up cached frames that exceed the number in our max_bytes variable
+void CacheCompressed::CleanUp()
+{
+	// Do we auto clean up?
+	if (max_bytes > 0)
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		while (total_bytes > max_bytes && frames.Count() > 20)
+		{
+			// Remove the oldest frame
+			EvictOldestFrame();
+		}
+	}
+}
+
+// Generate JSON string of this object
+std::string CacheCompressed::Json() {
+
+	// Return formatted string
+	return JsonValue().toStyledString();
+}
+
+// Generate Json::Value for this object
+Json::Value CacheCompressed::JsonValue() {
+
+	// Process range data (if anything has changed)
+	CalculateRanges();
+
+	// Create root json object
+	Json::Value root = CacheBase::JsonValue(); // get parent properties
+	root["type"] = cache_type;
+
+	root["version"] = std::to_string(range_version);
+
+	// Parse and append range data (if any)
+	try {
+		const Json::Value ranges = openshot::stringToJson(json_ranges);
+		root["ranges"] = ranges;
+	} catch (...) { }
+
+	// return JsonValue
+	return root;
+}
+
+// Load JSON string into this object
+void CacheCompressed::SetJson(const std::string value) {
+
+	try
+	{
+		// Parse string to Json::Value
+		const Json::Value root = openshot::stringToJson(value);
+		// Set all values that match
+		SetJsonValue(root);
+	}
+	catch (const std::exception& e)
+	{
+		// Error parsing JSON (or missing keys)
+		throw InvalidJSON("JSON is invalid (missing keys or invalid data types)");
+	}
+}
+
+// Load Json::Value into this object
+void CacheCompressed::SetJsonValue(const Json::Value root) {
+
+	// Close timeline before we do anything (this also removes all open and closing clips)
+	Clear();
+
+	// Set parent data
+	CacheBase::SetJsonValue(root);
+
+	if (!root["type"].isNull())
+		cache_type = root["type"].asString();
+}
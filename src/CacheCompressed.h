@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Header file for CacheCompressed class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_CACHE_COMPRESSED_H
+#define OPENSHOT_CACHE_COMPRESSED_H
+
+#include <memory>
+#include <vector>
+
+#include "BufferPool.h"
+#include "CacheBase.h"
+#include "CacheLRU.h"
+#include "ImageCodec.h"
+
+namespace openshot {
+	class Frame;
+
+	/**
+	 * @brief This class is a memory-based cache manager for Frame objects, which compresses frame images.
+	 *
+	 * Images are compressed with a fast lossless codec (see ImageCodec: in the style of QOI, in horizontal
+	 * stripes which are compressed and decompressed in parallel). Audio is stored as-is. GetFrame
+	 * decompresses the image into a pooled buffer (without holding the cache lock, so other threads
+	 * are not blocked by the decode), and returns a new Frame object.
+	 *
+	 * GetBytes() reports the compressed size, so a cache with the same max bytes holds many more frames than
+	 * a CacheMemory (typically 3-10x for rendered previews), at the cost of decompressing each frame.
+	 */
+	class CacheCompressed : public CacheBase {
+	private:
+		/// A compressed frame
+		struct CompressedFrame {
+			std::shared_ptr<openshot::Frame> frame; ///< Frame properties and audio (without an image)
+			std::shared_ptr<const openshot::ImageCodec::EncodedImage> image; ///< Compressed image (shared, so a frame is copied cheaply before decompressing it without the lock)
+			int64_t bytes; ///< Compressed size of the frame
+		};
+
+		CacheLRU<CompressedFrame> frames; ///< Compressed frames (most recently used first)
+		int64_t total_bytes; ///< Total compressed size of all cached frames
+		std::shared_ptr<BufferPool> buffers; ///< Pixel buffers of decompressed images
+
+		/// Clean up cached frames that exceed the max number of bytes
+		void CleanUp();
+
+		/// Remove the least recently used frame (counted as an eviction)
+		void EvictOldestFrame();
+
+		/// Compress a frame's image (and copy its audio)
+		static CompressedFrame Compress(std::shared_ptr<openshot::Frame> frame);
+
+		/// Decompress a frame (into a new Frame object)
+		std::shared_ptr<openshot::Frame> Decompress(const CompressedFrame& compressed);
+
+		/// Decompress a list of frames (copied while holding the lock), without holding the lock
+		std::vector<std::shared_ptr<openshot::Frame>> Decompress(const std::vector<CompressedFrame>& compressed_frames);
+
+	public:
+		/// Default constructor, no max bytes
+		CacheCompressed();
+
+		/// @brief Constructor that sets the max bytes to cache
+		/// @param max_bytes The maximum (compressed) bytes to allow in the cache. Once exceeded, the cache will purge the oldest frames.
+		CacheCompressed(int64_t max_bytes);
+
+		// Default destructor
+		virtual ~CacheCompressed();
+
+		/// @brief Add a Frame to the cache (the image is compressed)
+		/// @param frame The openshot::Frame object needing to be cached.
+		void Add(std::shared_ptr<openshot::Frame> frame);
+
+		/// Clear the cache of all frames
+		void Clear();
+
+		/// @brief Check if frame is already contained in cache
+		/// @param frame_number The frame number to be checked
+		bool Contains(int64_t frame_number);
+
+		/// Count the frames in the queue
+		int64_t Count();
+
+		/// Remove the least recently used frame (used by the CacheManager)
+		bool EvictOldest();
+
+		/// @brief Get a frame from the cache (a new Frame object, with a decompressed image)
+		/// @param frame_number The frame number of the cached frame
+		std::shared_ptr<openshot::Frame> GetFrame(int64_t frame_number);
+
+		/// @brief Get an array of all Frames
+		std::vector<std::shared_ptr<openshot::Frame>> GetFrames();
+
+		/// Gets the total compressed bytes of all cached frames
+		int64_t GetBytes();
+
+		/// Get the microseconds since the least recently used frame was used (-1 = nothing to evict)
+		int64_t GetOldestAge();
+
+		/// Get the smallest frame number
+		std::shared_ptr<openshot::Frame> GetSmallestFrame();
+
+		/// @brief Move frame to front of queue (so it lasts longer)
+		/// @param frame_number The frame number of the cached frame
+		void MoveToFront(int64_t frame_number);
+
+		/// @brief Remove a specific frame
+		/// @param frame_number The frame number of the cached frame
+		void Remove(int64_t frame_number);
+
+		/// @brief Remove a range of frames
+		/// @param start_frame_number The starting frame number of the cached frame
+		/// @param end_frame_number The ending frame number of the cached frame
+		void Remove(int64_t start_frame_number, int64_t end_frame_number);
+
+		// Get and Set JSON methods
+		std::string Json(); ///< Generate JSON string of this object
+		void SetJson(const std::string value); ///< Load JSON string into this object
+		Json::Value JsonValue(); ///< Generate Json::Value for this object
+		void SetJsonValue(const Json::Value root); ///< Load Json::Value into this object
+	};
+
+}
+
+#endif
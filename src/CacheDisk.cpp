@@ -10,18 +10,61 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <cmath>
+
 #include "CacheDisk.h"
 #include "Exceptions.h"
 #include "Frame.h"
 #include "QtUtilities.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
 
 #include <Qt>
+#include <QFile>
 #include <QString>
 #include <QTextStream>
 
 using namespace std;
 using namespace openshot;
 
+// Max size of a segment file (frames are appended to a new segment file once exceeded)
+#define CACHE_DISK_SEGMENT_BYTES (256 * 1024 * 1024)
+
+namespace openshot {
+	/// A segment file of raw frames (shared with any images which still map its pages)
+	struct CacheDiskSegment {
+		std::mutex mutex; ///< Protects the file (images are unmapped from other threads)
+		QFile file; ///< The segment file
+		int64_t size; ///< Number of bytes appended to the file
+		int64_t frames; ///< Number of cached frames in the file
+
+		CacheDiskSegment(QString segment_path) : file(segment_path), size(0), frames(0) { }
+
+		// Remove the segment file (once it is no longer cached or mapped)
+		~CacheDiskSegment() {
+			file.close();
+			file.remove();
+		}
+	};
+}
+
+// A memory-mapped frame, which is unmapped when its image is destroyed
+struct MappedSegmentRecord {
+	std::shared_ptr<CacheDiskSegment> segment;
+	uchar* data;
+};
+
+// Unmap a frame (QImage cleanup function)
+static void UnmapSegmentRecord(void* info)
+{
+	MappedSegmentRecord* mapped = static_cast<MappedSegmentRecord*>(info);
+	{
+		const std::lock_guard<std::mutex> lock(mapped->segment->mutex);
+		mapped->segment->file.unmap(mapped->data);
+	}
+	delete mapped;
+}
+
 // Default constructor, no max bytes
 CacheDisk::CacheDisk(std::string cache_path, std::string format, float quality, float scale) : CacheBase(0) {
 	// Set cache type name
@@ -33,6 +76,14 @@ CacheDisk::CacheDisk(std::string cache_path, std::string format, float quality,
 	image_quality = quality;
 	image_scale = scale;
 	max_bytes = 0;
+	current_segment = -1;
+	raw_format = QString::fromStdString(format).toLower() == "raw";
+	pending_bytes = 0;
+	max_pending_bytes = int64_t(Settings::Instance()->CACHE_DISK_MAX_PENDING_MB) * 1024 * 1024;
+	write_running = false;
+	write_pauses = 0;
+	writes_in_flight = 0;
+	SetWriteThreads(Settings::Instance()->CACHE_DISK_WRITE_THREADS);
 
 	// Init path directory
 	InitPath(cache_path);
@@ -48,6 +99,14 @@ CacheDisk::CacheDisk(std::string cache_path, std::string format, float quality,
 	image_format = format;
 	image_quality = quality;
 	image_scale = scale;
+	current_segment = -1;
+	raw_format = QString::fromStdString(format).toLower() == "raw";
+	pending_bytes = 0;
+	max_pending_bytes = int64_t(Settings::Instance()->CACHE_DISK_MAX_PENDING_MB) * 1024 * 1024;
+	write_running = false;
+	write_pauses = 0;
+	writes_in_flight = 0;
+	SetWriteThreads(Settings::Instance()->CACHE_DISK_WRITE_THREADS);
 
 	// Init path directory
 	InitPath(cache_path);
@@ -80,6 +139,9 @@ CacheDisk::~CacheDisk()
 {
 	Clear();
 
+	// Stop writer threads
+	SetWriteThreads(0);
+
 	// remove mutex
 	delete cacheMutex;
 }
@@ -87,79 +149,330 @@ CacheDisk::~CacheDisk()
 // Add a Frame to the cache
 void CacheDisk::Add(std::shared_ptr<Frame> frame)
 {
-	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
 	int64_t frame_number = frame->number;
+	int64_t frame_bytes = frame->GetBytes();
+	{
+		// Wait for pending frames to be written (if they hold too much memory)
+		std::unique_lock<std::mutex> write_lock(writeMutex);
+		writtenCondition.wait(write_lock, [&] {
+			return !write_running || pending_bytes == 0 || pending_bytes + frame_bytes <= max_pending_bytes; });
+	}
+
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
 
 	// Freshen frame if it already exists
-	if (frames.count(frame_number))
+	if (frames.Contains(frame_number))
 		// Move frame to front of queue
-		MoveToFront(frame_number);
+		frames.Touch(frame_number);
 
 	else
 	{
 		// Add frame to queue and map
-		frames[frame_number] = frame_number;
-		frame_numbers.push_front(frame_number);
-		ordered_frame_numbers.push_back(frame_number);
+		SegmentRecord record = SegmentRecord();
+		record.segment = -1;
+		frames.Add(frame_number, record);
+		RecordInsert();
+		ordered_frame_numbers.insert(frame_number);
 		needs_range_processing = true;
 
-		// Save image to disk (if needed)
-		QString frame_path(path.path() + "/" + QString("%1.").arg(frame_number) + QString(image_format.c_str()).toLower());
-		frame->Save(frame_path.toStdString(), image_scale, image_format, image_quality);
-		if (frame_size_bytes == 0) {
-			// Get compressed size of frame image (to correctly apply max size against)
-			QFile image_file(frame_path);
-			frame_size_bytes = image_file.size();
+		bool queued = false;
+		{
+			// Queue frame for a writer thread (if running)
+			const std::lock_guard<std::mutex> write_lock(writeMutex);
+			if (write_running) {
+				pending_frames[frame_number] = frame;
+				write_queue.push_back({frame, frame_number, frame_bytes});
+				pending_bytes += frame_bytes;
+				queued = true;
+			}
 		}
 
-		// Save audio data (if needed)
-		if (frame->has_audio_data) {
-			QString audio_path(path.path() + "/" + QString("%1").arg(frame_number) + ".audio");
-			QFile audio_file(audio_path);
+		if (queued)
+			writeCondition.notify_one();
+		else if (raw_format)
+			// Append raw frame to segment file
+			AppendRawFrame(frame_number, frame, RawImage(frame));
+		else {
+			// Save image and audio to disk
+			QString image_path = ImagePath(frame_number);
+			SaveFrame(frame, image_path, AudioPath(frame_number));
+			if (frame_size_bytes == 0) {
+				// Get compressed size of frame image (to correctly apply max size against)
+				QFile image_file(image_path);
+				frame_size_bytes = image_file.size();
+			}
+		}
 
-			if (audio_file.open(QIODevice::WriteOnly)) {
-				QTextStream audio_stream(&audio_file);
-				audio_stream << frame->SampleRate() << Qt::endl;
-				audio_stream << frame->GetAudioChannelsCount() << Qt::endl;
-				audio_stream << frame->GetAudioSamplesCount() << Qt::endl;
-				audio_stream << frame->ChannelsLayout() << Qt::endl;
-
-				// Loop through all samples
-				for (int channel = 0; channel < frame->GetAudioChannelsCount(); channel++)
-				{
-					// Get audio for this channel
-					float *samples = frame->GetAudioSamples(channel);
-					for (int sample = 0; sample < frame->GetAudioSamplesCount(); sample++)
-						audio_stream << samples[sample] << Qt::endl;
-				}
+		// Clean up old frames
+		CleanUp();
+	}
+}
 
+// Get the path of a frame's image file
+QString CacheDisk::ImagePath(int64_t frame_number)
+{
+	return path.path() + "/" + QString("%1.").arg(frame_number) + QString(image_format.c_str()).toLower();
+}
+
+// Get the path of a frame's audio file
+QString CacheDisk::AudioPath(int64_t frame_number)
+{
+	return path.path() + "/" + QString("%1").arg(frame_number) + ".audio";
+}
+
+// Save a frame's image and audio files
+void CacheDisk::SaveFrame(std::shared_ptr<Frame> frame, QString image_path, QString audio_path)
+{
+	// Save image to disk (if needed)
+	frame->Save(image_path.toStdString(), image_scale, image_format, image_quality);
+
+	// Save audio data (if needed)
+	if (frame->has_audio_data) {
+		QFile audio_file(audio_path);
+
+		if (audio_file.open(QIODevice::WriteOnly)) {
+			QTextStream audio_stream(&audio_file);
+			audio_stream << frame->SampleRate() << Qt::endl;
+			audio_stream << frame->GetAudioChannelsCount() << Qt::endl;
+			audio_stream << frame->GetAudioSamplesCount() << Qt::endl;
+			audio_stream << frame->ChannelsLayout() << Qt::endl;
+
+			// Loop through all samples
+			for (int channel = 0; channel < frame->GetAudioChannelsCount(); channel++)
+			{
+				// Get audio for this channel
+				float *samples = frame->GetAudioSamples(channel);
+				for (int sample = 0; sample < frame->GetAudioSamplesCount(); sample++)
+					audio_stream << samples[sample] << Qt::endl;
 			}
 
 		}
 
-		// Clean up old frames
-		CleanUp();
+	}
+}
+
+// Get a frame's image for a segment file (scaled and converted to premultiplied RGBA, if needed)
+QImage CacheDisk::RawImage(std::shared_ptr<Frame> frame)
+{
+	QImage image = *frame->GetImage();
+	if (fabs(image_scale) > 1.001 || fabs(image_scale) < 0.999)
+		image = image.scaled(image.width() * image_scale, image.height() * image_scale,
+							 Qt::KeepAspectRatio, Qt::SmoothTransformation);
+	if (image.format() != QImage::Format_RGBA8888_Premultiplied)
+		image = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+	return image;
+}
+
+// Append a frame to the current segment file
+void CacheDisk::AppendRawFrame(int64_t frame_number, std::shared_ptr<Frame> frame, const QImage& image)
+{
+	SegmentRecord record = SegmentRecord();
+	record.width = image.width();
+	record.height = image.height();
+	record.pixel_ratio_num = frame->GetPixelRatio().num;
+	record.pixel_ratio_den = frame->GetPixelRatio().den;
+	if (frame->has_audio_data) {
+		record.channels = frame->GetAudioChannelsCount();
+		record.samples = frame->GetAudioSamplesCount();
+		record.sample_rate = frame->SampleRate();
+		record.channel_layout = frame->ChannelsLayout();
+	}
+	int64_t image_bytes = int64_t(record.width) * record.height * 4;
+	record.size = image_bytes + int64_t(record.channels) * record.samples * sizeof(float);
+
+	// Start a new segment file (if needed)
+	auto segment = segments.find(current_segment);
+	if (segment == segments.end() || (segment->second->size > 0 && segment->second->size + record.size > CACHE_DISK_SEGMENT_BYTES))
+	{
+		// Remove the previous segment file (if all of its frames were removed)
+		if (segment != segments.end() && segment->second->frames == 0)
+			segments.erase(segment);
+
+		current_segment++;
+		QString segment_path = path.filePath(QString("segment-%1.raw").arg(current_segment));
+		auto new_segment = std::make_shared<CacheDiskSegment>(segment_path);
+		if (!new_segment->file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Unbuffered)) {
+			ZmqLogger::Instance()->AppendDebugMethod("CacheDisk::AppendRawFrame (Failed to create segment)", "frame_number", frame_number, "current_segment", current_segment);
+			Remove(frame_number);
+			return;
+		}
+		segment = segments.insert(std::make_pair(current_segment, new_segment)).first;
+	}
+	CacheDiskSegment& file_segment = *segment->second;
+	record.segment = segment->first;
+	record.offset = file_segment.size;
+
+	// Append pixels and planar audio samples
+	{
+		const std::lock_guard<std::mutex> lock(file_segment.mutex);
+		bool written = file_segment.file.seek(record.offset);
+		for (int row = 0; written && row < record.height; row++)
+			written = file_segment.file.write((const char*) image.constScanLine(row), record.width * 4) == record.width * 4;
+		for (int channel = 0; written && channel < record.channels; channel++)
+			written = file_segment.file.write((const char*) frame->GetAudioSamples(channel), record.samples * sizeof(float)) == int64_t(record.samples * sizeof(float));
+		if (!written) {
+			ZmqLogger::Instance()->AppendDebugMethod("CacheDisk::AppendRawFrame (Failed to write frame)", "frame_number", frame_number, "segment", record.segment);
+			Remove(frame_number);
+			return;
+		}
+	}
+	file_segment.size += record.size;
+	file_segment.frames++;
+
+	// Update the frame's record (if still cached)
+	SegmentRecord* existing = frames.Find(frame_number);
+	if (existing)
+		*existing = record;
+	if (frame_size_bytes == 0)
+		frame_size_bytes = record.size;
+}
+
+// Set the number of background threads which write frames (0 = write frames in Add)
+void CacheDisk::SetWriteThreads(int threads)
+{
+	{
+		// Stop existing threads (after writing all queued frames)
+		const std::lock_guard<std::mutex> write_lock(writeMutex);
+		write_running = false;
+	}
+	writeCondition.notify_all();
+	writtenCondition.notify_all();
+	for (auto& thread : write_threads)
+		thread.join();
+	write_threads.clear();
+
+	if (threads > 0) {
+		{
+			const std::lock_guard<std::mutex> write_lock(writeMutex);
+			write_running = true;
+		}
+		for (int thread = 0; thread < threads; thread++)
+			write_threads.emplace_back(&CacheDisk::WriteFrames, this);
+	}
+}
+
+// Wait until all pending frames are written
+void CacheDisk::Flush()
+{
+	std::unique_lock<std::mutex> write_lock(writeMutex);
+	writtenCondition.wait(write_lock, [this] { return pending_bytes == 0; });
+}
+
+// Encode and write queued frames (writer thread)
+void CacheDisk::WriteFrames()
+{
+	while (true) {
+		PendingWrite pending;
+		{
+			std::unique_lock<std::mutex> write_lock(writeMutex);
+			writeCondition.wait(write_lock, [this] {
+				return write_pauses == 0 && (!write_running || !write_queue.empty()); });
+			if (write_queue.empty())
+				// Stopped (and all queued frames are written)
+				return;
+			pending = write_queue.front();
+			write_queue.pop_front();
+			writes_in_flight++;
+		}
+
+		WritePendingFrame(pending);
+
+		{
+			const std::lock_guard<std::mutex> write_lock(writeMutex);
+			pending_bytes -= pending.bytes;
+			writes_in_flight--;
+		}
+		writtenCondition.notify_all();
+	}
+}
+
+// Encode a pending frame (without locking the cache), and then write it (if it is still pending)
+void CacheDisk::WritePendingFrame(const PendingWrite& pending)
+{
+	int64_t frame_number = pending.frame_number;
+	if (raw_format) {
+		QImage image = RawImage(pending.frame);
+
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+		auto pending_frame = pending_frames.find(frame_number);
+		if (pending_frame == pending_frames.end() || pending_frame->second != pending.frame)
+			// Frame was removed (or replaced)
+			return;
+		pending_frames.erase(pending_frame);
+		AppendRawFrame(frame_number, pending.frame, image);
+		return;
+	}
+
+	// Encode to temporary files (unique to this frame object)
+	QString image_path, audio_path;
+	{
+		const auto lock = LockCache();
+		image_path = ImagePath(frame_number);
+		audio_path = AudioPath(frame_number);
+	}
+	QString temp_suffix = QString(".%1.tmp").arg((quintptr) pending.frame.get(), 0, 16);
+	SaveFrame(pending.frame, image_path + temp_suffix, audio_path + temp_suffix);
+
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+	auto pending_frame = pending_frames.find(frame_number);
+	if (pending_frame == pending_frames.end() || pending_frame->second != pending.frame ||
+		image_path != ImagePath(frame_number)) {
+		// Frame was removed (or replaced)
+		QFile::remove(image_path + temp_suffix);
+		QFile::remove(audio_path + temp_suffix);
+		return;
+	}
+	pending_frames.erase(pending_frame);
+
+	// Move temporary files into place
+	QFile::remove(image_path);
+	QFile::rename(image_path + temp_suffix, image_path);
+	if (pending.frame->has_audio_data) {
+		QFile::remove(audio_path);
+		QFile::rename(audio_path + temp_suffix, audio_path);
+	}
+	if (frame_size_bytes == 0) {
+		// Get compressed size of frame image (to correctly apply max size against)
+		QFile image_file(image_path);
+		frame_size_bytes = image_file.size();
 	}
 }
 
 // Check if frame is already contained in cache
 bool CacheDisk::Contains(int64_t frame_number) {
-	if (frames.count(frame_number) > 0) {
-		return true;
-	} else {
-		return false;
-	}
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return frames.Contains(frame_number);
 }
 
 // Get a frame from the cache (or NULL shared_ptr if no frame is found)
 std::shared_ptr<Frame> CacheDisk::GetFrame(int64_t frame_number)
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
+
+	RecordLookup(pending_frames.count(frame_number) > 0 || frames.Contains(frame_number));
+	return ReadFrame(frame_number);
+}
+
+// Get a frame (without counting a lookup)
+std::shared_ptr<Frame> CacheDisk::ReadFrame(int64_t frame_number)
+{
+	// Return pending frames from memory (until they are written)
+	auto pending_frame = pending_frames.find(frame_number);
+	if (pending_frame != pending_frames.end())
+		return pending_frame->second;
 
 	// Does frame exists in cache?
-	if (frames.count(frame_number)) {
+	SegmentRecord* record = frames.Find(frame_number);
+	if (record && raw_format)
+		return GetRawFrame(frame_number, *record);
+
+	if (record) {
 		// Does frame exist on disk
 		QString frame_path(path.path() + "/" + QString("%1.").arg(frame_number) + QString(image_format.c_str()).toLower());
 		if (path.exists(frame_path)) {
@@ -222,19 +535,64 @@ std::shared_ptr<Frame> CacheDisk::GetFrame(int64_t frame_number)
 	return std::shared_ptr<Frame>();
 }
 
+// Create a frame from a memory-mapped segment record
+std::shared_ptr<Frame> CacheDisk::GetRawFrame(int64_t frame_number, const SegmentRecord& record)
+{
+	auto segment = segments.find(record.segment);
+	if (segment == segments.end())
+		return std::shared_ptr<Frame>();
+
+	// Create frame object
+	auto frame = std::make_shared<Frame>();
+	frame->number = frame_number;
+	frame->SetPixelRatio(record.pixel_ratio_num, record.pixel_ratio_den);
+	if (record.size == 0)
+		return frame;
+
+	// Map the frame's pages
+	uchar* data = NULL;
+	{
+		const std::lock_guard<std::mutex> lock(segment->second->mutex);
+		data = segment->second->file.map(record.offset, record.size);
+	}
+	if (!data)
+		return std::shared_ptr<Frame>();
+
+	// Copy planar audio samples
+	int64_t image_bytes = int64_t(record.width) * record.height * 4;
+	if (record.channels > 0) {
+		const float* samples = reinterpret_cast<const float*>(data + image_bytes);
+		frame->ResizeAudio(record.channels, record.samples, record.sample_rate, (ChannelLayout) record.channel_layout);
+		for (int channel = 0; channel < record.channels; channel++)
+			frame->AddAudio(true, channel, 0, samples + int64_t(channel) * record.samples, record.samples, 1.0);
+	}
+
+	if (record.width > 0 && record.height > 0) {
+		// Wrap the mapped pixels (read-only, so a modified image is copied first)
+		auto image = std::make_shared<QImage>((const uchar*) data, record.width, record.height, record.width * 4,
+											  QImage::Format_RGBA8888_Premultiplied, UnmapSegmentRecord,
+											  new MappedSegmentRecord{segment->second, data});
+		frame->AddImage(image);
+	} else {
+		const std::lock_guard<std::mutex> lock(segment->second->mutex);
+		segment->second->file.unmap(data);
+	}
+
+	// return the Frame object
+	return frame;
+}
+
 // @brief Get an array of all Frames
 std::vector<std::shared_ptr<openshot::Frame>> CacheDisk::GetFrames()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
+	// Loop through frames (sorted by frame number)
 	std::vector<std::shared_ptr<openshot::Frame>> all_frames;
-	std::vector<int64_t>::iterator itr_ordered;
-	for(itr_ordered = ordered_frame_numbers.begin(); itr_ordered != ordered_frame_numbers.end(); ++itr_ordered)
-	{
-		int64_t frame_number = *itr_ordered;
-		all_frames.push_back(GetFrame(frame_number));
-	}
+	all_frames.reserve(ordered_frame_numbers.size());
+	for (int64_t frame_number : ordered_frame_numbers)
+		all_frames.push_back(ReadFrame(frame_number));
 
 	return all_frames;
 }
@@ -243,20 +601,11 @@ std::vector<std::shared_ptr<openshot::Frame>> CacheDisk::GetFrames()
 std::shared_ptr<Frame> CacheDisk::GetSmallestFrame()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-	// Loop through frame numbers
-	std::deque<int64_t>::iterator itr;
-	int64_t smallest_frame = -1;
-	for(itr = frame_numbers.begin(); itr != frame_numbers.end(); ++itr)
-	{
-		if (*itr < smallest_frame || smallest_frame == -1)
-			smallest_frame = *itr;
-	}
+	const auto lock = LockCache();
 
 	// Return frame (if any)
-	if (smallest_frame != -1) {
-		return GetFrame(smallest_frame);
+	if (!ordered_frame_numbers.empty()) {
+		return ReadFrame(*ordered_frame_numbers.begin());
 	} else {
 		return NULL;
 	}
@@ -266,16 +615,15 @@ std::shared_ptr<Frame> CacheDisk::GetSmallestFrame()
 int64_t CacheDisk::GetBytes()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
-	int64_t  total_bytes = 0;
+	// Pending frames are counted by their size in memory (until they are written)
+	int64_t pending_size = 0;
+	for (const auto& pending : pending_frames)
+		pending_size += pending.second->GetBytes();
 
-	// Loop through frames, and calculate total bytes
-	std::deque<int64_t>::reverse_iterator itr;
-	for(itr = frame_numbers.rbegin(); itr != frame_numbers.rend(); ++itr)
-		total_bytes += frame_size_bytes;
-
-	return total_bytes;
+	// All written frames are the same size on disk (measured with the first frame)
+	return frame_size_bytes * (frames.Count() - int64_t(pending_frames.size())) + pending_size;
 }
 
 // Remove a specific frame
@@ -288,45 +636,47 @@ void CacheDisk::Remove(int64_t frame_number)
 void CacheDisk::Remove(int64_t start_frame_number, int64_t end_frame_number)
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-	// Loop through frame numbers
-	std::deque<int64_t>::iterator itr;
-	for(itr = frame_numbers.begin(); itr != frame_numbers.end();)
+	const auto lock = LockCache();
+	if (start_frame_number > end_frame_number)
+		return;
+
+	// Loop through cached frame numbers in this range
+	auto itr_ordered = ordered_frame_numbers.lower_bound(start_frame_number);
+	auto itr_end = ordered_frame_numbers.upper_bound(end_frame_number);
+	while (itr_ordered != itr_end)
 	{
-		//deque<int64_t>::iterator current = itr++;
-		if (*itr >= start_frame_number && *itr <= end_frame_number)
-		{
-			// erase frame number
-			itr = frame_numbers.erase(itr);
-		} else
-			itr++;
-	}
+		// Skip writing pending frame (if any)
+		pending_frames.erase(*itr_ordered);
+
+		SegmentRecord* record = frames.Find(*itr_ordered);
+		if (record && raw_format) {
+			// Remove the segment file once it contains no cached frames (and is not being appended to)
+			auto segment = segments.find(record->segment);
+			if (segment != segments.end() && --segment->second->frames == 0 && segment->first != current_segment)
+				segments.erase(segment);
 
-	// Loop through ordered frame numbers
-	std::vector<int64_t>::iterator itr_ordered;
-	for(itr_ordered = ordered_frame_numbers.begin(); itr_ordered != ordered_frame_numbers.end();)
-	{
-		if (*itr_ordered >= start_frame_number && *itr_ordered <= end_frame_number)
-		{
 			// erase frame number
-			frames.erase(*itr_ordered);
+			frames.Remove(*itr_ordered);
+			itr_ordered = ordered_frame_numbers.erase(itr_ordered);
+			continue;
+		}
 
-			// Remove the image file (if it exists)
-			QString frame_path(path.path() + "/" + QString("%1.").arg(*itr_ordered) + QString(image_format.c_str()).toLower());
-			QFile image_file(frame_path);
-			if (image_file.exists())
-				image_file.remove();
+		// erase frame number
+		frames.Remove(*itr_ordered);
 
-			// Remove audio file (if it exists)
-			QString audio_path(path.path() + "/" + QString("%1").arg(*itr_ordered) + ".audio");
-			QFile audio_file(audio_path);
-			if (audio_file.exists())
-				audio_file.remove();
+		// Remove the image file (if it exists)
+		QString frame_path(path.path() + "/" + QString("%1.").arg(*itr_ordered) + QString(image_format.c_str()).toLower());
+		QFile image_file(frame_path);
+		if (image_file.exists())
+			image_file.remove();
 
-			itr_ordered = ordered_frame_numbers.erase(itr_ordered);
-		} else
-			itr_ordered++;
+		// Remove audio file (if it exists)
+		QString audio_path(path.path() + "/" + QString("%1").arg(*itr_ordered) + ".audio");
+		QFile audio_file(audio_path);
+		if (audio_file.exists())
+			audio_file.remove();
+
+		itr_ordered = ordered_frame_numbers.erase(itr_ordered);
 	}
 
 	// Needs range processing (since cache has changed)
@@ -336,60 +686,63 @@ void CacheDisk::Remove(int64_t start_frame_number, int64_t end_frame_number)
 // Move frame to front of queue (so it lasts longer)
 void CacheDisk::MoveToFront(int64_t frame_number)
 {
-	// Does frame exists in cache?
-	if (frames.count(frame_number))
-	{
-		// Create a scoped lock, to protect the cache from multiple threads
-		const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-		// Loop through frame numbers
-		std::deque<int64_t>::iterator itr;
-		for(itr = frame_numbers.begin(); itr != frame_numbers.end(); ++itr)
-		{
-			if (*itr == frame_number)
-			{
-				// erase frame number
-				frame_numbers.erase(itr);
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
 
-				// add frame number to 'front' of queue
-				frame_numbers.push_front(frame_number);
-				break;
-			}
-		}
-	}
+	frames.Touch(frame_number);
 }
 
 // Clear the cache of all frames
 void CacheDisk::Clear()
 {
-	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-	// Clear all containers
-	frames.clear();
-	frame_numbers.clear();
-	frame_numbers.shrink_to_fit();
-	ordered_frame_numbers.clear();
-	ordered_frame_numbers.shrink_to_fit();
-	needs_range_processing = true;
-	frame_size_bytes = 0;
+	{
+		// Discard queued frames, and wait for frames already being written (which write files into the
+		// cache directory). Writer threads lock the cache, so the cache is not locked while waiting.
+		std::unique_lock<std::mutex> write_lock(writeMutex);
+		write_pauses++;
+		for (const auto& pending : write_queue)
+			pending_bytes -= pending.bytes;
+		write_queue.clear();
+		writtenCondition.wait(write_lock, [this] { return writes_in_flight == 0; });
+	}
+	writtenCondition.notify_all();
 
-	// Delete cache directory, and recreate it
-	QString current_path = path.path();
-	path.removeRecursively();
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+
+		// Clear all containers (segment files are removed once they are no longer mapped)
+		frames.Clear();
+		segments.clear();
+		pending_frames.clear();
+		ordered_frame_numbers.clear();
+		needs_range_processing = true;
+		frame_size_bytes = 0;
 
-	// Re-init folder
-	InitPath(current_path.toStdString());
+		// Delete cache directory, and recreate it
+		QString current_path = path.path();
+		path.removeRecursively();
+
+		// Re-init folder
+		InitPath(current_path.toStdString());
+	}
+
+	{
+		// Resume writer threads (frames added while clearing are written, or discarded if they were cleared)
+		const std::lock_guard<std::mutex> write_lock(writeMutex);
+		write_pauses--;
+	}
+	writeCondition.notify_all();
 }
 
 // Count the frames in the queue
 int64_t CacheDisk::Count()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
 	// Return the number of frames in the cache
-	return frames.size();
+	return frames.Count();
 }
 
 // Clean up cached frames that exceed the number in our max_bytes variable
@@ -399,15 +752,16 @@ void CacheDisk::CleanUp()
 	if (max_bytes > 0)
 	{
 		// Create a scoped lock, to protect the cache from multiple threads
-		const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+		const auto lock = LockCache();
 
-		while (GetBytes() > max_bytes && frame_numbers.size() > 20)
+		int64_t bytes = GetBytes();
+		while (bytes > max_bytes && frames.Count() > 20)
 		{
-			// Get the oldest frame number.
-			int64_t frame_to_remove = frame_numbers.back();
-
-			// Remove frame_number and frame
-			Remove(frame_to_remove);
+			// Remove the oldest frame
+			Remove(frames.Oldest());
+			int64_t remaining_bytes = GetBytes();
+			RecordEviction(bytes - remaining_bytes);
+			bytes = remaining_bytes;
 		}
 	}
 }
@@ -14,11 +14,18 @@
 #define OPENSHOT_CACHE_DISK_H
 
 #include "CacheBase.h"
+#include "CacheLRU.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 #include <QDir>
+#include <QImage>
 
 namespace openshot {
 	class Frame;
+	struct CacheDiskSegment;
 
 	/**
 	 * @brief This class is a disk-based cache manager for Frame objects.
@@ -26,34 +33,105 @@ namespace openshot {
 	 * It is used by the Timeline class, if enabled, to cache video and audio frames to disk, to cut down on CPU
 	 * and memory utilization. This will thrash a user's disk, but save their memory and CPU. It's a trade off that
 	 * sometimes makes perfect sense. You can also set the max number of bytes to cache.
+	 *
+	 * Frames are saved as image files (and text audio files), unless the image format is "raw". Raw frames are
+	 * appended (as premultiplied RGBA pixels and planar float audio) to large segment files, and are read back by
+	 * memory-mapping the segment, so the image pixels are never parsed or copied (until they are modified).
+	 *
+	 * With writer threads enabled (see SetWriteThreads), Add only queues a frame, and background threads encode
+	 * and write it. Pending frames are returned from memory by GetFrame until they are written, and Add waits
+	 * once pending frames hold more than Settings::CACHE_DISK_MAX_PENDING_MB of memory.
 	 */
 	class CacheDisk : public CacheBase {
 	private:
+		/// The location and properties of a frame in a segment file (raw format only)
+		struct SegmentRecord {
+			int segment; ///< Segment number
+			int64_t offset; ///< Byte offset of the frame in the segment file
+			int64_t size; ///< Size of the frame in bytes (image and audio)
+			int width; ///< Image width (0 = no image)
+			int height; ///< Image height
+			int pixel_ratio_num; ///< Pixel aspect ratio numerator
+			int pixel_ratio_den; ///< Pixel aspect ratio denominator
+			int channels; ///< Audio channels (0 = no audio)
+			int samples; ///< Audio samples per channel
+			int sample_rate; ///< Audio sample rate
+			int channel_layout; ///< Audio channel layout
+		};
+
 		QDir path; ///< This is the folder path of the cache directory
-		std::map<int64_t, int64_t> frames;	///< This map holds the frame number and Frame objects
-		std::deque<int64_t> frame_numbers;	///< This queue holds a sequential list of cached Frame numbers
+		CacheLRU<SegmentRecord> frames; ///< Cached frame numbers, and their segment records (most recently used first)
+		std::map<int, std::shared_ptr<CacheDiskSegment>> segments; ///< Segment files which contain cached frames (raw format only)
+		int current_segment; ///< The segment number new frames are appended to (raw format only)
+		bool raw_format; ///< Are frames appended to segment files (instead of image files)
+
+		/// A frame waiting to be written by a writer thread
+		struct PendingWrite {
+			std::shared_ptr<openshot::Frame> frame; ///< The frame to write
+			int64_t frame_number; ///< The frame number (when the frame was added)
+			int64_t bytes; ///< Memory held by the frame
+		};
+
+		std::map<int64_t, std::shared_ptr<openshot::Frame>> pending_frames; ///< Frames which are not written yet (served from memory)
+		std::deque<PendingWrite> write_queue; ///< Frames waiting for a writer thread (oldest first)
+		std::vector<std::thread> write_threads; ///< Background threads which encode and write frames
+		std::mutex writeMutex; ///< Protects the write queue and pending bytes
+		std::condition_variable writeCondition; ///< Signals writer threads (a frame was queued, or the threads are stopping)
+		std::condition_variable writtenCondition; ///< Signals Add and Flush (a pending frame was written or discarded)
+		int64_t pending_bytes; ///< Memory held by queued (and in-flight) frames
+		int64_t max_pending_bytes; ///< Max memory held by pending frames (Add waits once exceeded)
+		bool write_running; ///< Are the writer threads running
+		int write_pauses; ///< Number of callers (i.e. Clear) which need writer threads to stop taking frames from the queue
+		int writes_in_flight; ///< Number of frames being written by writer threads
 		std::string image_format;
 		float image_quality;
 		float image_scale;
 		int64_t frame_size_bytes; ///< The size of the cached frame in bytes
 
+		/// Append a frame (and its prepared image) to the current segment file (raw format only)
+		void AppendRawFrame(int64_t frame_number, std::shared_ptr<openshot::Frame> frame, const QImage& image);
+
+		/// Get the path of a frame's audio file
+		QString AudioPath(int64_t frame_number);
+
 		/// Clean up cached frames that exceed the max number of bytes
 		void CleanUp();
 
+		/// Create a frame from a memory-mapped segment record (raw format only)
+		std::shared_ptr<openshot::Frame> GetRawFrame(int64_t frame_number, const SegmentRecord& record);
+
+		/// Get a frame (without counting a lookup, since enumerating the cache is not a hit)
+		std::shared_ptr<openshot::Frame> ReadFrame(int64_t frame_number);
+
+		/// Get the path of a frame's image file
+		QString ImagePath(int64_t frame_number);
+
+		/// Get a frame's image for a segment file (scaled and converted to premultiplied RGBA)
+		QImage RawImage(std::shared_ptr<openshot::Frame> frame);
+
+		/// Save a frame's image and audio files
+		void SaveFrame(std::shared_ptr<openshot::Frame> frame, QString image_path, QString audio_path);
+
+		/// Encode and write queued frames (writer thread loop)
+		void WriteFrames();
+
+		/// Encode a pending frame (without locking the cache), and write it if it is still pending
+		void WritePendingFrame(const PendingWrite& pending);
+
 		/// Init path directory
 		void InitPath(std::string cache_path);
 
 	public:
 		/// @brief Default constructor, no max bytes
 		/// @param cache_path The folder path of the cache directory (empty string = /tmp/preview-cache/)
-		/// @param format The image format for disk caching (ppm, jpg, png)
+		/// @param format The image format for disk caching (ppm, jpg, png, or raw for memory-mapped segment files)
 		/// @param quality The quality of the image (1.0=highest quality/slowest speed, 0.0=worst quality/fastest speed)
 		/// @param scale The scale factor for the preview images (1.0 = original size, 0.5=half size, 0.25=quarter size, etc...)
 		CacheDisk(std::string cache_path, std::string format, float quality, float scale);
 
 		/// @brief Constructor that sets the max bytes to cache
 		/// @param cache_path The folder path of the cache directory (empty string = /tmp/preview-cache/)
-		/// @param format The image format for disk caching (ppm, jpg, png)
+		/// @param format The image format for disk caching (ppm, jpg, png, or raw for memory-mapped segment files)
 		/// @param quality The quality of the image (1.0=highest quality/slowest speed, 0.0=worst quality/fastest speed)
 		/// @param scale The scale factor for the preview images (1.0 = original size, 0.5=half size, 0.25=quarter size, etc...)
 		/// @param max_bytes The maximum bytes to allow in the cache. Once exceeded, the cache will purge the oldest frames.
@@ -76,6 +154,10 @@ namespace openshot {
 		/// Count the frames in the queue
 		int64_t Count();
 
+		/// @brief Wait until all pending frames are written by the writer threads
+		/// @note Do not call this while holding the cache mutex
+		void Flush();
+
 		/// @brief Get a frame from the cache
 		/// @param frame_number The frame number of the cached frame
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t frame_number);
@@ -89,10 +171,18 @@ namespace openshot {
 		/// Get the smallest frame number
 		std::shared_ptr<openshot::Frame> GetSmallestFrame();
 
+		/// Get the number of background threads which write frames
+		int GetWriteThreads() { return write_threads.size(); }
+
 		/// @brief Move frame to front of queue (so it lasts longer)
 		/// @param frame_number The frame number of the cached frame
 		void MoveToFront(int64_t frame_number);
 
+		/// @brief Set the number of background threads which encode and write frames (defaults to
+		/// Settings::CACHE_DISK_WRITE_THREADS). Pending frames are written before existing threads stop.
+		/// @param threads The number of writer threads (0 = frames are written by Add)
+		void SetWriteThreads(int threads);
+
 		/// @brief Remove a specific frame
 		/// @param frame_number The frame number of the cached frame
 		void Remove(int64_t frame_number);
@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @brief Header file for CacheLRU class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_CACHE_LRU_H
+#define OPENSHOT_CACHE_LRU_H
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace openshot {
+
+	/**
+	 * @brief This class keeps cached items (by frame number) in least-recently-used order.
+	 *
+	 * Items are stored in a hash map, and each item keeps its position in a linked list (front = most
+	 * recently used), so finding, freshening, adding, and removing an item, and finding the oldest item,
+	 * are all constant time. The time each item was last used is also kept, so the oldest items of different
+	 * caches can be compared. It is not thread safe (cache classes lock their own mutex).
+	 *
+	 * @code
+	 * openshot::CacheLRU<std::shared_ptr<openshot::Frame>> items;
+	 * items.Add(frame->number, frame);
+	 * items.Touch(frame->number); // Move to front
+	 * items.Remove(items.Oldest());
+	 * @endcode
+	 */
+	template <typename T>
+	class CacheLRU {
+	private:
+		typedef std::list<std::pair<int64_t, int64_t>> OrderList;
+		std::unordered_map<int64_t, std::pair<T, OrderList::iterator>> items; ///< Items (and their list position)
+		OrderList order; ///< Frame numbers, and the time they were last used (most recently used first)
+
+		/// Current time (in microseconds, from a monotonic clock)
+		static int64_t Now() {
+			return std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+	public:
+		/// @brief Add an item to the front (or replace an existing item, and move it to the front)
+		/// @param frame_number The frame number of the item
+		/// @param item The item to cache
+		void Add(int64_t frame_number, const T& item) {
+			auto existing = items.find(frame_number);
+			if (existing != items.end()) {
+				existing->second.first = item;
+				existing->second.second->second = Now();
+				order.splice(order.begin(), order, existing->second.second);
+			} else {
+				order.emplace_front(frame_number, Now());
+				items.emplace(frame_number, std::make_pair(item, order.begin()));
+			}
+		}
+
+		/// Remove all items
+		void Clear() {
+			items.clear();
+			order.clear();
+		}
+
+		/// Check if an item exists
+		bool Contains(int64_t frame_number) const { return items.count(frame_number) > 0; }
+
+		/// Count the items
+		int64_t Count() const { return items.size(); }
+
+		/// Get an item (or nullptr if not found), without changing its position
+		T* Find(int64_t frame_number) {
+			auto existing = items.find(frame_number);
+			return (existing != items.end()) ? &existing->second.first : nullptr;
+		}
+
+		/// Get the frame number of the least recently used item (the cache must not be empty)
+		int64_t Oldest() const { return order.back().first; }
+
+		/// Get the frame number of the most recently used item (the cache must not be empty)
+		int64_t Newest() const { return order.front().first; }
+
+		/// Get the number of microseconds since the least recently used item was last used (0 if empty)
+		int64_t OldestAge() const { return order.empty() ? 0 : Now() - order.back().second; }
+
+		/// Remove an item (returns false if not found)
+		bool Remove(int64_t frame_number) {
+			auto existing = items.find(frame_number);
+			if (existing == items.end())
+				return false;
+			order.erase(existing->second.second);
+			items.erase(existing);
+			return true;
+		}
+
+		/// Move an item to the front, so it lasts longer (returns false if not found)
+		bool Touch(int64_t frame_number) {
+			auto existing = items.find(frame_number);
+			if (existing == items.end())
+				return false;
+			existing->second.second->second = Now();
+			order.splice(order.begin(), order, existing->second.second);
+			return true;
+		}
+	};
+
+}
+
+#endif
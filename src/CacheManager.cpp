@@ -0,0 +1,187 @@
+/**
+ * @file
+ * @brief Source file for CacheManager class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+#include "CacheManager.h"
+#include "CacheBase.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
+
+using namespace std;
+using namespace openshot;
+
+// Global reference to CacheManager
+CacheManager *CacheManager::m_pInstance = nullptr;
+
+// Create or Get an instance of the cache manager singleton
+CacheManager *CacheManager::Instance()
+{
+	if (!m_pInstance) {
+		// Create the actual instance of CacheManager only once
+		m_pInstance = new CacheManager;
+	}
+
+	return m_pInstance;
+}
+
+// Gets the memory limit of all memory caches (0 = no limit)
+int64_t CacheManager::GetMaxBytes()
+{
+	return int64_t(Settings::Instance()->CACHE_MAX_MEMORY_MB) * 1024 * 1024;
+}
+
+// Register a memory cache
+void CacheManager::Register(CacheBase* cache)
+{
+	const std::lock_guard<std::mutex> lock(managerMutex);
+	caches.push_back(cache);
+}
+
+// Unregister a memory cache
+void CacheManager::Unregister(CacheBase* cache)
+{
+	// Waits for the evicting thread to stop using this cache (it skips unregistered caches)
+	std::unique_lock<std::mutex> lock(managerMutex);
+	caches.erase(std::remove(caches.begin(), caches.end(), cache), caches.end());
+	managerCondition.wait(lock, [this, cache] { return cleanup_cache != cache; });
+}
+
+// Evict the least recently used frames (weighted by cache level) until the total is within the memory limit
+void CacheManager::CleanUp()
+{
+	// Do we need to clean up?
+	int64_t max_bytes = GetMaxBytes();
+	if (max_bytes <= 0 || total_bytes <= max_bytes)
+		return;
+
+	// Only one thread evicts at a time (it continues until the total is within the limit,
+	// including any frames added by other threads in the meantime)
+	if (cleaning.exchange(true))
+		return;
+
+	int64_t evicted = 0;
+	int64_t batch = 0;
+	do {
+		// Evict down to 90% of the limit (so the next few frames don't evict again)
+		batch = EvictFrames(max_bytes - max_bytes / 10);
+		evicted += batch;
+		cleaning = false;
+
+		// Frames added (by other threads) just before cleaning was reset were not cleaned up
+	} while (batch > 0 && total_bytes > max_bytes && !cleaning.exchange(true));
+	evicted_frames += evicted;
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod("CacheManager::CleanUp", "evicted", evicted, "total_bytes", total_bytes, "max_bytes", max_bytes);
+}
+
+// Evict the oldest frames (weighted by cache level) until the total is within low_bytes
+int64_t CacheManager::EvictFrames(int64_t low_bytes)
+{
+	// Mark a cache as used by this thread (false if it was unregistered)
+	auto use_cache = [this](CacheBase* cache) {
+		const std::lock_guard<std::mutex> lock(managerMutex);
+		if (std::find(caches.begin(), caches.end(), cache) == caches.end())
+			return false;
+		cleanup_cache = cache;
+		return true;
+	};
+	auto release_cache = [this]() {
+		{
+			const std::lock_guard<std::mutex> lock(managerMutex);
+			cleanup_cache = nullptr;
+		}
+		managerCondition.notify_all();
+	};
+
+	// Age of the oldest frame of a cache. Ages are multiplied by 2 for each level
+	// below the Timeline, so lower levels are evicted first (-1 = nothing to evict).
+	auto weighted_age = [](CacheBase* cache) {
+		if (cache->GetLevel() == CACHE_LEVEL_UNMANAGED)
+			return int64_t(-1);
+		int64_t age = cache->GetOldestAge();
+		if (age < 0)
+			return age;
+		return age * (int64_t(1) << (CACHE_LEVEL_TIMELINE - cache->GetLevel()));
+	};
+
+	// Heap of the oldest frame of each cache (oldest first)
+	std::vector<CacheBase*> registered_caches;
+	{
+		const std::lock_guard<std::mutex> lock(managerMutex);
+		registered_caches = caches;
+	}
+	std::priority_queue<std::pair<int64_t, CacheBase*>> oldest;
+	for (CacheBase* cache : registered_caches) {
+		if (cache->GetLevel() == CACHE_LEVEL_UNMANAGED || !use_cache(cache))
+			continue;
+		int64_t age = weighted_age(cache);
+		release_cache();
+		if (age >= 0)
+			oldest.push(std::make_pair(age, cache));
+	}
+
+	// Evict the oldest frame, and update the age of that cache only
+	int64_t evicted = 0;
+	while (total_bytes > low_bytes && !oldest.empty()) {
+		CacheBase* cache = oldest.top().second;
+		oldest.pop();
+		if (!use_cache(cache))
+			continue;
+		bool evicted_frame = cache->EvictOldest();
+		int64_t age = evicted_frame ? weighted_age(cache) : -1;
+		release_cache();
+
+		if (evicted_frame)
+			evicted++;
+		if (age >= 0)
+			oldest.push(std::make_pair(age, cache));
+	}
+	return evicted;
+}
+
+// Generate JSON string of the current usage
+std::string CacheManager::Json() {
+
+	// Return formatted string
+	return JsonValue().toStyledString();
+}
+
+// Generate Json::Value of the current usage
+Json::Value CacheManager::JsonValue() {
+
+	const std::lock_guard<std::mutex> lock(managerMutex);
+
+	// Create root json object
+	Json::Value root;
+	root["max_bytes"] = std::to_string(GetMaxBytes());
+	root["bytes"] = std::to_string(total_bytes);
+	root["evicted_frames"] = std::to_string(evicted_frames);
+
+	// Usage of each cache
+	root["caches"] = Json::Value(Json::arrayValue);
+	for (CacheBase* cache : caches) {
+		Json::Value cache_root;
+		cache_root["type"] = cache->cache_type;
+		cache_root["level"] = cache->GetLevel();
+		cache_root["bytes"] = std::to_string(cache->GetMemoryUsage());
+		cache_root["max_bytes"] = std::to_string(cache->GetMaxBytes());
+		cache_root["frames"] = std::to_string(cache->Count());
+		root["caches"].append(cache_root);
+	}
+
+	// return JsonValue
+	return root;
+}
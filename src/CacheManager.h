@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @brief Header file for CacheManager class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_CACHE_MANAGER_H
+#define OPENSHOT_CACHE_MANAGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Json.h"
+
+namespace openshot {
+	class CacheBase;
+
+	/**
+	 * @brief This class enforces a single memory limit on all memory caches (a singleton)
+	 *
+	 * Each FFmpegReader, FrameMapper, Clip, and Timeline has its own cache (and max bytes), so the total
+	 * memory used by a large project is hard to predict. Memory caches register with the CacheManager, and
+	 * report the bytes they hold. Once the total exceeds Settings::CACHE_MAX_MEMORY_MB, the least recently
+	 * used frames of all caches are evicted (down to 90% of the limit, so eviction runs in batches). Each
+	 * cache's age is weighted by its level (see CacheLevel), so reader frames are evicted long before
+	 * Timeline frames.
+	 *
+	 * Only one thread evicts at a time (other threads continue without waiting). The oldest frame of each
+	 * cache is kept in a heap, so each eviction only asks the evicted cache for its next oldest frame.
+	 * The manager's mutex is never held while calling into a cache (which may write frames to disk).
+	 *
+	 * @code
+	 * // Limit all memory caches to 4 GB (combined)
+	 * openshot::Settings::Instance()->CACHE_MAX_MEMORY_MB = 4096;
+	 *
+	 * // Current usage (total and per cache)
+	 * std::cout << openshot::CacheManager::Instance()->Json() << std::endl;
+	 * @endcode
+	 */
+	class CacheManager {
+	private:
+		std::mutex managerMutex; ///< Mutex protecting caches and cleanup_cache
+		std::condition_variable managerCondition; ///< Signaled when the evicting thread stops using a cache
+		std::vector<openshot::CacheBase*> caches; ///< Registered caches
+		openshot::CacheBase* cleanup_cache; ///< Cache being called by the evicting thread (Unregister waits for it)
+		std::atomic<bool> cleaning; ///< Is a thread evicting frames
+		std::atomic<int64_t> total_bytes; ///< Total bytes of all memory caches
+		std::atomic<int64_t> evicted_frames; ///< Number of frames evicted (to stay within the memory limit)
+
+		/// Default constructor
+		CacheManager() : cleanup_cache(nullptr), cleaning(false), total_bytes(0), evicted_frames(0) {}; // Don't allow user to create an instance of this singleton
+
+#if __GNUC__ >=7
+		/// Default copy method
+		CacheManager(CacheManager const&) = delete; // Don't allow the user to assign this instance
+
+		/// Default assignment operator
+		CacheManager & operator=(CacheManager const&) = delete;  // Don't allow the user to assign this instance
+#else
+		/// Default copy method
+		CacheManager(CacheManager const&) {}; // Don't allow the user to assign this instance
+
+		/// Default assignment operator
+		CacheManager & operator=(CacheManager const&);  // Don't allow the user to assign this instance
+#endif
+
+		/// Private variable to keep track of singleton instance
+		static CacheManager * m_pInstance;
+
+		/// Evict the oldest frames (weighted by cache level) until the total is within low_bytes (returns the number of evicted frames)
+		int64_t EvictFrames(int64_t low_bytes);
+
+	public:
+		/// Create or get an instance of this cache manager singleton (invoke the class with this method)
+		static CacheManager * Instance();
+
+		/// @brief Evict the least recently used frames (weighted by cache level) until the total is within the memory limit.
+		/// Called by memory caches after adding a frame (without holding their own lock).
+		void CleanUp();
+
+		/// Gets the total bytes of all memory caches
+		int64_t GetBytes() { return total_bytes; };
+
+		/// Gets the number of frames evicted to stay within the memory limit
+		int64_t GetEvictedFrames() { return evicted_frames; };
+
+		/// Gets the memory limit of all memory caches (from Settings::CACHE_MAX_MEMORY_MB, 0 = no limit)
+		int64_t GetMaxBytes();
+
+		/// @brief Register a memory cache (at the end of its constructor)
+		/// @param cache The cache to register
+		void Register(openshot::CacheBase* cache);
+
+		/// @brief Add (or subtract) bytes from the total of all memory caches
+		/// @param bytes The change in bytes
+		void Resize(int64_t bytes) { total_bytes += bytes; };
+
+		/// @brief Unregister a memory cache (at the start of its destructor, so it is not evicted while destroyed)
+		/// @param cache The cache to unregister
+		void Unregister(openshot::CacheBase* cache);
+
+		// Get JSON methods
+		std::string Json(); ///< Generate JSON string of the current usage (total and per cache)
+		Json::Value JsonValue(); ///< Generate Json::Value of the current usage (total and per cache)
+	};
+
+}
+
+#endif
@@ -11,31 +11,43 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "CacheMemory.h"
+#include "CacheManager.h"
 #include "Exceptions.h"
 #include "Frame.h"
+#include "Settings.h"
 
 using namespace std;
 using namespace openshot;
 
 // Default constructor, no max bytes
-CacheMemory::CacheMemory() : CacheBase(0) {
+CacheMemory::CacheMemory() : CacheBase(0), total_bytes(0), inflation(0.0) {
 	// Set cache type name
 	cache_type = "CacheMemory";
 	range_version = 0;
 	needs_range_processing = false;
+	eviction_policy = (CacheEvictionPolicy) Settings::Instance()->CACHE_EVICTION_POLICY;
+
+	// Include in the global memory limit
+	CacheManager::Instance()->Register(this);
 }
 
 // Constructor that sets the max bytes to cache
-CacheMemory::CacheMemory(int64_t max_bytes) : CacheBase(max_bytes) {
+CacheMemory::CacheMemory(int64_t max_bytes) : CacheBase(max_bytes), total_bytes(0), inflation(0.0) {
 	// Set cache type name
 	cache_type = "CacheMemory";
 	range_version = 0;
 	needs_range_processing = false;
+	eviction_policy = (CacheEvictionPolicy) Settings::Instance()->CACHE_EVICTION_POLICY;
+
+	// Include in the global memory limit
+	CacheManager::Instance()->Register(this);
 }
 
 // Default destructor
 CacheMemory::~CacheMemory()
 {
+	// Stop evicting frames from this cache
+	CacheManager::Instance()->Unregister(this);
 	Clear();
 
 	// remove mutex
@@ -45,66 +57,93 @@ CacheMemory::~CacheMemory()
 // Add a Frame to the cache
 void CacheMemory::Add(std::shared_ptr<Frame> frame)
 {
-	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-	int64_t frame_number = frame->number;
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+		int64_t frame_number = frame->number;
 
-	// Freshen frame if it already exists
-	if (frames.count(frame_number))
-		// Move frame to front of queue
-		MoveToFront(frame_number);
+		// Freshen frame if it already exists
+		CachedFrame* existing = frames.Find(frame_number);
+		if (existing)
+		{
+			// Update size (the cached frame may have changed since it was added)
+			int64_t bytes = existing->frame->GetBytes();
+			total_bytes += bytes - existing->bytes;
+			existing->bytes = bytes;
+
+			// Move frame to front of queue
+			frames.Touch(frame_number);
+			UpdatePriority(frame_number, *existing);
+		}
+		else
+		{
+			// Add frame to queue and map
+			int64_t bytes = frame->GetBytes();
+			frames.Add(frame_number, CachedFrame{frame, bytes, 0.0});
+			UpdatePriority(frame_number, *frames.Find(frame_number));
+			total_bytes += bytes;
+			RecordInsert();
+			ordered_frame_numbers.insert(frame_number);
+			needs_range_processing = true;
+
+			// Clean up old frames
+			CleanUp();
+		}
 
-	else
-	{
-		// Add frame to queue and map
-		frames[frame_number] = frame;
-		frame_numbers.push_front(frame_number);
-		ordered_frame_numbers.push_back(frame_number);
-		needs_range_processing = true;
-
-		// Clean up old frames
-		CleanUp();
+		// Update global memory usage
+		UpdateMemoryUsage(total_bytes);
 	}
+
+	// Evict frames from all caches (if over the global memory limit)
+	CacheManager::Instance()->CleanUp();
 }
 
 // Check if frame is already contained in cache
 bool CacheMemory::Contains(int64_t frame_number) {
-	if (frames.count(frame_number) > 0) {
-		return true;
-	} else {
-		return false;
-	}
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return frames.Contains(frame_number);
 }
 
 // Get a frame from the cache (or NULL shared_ptr if no frame is found)
 std::shared_ptr<Frame> CacheMemory::GetFrame(int64_t frame_number)
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
 	// Does frame exists in cache?
-	if (frames.count(frame_number))
+	CachedFrame* cached = frames.Find(frame_number);
+	RecordLookup(cached != nullptr);
+	if (cached)
 		// return the Frame object
-		return frames[frame_number];
+		return cached->frame;
 
 	else
 		// no Frame found
 		return std::shared_ptr<Frame>();
 }
 
+// Get a frame (without counting a lookup)
+std::shared_ptr<Frame> CacheMemory::ReadFrame(int64_t frame_number)
+{
+	CachedFrame* cached = frames.Find(frame_number);
+	if (cached)
+		return cached->frame;
+	return std::shared_ptr<Frame>();
+}
+
 // @brief Get an array of all Frames
 std::vector<std::shared_ptr<openshot::Frame>> CacheMemory::GetFrames()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
+	// Loop through frames (sorted by frame number)
 	std::vector<std::shared_ptr<openshot::Frame>> all_frames;
-	std::vector<int64_t>::iterator itr_ordered;
-	for(itr_ordered = ordered_frame_numbers.begin(); itr_ordered != ordered_frame_numbers.end(); ++itr_ordered)
-	{
-		int64_t frame_number = *itr_ordered;
-		all_frames.push_back(GetFrame(frame_number));
-	}
+	all_frames.reserve(ordered_frame_numbers.size());
+	for (int64_t frame_number : ordered_frame_numbers)
+		all_frames.push_back(ReadFrame(frame_number));
 
 	return all_frames;
 }
@@ -113,20 +152,11 @@ std::vector<std::shared_ptr<openshot::Frame>> CacheMemory::GetFrames()
 std::shared_ptr<Frame> CacheMemory::GetSmallestFrame()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-	// Loop through frame numbers
-	std::deque<int64_t>::iterator itr;
-	int64_t smallest_frame = -1;
-	for(itr = frame_numbers.begin(); itr != frame_numbers.end(); ++itr)
-	{
-		if (*itr < smallest_frame || smallest_frame == -1)
-			smallest_frame = *itr;
-	}
+	const auto lock = LockCache();
 
 	// Return frame (if any)
-	if (smallest_frame != -1) {
-		return frames[smallest_frame];
+	if (!ordered_frame_numbers.empty()) {
+		return ReadFrame(*ordered_frame_numbers.begin());
 	} else {
 		return NULL;
 	}
@@ -136,16 +166,7 @@ std::shared_ptr<Frame> CacheMemory::GetSmallestFrame()
 int64_t CacheMemory::GetBytes()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-	int64_t total_bytes = 0;
-
-	// Loop through frames, and calculate total bytes
-	std::deque<int64_t>::reverse_iterator itr;
-	for(itr = frame_numbers.rbegin(); itr != frame_numbers.rend(); ++itr)
-	{
-		total_bytes += frames[*itr]->GetBytes();
-	}
+	const auto lock = LockCache();
 
 	return total_bytes;
 }
@@ -160,32 +181,25 @@ void CacheMemory::Remove(int64_t frame_number)
 void CacheMemory::Remove(int64_t start_frame_number, int64_t end_frame_number)
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
-
-	// Loop through frame numbers
-	std::deque<int64_t>::iterator itr;
-	for(itr = frame_numbers.begin(); itr != frame_numbers.end();)
-	{
-		if (*itr >= start_frame_number && *itr <= end_frame_number)
-		{
-			// erase frame number
-			itr = frame_numbers.erase(itr);
-		}else
-			itr++;
-	}
-
-	// Loop through ordered frame numbers
-	std::vector<int64_t>::iterator itr_ordered;
-	for(itr_ordered = ordered_frame_numbers.begin(); itr_ordered != ordered_frame_numbers.end();)
+	const auto lock = LockCache();
+	if (start_frame_number > end_frame_number)
+		return;
+
+	// Loop through cached frame numbers in this range
+	auto itr_ordered = ordered_frame_numbers.lower_bound(start_frame_number);
+	auto itr_end = ordered_frame_numbers.upper_bound(end_frame_number);
+	while (itr_ordered != itr_end)
 	{
-		if (*itr_ordered >= start_frame_number && *itr_ordered <= end_frame_number)
-		{
-			// erase frame number
-			frames.erase(*itr_ordered);
-			itr_ordered = ordered_frame_numbers.erase(itr_ordered);
-		}else
-			itr_ordered++;
+		// erase frame
+		CachedFrame* cached = frames.Find(*itr_ordered);
+		if (cached) {
+			total_bytes -= cached->bytes;
+			priorities.erase(std::make_pair(cached->priority, *itr_ordered));
+		}
+		frames.Remove(*itr_ordered);
+		itr_ordered = ordered_frame_numbers.erase(itr_ordered);
 	}
+	UpdateMemoryUsage(total_bytes);
 
 	// Needs range processing (since cache has changed)
 	needs_range_processing = true;
@@ -195,25 +209,12 @@ void CacheMemory::Remove(int64_t start_frame_number, int64_t end_frame_number)
 void CacheMemory::MoveToFront(int64_t frame_number)
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
-	// Does frame exists in cache?
-	if (frames.count(frame_number))
-	{
-		// Loop through frame numbers
-		std::deque<int64_t>::iterator itr;
-		for(itr = frame_numbers.begin(); itr != frame_numbers.end(); ++itr)
-		{
-			if (*itr == frame_number)
-			{
-				// erase frame number
-				frame_numbers.erase(itr);
-
-				// add frame number to 'front' of queue
-				frame_numbers.push_front(frame_number);
-				break;
-			}
-		}
+	CachedFrame* cached = frames.Find(frame_number);
+	if (cached) {
+		frames.Touch(frame_number);
+		UpdatePriority(frame_number, *cached);
 	}
 }
 
@@ -221,13 +222,14 @@ void CacheMemory::MoveToFront(int64_t frame_number)
 void CacheMemory::Clear()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
-	frames.clear();
-	frame_numbers.clear();
-	frame_numbers.shrink_to_fit();
+	frames.Clear();
+	priorities.clear();
 	ordered_frame_numbers.clear();
-	ordered_frame_numbers.shrink_to_fit();
+	total_bytes = 0;
+	inflation = 0.0;
+	UpdateMemoryUsage(0);
 	needs_range_processing = true;
 }
 
@@ -235,10 +237,72 @@ void CacheMemory::Clear()
 int64_t CacheMemory::Count()
 {
 	// Create a scoped lock, to protect the cache from multiple threads
-	const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+	const auto lock = LockCache();
 
 	// Return the number of frames in the cache
-	return frames.size();
+	return frames.Count();
+}
+
+// Get the microseconds since the least recently used frame was used (-1 = nothing to evict)
+int64_t CacheMemory::GetOldestAge()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// The most recently used frame is never evicted
+	return (frames.Count() > 1) ? frames.OldestAge() : -1;
+}
+
+// Remove the next frame to evict (used by the CacheManager)
+bool CacheMemory::EvictOldest()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	if (frames.Count() <= 1)
+		return false;
+	EvictFrame();
+	return true;
+}
+
+// Set the eviction policy of this cache
+void CacheMemory::SetEvictionPolicy(CacheEvictionPolicy policy)
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	eviction_policy = policy;
+}
+
+// Remove the next frame to evict (the cache must have more than 1 frame)
+void CacheMemory::EvictFrame()
+{
+	int64_t frame_number = frames.Oldest();
+	if (eviction_policy == CACHE_EVICTION_GREEDY_DUAL_SIZE && !priorities.empty())
+	{
+		// Lowest priority (skipping the most recently used frame)
+		auto lowest = priorities.begin();
+		if (lowest->second == frames.Newest() && priorities.size() > 1)
+			++lowest;
+
+		// Age the remaining frames
+		inflation = lowest->first;
+		frame_number = lowest->second;
+	}
+
+	RecordEviction(frames.Find(frame_number)->bytes);
+	Remove(frame_number);
+}
+
+// Calculate the eviction priority of a frame (the render time per byte, plus the inflation)
+void CacheMemory::UpdatePriority(int64_t frame_number, CachedFrame& cached)
+{
+	priorities.erase(std::make_pair(cached.priority, frame_number));
+
+	// Frames with an unknown render time cost 1 microsecond (so they are evicted in LRU order)
+	double cost = std::max(cached.frame->GetRenderTime(), int64_t(1));
+	cached.priority = inflation + cost / std::max(cached.bytes, int64_t(1));
+	priorities.insert(std::make_pair(cached.priority, frame_number));
 }
 
 // Clean up cached frames that exceed the number in our max_bytes variable
@@ -248,15 +312,12 @@ void CacheMemory::CleanUp()
 	if (max_bytes > 0)
 	{
 		// Create a scoped lock, to protect the cache from multiple threads
-		const std::lock_guard<std::recursive_mutex> lock(*cacheMutex);
+		const auto lock = LockCache();
 
-		while (GetBytes() > max_bytes && frame_numbers.size() > 20)
+		while (total_bytes > max_bytes && frames.Count() > 20)
 		{
-			// Get the oldest frame number.
-			int64_t frame_to_remove = frame_numbers.back();
-
-			// Remove frame_number and frame
-			Remove(frame_to_remove);
+			// Remove the oldest (or cheapest) frame
+			EvictFrame();
 		}
 	}
 }
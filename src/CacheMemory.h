@@ -14,6 +14,7 @@
 #define OPENSHOT_CACHE_MEMORY_H
 
 #include "CacheBase.h"
+#include "CacheLRU.h"
 
 namespace openshot {
 	class Frame;
@@ -25,15 +26,42 @@ namespace openshot {
 	 * high cost of decoding streams, once a frame is decoded, converted to RGB, and a Frame object is created,
 	 * it critical to keep these Frames cached for performance reasons.  However, the larger the cache, the more memory
 	 * is required.  You can set the max number of bytes to cache.
+	 *
+	 * Frames are kept in least-recently-used order (with a hash index), so adding, finding, freshening, and
+	 * removing a frame are constant time. The size of each frame is measured when it is added (or re-added).
+	 *
+	 * With the CACHE_EVICTION_GREEDY_DUAL_SIZE policy, each frame has a priority of L + (render time / bytes),
+	 * where L is the priority of the last evicted frame, and the frame with the lowest priority is evicted first.
+	 * Frames which were expensive to produce (i.e. slow effects) last longer per byte than frames which can be
+	 * decoded again quickly, and frames which are no longer used still age out as L rises.
 	 */
 	class CacheMemory : public CacheBase {
 	private:
-		std::map<int64_t, std::shared_ptr<openshot::Frame> > frames;	///< This map holds the frame number and Frame objects
-		std::deque<int64_t> frame_numbers;	///< This queue holds a sequential list of cached Frame numbers
+		/// A cached frame (and its size in bytes, when it was added)
+		struct CachedFrame {
+			std::shared_ptr<openshot::Frame> frame;
+			int64_t bytes;
+			double priority; ///< Eviction priority (used by CACHE_EVICTION_GREEDY_DUAL_SIZE)
+		};
+
+		CacheLRU<CachedFrame> frames; ///< Cached frames (most recently used first)
+		int64_t total_bytes; ///< Total size of all cached frames
+		openshot::CacheEvictionPolicy eviction_policy; ///< Which frame is evicted first
+		std::set<std::pair<double, int64_t>> priorities; ///< Eviction priorities and frame numbers (lowest first)
+		double inflation; ///< Priority of the last evicted frame (L, which ages the remaining frames)
+
+		/// Remove the next frame to evict (the most recently used frame is never evicted)
+		void EvictFrame();
+
+		/// Calculate the eviction priority of a frame, and update the priority index
+		void UpdatePriority(int64_t frame_number, CachedFrame& cached);
 
 		/// Clean up cached frames that exceed the max number of bytes
 		void CleanUp();
 
+		/// Get a frame (without counting a lookup, since enumerating the cache is not a hit)
+		std::shared_ptr<openshot::Frame> ReadFrame(int64_t frame_number);
+
 	public:
 		/// Default constructor, no max bytes
 		CacheMemory();
@@ -59,6 +87,9 @@ namespace openshot {
 		/// Count the frames in the queue
 		int64_t Count();
 
+		/// Remove the next frame to evict (used by the CacheManager)
+		bool EvictOldest();
+
 		/// @brief Get a frame from the cache
 		/// @param frame_number The frame number of the cached frame
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t frame_number);
@@ -69,6 +100,12 @@ namespace openshot {
 		/// Gets the maximum bytes value
 		int64_t GetBytes();
 
+		/// Get the eviction policy of this cache
+		openshot::CacheEvictionPolicy GetEvictionPolicy() { return eviction_policy; };
+
+		/// Get the microseconds since the least recently used frame was used (-1 = nothing to evict)
+		int64_t GetOldestAge();
+
 		/// Get the smallest frame number
 		std::shared_ptr<openshot::Frame> GetSmallestFrame();
 
@@ -85,6 +122,10 @@ namespace openshot {
 		/// @param end_frame_number The ending frame number of the cached frame
 		void Remove(int64_t start_frame_number, int64_t end_frame_number);
 
+		/// @brief Set the eviction policy of this cache (the default is Settings::CACHE_EVICTION_POLICY)
+		/// @param policy Which frame is evicted first, when this cache exceeds its max bytes (or the global memory limit)
+		void SetEvictionPolicy(openshot::CacheEvictionPolicy policy);
+
 		// Get and Set JSON methods
 		std::string Json(); ///< Generate JSON string of this object
 		void SetJson(const std::string value); ///< Load JSON string into this object
@@ -0,0 +1,425 @@
+/**
+ * @file
+ * @brief Source file for CacheTiered class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "CacheTiered.h"
+#include "CacheManager.h"
+#include "Exceptions.h"
+#include "Frame.h"
+
+using namespace std;
+using namespace openshot;
+
+// Default constructor, no max bytes
+CacheTiered::CacheTiered(std::string cache_path)
+	: CacheBase(0), disk(cache_path, "RAW", 1.0, 1.0), memory_bytes(0), max_disk_bytes(0) {
+	// Set cache type name
+	cache_type = "CacheTiered";
+	range_version = 0;
+	needs_range_processing = false;
+
+	// Include the memory tier in the global memory limit
+	CacheManager::Instance()->Register(this);
+}
+
+// Constructor that sets the max bytes of each tier
+CacheTiered::CacheTiered(std::string cache_path, int64_t max_bytes, int64_t max_disk_bytes)
+	: CacheBase(max_bytes), disk(cache_path, "RAW", 1.0, 1.0), memory_bytes(0), max_disk_bytes(max_disk_bytes) {
+	// Set cache type name
+	cache_type = "CacheTiered";
+	range_version = 0;
+	needs_range_processing = false;
+
+	// Include the memory tier in the global memory limit
+	CacheManager::Instance()->Register(this);
+}
+
+// Default destructor
+CacheTiered::~CacheTiered()
+{
+	// Stop evicting frames from this cache
+	CacheManager::Instance()->Unregister(this);
+	Clear();
+
+	// remove mutex
+	delete cacheMutex;
+}
+
+// Add a Frame to the cache
+void CacheTiered::Add(std::shared_ptr<Frame> frame)
+{
+	{
+		// Create a scoped lock, to protect the cache from multiple threads
+		const auto lock = LockCache();
+		int64_t frame_number = frame->number;
+
+		// Freshen frame if it already exists
+		CachedFrame* existing = memory_frames.Find(frame_number);
+		if (existing)
+		{
+			// Update size (the cached frame may have changed since it was added)
+			int64_t bytes = existing->frame->GetBytes();
+			memory_bytes += bytes - existing->bytes;
+			existing->bytes = bytes;
+
+			// Move frame to front of queue
+			memory_frames.Touch(frame_number);
+		}
+		else
+		{
+			if (disk_frames.Remove(frame_number))
+				// Replace the frame on disk (with the frame in memory)
+				disk.Remove(frame_number);
+			else {
+				ordered_frame_numbers.insert(frame_number);
+				needs_range_processing = true;
+			}
+
+			// Add frame to the front of the memory tier
+			int64_t bytes = frame->GetBytes();
+			memory_frames.Add(frame_number, CachedFrame{frame, bytes});
+			memory_bytes += bytes;
+			RecordInsert();
+		}
+
+		// Clean up old frames
+		CleanUp();
+	}
+
+	// Evict frames from all caches (if over the global memory limit)
+	CacheManager::Instance()->CleanUp();
+}
+
+// Move a frame from the disk tier to the front of the memory tier
+std::shared_ptr<Frame> CacheTiered::Promote(int64_t frame_number)
+{
+	std::shared_ptr<Frame> frame = disk.GetFrame(frame_number);
+	disk.Remove(frame_number);
+	disk_frames.Remove(frame_number);
+
+	if (!frame) {
+		// Frame is missing from disk
+		ordered_frame_numbers.erase(frame_number);
+		needs_range_processing = true;
+		return frame;
+	}
+
+	int64_t bytes = frame->GetBytes();
+	memory_frames.Add(frame_number, CachedFrame{frame, bytes});
+	memory_bytes += bytes;
+
+	// Demote older frames (if needed)
+	CleanUp();
+	return frame;
+}
+
+// Check if frame is already contained in cache
+bool CacheTiered::Contains(int64_t frame_number) {
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return memory_frames.Contains(frame_number) || disk_frames.Contains(frame_number);
+}
+
+// Get a frame from the cache (or NULL shared_ptr if no frame is found)
+std::shared_ptr<Frame> CacheTiered::GetFrame(int64_t frame_number)
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// Does frame exists in memory?
+	CachedFrame* cached = memory_frames.Find(frame_number);
+	if (cached) {
+		RecordLookup(true);
+		return cached->frame;
+	}
+
+	// Promote frame from disk (if found)
+	std::shared_ptr<Frame> frame;
+	if (disk_frames.Contains(frame_number))
+		frame = Promote(frame_number);
+
+	RecordLookup(frame != nullptr);
+	return frame;
+}
+
+// Get a frame from either tier (without promoting it)
+std::shared_ptr<Frame> CacheTiered::ReadFrame(int64_t frame_number)
+{
+	CachedFrame* cached = memory_frames.Find(frame_number);
+	if (cached)
+		return cached->frame;
+	if (disk_frames.Contains(frame_number))
+		return disk.GetFrame(frame_number);
+	return std::shared_ptr<Frame>();
+}
+
+// @brief Get an array of all Frames
+std::vector<std::shared_ptr<openshot::Frame>> CacheTiered::GetFrames()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// Loop through frames (sorted by frame number)
+	std::vector<std::shared_ptr<openshot::Frame>> all_frames;
+	all_frames.reserve(ordered_frame_numbers.size());
+	for (int64_t frame_number : ordered_frame_numbers)
+		all_frames.push_back(ReadFrame(frame_number));
+
+	return all_frames;
+}
+
+// Get the smallest frame number (or NULL shared_ptr if no frame is found)
+std::shared_ptr<Frame> CacheTiered::GetSmallestFrame()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// Return frame (if any)
+	if (!ordered_frame_numbers.empty()) {
+		return ReadFrame(*ordered_frame_numbers.begin());
+	} else {
+		return NULL;
+	}
+}
+
+// Gets the total bytes of both tiers
+int64_t CacheTiered::GetBytes()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return memory_bytes + disk.GetBytes();
+}
+
+// Gets the bytes of the disk tier
+int64_t CacheTiered::GetDiskBytes()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return disk.GetBytes();
+}
+
+// Remove a specific frame
+void CacheTiered::Remove(int64_t frame_number)
+{
+	Remove(frame_number, frame_number);
+}
+
+// Remove range of frames
+void CacheTiered::Remove(int64_t start_frame_number, int64_t end_frame_number)
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+	if (start_frame_number > end_frame_number)
+		return;
+
+	// Loop through cached frame numbers in this range
+	auto itr_ordered = ordered_frame_numbers.lower_bound(start_frame_number);
+	auto itr_end = ordered_frame_numbers.upper_bound(end_frame_number);
+	while (itr_ordered != itr_end)
+	{
+		// erase frame (from either tier)
+		CachedFrame* cached = memory_frames.Find(*itr_ordered);
+		if (cached)
+			memory_bytes -= cached->bytes;
+		memory_frames.Remove(*itr_ordered);
+		disk_frames.Remove(*itr_ordered);
+		itr_ordered = ordered_frame_numbers.erase(itr_ordered);
+	}
+	disk.Remove(start_frame_number, end_frame_number);
+	UpdateMemoryUsage(memory_bytes);
+
+	// Needs range processing (since cache has changed)
+	needs_range_processing = true;
+}
+
+// Move frame to front of queue (so it lasts longer)
+void CacheTiered::MoveToFront(int64_t frame_number)
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	if (!memory_frames.Touch(frame_number) && disk_frames.Contains(frame_number))
+		Promote(frame_number);
+}
+
+// Clear the cache of all frames
+void CacheTiered::Clear()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	memory_frames.Clear();
+	disk_frames.Clear();
+	disk.Clear();
+	ordered_frame_numbers.clear();
+	memory_bytes = 0;
+	UpdateMemoryUsage(0);
+	needs_range_processing = true;
+}
+
+// Count the frames in the queue
+int64_t CacheTiered::Count()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// Return the number of frames in the cache
+	return memory_frames.Count() + disk_frames.Count();
+}
+
+// Count the frames in the disk tier
+int64_t CacheTiered::CountOnDisk()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	return disk_frames.Count();
+}
+
+// Move the oldest frame in memory to the front of the disk tier
+void CacheTiered::DemoteOldest()
+{
+	int64_t frame_number = memory_frames.Oldest();
+	CachedFrame* cached = memory_frames.Find(frame_number);
+	disk.Add(cached->frame);
+	disk_frames.Add(frame_number, true);
+	memory_bytes -= cached->bytes;
+	memory_frames.Remove(frame_number);
+}
+
+// Get the microseconds since the least recently used frame in memory was used (-1 = nothing to evict)
+int64_t CacheTiered::GetOldestAge()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// The most recently used frame is never demoted
+	return (memory_frames.Count() > 1) ? memory_frames.OldestAge() : -1;
+}
+
+// Demote the least recently used frame in memory to disk (used by the CacheManager)
+bool CacheTiered::EvictOldest()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	if (memory_frames.Count() <= 1)
+		return false;
+	DemoteOldest();
+
+	// Remove the oldest frames on disk (if needed)
+	CleanUp();
+	return true;
+}
+
+// Demote (and remove) cached frames that exceed the max bytes of each tier
+void CacheTiered::CleanUp()
+{
+	// Create a scoped lock, to protect the cache from multiple threads
+	const auto lock = LockCache();
+
+	// Demote the oldest frames in memory to the front of the disk tier
+	if (max_bytes > 0)
+	{
+		while (memory_bytes > max_bytes && memory_frames.Count() > 20)
+			DemoteOldest();
+	}
+
+	// Remove the oldest frames on disk
+	if (max_disk_bytes > 0)
+	{
+		while (disk.GetBytes() > max_disk_bytes && disk_frames.Count() > 0)
+		{
+			int64_t frame_number = disk_frames.Oldest();
+			int64_t disk_bytes = disk.GetBytes();
+			disk.Remove(frame_number);
+			RecordEviction(disk_bytes - disk.GetBytes());
+			disk_frames.Remove(frame_number);
+			ordered_frame_numbers.erase(frame_number);
+			needs_range_processing = true;
+		}
+	}
+
+	// Update global memory usage
+	UpdateMemoryUsage(memory_bytes);
+}
+
+// Generate JSON string of this object
+std::string CacheTiered::Json() {
+
+	// Return formatted string
+	return JsonValue().toStyledString();
+}
+
+// Generate Json::Value for this object
+Json::Value CacheTiered::JsonValue() {
+
+	// Process range data (if anything has changed)
+	CalculateRanges();
+
+	// Create root json object
+	Json::Value root = CacheBase::JsonValue(); // get parent properties
+	root["type"] = cache_type;
+	root["path"] = disk.JsonValue()["path"];
+	root["max_disk_bytes"] = std::to_string(max_disk_bytes);
+
+	root["version"] = std::to_string(range_version);
+
+	// Parse and append range data (if any)
+	try {
+		const Json::Value ranges = openshot::stringToJson(json_ranges);
+		root["ranges"] = ranges;
+	} catch (...) { }
+
+	// return JsonValue
+	return root;
+}
+
+// Load JSON string into this object
+void CacheTiered::SetJson(const std::string value) {
+
+	try
+	{
+		// Parse string to Json::Value
+		const Json::Value root = openshot::stringToJson(value);
+		// Set all values that match
+		SetJsonValue(root);
+	}
+	catch (const std::exception& e)
+	{
+		// Error parsing JSON (or missing keys)
+		throw InvalidJSON("JSON is invalid (missing keys or invalid data types)");
+	}
+}
+
+// Load Json::Value into this object
+void CacheTiered::SetJsonValue(const Json::Value root) {
+
+	// Close timeline before we do anything (this also removes all open and closing clips)
+	Clear();
+
+	// Set parent data
+	CacheBase::SetJsonValue(root);
+
+	if (!root["type"].isNull())
+		cache_type = root["type"].asString();
+	if (!root["max_disk_bytes"].isNull())
+		max_disk_bytes = std::stoll(root["max_disk_bytes"].asString());
+	if (!root["path"].isNull()) {
+		// Update path of disk tier
+		Json::Value disk_root;
+		disk_root["path"] = root["path"];
+		disk.SetJsonValue(disk_root);
+	}
+}
@@ -0,0 +1,146 @@
+/**
+ * @file
+ * @brief Header file for CacheTiered class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_CACHE_TIERED_H
+#define OPENSHOT_CACHE_TIERED_H
+
+#include "CacheBase.h"
+#include "CacheDisk.h"
+#include "CacheLRU.h"
+
+namespace openshot {
+	class Frame;
+
+	/**
+	 * @brief This class is a two-tier (memory over disk) cache manager for Frame objects.
+	 *
+	 * Recently used frames are kept in memory (up to the max bytes of the cache). Once exceeded, the oldest
+	 * frames in memory are demoted to a disk tier (a CacheDisk using raw segment files), instead of being
+	 * removed, and frames found on disk are promoted back into memory. Both tiers form a single LRU list
+	 * (all frames in memory are more recently used than all frames on disk), so frames are only removed
+	 * from the cache once they are the oldest frames on disk, and the disk tier exceeds its max bytes.
+	 *
+	 * @code
+	 * // 2 GB of frames in memory, and 40 GB on disk
+	 * openshot::CacheTiered* cache = new openshot::CacheTiered("/home/user/.openshot/cache/", 2147483648, 42949672960);
+	 * timeline.SetCache(cache);
+	 * @endcode
+	 */
+	class CacheTiered : public CacheBase {
+	private:
+		/// A frame in the memory tier (and its size in bytes, when it was added)
+		struct CachedFrame {
+			std::shared_ptr<openshot::Frame> frame;
+			int64_t bytes;
+		};
+
+		CacheLRU<CachedFrame> memory_frames; ///< Frames in the memory tier (most recently used first)
+		CacheLRU<bool> disk_frames; ///< Frame numbers in the disk tier (most recently used first)
+		CacheDisk disk; ///< The disk tier
+		int64_t memory_bytes; ///< Total size of the frames in the memory tier
+		int64_t max_disk_bytes; ///< The max number of bytes in the disk tier (0 = no limit)
+
+		/// Demote the oldest frames to disk (and remove the oldest frames on disk) that exceed the max bytes
+		void CleanUp();
+
+		/// Move the oldest frame in memory to the front of the disk tier
+		void DemoteOldest();
+
+		/// Move a frame from the disk tier to the front of the memory tier (or NULL if not found)
+		std::shared_ptr<openshot::Frame> Promote(int64_t frame_number);
+
+		/// Get a frame from either tier (without promoting it)
+		std::shared_ptr<openshot::Frame> ReadFrame(int64_t frame_number);
+
+	public:
+		/// @brief Default constructor, no max bytes (frames are never demoted)
+		/// @param cache_path The folder path of the disk tier (empty string = /tmp/preview-cache/)
+		CacheTiered(std::string cache_path);
+
+		/// @brief Constructor that sets the max bytes of each tier
+		/// @param cache_path The folder path of the disk tier (empty string = /tmp/preview-cache/)
+		/// @param max_bytes The maximum bytes to allow in memory. Once exceeded, the oldest frames are demoted to disk.
+		/// @param max_disk_bytes The maximum bytes to allow on disk (0 = no limit). Once exceeded, the cache will purge the oldest frames.
+		CacheTiered(std::string cache_path, int64_t max_bytes, int64_t max_disk_bytes);
+
+		// Default destructor
+		virtual ~CacheTiered();
+
+		/// @brief Add a Frame to the cache (in memory)
+		/// @param frame The openshot::Frame object needing to be cached.
+		void Add(std::shared_ptr<openshot::Frame> frame);
+
+		/// Clear the cache of all frames
+		void Clear();
+
+		/// @brief Check if frame is already contained in cache
+		/// @param frame_number The frame number to be checked
+		bool Contains(int64_t frame_number);
+
+		/// Count the frames in the queue
+		int64_t Count();
+
+		/// Demote the least recently used frame in memory to disk (used by the CacheManager)
+		bool EvictOldest();
+
+		/// Count the frames in the disk tier
+		int64_t CountOnDisk();
+
+		/// @brief Get a frame from the cache (frames found on disk are promoted to memory)
+		/// @param frame_number The frame number of the cached frame
+		std::shared_ptr<openshot::Frame> GetFrame(int64_t frame_number);
+
+		/// @brief Get an array of all Frames (without promoting them)
+		std::vector<std::shared_ptr<openshot::Frame>> GetFrames();
+
+		/// Gets the total bytes of both tiers
+		int64_t GetBytes();
+
+		/// Gets the bytes of the disk tier
+		int64_t GetDiskBytes();
+
+		/// Gets the max bytes of the disk tier (0 = no limit)
+		int64_t GetMaxDiskBytes() { return max_disk_bytes; };
+
+		/// Get the microseconds since the least recently used frame in memory was used (-1 = nothing to evict)
+		int64_t GetOldestAge();
+
+		/// Get the smallest frame number
+		std::shared_ptr<openshot::Frame> GetSmallestFrame();
+
+		/// @brief Move frame to front of queue (so it lasts longer), and promote it to memory (if needed)
+		/// @param frame_number The frame number of the cached frame
+		void MoveToFront(int64_t frame_number);
+
+		/// @brief Remove a specific frame
+		/// @param frame_number The frame number of the cached frame
+		void Remove(int64_t frame_number);
+
+		/// @brief Remove a range of frames
+		/// @param start_frame_number The starting frame number of the cached frame
+		/// @param end_frame_number The ending frame number of the cached frame
+		void Remove(int64_t start_frame_number, int64_t end_frame_number);
+
+		/// @brief Set the max bytes of the disk tier
+		/// @param number_of_bytes The maximum bytes to allow on disk (0 = no limit)
+		void SetMaxDiskBytes(int64_t number_of_bytes) { max_disk_bytes = number_of_bytes; };
+
+		// Get and Set JSON methods
+		std::string Json(); ///< Generate JSON string of this object
+		void SetJson(const std::string value); ///< Load JSON string into this object
+		Json::Value JsonValue(); ///< Generate Json::Value for this object
+		void SetJsonValue(const Json::Value root); ///< Load Json::Value into this object
+	};
+
+}
+
+#endif
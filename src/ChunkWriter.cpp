@@ -13,12 +13,14 @@
 #include "ChunkWriter.h"
 #include "Exceptions.h"
 #include "Frame.h"
+#include "FrameStream.h"
 
 using namespace openshot;
 
 ChunkWriter::ChunkWriter(std::string path, ReaderBase *reader) :
 		local_reader(reader), path(path), chunk_size(24*3), chunk_count(1), frame_count(1), is_writing(false),
-		default_extension(".webm"), default_vcodec("libvpx"), default_acodec("libvorbis"), last_frame_needed(false), is_open(false)
+		default_extension(".webm"), default_vcodec("libvpx"), default_acodec("libvorbis"), last_frame_needed(false), is_open(false),
+		writer_thumb(NULL), writer_preview(NULL), writer_final(NULL), writer_renditions(NULL)
 {
 	// Change codecs to default
 	info.vcodec = default_vcodec;
@@ -101,6 +103,13 @@ void ChunkWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame)
 		writer_preview->WriteHeader();
 		writer_thumb->WriteHeader();
 
+		// Encode the 3 qualities in parallel (each frame is scaled once per quality)
+		writer_renditions = new RenditionWriter();
+		writer_renditions->AddRendition(writer_final);
+		writer_renditions->AddRendition(writer_preview);
+		writer_renditions->AddRendition(writer_thumb);
+		writer_renditions->Open();
+
 		// Keep track that a chunk is being written
 		is_writing = true;
 		last_frame_needed = true;
@@ -113,18 +122,14 @@ void ChunkWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame)
 		if (last_frame)
 		{
 			// Write the previous chunks LAST FRAME to the current chunk
-			writer_final->WriteFrame(last_frame);
-			writer_preview->WriteFrame(last_frame);
-			writer_thumb->WriteFrame(last_frame);
+			writer_renditions->WriteFrame(last_frame);
 		} else {
 			// Write the 1st frame (of the 1st chunk)... since no previous chunk is available
 			auto blank_frame = std::make_shared<Frame>(
 				1, info.width, info.height, "#000000",
 				info.sample_rate, info.channels);
 			blank_frame->AddColor(info.width, info.height, "#000000");
-			writer_final->WriteFrame(blank_frame);
-			writer_preview->WriteFrame(blank_frame);
-			writer_thumb->WriteFrame(blank_frame);
+			writer_renditions->WriteFrame(blank_frame);
 		}
 
 		// disable last frame
@@ -134,9 +139,7 @@ void ChunkWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame)
 
 	//////////////////////////////////////////////////
 	// WRITE THE CURRENT FRAME TO THE CURRENT CHUNK
-	writer_final->WriteFrame(frame);
-	writer_preview->WriteFrame(frame);
-	writer_thumb->WriteFrame(frame);
+	writer_renditions->WriteFrame(frame);
 	//////////////////////////////////////////////////
 
 
@@ -147,20 +150,19 @@ void ChunkWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame)
 		for (int z = 0; z<12; z++)
 		{
 			// Repeat frame
-			writer_final->WriteFrame(frame);
-			writer_preview->WriteFrame(frame);
-			writer_thumb->WriteFrame(frame);
+			writer_renditions->WriteFrame(frame);
 		}
 
-		// Write Footer
-		writer_final->WriteTrailer();
-		writer_preview->WriteTrailer();
-		writer_thumb->WriteTrailer();
-
-		// Close writer & reader
-		writer_final->Close();
-		writer_preview->Close();
-		writer_thumb->Close();
+		// Encode the queued frames, write footers, and close writers
+		writer_renditions->Close();
+		delete writer_renditions;
+		delete writer_final;
+		delete writer_preview;
+		delete writer_thumb;
+		writer_renditions = NULL;
+		writer_final = NULL;
+		writer_preview = NULL;
+		writer_thumb = NULL;
 
 		// Increment chunk count
 		chunk_count++;
@@ -180,11 +182,10 @@ void ChunkWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame)
 // Write a block of frames from a reader
 void ChunkWriter::WriteFrame(ReaderBase* reader, int64_t start, int64_t length)
 {
-	// Loop through each frame (and encoded it)
-	for (int64_t number = start; number <= length; number++)
+	// Loop through each frame (and encoded it), while the next frames are read ahead
+	std::shared_ptr<FrameStream> stream = reader->GetFrames(start, length - start + 1);
+	while (std::shared_ptr<Frame> f = stream->Next())
 	{
-		// Get the frame
-		std::shared_ptr<Frame> f = reader->GetFrame(number);
 
 		// Encode frame
 		WriteFrame(f);
@@ -194,11 +195,10 @@ void ChunkWriter::WriteFrame(ReaderBase* reader, int64_t start, int64_t length)
 // Write a block of frames from the local cached reader
 void ChunkWriter::WriteFrame(int64_t start, int64_t length)
 {
-	// Loop through each frame (and encoded it)
-	for (int64_t number = start; number <= length; number++)
+	// Loop through each frame (and encoded it), while the next frames are read ahead
+	std::shared_ptr<FrameStream> stream = local_reader->GetFrames(start, length - start + 1);
+	while (std::shared_ptr<Frame> f = stream->Next())
 	{
-		// Get the frame
-		std::shared_ptr<Frame> f = local_reader->GetFrame(number);
 
 		// Encode frame
 		WriteFrame(f);
@@ -215,20 +215,19 @@ void ChunkWriter::Close()
 		for (int z = 0; z<12; z++)
 		{
 			// Repeat frame
-			writer_final->WriteFrame(last_frame);
-			writer_preview->WriteFrame(last_frame);
-			writer_thumb->WriteFrame(last_frame);
+			writer_renditions->WriteFrame(last_frame);
 		}
 
-		// Write Footer
-		writer_final->WriteTrailer();
-		writer_preview->WriteTrailer();
-		writer_thumb->WriteTrailer();
-
-		// Close writer & reader
-		writer_final->Close();
-		writer_preview->Close();
-		writer_thumb->Close();
+		// Encode the queued frames, write footers, and close writers
+		writer_renditions->Close();
+		delete writer_renditions;
+		delete writer_final;
+		delete writer_preview;
+		delete writer_thumb;
+		writer_renditions = NULL;
+		writer_final = NULL;
+		writer_preview = NULL;
+		writer_thumb = NULL;
 
 		// Increment chunk count
 		chunk_count++;
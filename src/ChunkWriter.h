@@ -16,6 +16,7 @@
 #include "ReaderBase.h"
 #include "WriterBase.h"
 #include "FFmpegWriter.h"
+#include "RenditionWriter.h"
 #include "CacheMemory.h"
 #include "Json.h"
 
@@ -40,6 +41,9 @@ namespace openshot
 	 * computing environment, without needing to share the entire video file. They also allow a
 	 * chunk to be frame accurate, since seeking inaccuracies are removed.
 	 *
+	 * Each chunk is written in 3 qualities (final, preview, and thumb) by a RenditionWriter, which
+	 * downscales each frame once per quality, and encodes the qualities in parallel.
+	 *
 	 * @code
 	 * // This example demonstrates how to feed a reader into a ChunkWriter
 	 * FFmpegReader *r = new FFmpegReader("MyAwesomeVideo.mp4"); // Get a reader
@@ -72,6 +76,7 @@ namespace openshot
 		openshot::FFmpegWriter *writer_thumb;
 		openshot::FFmpegWriter *writer_preview;
 		openshot::FFmpegWriter *writer_final;
+		openshot::RenditionWriter *writer_renditions; ///< Scales each frame once, and encodes the 3 qualities in parallel
 	    std::shared_ptr<Frame> last_frame;
 	    bool last_frame_needed;
 	    std::string default_extension;
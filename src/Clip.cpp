@@ -16,8 +16,11 @@
 #include "Exceptions.h"
 #include "FFmpegReader.h"
 #include "FrameMapper.h"
+#include "FrameStream.h"
 #include "QtImageReader.h"
 #include "ChunkReader.h"
+#include "ColorChain.h"
+#include "Compositor.h"
 #include "DummyReader.h"
 #include "Timeline.h"
 #include "ZmqLogger.h"
@@ -28,6 +31,8 @@
 	#include "TextReader.h"
 #endif
 
+#include <chrono>
+
 #include <Qt>
 
 using namespace openshot;
@@ -49,6 +54,9 @@ void Clip::init_settings()
 	previous_properties = "";
 	parentObjectId = "";
 
+	// Keep final clip frames longer than reader frames (when over the global memory limit)
+	final_cache.SetLevel(CACHE_LEVEL_CLIP);
+
 	// Init scale curves
 	scale_x = Keyframe(1.0);
 	scale_y = Keyframe(1.0);
@@ -296,6 +304,7 @@ void Clip::Reader(ReaderBase* new_reader)
 
 	// set reader pointer
 	reader = new_reader;
+	PropertiesChanged();
 
 	// set parent
 	if (reader) {
@@ -325,8 +334,9 @@ void Clip::Open()
 		reader->Open();
 		is_open = true;
 
-		// Copy Reader info to Clip
+		// Copy Reader info to Clip (the JSON of the reader includes its info)
 		info = reader->info;
+		PropertiesChanged();
 
 		// Set some clip properties from the file reader
 		if (end == 0.0)
@@ -394,6 +404,20 @@ std::shared_ptr<Frame> Clip::GetFrame(int64_t clip_frame_number)
 	return GetFrame(NULL, clip_frame_number, NULL);
 }
 
+// Get a range of frames (in order) of this clip, which are processed ahead of the caller
+std::shared_ptr<openshot::FrameStream> Clip::GetFrames(int64_t start, int64_t count)
+{
+	auto stream = std::make_shared<FrameStream>([this](int64_t number) { return GetFrame(number); }, start, count);
+
+	// Read ahead from the source reader (clip frames match reader frames, unless time mapped)
+	if (reader && time.GetLength() <= 1 && count > 0) {
+		FrameStream::FrameMapping mapping = [this](int64_t number) { return adjust_frame_number_minimum(number); };
+		stream->AddUpstream(reader->GetFrames(mapping(start), count), mapping);
+	}
+
+	return stream;
+}
+
 // Create an openshot::Frame object for a specific frame number of this reader.
 // NOTE: background_frame is ignored in this method (this method is only used by Effect classes)
 std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> background_frame, int64_t clip_frame_number)
@@ -404,6 +428,26 @@ std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> backgroun
 
 // Use an existing openshot::Frame object and draw this Clip's frame onto it
 std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> background_frame, int64_t clip_frame_number, openshot::TimelineInfoStruct* options)
+{
+	// Get the processed clip frame (with all keyframes and effects)
+	std::shared_ptr<Frame> frame = GetLayerFrame(background_frame, clip_frame_number, options);
+
+	if (!background_frame) {
+		// Create missing background_frame w/ transparent color (if needed)
+		background_frame = std::make_shared<Frame>(frame->number, frame->GetWidth(), frame->GetHeight(),
+												   "#00000000",  frame->GetAudioSamplesCount(),
+												   frame->GetAudioChannelsCount());
+	}
+
+	// Apply background canvas (i.e. flatten this image onto previous layer image)
+	apply_background(frame, background_frame);
+
+	// Return processed 'frame'
+	return frame;
+}
+
+// Get the processed frame of this clip (without flattening it onto the background_frame)
+std::shared_ptr<Frame> Clip::GetLayerFrame(std::shared_ptr<openshot::Frame> background_frame, int64_t clip_frame_number, openshot::TimelineInfoStruct* options)
 {
 	// Check for open reader (or throw exception)
 	if (!is_open)
@@ -417,47 +461,42 @@ std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> backgroun
 		// Check cache
 		frame = final_cache.GetFrame(clip_frame_number);
 		if (!frame) {
-            // Generate clip frame
-            frame = GetOrCreateFrame(clip_frame_number);
-
-            // Get frame size and frame #
-            int64_t timeline_frame_number = clip_frame_number;
-            QSize timeline_size(frame->GetWidth(), frame->GetHeight());
-            if (background_frame) {
-                // If a background frame is provided, use it instead
-                timeline_frame_number = background_frame->number;
-                timeline_size.setWidth(background_frame->GetWidth());
-                timeline_size.setHeight(background_frame->GetHeight());
-            }
-
-            // Get time mapped frame object (used to increase speed, change direction, etc...)
-            apply_timemapping(frame);
-
-            // Apply waveform image (if any)
-            apply_waveform(frame, timeline_size);
+			// Measure the render time of this frame (used by cost-aware caches)
+			auto start_time = std::chrono::steady_clock::now();
+
+			// Generate clip frame
+			frame = GetOrCreateFrame(clip_frame_number);
+
+			// Get frame size and frame #
+			int64_t timeline_frame_number = clip_frame_number;
+			QSize timeline_size(frame->GetWidth(), frame->GetHeight());
+			if (background_frame) {
+				// If a background frame is provided, use it instead
+				timeline_frame_number = background_frame->number;
+				timeline_size.setWidth(background_frame->GetWidth());
+				timeline_size.setHeight(background_frame->GetHeight());
+			}
 
-            // Apply effects BEFORE applying keyframes (if any local or global effects are used)
-            apply_effects(frame, timeline_frame_number, options, true);
+			// Get time mapped frame object (used to increase speed, change direction, etc...)
+			apply_timemapping(frame);
 
-            // Apply keyframe / transforms to current clip image
-            apply_keyframes(frame, timeline_size);
+			// Apply waveform image (if any)
+			apply_waveform(frame, timeline_size);
 
-            // Apply effects AFTER applying keyframes (if any local or global effects are used)
-            apply_effects(frame, timeline_frame_number, options, false);
+			// Apply effects BEFORE applying keyframes (if any local or global effects are used)
+			apply_effects(frame, timeline_frame_number, options, true);
 
-            // Add final frame to cache (before flattening into background_frame)
-            final_cache.Add(frame);
-        }
+			// Apply keyframe / transforms to current clip image
+			apply_keyframes(frame, timeline_size);
 
-        if (!background_frame) {
-            // Create missing background_frame w/ transparent color (if needed)
-            background_frame = std::make_shared<Frame>(frame->number, frame->GetWidth(), frame->GetHeight(),
-                                                       "#00000000",  frame->GetAudioSamplesCount(),
-                                                       frame->GetAudioChannelsCount());
-        }
+			// Apply effects AFTER applying keyframes (if any local or global effects are used)
+			apply_effects(frame, timeline_frame_number, options, false);
+			frame->SetRenderTime(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start_time).count());
 
-		// Apply background canvas (i.e. flatten this image onto previous layer image)
-		apply_background(frame, background_frame);
+			// Add final frame to cache (before flattening into background_frame)
+			final_cache.Add(frame);
+		}
 
 		// Return processed 'frame'
 		return frame;
@@ -467,6 +506,12 @@ std::shared_ptr<Frame> Clip::GetFrame(std::shared_ptr<openshot::Frame> backgroun
 		throw ReaderClosed("No Reader has been initialized for this Clip.  Call Reader(*reader) before calling this method.");
 }
 
+// Flatten a processed frame of this clip onto a background frame
+void Clip::FlattenLayer(std::shared_ptr<openshot::Frame> frame, std::shared_ptr<openshot::Frame> background_frame)
+{
+	apply_background(frame, background_frame);
+}
+
 // Look up an effect by ID
 openshot::EffectBase* Clip::GetEffect(const std::string& id)
 {
@@ -1158,6 +1203,7 @@ void Clip::AddEffect(EffectBase* effect)
 
 	// Clear cache (it might have changed)
 	final_cache.Clear();
+	PropertiesChanged();
 }
 
 // Remove an effect from the clip
@@ -1167,19 +1213,22 @@ void Clip::RemoveEffect(EffectBase* effect)
 
 	// Clear cache (it might have changed)
 	final_cache.Clear();
+	PropertiesChanged();
 }
 
 // Apply background image to the current clip image (i.e. flatten this image onto previous layer)
 void Clip::apply_background(std::shared_ptr<openshot::Frame> frame, std::shared_ptr<openshot::Frame> background_frame) {
 	// Add background canvas
 	std::shared_ptr<QImage> background_canvas = background_frame->GetImage();
-	QPainter painter(background_canvas.get());
-	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
 
 	// Composite a new layer onto the image
-	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-	painter.drawImage(0, 0, *frame->GetImage());
-	painter.end();
+	if (!Compositor::Composite(background_canvas.get(), frame->GetImage().get(), QTransform())) {
+		QPainter painter(background_canvas.get());
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		painter.drawImage(0, 0, *frame->GetImage());
+		painter.end();
+	}
 
 	// Add new QImage to frame
 	frame->AddImage(background_canvas);
@@ -1188,15 +1237,32 @@ void Clip::apply_background(std::shared_ptr<openshot::Frame> frame, std::shared_
 // Apply effects to the source frame (if any)
 void Clip::apply_effects(std::shared_ptr<Frame> frame, int64_t timeline_frame_number, TimelineInfoStruct* options, bool before_keyframes)
 {
+	// Consecutive color effects are fused into a single pass over the image
+	std::vector<ColorOperator> color_operators;
+	auto apply_color_operators = [&]() {
+		if (!color_operators.empty())
+			ColorChain::Apply(frame->GetImage().get(), color_operators);
+		color_operators.clear();
+	};
+
 	for (auto effect : effects)
 	{
-		// Apply the effect to this frame
-		if (effect->info.apply_before_clip && before_keyframes) {
-			effect->GetFrame(frame, frame->number);
-		} else if (!effect->info.apply_before_clip && !before_keyframes) {
-			effect->GetFrame(frame, frame->number);
+		// Skip effects which are applied at the other stage (before or after the clip's keyframes)
+		if (effect->info.apply_before_clip != before_keyframes)
+			continue;
+
+		// Queue color effects
+		ColorOperator color_operator = frame->has_image_data ? effect->GetColorOperator(frame->number) : nullptr;
+		if (color_operator) {
+			color_operators.push_back(color_operator);
+			continue;
 		}
+
+		// Apply the effect to this frame
+		apply_color_operators();
+		effect->ProcessFrame(frame, frame->number);
 	}
+	apply_color_operators();
 
 	if (timeline != NULL && options != NULL) {
 		// Apply global timeline effects (i.e. transitions & masks... if any)
@@ -1230,22 +1296,30 @@ void Clip::apply_keyframes(std::shared_ptr<Frame> frame, QSize timeline_size) {
 	// Get transform from clip's keyframes
 	QTransform transform = get_transform(frame, background_canvas->width(), background_canvas->height());
 
-	// Load timeline's new frame image into a QPainter
-	QPainter painter(background_canvas.get());
-	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
+	// Composite a new layer onto the image (translate and scale are handled by the SIMD compositor,
+	// and QPainter is only used for shear and perspective transforms)
+	if (!Compositor::Composite(background_canvas.get(), source_image.get(), transform)) {
+		// Load timeline's new frame image into a QPainter
+		QPainter painter(background_canvas.get());
+		painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform | QPainter::TextAntialiasing, true);
 
-	// Apply transform (translate, rotate, scale)
-	painter.setTransform(transform);
+		// Apply transform (translate, rotate, scale)
+		painter.setTransform(transform);
 
-	// Composite a new layer onto the image
-	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-	painter.drawImage(0, 0, *source_image);
+		// Composite a new layer onto the image
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+		painter.drawImage(0, 0, *source_image);
+		painter.end();
+	}
 
 	if (timeline) {
 		Timeline *t = static_cast<Timeline *>(timeline);
 
 		// Draw frame #'s on top of image (if needed)
 		if (display != FRAME_DISPLAY_NONE) {
+			QPainter painter(background_canvas.get());
+			painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing, true);
+
 			std::stringstream frame_number_str;
 			switch (display) {
 				case (FRAME_DISPLAY_NONE):
@@ -1268,9 +1342,9 @@ void Clip::apply_keyframes(std::shared_ptr<Frame> frame, QSize timeline_size) {
 			// Draw frame number on top of image
 			painter.setPen(QColor("#ffffff"));
 			painter.drawText(20, 20, QString(frame_number_str.str().c_str()));
+			painter.end();
 		}
 	}
-	painter.end();
 
 	// Add new QImage to frame
 	frame->AddImage(background_canvas);
@@ -242,6 +242,14 @@ namespace openshot {
 		/// @param clip_frame_number The frame number (starting at 1) of the clip
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t clip_frame_number) override;
 
+		/// @brief Get a range of frames (in order) of this clip, which are processed ahead of the caller
+		///
+		/// The source reader is also read ahead (i.e. decoded), in step with this stream (unless time
+		/// mapping is used, since it could request any frame of the reader).
+		/// @param start The first frame number of the clip
+		/// @param count The number of frames
+		std::shared_ptr<openshot::FrameStream> GetFrames(int64_t start, int64_t count) override;
+
 		/// @brief Get an openshot::Frame object for a specific frame number of this clip. The image size and number
 		/// of samples match the background_frame passed in and the timeline (if available).
 		///
@@ -268,6 +276,23 @@ namespace openshot {
 		/// such as, if it's a top clip. This info is used to apply global transitions and masks, if needed.
 		std::shared_ptr<openshot::Frame> GetFrame(std::shared_ptr<openshot::Frame> background_frame, int64_t clip_frame_number, openshot::TimelineInfoStruct* options);
 
+		/// @brief Get the processed openshot::Frame of this clip (with all keyframes and effects applied), without
+		/// flattening it onto a background canvas.
+		///
+		/// This allows the frames of many clips to be processed concurrently, and then flattened (in layer order)
+		/// with FlattenLayer(). The background_frame is not modified (only its size and frame number are used).
+		///
+		/// @returns The processed openshot::Frame object
+		/// @param background_frame The frame object used to determine the canvas size and timeline frame number (optional)
+		/// @param clip_frame_number The frame number (starting at 1) of the clip on the timeline
+		/// @param options The openshot::TimelineInfoStruct pointer, with more details about this specific timeline clip
+		std::shared_ptr<openshot::Frame> GetLayerFrame(std::shared_ptr<openshot::Frame> background_frame, int64_t clip_frame_number, openshot::TimelineInfoStruct* options);
+
+		/// @brief Flatten a processed frame of this clip (from GetLayerFrame) onto a background frame
+		/// @param frame The processed frame of this clip
+		/// @param background_frame The frame object to use as a background canvas (i.e. an existing Timeline openshot::Frame instance)
+		void FlattenLayer(std::shared_ptr<openshot::Frame> frame, std::shared_ptr<openshot::Frame> background_frame);
+
 		/// Open the internal reader
 		void Open() override;
 
@@ -10,15 +10,26 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <atomic>
+
 #include "ClipBase.h"
 #include "Timeline.h"
 
 using namespace openshot;
 
+// Versions of all clips and effects (unique, so a new clip never has the version of a deleted clip)
+static std::atomic<int64_t> clip_versions(0);
+
+// Give the properties a new version (after a property is changed)
+void ClipBase::PropertiesChanged() {
+	version = ++clip_versions;
+}
+
 // Set position on timeline (in seconds)
 void ClipBase::Position(float value) {
 
 	position = value;
+	PropertiesChanged();
 
 	if (ParentTimeline()) {
 		// Resort timeline items (internal clips/effects arrays)
@@ -30,6 +41,7 @@ void ClipBase::Position(float value) {
 // Set layer of clip on timeline (lower number is covered by higher numbers)
 void ClipBase::Layer(int value) {
 	layer = value;
+	PropertiesChanged();
 
 	if (ParentTimeline()) {
 		// Resort timeline items (internal clips/effects arrays)
@@ -41,6 +53,7 @@ void ClipBase::Layer(int value) {
 // Set start position (in seconds) of clip (trim start of video)
 void ClipBase::Start(float value) {
 	start = value;
+	PropertiesChanged();
 
 	if (ParentTimeline()) {
 		// Resort timeline items (internal clips/effects arrays)
@@ -52,6 +65,7 @@ void ClipBase::Start(float value) {
 // Set end position (in seconds) of clip (trim end of video)
 void ClipBase::End(float value) {
 	end = value;
+	PropertiesChanged();
 
 	if (ParentTimeline()) {
 		// Resort timeline items (internal clips/effects arrays)
@@ -78,6 +92,7 @@ Json::Value ClipBase::JsonValue() const {
 
 // Load Json::Value into this object
 void ClipBase::SetJsonValue(const Json::Value root) {
+	PropertiesChanged();
 
 	// Set data from Json (if key is found)
 	if (!root["id"].isNull())
@@ -39,6 +39,7 @@ namespace openshot {
 		float end; ///< The position in seconds to end playing (used to trim the ending of a clip)
 		std::string previous_properties; ///< This string contains the previous JSON properties
 		openshot::TimelineBase* timeline; ///< Pointer to the parent timeline instance (if any)
+		int64_t version; ///< Version of the properties (see Version)
 
 		/// Generate JSON for a property
 		Json::Value add_property_json(std::string name, float value, std::string type, std::string memo, const Keyframe* keyframe, float min_value, float max_value, bool readonly, int64_t requested_frame) const;
@@ -46,6 +47,9 @@ namespace openshot {
 		/// Generate JSON choice for a property (dropdown properties)
 		Json::Value add_property_choice_json(std::string name, int value, int selected_value) const;
 
+		/// Give the properties a new version (after a property is changed)
+		void PropertiesChanged();
+
 	public:
 		/// Constructor for the base clip
 		ClipBase() :
@@ -54,7 +58,8 @@ namespace openshot {
 			start(0.0),
 			end(0.0),
 			previous_properties(""),
-			timeline(nullptr) {}
+			timeline(nullptr),
+			version(0) { PropertiesChanged(); }
 
 		// Compare a clip using the Position() property
 		bool operator< ( ClipBase& a) { return (Position() < a.Position()); }
@@ -90,8 +95,15 @@ namespace openshot {
 		float Duration() const { return end - start; } ///< Get the length of this clip (in seconds)
 		virtual openshot::TimelineBase* ParentTimeline() { return timeline; } ///< Get the associated Timeline pointer (if any)
 
+		/// @brief Get the version of the properties of this clip (used to invalidate cached keys)
+		///
+		/// The version changes when a setter of this class or SetJsonValue is called, and (for a Clip) when
+		/// its reader or effects change. Versions are unique across all clips and effects, so a new clip never
+		/// has the version of a deleted one. Keyframe edits are counted by Keyframe::Edits().
+		int64_t Version() const { return version; }
+
 		// Set basic properties
-		void Id(std::string value) { id = value; } ///> Set the Id of this clip object
+		void Id(std::string value) { id = value; PropertiesChanged(); } ///> Set the Id of this clip object
 		void Position(float value); ///< Set position on timeline (in seconds)
 		void Layer(int value); ///< Set layer of clip on timeline (lower number is covered by higher numbers)
 		void Start(float value); ///< Set start position (in seconds) of clip (trim start of video)
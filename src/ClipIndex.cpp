@@ -0,0 +1,228 @@
+/**
+ * @file
+ * @brief Source file for ClipIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+
+#include "ClipIndex.h"
+#include "Clip.h"
+
+using namespace openshot;
+
+// Default constructor
+ClipIndex::ClipIndex() : fps(30, 1), next_sequence(0) {
+}
+
+// Calculate the frame range of a clip (keeping its sequence)
+ClipIndex::ClipRange ClipIndex::calculate_range(Clip* clip, uint64_t sequence) const
+{
+	ClipRange range;
+	range.clip = clip;
+	range.layer = clip->Layer();
+	range.position = clip->Position();
+	range.sequence = sequence;
+	range.start_position = round(clip->Position() * fps.ToDouble()) + 1;
+	range.end_position = round((clip->Position() + clip->Duration()) * fps.ToDouble()) + 1;
+	return range;
+}
+
+// Is a clip range ordered before another one (by position, and then by sequence)
+bool ClipIndex::is_before(const ClipRange& lhs, const ClipRange& rhs)
+{
+	if (lhs.position != rhs.position)
+		return lhs.position < rhs.position;
+	return lhs.sequence < rhs.sequence;
+}
+
+// Insert a clip range into a layer (at its sorted position)
+void ClipIndex::insert_range(LayerIndex& layer_index, const ClipRange& range)
+{
+	auto it = std::lower_bound(layer_index.sorted.begin(), layer_index.sorted.end(), range, is_before);
+	layer_index.sorted.insert(it, range);
+	layer_index.members[range.clip] = range;
+	layer_index.dirty = true;
+}
+
+// Erase a clip range from a layer
+void ClipIndex::erase_range(LayerIndex& layer_index, const ClipRange& range)
+{
+	// Sequences are unique, so the sorted position of the range is exact
+	auto it = std::lower_bound(layer_index.sorted.begin(), layer_index.sorted.end(), range, is_before);
+	if (it != layer_index.sorted.end() && it->clip == range.clip)
+		layer_index.sorted.erase(it);
+	layer_index.members.erase(range.clip);
+	layer_index.dirty = true;
+}
+
+// Add a clip to the index
+void ClipIndex::Add(Clip* clip)
+{
+	// Clips which are already indexed are just updated
+	if (clip_layers.count(clip)) {
+		Update(clip);
+		return;
+	}
+
+	ClipRange range = calculate_range(clip, next_sequence++);
+	insert_range(layers[range.layer], range);
+	clip_layers[clip] = range.layer;
+}
+
+// Remove a clip from the index
+void ClipIndex::Remove(Clip* clip)
+{
+	auto layer_it = clip_layers.find(clip);
+	if (layer_it == clip_layers.end())
+		return;
+
+	auto index_it = layers.find(layer_it->second);
+	if (index_it != layers.end()) {
+		LayerIndex& layer_index = index_it->second;
+		auto member = layer_index.members.find(clip);
+		if (member != layer_index.members.end())
+			erase_range(layer_index, member->second);
+
+		// Remove empty layers
+		if (layer_index.members.empty())
+			layers.erase(index_it);
+	}
+	clip_layers.erase(layer_it);
+}
+
+// Re-index a clip (after its position, layer, start, or end has changed)
+void ClipIndex::Update(Clip* clip)
+{
+	auto layer_it = clip_layers.find(clip);
+	if (layer_it == clip_layers.end()) {
+		// Not indexed yet
+		Add(clip);
+		return;
+	}
+
+	auto index_it = layers.find(layer_it->second);
+	LayerIndex& layer_index = index_it->second;
+	ClipRange existing = layer_index.members[clip];
+	ClipRange range = calculate_range(clip, existing.sequence);
+
+	if (range.layer == existing.layer && range.position == existing.position) {
+		// Same order, only update the range (if it has changed)
+		if (existing.start_position != range.start_position || existing.end_position != range.end_position) {
+			auto it = std::lower_bound(layer_index.sorted.begin(), layer_index.sorted.end(), existing, is_before);
+			if (it != layer_index.sorted.end() && it->clip == clip)
+				*it = range;
+			layer_index.members[clip] = range;
+			layer_index.dirty = true;
+		}
+		return;
+	}
+
+	// Move the clip (to its new sorted position, or to another layer), keeping its sequence
+	erase_range(layer_index, existing);
+	if (layer_index.members.empty())
+		layers.erase(index_it);
+	insert_range(layers[range.layer], range);
+	layer_it->second = range.layer;
+}
+
+// Remove all clips from the index
+void ClipIndex::Clear()
+{
+	layers.clear();
+	clip_layers.clear();
+}
+
+// Set the frame rate used to calculate frame ranges
+void ClipIndex::FPS(Fraction new_fps)
+{
+	if (new_fps.num == fps.num && new_fps.den == fps.den)
+		return;
+	fps = new_fps;
+
+	// Recalculate all ranges (the order only changes if a clip was moved without calling Update)
+	for (auto& layer_pair : layers) {
+		LayerIndex& layer_index = layer_pair.second;
+		for (auto& range : layer_index.sorted)
+			range = calculate_range(range.clip, range.sequence);
+		if (!std::is_sorted(layer_index.sorted.begin(), layer_index.sorted.end(), is_before))
+			std::sort(layer_index.sorted.begin(), layer_index.sorted.end(), is_before);
+		for (const auto& range : layer_index.sorted)
+			layer_index.members[range.clip] = range;
+		layer_index.dirty = true;
+	}
+}
+
+// Recalculate the max end frames of the interval tree of a layer
+void ClipIndex::build_layer(LayerIndex& layer_index)
+{
+	layer_index.max_end.assign(layer_index.sorted.size(), 0);
+	build_max_end(layer_index, 0, layer_index.sorted.size());
+
+	layer_index.dirty = false;
+}
+
+// Calculate the max end frame of a sub-tree (the node of range [lo, hi) is its midpoint)
+int64_t ClipIndex::build_max_end(LayerIndex& layer_index, size_t lo, size_t hi)
+{
+	if (lo >= hi)
+		return INT64_MIN;
+
+	size_t mid = lo + (hi - lo) / 2;
+	int64_t max_end = layer_index.sorted[mid].end_position;
+	max_end = std::max(max_end, build_max_end(layer_index, lo, mid));
+	max_end = std::max(max_end, build_max_end(layer_index, mid + 1, hi));
+	layer_index.max_end[mid] = max_end;
+	return max_end;
+}
+
+// Collect all clips in a sub-tree which intersect a range of frames
+void ClipIndex::query_layer(const LayerIndex& layer_index, size_t lo, size_t hi, int64_t first_frame, int64_t last_frame, std::vector<Clip*>& matches) const
+{
+	if (lo >= hi)
+		return;
+
+	size_t mid = lo + (hi - lo) / 2;
+
+	// Nothing in this sub-tree ends after the first frame
+	if (layer_index.max_end[mid] < first_frame)
+		return;
+
+	// Search left sub-tree (earlier clips)
+	query_layer(layer_index, lo, mid, first_frame, last_frame, matches);
+
+	// This clip (and all clips to the right) start after the last frame
+	const ClipRange& range = layer_index.sorted[mid];
+	if (range.start_position > last_frame)
+		return;
+
+	if (range.end_position >= first_frame)
+		matches.push_back(range.clip);
+
+	// Search right sub-tree (later clips)
+	query_layer(layer_index, mid + 1, hi, first_frame, last_frame, matches);
+}
+
+// Get all clips which intersect a range of timeline frames
+std::vector<Clip*> ClipIndex::Intersecting(int64_t first_frame, int64_t last_frame)
+{
+	std::vector<Clip*> matches;
+
+	// Loop through layers (lowest to highest)
+	for (auto& layer_pair : layers) {
+		LayerIndex& layer_index = layer_pair.second;
+		if (layer_index.dirty)
+			build_layer(layer_index);
+
+		query_layer(layer_index, 0, layer_index.sorted.size(), first_frame, last_frame, matches);
+	}
+
+	return matches;
+}
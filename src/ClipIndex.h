@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Header file for ClipIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_CLIP_INDEX_H
+#define OPENSHOT_CLIP_INDEX_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "Fraction.h"
+
+namespace openshot {
+	// Forward decl
+	class Clip;
+
+	/**
+	 * @brief This class indexes the frame ranges of clips on a timeline, so intersecting clips can be found quickly.
+	 *
+	 * Each layer keeps its clips sorted by position, arranged as an implicit interval tree (each node
+	 * stores the furthest end frame of its sub-tree). This allows all clips intersecting a range of
+	 * timeline frames to be found in O(log n + k), instead of checking every clip on every frame.
+	 * Clips with the same position are kept in the order they were added, so the order is deterministic.
+	 *
+	 * Clips are re-indexed by calling Update() whenever their position, layer, start, or end changes.
+	 * A changed clip is moved within its sorted layer (binary search, no re-sorting), and the max end
+	 * frames of the layer are recalculated (lazily, on the next query) in O(n).
+	 */
+	class ClipIndex {
+	private:
+		/// The frame range of a single clip (in timeline frames)
+		struct ClipRange {
+			openshot::Clip* clip; ///< Pointer to the clip
+			int layer; ///< Layer of the clip
+			float position; ///< Position of the clip (in seconds, used for ordering)
+			uint64_t sequence; ///< Order in which the clip was added (orders clips with the same position)
+			int64_t start_position; ///< First timeline frame of the clip
+			int64_t end_position; ///< Last timeline frame of the clip (inclusive of the trailing frame)
+		};
+
+		/// All clip ranges on a single layer
+		struct LayerIndex {
+			std::map<openshot::Clip*, ClipRange> members; ///< Clips on this layer
+			std::vector<ClipRange> sorted; ///< Clips sorted by position and sequence (implicit interval tree)
+			std::vector<int64_t> max_end; ///< Max end frame of each sub-tree (indexed by tree node)
+			bool dirty = true; ///< Do the max end frames need to be recalculated
+		};
+
+		std::map<int, LayerIndex> layers; ///< Indexed clips, keyed by layer
+		std::map<openshot::Clip*, int> clip_layers; ///< Current layer of each indexed clip
+		openshot::Fraction fps; ///< Frame rate used to convert clip times into frame numbers
+		uint64_t next_sequence; ///< Sequence of the next added clip
+
+		/// Calculate the frame range of a clip (keeping its sequence)
+		ClipRange calculate_range(openshot::Clip* clip, uint64_t sequence) const;
+
+		/// Is a clip range ordered before another one (by position, and then by sequence)
+		static bool is_before(const ClipRange& lhs, const ClipRange& rhs);
+
+		/// Insert a clip range into a layer (at its sorted position)
+		void insert_range(LayerIndex& layer_index, const ClipRange& range);
+
+		/// Erase a clip range from a layer
+		void erase_range(LayerIndex& layer_index, const ClipRange& range);
+
+		/// Recalculate the max end frames of the interval tree of a layer
+		void build_layer(LayerIndex& layer_index);
+
+		/// Calculate the max end frame of a sub-tree (and all of its children)
+		int64_t build_max_end(LayerIndex& layer_index, size_t lo, size_t hi);
+
+		/// Collect all clips in a sub-tree which intersect a range of frames (in position order)
+		void query_layer(const LayerIndex& layer_index, size_t lo, size_t hi, int64_t first_frame, int64_t last_frame, std::vector<openshot::Clip*>& matches) const;
+
+	public:
+		/// Default constructor
+		ClipIndex();
+
+		/// Add a clip to the index
+		void Add(openshot::Clip* clip);
+
+		/// Remove a clip from the index
+		void Remove(openshot::Clip* clip);
+
+		/// Re-index a clip (after its position, layer, start, or end has changed)
+		void Update(openshot::Clip* clip);
+
+		/// Remove all clips from the index
+		void Clear();
+
+		/// Get the number of indexed clips
+		size_t Count() const { return clip_layers.size(); }
+
+		/// Set the frame rate used to calculate frame ranges (re-indexes all clips if changed)
+		void FPS(openshot::Fraction new_fps);
+
+		/// @brief Get all clips which intersect a range of timeline frames
+		///
+		/// Clips are returned sorted by layer, and then by position (the same order as Timeline::Clips())
+		/// @param first_frame The first timeline frame of the range
+		/// @param last_frame The last timeline frame of the range
+		std::vector<openshot::Clip*> Intersecting(int64_t first_frame, int64_t last_frame);
+	};
+
+}
+
+#endif
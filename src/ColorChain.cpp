@@ -0,0 +1,80 @@
+/**
+ * @file
+ * @brief Source file for ColorChain class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cstdint>
+
+#include <QImage>
+
+#include "ColorChain.h"
+#include "OpenMPUtilities.h"
+
+using namespace openshot;
+
+// Number of pixels processed at once (the float buffer of a tile stays in the CPU cache)
+#define COLOR_CHAIN_TILE_PIXELS 1024
+
+// Minimum number of rows before processing in parallel
+#define COLOR_CHAIN_PARALLEL_ROWS 16
+
+// Apply color operations (in order) to every pixel of an image
+void ColorChain::Apply(QImage* image, const std::vector<ColorOperator>& operators)
+{
+	if (!image || image->isNull() || operators.empty())
+		return;
+	if (image->format() != QImage::Format_RGBA8888_Premultiplied)
+		*image = image->convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+
+	// Detach the image (before any threads write to it)
+	uint8_t* bits = image->bits();
+	const int width = image->width();
+	const int height = image->height();
+	const int64_t bytes_per_line = image->bytesPerLine();
+
+	#pragma omp parallel for if (height >= COLOR_CHAIN_PARALLEL_ROWS) num_threads(OPEN_MP_NUM_PROCESSORS) schedule(static)
+	for (int row = 0; row < height; row++)
+	{
+		float colors[COLOR_CHAIN_TILE_PIXELS * 3];
+		uint8_t* row_pixels = bits + row * bytes_per_line;
+
+		for (int start = 0; start < width; start += COLOR_CHAIN_TILE_PIXELS)
+		{
+			const int count = std::min(COLOR_CHAIN_TILE_PIXELS, width - start);
+			uint8_t* pixels = row_pixels + start * 4;
+
+			// Remove the premultiplied alpha
+			for (int pixel = 0; pixel < count; pixel++) {
+				const int A = pixels[pixel * 4 + 3];
+				const float scale = (A > 0) ? 255.0f / A : 0.0f;
+				colors[pixel * 3 + 0] = pixels[pixel * 4 + 0] * scale;
+				colors[pixel * 3 + 1] = pixels[pixel * 4 + 1] * scale;
+				colors[pixel * 3 + 2] = pixels[pixel * 4 + 2] * scale;
+			}
+
+			// Apply each color operation to the tile, and constrain the colors from 0 to 255
+			// (as if each effect had written its own image)
+			for (const ColorOperator& color_operator : operators) {
+				color_operator(colors, count);
+				for (int value = 0; value < count * 3; value++)
+					colors[value] = std::min(std::max(colors[value], 0.0f), 255.0f);
+			}
+
+			// Pre-multiply the alpha back into the color channels
+			for (int pixel = 0; pixel < count; pixel++) {
+				const float alpha_percent = pixels[pixel * 4 + 3] / 255.0f;
+				pixels[pixel * 4 + 0] = uint8_t(colors[pixel * 3 + 0] * alpha_percent + 0.5f);
+				pixels[pixel * 4 + 1] = uint8_t(colors[pixel * 3 + 1] * alpha_percent + 0.5f);
+				pixels[pixel * 4 + 2] = uint8_t(colors[pixel * 3 + 2] * alpha_percent + 0.5f);
+			}
+		}
+	}
+}
@@ -0,0 +1,57 @@
+/**
+ * @file
+ * @brief Header file for ColorChain class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_COLOR_CHAIN_H
+#define OPENSHOT_COLOR_CHAIN_H
+
+#include <functional>
+#include <vector>
+
+class QImage;
+
+namespace openshot {
+
+	/// @brief A point-wise color operation, applied to a run of pixels (see EffectBase::GetColorOperator)
+	///
+	/// The colors are the un-premultiplied red, green, and blue values (0 to 255) of each pixel, which the
+	/// operation changes in place. Alpha is never changed.
+	typedef std::function<void(float* colors, int count)> ColorOperator;
+
+	/**
+	 * @brief This class applies a chain of point-wise color operations to an image, in a single pass.
+	 *
+	 * Color effects (such as Brightness, Saturation, Hue, and Negate) each loop over every pixel, removing and
+	 * re-applying the premultiplied alpha. Consecutive color effects are fused by Clip::apply_effects instead:
+	 * the image is processed in tiles of pixels, which are un-premultiplied into a small float buffer (which stays
+	 * in the CPU cache), passed through each operator, and premultiplied back into the image. Each pixel is read
+	 * and written once, no matter how many effects are chained. Colors are constrained from 0 to 255 after each
+	 * operator (like separate effects), but intermediate results are not rounded.
+	 *
+	 * @code
+	 * std::vector<openshot::ColorOperator> operators;
+	 * operators.push_back(brightness.GetColorOperator(frame_number));
+	 * operators.push_back(hue.GetColorOperator(frame_number));
+	 * openshot::ColorChain::Apply(frame->GetImage().get(), operators);
+	 * @endcode
+	 */
+	class ColorChain {
+	public:
+		/// @brief Apply color operations (in order) to every pixel of an image
+		///
+		/// @param image The image to modify (converted to QImage::Format_RGBA8888_Premultiplied, if needed)
+		/// @param operators The color operations to apply
+		static void Apply(QImage* image, const std::vector<openshot::ColorOperator>& operators);
+	};
+
+}
+
+#endif
@@ -0,0 +1,451 @@
+/**
+ * @file
+ * @brief Source file for Compositor class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <QImage>
+#include <QRectF>
+#include <QTransform>
+
+#include "Compositor.h"
+#include "OpenMPUtilities.h"
+
+// SIMD kernels (AVX2 is selected at runtime, since it is not part of the x86-64 baseline)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define OPENSHOT_COMPOSITOR_SSE2
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define OPENSHOT_COMPOSITOR_AVX2
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define OPENSHOT_COMPOSITOR_NEON
+#endif
+
+using namespace openshot;
+
+// Minimum number of rows before compositing in parallel
+#define COMPOSITOR_PARALLEL_ROWS 64
+
+// Signature of a row blending kernel
+typedef void (*BlendRowKernel)(uint8_t*, const uint8_t*, int, int);
+
+// Divide by 255 (rounded), for values up to 255 * 255
+static inline uint32_t div255(uint32_t value)
+{
+	value += 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+// Blend a row of pixels (scalar)
+static void blend_row_scalar(uint8_t* destination, const uint8_t* source, int pixels, int opacity)
+{
+	for (int pixel = 0; pixel < pixels; pixel++, destination += 4, source += 4) {
+		uint32_t source_alpha = source[3];
+		if (opacity != 255)
+			source_alpha = div255(source_alpha * opacity);
+
+		if (source_alpha == 0) {
+			// Transparent source pixel (nothing to blend)
+			continue;
+		} else if (source_alpha == 255) {
+			// Opaque source pixel (only possible at full opacity)
+			memcpy(destination, source, 4);
+			continue;
+		}
+
+		uint32_t inverse_alpha = 255 - source_alpha;
+		for (int channel = 0; channel < 4; channel++) {
+			uint32_t source_value = source[channel];
+			if (opacity != 255)
+				source_value = div255(source_value * opacity);
+			destination[channel] = std::min(255u, source_value + div255(destination[channel] * inverse_alpha));
+		}
+	}
+}
+
+#ifdef OPENSHOT_COMPOSITOR_SSE2
+// Divide 16-bit lanes by 255 (rounded)
+static inline __m128i div255_sse2(__m128i value)
+{
+	value = _mm_add_epi16(value, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+// Blend 2 pixels (expanded to 16-bit lanes)
+static inline __m128i blend_pixels_sse2(__m128i source, __m128i destination, __m128i opacity, bool apply_opacity)
+{
+	if (apply_opacity)
+		source = div255_sse2(_mm_mullo_epi16(source, opacity));
+
+	// Broadcast the alpha lane of each pixel, and invert it
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+
+	return _mm_add_epi16(source, div255_sse2(_mm_mullo_epi16(destination, inverse_alpha)));
+}
+
+// Blend a row of pixels (4 pixels at a time)
+static void blend_row_sse2(uint8_t* destination, const uint8_t* source, int pixels, int opacity)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha_mask = _mm_set1_epi32((int) 0xFF000000);
+	const __m128i opacity_lanes = _mm_set1_epi16(opacity);
+	const bool apply_opacity = opacity != 255;
+
+	int pixel = 0;
+	for (; pixel + 4 <= pixels; pixel += 4) {
+		__m128i source_pixels = _mm_loadu_si128((const __m128i*) (source + pixel * 4));
+		__m128i source_alpha = _mm_and_si128(source_pixels, alpha_mask);
+
+		// Skip transparent pixels
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(source_alpha, zero)) == 0xFFFF)
+			continue;
+
+		// Copy opaque pixels
+		if (!apply_opacity && _mm_movemask_epi8(_mm_cmpeq_epi32(source_alpha, alpha_mask)) == 0xFFFF) {
+			_mm_storeu_si128((__m128i*) (destination + pixel * 4), source_pixels);
+			continue;
+		}
+
+		__m128i destination_pixels = _mm_loadu_si128((const __m128i*) (destination + pixel * 4));
+		__m128i low = blend_pixels_sse2(_mm_unpacklo_epi8(source_pixels, zero), _mm_unpacklo_epi8(destination_pixels, zero), opacity_lanes, apply_opacity);
+		__m128i high = blend_pixels_sse2(_mm_unpackhi_epi8(source_pixels, zero), _mm_unpackhi_epi8(destination_pixels, zero), opacity_lanes, apply_opacity);
+		_mm_storeu_si128((__m128i*) (destination + pixel * 4), _mm_packus_epi16(low, high));
+	}
+
+	// Blend remaining pixels
+	blend_row_scalar(destination + pixel * 4, source + pixel * 4, pixels - pixel, opacity);
+}
+#endif
+
+#ifdef OPENSHOT_COMPOSITOR_AVX2
+// Divide 16-bit lanes by 255 (rounded)
+__attribute__((target("avx2")))
+static inline __m256i div255_avx2(__m256i value)
+{
+	value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+// Blend 4 pixels (expanded to 16-bit lanes)
+__attribute__((target("avx2")))
+static inline __m256i blend_pixels_avx2(__m256i source, __m256i destination, __m256i opacity, bool apply_opacity)
+{
+	if (apply_opacity)
+		source = div255_avx2(_mm256_mullo_epi16(source, opacity));
+
+	// Broadcast the alpha lane of each pixel, and invert it
+	__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+
+	return _mm256_add_epi16(source, div255_avx2(_mm256_mullo_epi16(destination, inverse_alpha)));
+}
+
+// Blend a row of pixels (8 pixels at a time)
+__attribute__((target("avx2")))
+static void blend_row_avx2(uint8_t* destination, const uint8_t* source, int pixels, int opacity)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alpha_mask = _mm256_set1_epi32((int) 0xFF000000);
+	const __m256i opacity_lanes = _mm256_set1_epi16(opacity);
+	const bool apply_opacity = opacity != 255;
+
+	int pixel = 0;
+	for (; pixel + 8 <= pixels; pixel += 8) {
+		__m256i source_pixels = _mm256_loadu_si256((const __m256i*) (source + pixel * 4));
+		__m256i source_alpha = _mm256_and_si256(source_pixels, alpha_mask);
+
+		// Skip transparent pixels
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(source_alpha, zero)) == -1)
+			continue;
+
+		// Copy opaque pixels
+		if (!apply_opacity && _mm256_movemask_epi8(_mm256_cmpeq_epi32(source_alpha, alpha_mask)) == -1) {
+			_mm256_storeu_si256((__m256i*) (destination + pixel * 4), source_pixels);
+			continue;
+		}
+
+		// Unpack and pack both operate within 128-bit lanes, so pixel order is preserved
+		__m256i destination_pixels = _mm256_loadu_si256((const __m256i*) (destination + pixel * 4));
+		__m256i low = blend_pixels_avx2(_mm256_unpacklo_epi8(source_pixels, zero), _mm256_unpacklo_epi8(destination_pixels, zero), opacity_lanes, apply_opacity);
+		__m256i high = blend_pixels_avx2(_mm256_unpackhi_epi8(source_pixels, zero), _mm256_unpackhi_epi8(destination_pixels, zero), opacity_lanes, apply_opacity);
+		_mm256_storeu_si256((__m256i*) (destination + pixel * 4), _mm256_packus_epi16(low, high));
+	}
+
+	// Blend remaining pixels
+	blend_row_scalar(destination + pixel * 4, source + pixel * 4, pixels - pixel, opacity);
+}
+#endif
+
+#ifdef OPENSHOT_COMPOSITOR_NEON
+// Multiply 8-bit lanes and divide by 255 (rounded)
+static inline uint8x8_t multiply_div255_neon(uint8x8_t a, uint8x8_t b)
+{
+	uint16x8_t product = vmull_u8(a, b);
+	return vrshrn_n_u16(vrsraq_n_u16(product, product, 8), 8);
+}
+
+// Blend a row of pixels (8 pixels at a time)
+static void blend_row_neon(uint8_t* destination, const uint8_t* source, int pixels, int opacity)
+{
+	const uint8x8_t opacity_lanes = vdup_n_u8(opacity);
+	const bool apply_opacity = opacity != 255;
+
+	int pixel = 0;
+	for (; pixel + 8 <= pixels; pixel += 8) {
+		// Load de-interleaved channels (R, G, B, A)
+		uint8x8x4_t source_pixels = vld4_u8(source + pixel * 4);
+		if (apply_opacity) {
+			for (int channel = 0; channel < 4; channel++)
+				source_pixels.val[channel] = multiply_div255_neon(source_pixels.val[channel], opacity_lanes);
+		}
+
+		// Skip transparent pixels
+		if (vget_lane_u64(vreinterpret_u64_u8(source_pixels.val[3]), 0) == 0)
+			continue;
+
+		uint8x8x4_t destination_pixels = vld4_u8(destination + pixel * 4);
+		uint8x8_t inverse_alpha = vmvn_u8(source_pixels.val[3]);
+		for (int channel = 0; channel < 4; channel++)
+			destination_pixels.val[channel] = vqadd_u8(source_pixels.val[channel], multiply_div255_neon(destination_pixels.val[channel], inverse_alpha));
+		vst4_u8(destination + pixel * 4, destination_pixels);
+	}
+
+	// Blend remaining pixels
+	blend_row_scalar(destination + pixel * 4, source + pixel * 4, pixels - pixel, opacity);
+}
+#endif
+
+// Select the fastest row blending kernel supported by this CPU
+static BlendRowKernel blend_row_kernel(std::string* name = NULL)
+{
+#ifdef OPENSHOT_COMPOSITOR_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		if (name) *name = "AVX2";
+		return blend_row_avx2;
+	}
+#endif
+#if defined(OPENSHOT_COMPOSITOR_SSE2)
+	if (name) *name = "SSE2";
+	return blend_row_sse2;
+#elif defined(OPENSHOT_COMPOSITOR_NEON)
+	if (name) *name = "NEON";
+	return blend_row_neon;
+#else
+	if (name) *name = "Scalar";
+	return blend_row_scalar;
+#endif
+}
+
+// Get the row blending kernel (selected once)
+static BlendRowKernel blend_row_function()
+{
+	static const BlendRowKernel kernel = blend_row_kernel();
+	return kernel;
+}
+
+// Interpolate 2 pixels, with a weight between 0 and 256 (all 4 channels at once)
+static inline uint32_t interpolate_pixel(uint32_t a, uint32_t b, uint32_t weight)
+{
+	uint32_t red_blue = ((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8;
+	uint32_t alpha_green = (((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight) >> 8;
+	return (red_blue & 0x00FF00FF) | ((alpha_green & 0x00FF00FF) << 8);
+}
+
+// Get a source pixel (transparent if outside of the image)
+static inline uint32_t get_pixel(const uint8_t* bits, int bytes_per_line, int width, int height, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= width || y >= height)
+		return 0;
+	return reinterpret_cast<const uint32_t*>(bits + y * bytes_per_line)[x];
+}
+
+// Composite a source image on top of a destination image
+bool Compositor::Composite(QImage* destination, const QImage* source, const QTransform& transform, float opacity)
+{
+	// Only premultiplied RGBA images are supported
+	if (!destination || !source ||
+		destination->format() != QImage::Format_RGBA8888_Premultiplied ||
+		source->format() != QImage::Format_RGBA8888_Premultiplied)
+		return false;
+
+	// Shear and perspective transforms are not supported
+	QTransform::TransformationType transform_type = transform.type();
+	if (transform_type > QTransform::TxRotate || !transform.isInvertible())
+		return false;
+
+	// Nothing to draw
+	int alpha = std::round(std::max(0.0f, std::min(1.0f, opacity)) * 255.0f);
+	if (alpha == 0 || source->isNull() || destination->isNull())
+		return true;
+
+	// Get image pointers (detach the destination image before blending rows in parallel)
+	uint8_t* destination_bits = destination->bits();
+	const uint8_t* source_bits = source->constBits();
+	const int destination_stride = destination->bytesPerLine();
+	const int source_stride = source->bytesPerLine();
+	const int destination_width = destination->width();
+	const int destination_height = destination->height();
+	const int source_width = source->width();
+	const int source_height = source->height();
+	const BlendRowKernel blend_row = blend_row_function();
+
+	const double offset_x = transform.dx();
+	const double offset_y = transform.dy();
+	if (transform_type <= QTransform::TxTranslate &&
+		std::fabs(offset_x - std::round(offset_x)) < 0.001 && std::fabs(offset_y - std::round(offset_y)) < 0.001) {
+
+		// FAST PATH: integer translation (blend rows directly from the source image)
+		const int x = std::round(offset_x);
+		const int y = std::round(offset_y);
+		const int first_column = std::max(0, x);
+		const int last_column = std::min(destination_width, x + source_width);
+		const int first_row = std::max(0, y);
+		const int last_row = std::min(destination_height, y + source_height);
+		if (first_column >= last_column || first_row >= last_row)
+			return true;
+
+		#pragma omp parallel for if (last_row - first_row >= COMPOSITOR_PARALLEL_ROWS) num_threads(OPEN_MP_NUM_PROCESSORS)
+		for (int row = first_row; row < last_row; row++) {
+			blend_row(destination_bits + row * destination_stride + first_column * 4,
+					  source_bits + (row - y) * source_stride + (first_column - x) * 4,
+					  last_column - first_column, alpha);
+		}
+		return true;
+	}
+
+	// Find the destination area covered by the transformed source image
+	QRectF bounds = transform.mapRect(QRectF(0, 0, source_width, source_height));
+	const int first_column = std::max(0, int(std::floor(bounds.left())) - 1);
+	const int last_column = std::min(destination_width, int(std::ceil(bounds.right())) + 1);
+	const int first_row = std::max(0, int(std::floor(bounds.top())) - 1);
+	const int last_row = std::min(destination_height, int(std::ceil(bounds.bottom())) + 1);
+	if (first_column >= last_column || first_row >= last_row)
+		return true;
+	const int columns = last_column - first_column;
+
+	// Map destination pixel centers back to the source image
+	const QTransform inverse = transform.inverted();
+
+	if (transform_type <= QTransform::TxScale) {
+		// FAST PATH: axis-aligned scale (the horizontal samples are shared by every row)
+		std::vector<int> sample_columns;
+		std::vector<uint32_t> sample_weights;
+		int first_sample_column = -1;
+		for (int column = first_column; column < last_column; column++) {
+			double source_x = inverse.m11() * (column + 0.5) + inverse.dx();
+			if (source_x < 0.0 || source_x >= source_width)
+				continue;
+			// The covered columns are contiguous (so only the first one is needed)
+			if (first_sample_column < 0)
+				first_sample_column = column;
+
+			double sample_x = std::max(0.0, source_x - 0.5);
+			int sample_column = std::min(int(sample_x), source_width - 1);
+			sample_columns.push_back(sample_column);
+			sample_weights.push_back(std::min(256, int((sample_x - sample_column) * 256.0)));
+		}
+		if (sample_columns.empty())
+			return true;
+		const int sample_count = sample_columns.size();
+
+		#pragma omp parallel if (last_row - first_row >= COMPOSITOR_PARALLEL_ROWS) num_threads(OPEN_MP_NUM_PROCESSORS)
+		{
+			std::vector<uint32_t> row_pixels(sample_count);
+
+			#pragma omp for
+			for (int row = first_row; row < last_row; row++) {
+				double source_y = inverse.m22() * (row + 0.5) + inverse.dy();
+				if (source_y < 0.0 || source_y >= source_height)
+					continue;
+
+				// Get the 2 source rows (clamped to the edges of the image)
+				double sample_y = std::max(0.0, source_y - 0.5);
+				int sample_row = std::min(int(sample_y), source_height - 1);
+				uint32_t weight_y = std::min(256, int((sample_y - sample_row) * 256.0));
+				const uint32_t* top = reinterpret_cast<const uint32_t*>(source_bits + sample_row * source_stride);
+				const uint32_t* bottom = reinterpret_cast<const uint32_t*>(source_bits + std::min(sample_row + 1, source_height - 1) * source_stride);
+
+				// Resample row (bilinear)
+				for (int sample = 0; sample < sample_count; sample++) {
+					int x1 = sample_columns[sample];
+					int x2 = std::min(x1 + 1, source_width - 1);
+					uint32_t weight_x = sample_weights[sample];
+					row_pixels[sample] = interpolate_pixel(interpolate_pixel(top[x1], top[x2], weight_x),
+														   interpolate_pixel(bottom[x1], bottom[x2], weight_x), weight_y);
+				}
+
+				blend_row(destination_bits + row * destination_stride + first_sample_column * 4,
+						  reinterpret_cast<const uint8_t*>(row_pixels.data()), sample_count, alpha);
+			}
+		}
+		return true;
+	}
+
+	// ROTATION: resample each row (bilinear), treating pixels outside of the image as transparent
+	// (which also anti-aliases the edges of the rotated image)
+	#pragma omp parallel if (last_row - first_row >= COMPOSITOR_PARALLEL_ROWS) num_threads(OPEN_MP_NUM_PROCESSORS)
+	{
+		std::vector<uint32_t> row_pixels(columns);
+
+		#pragma omp for
+		for (int row = first_row; row < last_row; row++) {
+			// Source position of the first pixel center in this row (and the step per pixel)
+			double source_x = inverse.m11() * (first_column + 0.5) + inverse.m21() * (row + 0.5) + inverse.dx() - 0.5;
+			double source_y = inverse.m12() * (first_column + 0.5) + inverse.m22() * (row + 0.5) + inverse.dy() - 0.5;
+			const double step_x = inverse.m11();
+			const double step_y = inverse.m12();
+
+			for (int column = 0; column < columns; column++, source_x += step_x, source_y += step_y) {
+				if (source_x <= -1.0 || source_y <= -1.0 || source_x >= source_width || source_y >= source_height) {
+					row_pixels[column] = 0;
+					continue;
+				}
+
+				int x1 = std::floor(source_x);
+				int y1 = std::floor(source_y);
+				uint32_t weight_x = std::min(256, int((source_x - x1) * 256.0));
+				uint32_t weight_y = std::min(256, int((source_y - y1) * 256.0));
+				uint32_t top = interpolate_pixel(get_pixel(source_bits, source_stride, source_width, source_height, x1, y1),
+												 get_pixel(source_bits, source_stride, source_width, source_height, x1 + 1, y1), weight_x);
+				uint32_t bottom = interpolate_pixel(get_pixel(source_bits, source_stride, source_width, source_height, x1, y1 + 1),
+													get_pixel(source_bits, source_stride, source_width, source_height, x1 + 1, y1 + 1), weight_x);
+				row_pixels[column] = interpolate_pixel(top, bottom, weight_y);
+			}
+
+			blend_row(destination_bits + row * destination_stride + first_column * 4,
+					  reinterpret_cast<const uint8_t*>(row_pixels.data()), columns, alpha);
+		}
+	}
+	return true;
+}
+
+// Blend a row of premultiplied RGBA pixels onto another row
+void Compositor::BlendRow(uint8_t* destination, const uint8_t* source, int pixels, int opacity)
+{
+	blend_row_function()(destination, source, pixels, std::max(0, std::min(255, opacity)));
+}
+
+// Get the name of the instruction set used to blend rows
+std::string Compositor::InstructionSet()
+{
+	std::string name;
+	blend_row_kernel(&name);
+	return name;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @brief Header file for Compositor class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_COMPOSITOR_H
+#define OPENSHOT_COMPOSITOR_H
+
+#include <cstdint>
+#include <string>
+
+class QImage;
+class QTransform;
+
+namespace openshot {
+
+	/**
+	 * @brief This class composites premultiplied RGBA images (source-over), without using QPainter.
+	 *
+	 * Rows are blended with SIMD kernels (AVX2, SSE2, or NEON, with a scalar fallback), and
+	 * processed in parallel. Integer translations are blended directly from the source image,
+	 * while scaled and rotated images are resampled (bilinear) one row at a time.
+	 *
+	 * Only QImage::Format_RGBA8888_Premultiplied images, and transforms without shear or perspective,
+	 * are supported. Composite() returns false for anything else, so the caller can use QPainter instead.
+	 *
+	 * @code
+	 * QTransform transform;
+	 * transform.translate(100, 50);
+	 * if (!openshot::Compositor::Composite(canvas.get(), image.get(), transform)) {
+	 *     QPainter painter(canvas.get());
+	 *     painter.setTransform(transform);
+	 *     painter.drawImage(0, 0, *image);
+	 * }
+	 * @endcode
+	 */
+	class Compositor {
+	public:
+		/// @brief Composite a source image on top of a destination image (source-over)
+		///
+		/// @returns True if the image was composited, or false if the image formats or transform are not
+		/// supported (the destination is not modified in this case)
+		/// @param destination The image to draw onto (i.e. the background canvas)
+		/// @param source The image to draw
+		/// @param transform The transform (translate, scale, rotate) to apply to the source image
+		/// @param opacity The opacity of the source image (0.0 to 1.0)
+		static bool Composite(QImage* destination, const QImage* source, const QTransform& transform, float opacity = 1.0);
+
+		/// @brief Blend a row of premultiplied RGBA pixels onto another row (source-over)
+		///
+		/// @param destination The destination pixels (4 bytes per pixel)
+		/// @param source The source pixels (4 bytes per pixel)
+		/// @param pixels The number of pixels to blend
+		/// @param opacity The opacity of the source pixels (0 to 255)
+		static void BlendRow(uint8_t* destination, const uint8_t* source, int pixels, int opacity = 255);
+
+		/// Get the name of the instruction set used to blend rows (i.e. "AVX2", "SSE2", "NEON", or "Scalar")
+		static std::string InstructionSet();
+	};
+
+}
+
+#endif
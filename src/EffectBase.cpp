@@ -239,3 +239,10 @@ std::string EffectBase::ParentClipId() const{
 	else
 		return "";
 }
+
+// Process a frame with this effect, one frame at a time
+std::shared_ptr<openshot::Frame> EffectBase::ProcessFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
+{
+	const std::lock_guard<std::mutex> lock(processMutex);
+	return GetFrame(frame, frame_number);
+}
@@ -15,11 +15,13 @@
 
 #include "ClipBase.h"
 
+#include "ColorChain.h"
 #include "Json.h"
 #include "TrackedObjectBase.h"
 
 #include <memory>
 #include <map>
+#include <mutex>
 #include <string>
 
 namespace openshot
@@ -54,6 +56,7 @@ namespace openshot
 	{
 	private:
 		int order; ///< The order to evaluate this effect. Effects are processed in this order (when more than one overlap).
+		std::mutex processMutex; ///< Held while this effect processes a frame (see ProcessFrame)
 
 	protected:
 		openshot::ClipBase* clip; ///< Pointer to the parent clip instance (if any)
@@ -90,6 +93,27 @@ namespace openshot
 		/// Return the ID of this effect's parent clip
 		std::string ParentClipId() const;
 
+		/// @brief Get the color operation of a point-wise color effect, for a specific frame (or nullptr)
+		///
+		/// Effects which only change the color of each pixel (without reading other pixels) return an operation, so
+		/// consecutive color effects on a clip can be fused into a single pass over the image (see ColorChain).
+		/// Keyframes are evaluated when the operation is created, and it must not depend on mutable effect state.
+		///
+		/// @param frame_number The frame number (on the clip's timeline) to evaluate keyframes at
+		virtual openshot::ColorOperator GetColorOperator(int64_t frame_number) const { return nullptr; };
+
+		/// @brief Process a frame with this effect (see GetFrame), one frame at a time
+		///
+		/// Effects keep per-instance state (i.e. cached masks, images, or tracking data), and GetFrame is not
+		/// thread safe. Clips and timelines call this method instead, so concurrent renders (see
+		/// Timeline::ConcurrentRendering) never run GetFrame of the same effect on multiple threads at once.
+		/// Color operations (see GetColorOperator) don't use effect state, and are applied without this lock.
+		///
+		/// @returns The modified openshot::Frame object
+		/// @param frame The frame to process
+		/// @param frame_number The frame number (on the clip's timeline) of the frame
+		std::shared_ptr<openshot::Frame> ProcessFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number);
+
 		/// Get the indexes and IDs of all visible objects in the given frame
 		virtual std::string GetVisibleObjects(int64_t frame_number) const {return {}; };
 
@@ -133,6 +133,24 @@ enum ChromaKeyMethod
     CHROMAKEY_LAST_METHOD = CHROMAKEY_YCBCR
 };
 
+/// This enumeration determines the level of a cache in the frame pipeline (used by the CacheManager
+/// to decide which cached frames to evict first, when all caches exceed the global memory limit)
+enum CacheLevel
+{
+	CACHE_LEVEL_UNMANAGED,	///< Never evicted by the CacheManager (i.e. frames which are still being decoded)
+	CACHE_LEVEL_READER,		///< Decoded frames of a reader (evicted first)
+	CACHE_LEVEL_MAPPER,		///< Mapped frames of a FrameMapper
+	CACHE_LEVEL_CLIP,		///< Final frames of a Clip
+	CACHE_LEVEL_TIMELINE	///< Final frames of a Timeline (kept longest)
+};
+
+/// This enumeration determines which frame a memory cache evicts first
+enum CacheEvictionPolicy
+{
+	CACHE_EVICTION_LRU,					///< Evict the least recently used frame
+	CACHE_EVICTION_GREEDY_DUAL_SIZE		///< Evict the frame with the lowest render time per byte (aged by recency)
+};
+
 }  // namespace openshot
 
 #endif
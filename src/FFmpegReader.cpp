@@ -21,6 +21,7 @@
 
 #include "FFmpegReader.h"
 #include "Exceptions.h"
+#include "FrameStream.h"
 #include "Timeline.h"
 #include "ZmqLogger.h"
 
@@ -75,7 +76,8 @@ FFmpegReader::FFmpegReader(const std::string &path, bool inspect_reader)
 		  current_video_frame(0), packet(NULL), max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), audio_pts(0),
 		  video_pts(0), pFormatCtx(NULL), videoStream(-1), audioStream(-1), pCodecCtx(NULL), aCodecCtx(NULL),
 		  pStream(NULL), aStream(NULL), pFrame(NULL), previous_packet_location{-1,0},
-		  hold_packet(false) {
+		  hold_packet(false), seek_index_building(false), prefetch_size(0), prefetch_running(false),
+		  prefetch_next(0), prefetch_position(0), prefetch_generation(0) {
 
 	// Initialize FFMpeg, and register all formats and codecs
 	AV_REGISTER_ALL
@@ -90,14 +92,23 @@ FFmpegReader::FFmpegReader(const std::string &path, bool inspect_reader)
 	working_cache.SetMaxBytesFromInfo(max_concurrent_frames * info.fps.ToDouble() * 2, info.width, info.height, info.sample_rate, info.channels);
 	final_cache.SetMaxBytesFromInfo(max_concurrent_frames * 2, info.width, info.height, info.sample_rate, info.channels);
 
+	// Frames in the working cache are still being decoded (and must not be evicted)
+	working_cache.SetLevel(CACHE_LEVEL_UNMANAGED);
+
 	// Open and Close the reader, to populate its attributes (such as height, width, etc...)
 	if (inspect_reader) {
 		Open();
 		Close();
 	}
+
+	// Start prefetch thread (if enabled)
+	SetPrefetch(openshot::Settings::Instance()->FFMPEG_PREFETCH_FRAMES);
 }
 
 FFmpegReader::~FFmpegReader() {
+	// Stop prefetch thread
+	SetPrefetch(0);
+
 	if (is_open)
 		// Auto close reader if not already done
 		Close();
@@ -562,6 +573,14 @@ void FFmpegReader::Open() {
 		working_cache.SetMaxBytesFromInfo(max_concurrent_frames * info.fps.ToDouble() * 2, info.width, info.height, info.sample_rate, info.channels);
 		final_cache.SetMaxBytesFromInfo(max_concurrent_frames * 2, info.width, info.height, info.sample_rate, info.channels);
 
+		// Load seek index (if previously saved), or build it while reading from the beginning of the file
+		seek_index_building = false;
+		if (openshot::Settings::Instance()->ENABLE_SEEK_INDEX && info.has_video && !seek_index.IsComplete()) {
+			if (seek_index.Count() == 0)
+				seek_index.Load(SeekIndex::IndexPath(path), path, videoStream);
+			seek_index_building = !seek_index.IsComplete();
+		}
+
 		// Scan PTS for any offsets (i.e. non-zero starting streams). At least 1 stream must start at zero timestamp.
 		// This method allows us to shift timestamps to ensure at least 1 stream is starting at zero.
 		UpdatePTSOffset();
@@ -581,9 +600,19 @@ void FFmpegReader::Open() {
 			Seek(1);
 		}
 	}
+
+	// Start prefetch thread (if enabled)
+	StartPrefetch();
 }
 
 void FFmpegReader::Close() {
+	// Stop prefetch thread (before it can lock getFrameMutex again)
+	StopPrefetch();
+
+	CloseFile();
+}
+
+void FFmpegReader::CloseFile() {
 	// Close all objects, if reader is 'open'
 	if (is_open) {
 		// Prevent async calls to the following code
@@ -646,6 +675,17 @@ void FFmpegReader::Close() {
 		final_cache.Clear();
 		working_cache.Clear();
 
+		// Discard prefetched frames (if re-opened while prefetching, the prefetch thread waits for the next request)
+		{
+			const std::lock_guard<std::mutex> prefetch_lock(prefetchMutex);
+			prefetched_frames.clear();
+			prefetch_generation++;
+			prefetch_next = 0;
+		}
+
+		// Free scaling contexts (and unused image buffers)
+		scaler.Clear();
+
 		// Close the video file
 		avformat_close_input(&pFormatCtx);
 		av_freep(&pFormatCtx);
@@ -929,6 +969,52 @@ std::shared_ptr<Frame> FFmpegReader::GetFrame(int64_t requested_frame) {
 	// Debug output
 	ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::GetFrame", "requested_frame", requested_frame, "last_frame", last_frame);
 
+	// Without prefetching, decode on the caller's thread
+	if (prefetch_size == 0)
+		return DecodeFrame(requested_frame);
+
+	{
+		// Check the prefetched frames (without waiting for the decoder)
+		std::unique_lock<std::mutex> lock(prefetchMutex);
+		auto prefetched = prefetched_frames.find(requested_frame);
+		if (prefetched != prefetched_frames.end()) {
+			std::shared_ptr<Frame> frame = prefetched->second;
+			prefetched_frames.erase(prefetched_frames.begin(), std::next(prefetched));
+			prefetch_position = requested_frame;
+			lock.unlock();
+			prefetchCondition.notify_all();
+
+			// Debug output
+			ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::GetFrame", "returned prefetched frame", requested_frame);
+			return frame;
+		}
+
+		// Cancel prefetched frames when seeking (backwards, or further ahead than the prefetch thread would decode)
+		if (requested_frame < prefetch_position || (prefetch_next > 0 && requested_frame > prefetch_next + prefetch_size)) {
+			prefetched_frames.clear();
+			prefetch_generation++;
+			prefetch_next = 0;
+		}
+	}
+
+	// Decode frame (or wait for the prefetch thread to finish decoding it)
+	std::shared_ptr<Frame> frame = DecodeFrame(requested_frame);
+
+	{
+		// Continue prefetching after this frame
+		const std::lock_guard<std::mutex> lock(prefetchMutex);
+		prefetch_position = requested_frame;
+		prefetched_frames.erase(prefetched_frames.begin(), prefetched_frames.upper_bound(requested_frame));
+		if (prefetch_next <= requested_frame)
+			prefetch_next = requested_frame + 1;
+	}
+	prefetchCondition.notify_all();
+
+	return frame;
+}
+
+// Get a frame from the cache, or decode it (seeking if needed)
+std::shared_ptr<Frame> FFmpegReader::DecodeFrame(int64_t requested_frame) {
 	// Check the cache for this frame
 	std::shared_ptr<Frame> frame = final_cache.GetFrame(requested_frame);
 	if (frame) {
@@ -978,6 +1064,111 @@ std::shared_ptr<Frame> FFmpegReader::GetFrame(int64_t requested_frame) {
 	}
 }
 
+// Decode frames on a background thread, ahead of the last requested frame
+void FFmpegReader::SetPrefetch(int frames) {
+	{
+		const std::lock_guard<std::mutex> lock(prefetchMutex);
+		prefetch_size = std::max(0, frames);
+		prefetched_frames.clear();
+		prefetch_generation++;
+	}
+
+	// The thread only runs while the reader is open
+	if (prefetch_size == 0)
+		StopPrefetch();
+	else if (is_open)
+		StartPrefetch();
+}
+
+// Start the prefetch thread (if enabled, and not already running)
+void FFmpegReader::StartPrefetch() {
+	{
+		const std::lock_guard<std::mutex> lock(prefetchMutex);
+		if (prefetch_size == 0 || prefetch_running)
+			return;
+
+		// Start thread (which waits for the first request)
+		prefetch_running = true;
+		prefetch_next = 0;
+		prefetch_thread = std::thread(&FFmpegReader::PrefetchFrames, this);
+	}
+	prefetchCondition.notify_all();
+}
+
+// Stop the prefetch thread, and wait for it
+void FFmpegReader::StopPrefetch() {
+	std::thread stopped_thread;
+	{
+		// Stop thread (after the current frame is decoded)
+		const std::lock_guard<std::mutex> lock(prefetchMutex);
+		prefetch_running = false;
+		prefetched_frames.clear();
+		prefetch_generation++;
+		stopped_thread = std::move(prefetch_thread);
+	}
+	prefetchCondition.notify_all();
+
+	if (stopped_thread.joinable())
+		stopped_thread.join();
+}
+
+// Decode frames ahead of the last requested frame (until stopped)
+void FFmpegReader::PrefetchFrames() {
+	while (true) {
+		int64_t number = 0;
+		int64_t generation = 0;
+		{
+			// Wait until the queue has room (and a frame has been requested)
+			std::unique_lock<std::mutex> lock(prefetchMutex);
+			prefetchCondition.wait(lock, [this] {
+				return !prefetch_running || (prefetch_next > 0 && prefetch_next <= info.video_length &&
+					prefetch_next <= prefetch_position + prefetch_size && int(prefetched_frames.size()) < prefetch_size);
+			});
+			if (!prefetch_running)
+				return;
+
+			number = prefetch_next++;
+			generation = prefetch_generation;
+		}
+
+		// Demux and decode the next frame (walking the stream forward)
+		std::shared_ptr<Frame> frame;
+		try {
+			const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+			if (is_open)
+				frame = DecodeFrame(number);
+		} catch (...) {
+			// The frame is not kept, so the caller decodes it again when requested (and gets the error)
+			ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::PrefetchFrames (failed to decode frame)", "number", number);
+		}
+
+		{
+			// Keep frame (unless cancelled by a seek, or already requested by the caller)
+			const std::lock_guard<std::mutex> lock(prefetchMutex);
+			if (generation == prefetch_generation) {
+				if (frame && number > prefetch_position)
+					prefetched_frames[number] = frame;
+				else if (!frame)
+					prefetch_next = 0; // Wait for the next request
+			}
+		}
+		prefetchCondition.notify_all();
+	}
+}
+
+// Get a range of frames (in order), which are decoded ahead of the caller
+std::shared_ptr<openshot::FrameStream> FFmpegReader::GetFrames(int64_t start, int64_t count) {
+	// The final cache holds (max_concurrent_frames * 2) frames, so only read ahead by half of
+	// that. Otherwise, frames could be evicted before they are requested (which causes a seek).
+	int read_ahead = std::max(1, max_concurrent_frames);
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::GetFrames", "start", start, "count", count, "read_ahead", read_ahead);
+
+	// Decoding is sequential, so use a single worker
+	return std::make_shared<FrameStream>([this](int64_t number) { return GetFrame(number); }, start, count, read_ahead, 1);
+}
+
 // Read the stream until we find the requested Frame
 std::shared_ptr<Frame> FFmpegReader::ReadStream(int64_t requested_frame) {
 	// Allocate video frame
@@ -1148,6 +1339,12 @@ int FFmpegReader::GetNextPacket() {
 		// Keep track of packet stats
 		if (packet->stream_index == videoStream) {
 			packet_status.video_read++;
+
+			// Add packet to seek index (if reading from the beginning of the file)
+			if (seek_index_building && packet->dts != AV_NOPTS_VALUE) {
+				int64_t packet_pts = (packet->pts != AV_NOPTS_VALUE) ? packet->pts : packet->dts;
+				seek_index.Add(packet_pts, packet->dts, packet->pos, packet->flags & AV_PKT_FLAG_KEY);
+			}
 		} else if (packet->stream_index == audioStream) {
 			packet_status.audio_read++;
 		}
@@ -1155,6 +1352,13 @@ int FFmpegReader::GetNextPacket() {
 		// No more packets found
 		delete next_packet;
 		packet = NULL;
+
+		// Entire file was indexed (save seek index for next time)
+		if (seek_index_building && found_packet == AVERROR_EOF) {
+			seek_index_building = false;
+			seek_index.SetComplete();
+			seek_index.Save(SeekIndex::IndexPath(path), path, videoStream);
+		}
 	}
 	// Return if packet was found (or error number)
 	return found_packet;
@@ -1407,15 +1611,6 @@ void FFmpegReader::ProcessVideoPacket(int64_t requested_frame) {
 	int width = info.width;
 	int64_t video_length = info.video_length;
 
-	// Create variables for a RGB Frame (since most videos are not in RGB, we must convert it)
-	AVFrame *pFrameRGB = nullptr;
-	uint8_t *buffer = nullptr;
-
-	// Allocate an AVFrame structure
-	pFrameRGB = AV_ALLOCATE_FRAME();
-	if (pFrameRGB == nullptr)
-		throw OutOfMemory("Failed to allocate frame buffer", path);
-
 	// Determine the max size of this source image (based on the timeline's size, the scaling mode,
 	// and the scaling keyframes). This is a performance improvement, to keep the images as small as possible,
 	// without losing quality. NOTE: We cannot go smaller than the timeline itself, or the add_layer timeline
@@ -1490,36 +1685,23 @@ void FFmpegReader::ProcessVideoPacket(int64_t requested_frame) {
 		}
 	}
 
-	// Determine required buffer size and allocate buffer
-	const int bytes_per_pixel = 4;
-	int buffer_size = (width * height * bytes_per_pixel) + 128;
-	buffer = new unsigned char[buffer_size]();
-
-	// Copy picture data from one AVFrame (or AVPicture) to another one.
-	AV_COPY_PICTURE_DATA(pFrameRGB, buffer, PIX_FMT_RGBA, width, height);
-
 	int scale_mode = SWS_FAST_BILINEAR;
 	if (openshot::Settings::Instance()->HIGH_QUALITY_SCALING) {
 		scale_mode = SWS_BICUBIC;
 	}
-	SwsContext *img_convert_ctx = sws_getContext(info.width, info.height, AV_GET_CODEC_PIXEL_FORMAT(pStream, pCodecCtx), width,
-												 height, PIX_FMT_RGBA, scale_mode, NULL, NULL, NULL);
 
-	// Resize / Convert to RGB
-	sws_scale(img_convert_ctx, pFrame->data, pFrame->linesize, 0,
-			  original_height, pFrameRGB->data, pFrameRGB->linesize);
+	// Resize / Convert to RGB (using a cached scaling context, and a pooled buffer). Images with
+	// an alpha channel are converted to premultipled when added to the frame (which is slower).
+	std::shared_ptr<QImage> image = scaler.Convert(pFrame, pix_fmt, info.width, original_height,
+												   width, height, scale_mode, ffmpeg_has_alpha(pix_fmt));
+	if (!image)
+		throw OutOfMemory("Failed to convert video frame", path);
 
 	// Create or get the existing frame object
 	std::shared_ptr<Frame> f = CreateFrame(current_frame);
 
 	// Add Image data to frame
-	if (!ffmpeg_has_alpha(AV_GET_CODEC_PIXEL_FORMAT(pStream, pCodecCtx))) {
-		// Add image with no alpha channel, Speed optimization
-		f->AddImage(width, height, bytes_per_pixel, QImage::Format_RGBA8888_Premultiplied, buffer);
-	} else {
-		// Add image with alpha channel (this will be converted to premultipled when needed, but is slower)
-		f->AddImage(width, height, bytes_per_pixel, QImage::Format_RGBA8888, buffer);
-	}
+	f->AddImage(image);
 
 	// Update working cache
 	working_cache.Add(f);
@@ -1527,12 +1709,8 @@ void FFmpegReader::ProcessVideoPacket(int64_t requested_frame) {
 	// Keep track of last last_video_frame
 	last_video_frame = f;
 
-	// Free the RGB image
-	AV_FREE_FRAME(&pFrameRGB);
-
 	// Remove frame and packet
 	RemoveAVFrame(pFrame);
-	sws_freeContext(img_convert_ctx);
 
 	// Get video PTS in seconds
 	video_pts_seconds = (double(video_pts) * info.video_timebase.ToDouble()) + pts_offset_seconds;
@@ -1822,7 +2000,7 @@ void FFmpegReader::Seek(int64_t requested_frame) {
 		is_seeking = true;
 
 		// Close and re-open file (basically seeking to frame 1)
-		Close();
+		CloseFile();
 		Open();
 
 		// Update overrides (since closing and re-opening might update these)
@@ -1844,6 +2022,34 @@ void FFmpegReader::Seek(int64_t requested_frame) {
 		bool seek_worked = false;
 		int64_t seek_target = 0;
 
+		// Packets are no longer read from the beginning of the file
+		seek_index_building = false;
+
+		// Seek directly to the nearest preceding keyframe (if indexed), and decode forward from there
+		SeekIndex::Entry keyframe;
+		if (!seek_worked && info.has_video && !HasAlbumArt() && openshot::Settings::Instance()->ENABLE_SEEK_INDEX &&
+			seek_index.FindKeyframe(ConvertFrameToVideoPTS(requested_frame - buffer_amount), keyframe)) {
+			seek_target = keyframe.pts;
+
+			// Formats with timestamp discontinuities (i.e. MPEG-TS) seek more reliably by byte offset
+			int seek_result = -1;
+			if (keyframe.pos >= 0 && (pFormatCtx->iformat->flags & AVFMT_TS_DISCONT) && !(pFormatCtx->iformat->flags & AVFMT_NO_BYTE_SEEK))
+				seek_result = av_seek_frame(pFormatCtx, info.video_stream_index, keyframe.pos, AVSEEK_FLAG_BYTE);
+			else
+				seek_result = av_seek_frame(pFormatCtx, info.video_stream_index, keyframe.pts, AVSEEK_FLAG_BACKWARD);
+
+			if (seek_result >= 0) {
+				// VIDEO SEEK (to a known keyframe)
+				is_video_seek = true;
+				seek_worked = true;
+
+				ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::Seek (using seek index)",
+													  "requested_frame", requested_frame,
+													  "keyframe.pts", keyframe.pts,
+													  "keyframe.pos", keyframe.pos);
+			}
+		}
+
 		// Seek video stream (if any), except album arts
 		if (!seek_worked && info.has_video && !HasAlbumArt()) {
 			seek_target = ConvertFrameToVideoPTS(requested_frame - buffer_amount);
@@ -1901,7 +2107,7 @@ void FFmpegReader::Seek(int64_t requested_frame) {
 			is_seeking = true;
 
 			// Close and re-open file (basically seeking to frame 1)
-			Close();
+			CloseFile();
 			Open();
 
 			// Not actually seeking, so clear these flags
@@ -1917,6 +2123,64 @@ void FFmpegReader::Seek(int64_t requested_frame) {
 	}
 }
 
+// Scan all video packets of the file, and build a complete seek index
+bool FFmpegReader::BuildSeekIndex() {
+	// Open a separate format context (so the current read position is not changed)
+	AVFormatContext *scanFormatCtx = NULL;
+	if (avformat_open_input(&scanFormatCtx, path.c_str(), NULL, NULL) != 0)
+		throw InvalidFile("File could not be opened.", path);
+	if (avformat_find_stream_info(scanFormatCtx, NULL) < 0) {
+		avformat_close_input(&scanFormatCtx);
+		throw NoStreamsFound("No streams found in file.", path);
+	}
+
+	// Find the first video stream (same as Open)
+	int scanStream = -1;
+	for (unsigned int i = 0; i < scanFormatCtx->nb_streams; i++) {
+		if (AV_GET_CODEC_TYPE(scanFormatCtx->streams[i]) == AVMEDIA_TYPE_VIDEO) {
+			scanStream = i;
+			break;
+		}
+	}
+	if (scanStream < 0) {
+		avformat_close_input(&scanFormatCtx);
+		return false;
+	}
+
+	// Read all packets (without decoding)
+	SeekIndex index;
+	AVPacket *scanPacket = av_packet_alloc();
+	int result = 0;
+	while ((result = av_read_frame(scanFormatCtx, scanPacket)) >= 0) {
+		if (scanPacket->stream_index == scanStream && scanPacket->dts != AV_NOPTS_VALUE) {
+			int64_t packet_pts = (scanPacket->pts != AV_NOPTS_VALUE) ? scanPacket->pts : scanPacket->dts;
+			index.Add(packet_pts, scanPacket->dts, scanPacket->pos, scanPacket->flags & AV_PKT_FLAG_KEY);
+		}
+		av_packet_unref(scanPacket);
+	}
+	av_packet_free(&scanPacket);
+	avformat_close_input(&scanFormatCtx);
+
+	if (result != AVERROR_EOF)
+		return false;
+	index.SetComplete();
+
+	ZmqLogger::Instance()->AppendDebugMethod("FFmpegReader::BuildSeekIndex", "packets", index.Count(), "keyframes", index.KeyframeCount());
+
+	// Save (and use) the new index
+	index.Save(SeekIndex::IndexPath(path), path, scanStream);
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	seek_index = index;
+	seek_index_building = false;
+	return true;
+}
+
+// Does this reader have a complete seek index
+bool FFmpegReader::HasSeekIndex() {
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	return seek_index.IsComplete();
+}
+
 // Get the PTS for the current video packet
 int64_t FFmpegReader::GetPacketPTS() {
 	if (packet) {
@@ -21,16 +21,23 @@
 // Include FFmpeg headers and macros
 #include "FFmpegUtilities.h"
 
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <ctime>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <stdio.h>
 #include <memory>
+#include <thread>
 #include "AudioLocation.h"
 #include "CacheMemory.h"
 #include "Clip.h"
 #include "OpenMPUtilities.h"
+#include "SeekIndex.h"
 #include "Settings.h"
+#include "VideoScaler.h"
 
 
 namespace openshot {
@@ -119,6 +126,19 @@ namespace openshot {
 
 		CacheMemory working_cache;
 		AudioLocation previous_packet_location;
+		VideoScaler scaler; ///< Cached scaling contexts (and pooled image buffers)
+		SeekIndex seek_index; ///< Index of video packets (used to seek directly to keyframes)
+		bool seek_index_building; ///< Are packets being added to the seek index (i.e. reading from the beginning)
+
+		std::thread prefetch_thread; ///< Background thread which decodes frames ahead of the last requested frame
+		std::mutex prefetchMutex; ///< Mutex protecting the prefetch state below
+		std::condition_variable prefetchCondition; ///< Signaled when the prefetch state changes
+		std::map<int64_t, std::shared_ptr<openshot::Frame>> prefetched_frames; ///< Bounded queue of decoded frames
+		std::atomic<int> prefetch_size; ///< Max # of prefetched frames (0 = disabled)
+		bool prefetch_running; ///< Is the prefetch thread running (only while the reader is open)
+		int64_t prefetch_next; ///< Next frame # decoded by the prefetch thread
+		int64_t prefetch_position; ///< Last frame # requested by the caller
+		int64_t prefetch_generation; ///< Incremented when prefetched frames are cancelled (i.e. on seek)
 
 		// DEBUG VARIABLES (FOR AUDIO ISSUES)
 		int prev_samples;
@@ -164,6 +184,9 @@ namespace openshot {
 		/// Check the working queue, and move finished frames to the finished queue
 		void CheckWorkingFrames(int64_t requested_frame);
 
+		/// Close the file and codecs (without stopping the prefetch thread, i.e. when re-opening the file to seek)
+		void CloseFile();
+
 		/// Convert Frame Number into Audio PTS
 		int64_t ConvertFrameToAudioPTS(int64_t frame_number);
 
@@ -176,6 +199,9 @@ namespace openshot {
 		/// Create a new Frame (or return an existing one) and add it to the working queue.
 		std::shared_ptr<openshot::Frame> CreateFrame(int64_t requested_frame);
 
+		/// Get a frame from the cache, or decode it (seeking if needed)
+		std::shared_ptr<openshot::Frame> DecodeFrame(int64_t requested_frame);
+
 		/// Calculate Starting video frame and sample # for an audio PTS
 		AudioLocation GetAudioPTSLocation(int64_t pts);
 
@@ -194,6 +220,9 @@ namespace openshot {
 		/// Remove partial frames due to seek
 		bool IsPartialFrame(int64_t requested_frame);
 
+		/// Decode frames ahead of the last requested frame (until stopped)
+		void PrefetchFrames();
+
 		/// Process a video packet
 		void ProcessVideoPacket(int64_t requested_frame);
 
@@ -212,6 +241,12 @@ namespace openshot {
 		/// Seek to a specific Frame.  This is not always frame accurate, it's more of an estimation on many codecs.
 		void Seek(int64_t requested_frame);
 
+		/// Start the prefetch thread (if enabled, and not already running)
+		void StartPrefetch();
+
+		/// Stop the prefetch thread, and wait for it (must not be called while holding getFrameMutex)
+		void StopPrefetch();
+
 		/// Update PTS Offset (presentation time stamp). This shifts timestamps for all streams, so the first timestamp
 		/// is always zero. If one stream starts first, it will always be zero, and the other streams shifted
 		/// to maintain the correct relative time distance.
@@ -254,9 +289,39 @@ namespace openshot {
 		/// @param requested_frame	The frame number that is requested.
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t requested_frame) override;
 
+		/// @brief Get a range of frames (in order), which are decoded ahead of the caller
+		///
+		/// Frames are decoded sequentially (by a single worker), and no further ahead than the final cache
+		/// can hold, so frames requested with GetFrame() are never evicted before the caller reaches them.
+		/// @param start The first frame number
+		/// @param count The number of frames
+		std::shared_ptr<openshot::FrameStream> GetFrames(int64_t start, int64_t count) override;
+
 		/// Determine if reader is open or closed
 		bool IsOpen() override { return is_open; };
 
+		/// @brief Scan all video packets of the file, and build a complete seek index
+		///
+		/// Otherwise, the seek index is built while the file is read from the beginning. The index is saved
+		/// to Settings::PATH_SEEK_INDEX (if set), and loaded the next time the file is opened.
+		/// @returns True if the index was built
+		bool BuildSeekIndex();
+
+		/// Does this reader have a complete seek index (built, scanned, or loaded)
+		bool HasSeekIndex();
+
+		/// Get the max # of frames decoded ahead by the prefetch thread (0 = disabled)
+		int GetPrefetch() { return prefetch_size; };
+
+		/// @brief Decode frames on a background thread, ahead of the last requested frame
+		///
+		/// When enabled, a background thread demuxes and decodes up to this many frames after the last
+		/// requested frame, so sequential reads (i.e. playback and export) are returned without waiting
+		/// for I/O or decoding. Prefetched frames are discarded (and the thread restarts from the new position)
+		/// when the caller seeks. Defaults to Settings::FFMPEG_PREFETCH_FRAMES.
+		/// @param frames The max # of prefetched frames (0 disables the prefetch thread)
+		void SetPrefetch(int frames);
+
 		/// Return the type name of the class
 		std::string Name() override { return "FFmpegReader"; };
 
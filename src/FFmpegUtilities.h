@@ -51,6 +51,7 @@ extern "C" {
     #include <libavresample/avresample.h>
 #endif
 
+    #include <libavutil/audio_fifo.h>
     #include <libavutil/mathematics.h>
     #include <libavutil/pixfmt.h>
     #include <libavutil/pixdesc.h>
@@ -16,16 +16,22 @@
 #include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <cstring>
 #include <ctime>
+#include <memory>
 #include <unistd.h>
 
 #include "FFmpegUtilities.h"
 
 #include "FFmpegWriter.h"
 #include "Exceptions.h"
+#include "FFmpegReader.h"
 #include "Frame.h"
+#include "FrameMapper.h"
+#include "FrameStream.h"
 #include "OpenMPUtilities.h"
 #include "Settings.h"
+#include "Timeline.h"
 #include "ZmqLogger.h"
 
 using namespace openshot;
@@ -73,12 +79,15 @@ static int set_hwframe_ctx(AVCodecContext *ctx, AVBufferRef *hw_device_ctx, int6
 #endif // USE_HW_ACCEL
 
 FFmpegWriter::FFmpegWriter(const std::string& path) :
-		path(path), oc(NULL), audio_st(NULL), video_st(NULL), samples(NULL),
-		audio_outbuf(NULL), audio_outbuf_size(0), audio_input_frame_size(0), audio_input_position(0),
+		path(path), oc(NULL), audio_st(NULL), video_st(NULL), audio_input_frame_size(0),
 		initial_audio_input_frame_size(0), img_convert_ctx(NULL), num_of_rescalers(1),
 		rescaler_position(0), video_codec_ctx(NULL), audio_codec_ctx(NULL), is_writing(false), video_timestamp(0), audio_timestamp(0),
-		original_sample_rate(0), original_channels(0), avr(NULL), avr_planar(NULL), is_open(false), prepare_streams(false),
-		write_header(false), write_trailer(false), audio_encoder_buffer_size(0), audio_encoder_buffer(NULL) {
+		original_sample_rate(0), original_channels(0), avr(NULL), audio_fifo(NULL), audio_frame(NULL), audio_converted(NULL),
+		audio_converted_size(0), is_open(false), prepare_streams(false),
+		write_header(false), write_trailer(false), audio_encoder_buffer_size(0), audio_encoder_buffer(NULL),
+		pipeline_size(0), pipeline_running(false), pipeline_draining(false), pipeline_frames(0),
+		pipeline_next_input(0), pipeline_next_output(0), smart_render(false), force_keyframe(false),
+		video_last_dts(AV_NOPTS_VALUE) {
 
 	// Disable audio & video (so they can be independently enabled)
 	info.has_audio = false;
@@ -89,6 +98,18 @@ FFmpegWriter::FFmpegWriter(const std::string& path) :
 
 	// auto detect format
 	auto_detect_format();
+
+	// Encode frames on background threads (if enabled)
+	pipeline_size = std::max(0, openshot::Settings::Instance()->FFMPEG_WRITER_PIPELINE_FRAMES);
+}
+
+FFmpegWriter::~FFmpegWriter() {
+	// Stop pipeline threads (encoding any queued frames)
+	try {
+		drain_pipeline();
+	} catch (...) {
+		ZmqLogger::Instance()->AppendDebugMethod("FFmpegWriter::~FFmpegWriter (pipeline error)");
+	}
 }
 
 // Open the writer
@@ -682,15 +703,185 @@ void FFmpegWriter::WriteFrame(std::shared_ptr<openshot::Frame> frame) {
 	ZmqLogger::Instance()->AppendDebugMethod(
 		"FFmpegWriter::WriteFrame",
 		"frame->number", frame->number,
-		"is_writing", is_writing);
+		"is_writing", is_writing,
+		"pipeline_size", pipeline_size);
+
+	if (pipeline_size > 0) {
+		// Start pipeline threads (if needed)
+		if (!pipeline_running) {
+			pipeline_running = true;
+			int converter_count = std::max(1, std::min(pipeline_size, OPEN_MP_NUM_PROCESSORS));
+			for (int converter = 0; converter < converter_count; converter++)
+				pipeline_converters.emplace_back(&FFmpegWriter::pipeline_convert, this);
+			pipeline_encoder = std::thread(&FFmpegWriter::pipeline_encode, this);
+		}
 
-	// Write frames to video file
-	write_frame(frame);
+		// Queue frame (waiting while the pipeline is full)
+		bool failed = false;
+		{
+			std::unique_lock<std::mutex> lock(pipelineMutex);
+			pipelineCondition.wait(lock, [this] { return pipeline_frames < pipeline_size || pipeline_error; });
+			failed = bool(pipeline_error);
+			if (!failed) {
+				pipeline_input.emplace_back(pipeline_next_input++, frame);
+				pipeline_frames++;
+			}
+		}
+		pipelineCondition.notify_all();
+
+		// Raise pipeline exception from main thread
+		if (failed)
+			drain_pipeline();
+	} else {
+		// Write frames to video file
+		write_frame(frame);
+	}
 
 	// Keep track of the last frame added
 	last_frame = frame;
 }
 
+// Encode frames on background threads, so WriteFrame returns as soon as a frame is queued
+void FFmpegWriter::SetPipeline(int frames) {
+	// Encode the frames already queued (with the previous settings)
+	drain_pipeline();
+
+	pipeline_size = std::max(0, frames);
+}
+
+// Convert queued frames to the output pixel format (pipeline thread)
+void FFmpegWriter::pipeline_convert() {
+	// Each conversion thread has its own scaler (created for the first image)
+	SwsContext *scaler = NULL;
+
+	while (true) {
+		int64_t sequence = 0;
+		std::shared_ptr<Frame> frame;
+		{
+			// Wait for a queued frame (or the end of the pipeline)
+			std::unique_lock<std::mutex> lock(pipelineMutex);
+			pipelineCondition.wait(lock, [this] { return !pipeline_input.empty() || pipeline_draining; });
+			if (pipeline_input.empty())
+				break;
+
+			sequence = pipeline_input.front().first;
+			frame = pipeline_input.front().second;
+			pipeline_input.pop_front();
+		}
+
+		// Resize & convert pixel format (unless the size is 1x1, i.e. no image in this frame)
+		AVFrame *frame_final = NULL;
+		if (info.has_video && video_st && !(frame->GetWidth() == 1 && frame->GetHeight() == 1)) {
+			try {
+				if (!scaler)
+					scaler = create_scaler(frame->GetWidth(), frame->GetHeight());
+				frame_final = convert_video_frame(frame, scaler);
+			} catch (...) {
+				const std::lock_guard<std::mutex> lock(pipelineMutex);
+				if (!pipeline_error)
+					pipeline_error = std::current_exception();
+			}
+		}
+
+		{
+			// Pass converted frame to the encoding thread
+			const std::lock_guard<std::mutex> lock(pipelineMutex);
+			pipeline_output[sequence] = std::make_pair(frame, frame_final);
+		}
+		pipelineCondition.notify_all();
+	}
+
+	if (scaler)
+		sws_freeContext(scaler);
+}
+
+// Encode and mux converted frames, in order (pipeline thread)
+void FFmpegWriter::pipeline_encode() {
+	while (true) {
+		std::shared_ptr<Frame> frame;
+		AVFrame *frame_final = NULL;
+		bool failed = false;
+		{
+			// Wait for the next frame (or the end of the pipeline)
+			std::unique_lock<std::mutex> lock(pipelineMutex);
+			pipelineCondition.wait(lock, [this] {
+				return pipeline_output.count(pipeline_next_output) || (pipeline_draining && pipeline_frames == 0);
+			});
+			auto next = pipeline_output.find(pipeline_next_output);
+			if (next == pipeline_output.end())
+				break;
+
+			frame = next->second.first;
+			frame_final = next->second.second;
+			pipeline_output.erase(next);
+			failed = bool(pipeline_error);
+		}
+
+		// Encode audio & video, and write packets to the video file (skipped after an error)
+		if (!failed) {
+			try {
+				if (info.has_audio && audio_st)
+					write_audio_packets(false, frame);
+				if (frame_final && !write_video_packet(frame, frame_final))
+					throw ErrorEncodingVideo("Error while writing raw video frame", -1);
+			} catch (...) {
+				const std::lock_guard<std::mutex> lock(pipelineMutex);
+				if (!pipeline_error)
+					pipeline_error = std::current_exception();
+			}
+		}
+
+		// Deallocate buffer and AVFrame
+		if (frame_final) {
+			av_freep(&(frame_final->data[0]));
+			AV_FREE_FRAME(&frame_final);
+		}
+
+		{
+			const std::lock_guard<std::mutex> lock(pipelineMutex);
+			pipeline_next_output++;
+			pipeline_frames--;
+		}
+		pipelineCondition.notify_all();
+	}
+}
+
+// Encode all queued frames, and stop the pipeline threads (throws the first pipeline error, if any)
+void FFmpegWriter::drain_pipeline() {
+	if (!pipeline_running)
+		return;
+
+	{
+		const std::lock_guard<std::mutex> lock(pipelineMutex);
+		pipeline_draining = true;
+	}
+	pipelineCondition.notify_all();
+
+	// Wait for all queued frames
+	for (std::thread& converter : pipeline_converters)
+		converter.join();
+	pipeline_converters.clear();
+	pipeline_encoder.join();
+
+	std::exception_ptr error;
+	{
+		const std::lock_guard<std::mutex> lock(pipelineMutex);
+		error = pipeline_error;
+		pipeline_error = nullptr;
+		pipeline_running = false;
+		pipeline_draining = false;
+		pipeline_frames = 0;
+		pipeline_next_input = 0;
+		pipeline_next_output = 0;
+	}
+
+	ZmqLogger::Instance()->AppendDebugMethod("FFmpegWriter::drain_pipeline", "error", bool(error));
+
+	// Raise pipeline exception from main thread
+	if (error)
+		std::rethrow_exception(error);
+}
+
 // Write all frames in the queue to the video file.
 void FFmpegWriter::write_frame(std::shared_ptr<Frame> frame) {
 	// Flip writing flag
@@ -740,18 +931,392 @@ void FFmpegWriter::WriteFrame(ReaderBase *reader, int64_t start, int64_t length)
 		"start", start,
 		"length", length);
 
-	// Loop through each frame (and encoded it)
-	for (int64_t number = start; number <= length; number++) {
-		// Get the frame
-		std::shared_ptr<Frame> f = reader->GetFrame(number);
+	// Copy the complete GOPs of unmodified timeline ranges (if smart rendering). The frames of the
+	// source files are numbered with the writer's frame rate, and copied frames are not resized, so
+	// the writer must use the frame rate and size of the timeline.
+	Timeline *timeline = dynamic_cast<Timeline *>(reader);
+	if (smart_render && timeline && info.has_video && video_st &&
+		info.fps.num == timeline->info.fps.num && info.fps.den == timeline->info.fps.den &&
+		info.width == timeline->info.width && info.height == timeline->info.height) {
+		for (const PassThroughRange& range : timeline->GetPassThroughRanges(start, length)) {
+			int64_t offset = range.start - range.source_start;
+			int64_t copy_first = 0;
+			int64_t copy_last = 0;
+			int64_t decode_delay = 0;
+			if (range.start < start ||
+				!find_copy_range(range.path, range.source_start, range.end - offset, copy_first, copy_last, decode_delay))
+				continue;
+
+			// Encode the frames before the first keyframe (i.e. the edit boundary)
+			write_frames(reader, start, copy_first + offset - 1);
+			start = copy_first + offset;
+
+			// Copy the GOPs (after all queued frames are encoded), or encode them with the remaining frames
+			drain_pipeline();
+			if (copy_pass_through(range.path, copy_first, copy_last, copy_first + offset, decode_delay))
+				start = copy_last + offset + 1;
+		}
+	} else if (smart_render && timeline) {
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"FFmpegWriter::WriteFrame (smart rendering skipped, the frame rate or size differs from the timeline)",
+			"info.width", info.width,
+			"info.height", info.height,
+			"timeline->info.width", timeline->info.width,
+			"timeline->info.height", timeline->info.height);
+	}
 
+	// Encode the remaining frames
+	write_frames(reader, start, length);
+}
+
+// Write a range of frames from a reader (rendered and encoded)
+void FFmpegWriter::write_frames(ReaderBase *reader, int64_t start, int64_t end) {
+	if (start > end)
+		return;
+
+	// Loop through each frame (and encoded it), while the next frames are read ahead
+	std::shared_ptr<FrameStream> stream = reader->GetFrames(start, end - start + 1);
+	while (std::shared_ptr<Frame> f = stream->Next()) {
 		// Encode frame
 		WriteFrame(f);
 	}
 }
 
+// Get the first PTS of a source stream
+static int64_t source_start_pts(AVStream *stream) {
+	return (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0;
+}
+
+// Get the frame number of a PTS in a source stream (frame numbers start at 1)
+static int64_t source_pts_to_frame(AVStream *stream, Fraction fps, int64_t pts) {
+	return av_rescale_q(pts - source_start_pts(stream), stream->time_base, av_make_q(fps.den, fps.num)) + 1;
+}
+
+// Get the PTS of a frame number in a source stream
+static int64_t source_frame_to_pts(AVStream *stream, Fraction fps, int64_t frame) {
+	return av_rescale_q(frame - 1, av_make_q(fps.den, fps.num), stream->time_base) + source_start_pts(stream);
+}
+
+// Open the video stream of a source file (returns NULL if the file has no video)
+static AVStream *open_source_video(const std::string& source_path, AVFormatContext **input) {
+	*input = NULL;
+	if (avformat_open_input(input, source_path.c_str(), NULL, NULL) != 0)
+		return NULL;
+	int stream_index = -1;
+	if (avformat_find_stream_info(*input, NULL) >= 0)
+		stream_index = av_find_best_stream(*input, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	if (stream_index < 0) {
+		avformat_close_input(input);
+		return NULL;
+	}
+	return (*input)->streams[stream_index];
+}
+
+// Can the encoder be reset between copied packets (and does it produce the same codec, size, and pixel format as a source stream)
+bool FFmpegWriter::can_copy_video(AVStream *source) {
+#if IS_FFMPEG_3_2 && defined(AV_CODEC_CAP_ENCODER_FLUSH)
+	if (!video_codec_ctx || !video_codec_ctx->codec ||
+		!(video_codec_ctx->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH))
+		return false;
+
+	const AVCodecParameters *source_par = source->codecpar;
+	if (source_par->codec_id != video_codec_ctx->codec_id ||
+		source_par->width != video_codec_ctx->width ||
+		source_par->height != video_codec_ctx->height ||
+		source_par->format != video_codec_ctx->pix_fmt)
+		return false;
+
+	// Copied packets are decoded with the codec parameters of the output file (i.e. the SPS / PPS of
+	// H.264, stored once in MP4), so they must be identical to the parameters of the source file
+	if ((video_codec_ctx->profile >= 0 && source_par->profile != video_codec_ctx->profile) ||
+		(video_codec_ctx->level >= 0 && source_par->level != video_codec_ctx->level))
+		return false;
+	return source_par->extradata_size == video_codec_ctx->extradata_size &&
+		(source_par->extradata_size == 0 ||
+		 memcmp(source_par->extradata, video_codec_ctx->extradata, source_par->extradata_size) == 0);
+#else
+	// Encoders cannot be reset (without closing them)
+	return false;
+#endif
+}
+
+// Find the complete GOPs of a source file inside a range of frames
+bool FFmpegWriter::find_copy_range(const std::string& source_path, int64_t first_frame, int64_t last_frame, int64_t& copy_first, int64_t& copy_last, int64_t& decode_delay) {
+	copy_first = 0;
+	copy_last = 0;
+	decode_delay = 0;
+
+	AVFormatContext *input = NULL;
+	AVStream *source = open_source_video(source_path, &input);
+	if (!source)
+		return false;
+
+	bool found = false;
+	if (can_copy_video(source)) {
+		// Find the keyframes of the range (and the keyframe after it), starting at the keyframe before the range
+		av_seek_frame(input, source->index, source_frame_to_pts(source, info.fps, first_frame), AVSEEK_FLAG_BACKWARD);
+		std::vector<int64_t> keyframes;
+		std::vector<int64_t> keyframe_pts_list;
+		struct PacketTimestamps { int64_t frame; int64_t pts; int64_t dts; };
+		std::vector<PacketTimestamps> packets;
+		int64_t keyframe_pts = AV_NOPTS_VALUE;
+		int64_t max_frame = 0;
+		bool open_gop = false;
+		bool end_of_file = true;
+
+		AVPacket *pkt = av_packet_alloc();
+		while (av_read_frame(input, pkt) >= 0) {
+			if (pkt->stream_index == source->index && pkt->pts != AV_NOPTS_VALUE) {
+				int64_t frame = source_pts_to_frame(source, info.fps, pkt->pts);
+				if (pkt->flags & AV_PKT_FLAG_KEY) {
+					if (frame > last_frame + 1) {
+						end_of_file = false;
+						av_packet_unref(pkt);
+						break;
+					}
+					keyframes.push_back(frame);
+					keyframe_pts_list.push_back(pkt->pts);
+					keyframe_pts = pkt->pts;
+				} else if (keyframe_pts != AV_NOPTS_VALUE && pkt->pts < keyframe_pts && frame >= first_frame) {
+					// Frames shown before the last keyframe (but decoded after it) reference the previous GOP
+					open_gop = true;
+				}
+				max_frame = std::max(max_frame, frame);
+				packets.push_back({frame, pkt->pts, (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts});
+			}
+			av_packet_unref(pkt);
+		}
+		av_packet_free(&pkt);
+
+		// The end of the file also ends the last GOP
+		if (end_of_file)
+			keyframes.push_back(max_frame + 1);
+
+		// Copy from the first keyframe inside the range, to the frame before the last keyframe inside the range
+		for (int64_t keyframe : keyframes) {
+			if (keyframe >= first_frame && keyframe <= last_frame + 1) {
+				if (copy_first == 0)
+					copy_first = keyframe;
+				copy_last = keyframe - 1;
+			}
+		}
+		found = !open_gop && copy_first > 0 && copy_last >= copy_first;
+
+		// The copied packets must be decoded in order, and shown after they are decoded (or their
+		// timestamps would be changed when they are written)
+		if (found) {
+			int64_t first_pts = keyframe_pts_list[std::find(keyframes.begin(), keyframes.end(), copy_first) - keyframes.begin()];
+			int64_t first_dts = first_pts;
+			int64_t last_dts = AV_NOPTS_VALUE;
+			for (const auto& packet : packets) {
+				if (packet.frame < copy_first || packet.frame > copy_last)
+					continue;
+				if (packet.pts < packet.dts || (last_dts != AV_NOPTS_VALUE && packet.dts <= last_dts)) {
+					found = false;
+					break;
+				}
+				last_dts = packet.dts;
+				first_dts = std::min(first_dts, packet.dts);
+			}
+			decode_delay = av_rescale_q(first_pts - first_dts, source->time_base, video_st->time_base);
+		}
+	}
+	avformat_close_input(&input);
+
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"FFmpegWriter::find_copy_range",
+		"first_frame", first_frame,
+		"last_frame", last_frame,
+		"copy_first", copy_first,
+		"copy_last", copy_last,
+		"decode_delay", decode_delay,
+		"found", found);
+
+	return found;
+}
+
+// Copy the video packets of a range of GOPs from a source file (and encode the audio of those frames)
+bool FFmpegWriter::copy_pass_through(const std::string& source_path, int64_t first_frame, int64_t last_frame, int64_t timeline_frame, int64_t decode_delay) {
+	// Write the frames still buffered by the encoder (which are shown before the copied frames)
+	restart_video_encoder();
+
+	// Offset the copied timestamps to the current position of the video stream
+	int64_t offset = av_rescale_q(video_timestamp, video_codec_ctx->time_base, video_st->time_base);
+
+	// The first copied packet must be decoded after the last encoded packet (or its DTS would be changed)
+	if (video_last_dts != AV_NOPTS_VALUE && offset - decode_delay <= video_last_dts) {
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"FFmpegWriter::copy_pass_through (cannot copy, the packets would be decoded before the encoded packets)",
+			"first_frame", first_frame,
+			"last_frame", last_frame,
+			"decode_delay", decode_delay,
+			"video_last_dts", video_last_dts);
+		return false;
+	}
+
+	AVFormatContext *input = NULL;
+	AVStream *source = open_source_video(source_path, &input);
+	if (!source)
+		throw InvalidFile("Could not open source file for copying.", source_path);
+
+	// Read the audio of the copied frames directly from the file (without decoding the video)
+	std::unique_ptr<FFmpegReader> audio_reader;
+	std::unique_ptr<FrameMapper> audio_mapper;
+	if (info.has_audio && audio_st) {
+		audio_reader.reset(new FFmpegReader(source_path));
+		if (audio_reader->info.has_audio) {
+			audio_reader->Open();
+			audio_reader->info.has_video = false;
+			audio_mapper.reset(new FrameMapper(audio_reader.get(), info.fps, PULLDOWN_NONE, info.sample_rate, info.channels, info.channel_layout));
+			audio_mapper->Open();
+		}
+	}
+
+	// Encode the audio of the copied frames (up to a frame number of the source file)
+	int64_t next_audio_frame = first_frame;
+	auto write_audio = [&](int64_t up_to_frame) {
+		for (; info.has_audio && audio_st && next_audio_frame <= std::min(up_to_frame, last_frame); next_audio_frame++) {
+			int64_t number = timeline_frame + next_audio_frame - first_frame;
+			std::shared_ptr<Frame> f;
+			if (audio_mapper) {
+				f = audio_mapper->GetFrame(next_audio_frame);
+			} else {
+				// The file has no audio (so add silence)
+				f = std::make_shared<Frame>(number, Frame::GetSamplesPerFrame(number, info.fps, info.sample_rate, info.channels), info.channels);
+				f->SampleRate(info.sample_rate);
+				f->ChannelsLayout(info.channel_layout);
+			}
+			write_audio_packets(false, f);
+		}
+	};
+
+	int64_t first_pts = source_frame_to_pts(source, info.fps, first_frame);
+	av_seek_frame(input, source->index, first_pts, AVSEEK_FLAG_BACKWARD);
+
+	AVPacket *pkt = av_packet_alloc();
+	bool copying = false;
+	while (av_read_frame(input, pkt) >= 0) {
+		if (pkt->stream_index == source->index && pkt->pts != AV_NOPTS_VALUE) {
+			int64_t frame = source_pts_to_frame(source, info.fps, pkt->pts);
+			bool keyframe = pkt->flags & AV_PKT_FLAG_KEY;
+			if (keyframe && frame > last_frame) {
+				// The next GOP (which is encoded)
+				av_packet_unref(pkt);
+				break;
+			}
+			if (keyframe && frame == first_frame) {
+				// Start copying at the first keyframe (using its exact PTS)
+				copying = true;
+				first_pts = pkt->pts;
+			}
+
+			if (copying && frame >= first_frame && frame <= last_frame) {
+				int64_t dts = (pkt->dts != AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+				pkt->pts = av_rescale_q(pkt->pts - first_pts, source->time_base, video_st->time_base) + offset;
+				pkt->dts = av_rescale_q(dts - first_pts, source->time_base, video_st->time_base) + offset;
+				pkt->duration = av_rescale_q(pkt->duration, source->time_base, video_st->time_base);
+				pkt->pos = -1;
+				pkt->stream_index = video_st->index;
+				if (!fix_video_timestamps(pkt)) {
+					// Only possible if the file changed after find_copy_range
+					ZmqLogger::Instance()->AppendDebugMethod(
+						"FFmpegWriter::copy_pass_through (WARNING: the timestamps of a copied packet were changed)",
+						"frame", frame);
+				}
+
+				// Encode the audio of the frames decoded so far (so the muxer can interleave them)
+				write_audio(source_pts_to_frame(source, info.fps, dts));
+
+				int error_code = av_interleaved_write_frame(oc, pkt);
+				if (error_code < 0) {
+					ZmqLogger::Instance()->AppendDebugMethod(
+						"FFmpegWriter::copy_pass_through ERROR ["
+							+ av_err2string(error_code) + "]",
+						"error_code", error_code);
+				}
+			}
+		}
+		av_packet_unref(pkt);
+	}
+	av_packet_free(&pkt);
+	avformat_close_input(&input);
+
+	// Encode the audio of the remaining frames
+	write_audio(last_frame);
+	if (audio_mapper)
+		audio_mapper->Close();
+	if (audio_reader)
+		audio_reader->Close();
+
+	// Continue encoding after the copied frames (starting with a keyframe)
+	video_timestamp += av_rescale_q(last_frame - first_frame + 1, av_make_q(info.fps.den, info.fps.num), video_codec_ctx->time_base);
+	force_keyframe = true;
+
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"FFmpegWriter::copy_pass_through",
+		"first_frame", first_frame,
+		"last_frame", last_frame,
+		"timeline_frame", timeline_frame);
+	return true;
+}
+
+// Write the packets buffered by the video encoder, and reset it (so the next frame starts a new GOP)
+void FFmpegWriter::restart_video_encoder() {
+#if IS_FFMPEG_3_2
+	AVPacket *pkt = av_packet_alloc();
+	int error_code = avcodec_send_frame(video_codec_ctx, NULL);
+	while (error_code >= 0) {
+		error_code = avcodec_receive_packet(video_codec_ctx, pkt);
+		if (error_code < 0)
+			break;
+		av_packet_rescale_ts(pkt, video_codec_ctx->time_base, video_st->time_base);
+		pkt->stream_index = video_st->index;
+		fix_video_timestamps(pkt);
+		error_code = av_interleaved_write_frame(oc, pkt);
+	}
+	av_packet_free(&pkt);
+
+	// Reset the encoder (which only works for encoders with AV_CODEC_CAP_ENCODER_FLUSH)
+	avcodec_flush_buffers(video_codec_ctx);
+#endif
+	force_keyframe = true;
+}
+
+// Keep the DTS of video packets increasing (when switching between encoded and copied packets)
+bool FFmpegWriter::fix_video_timestamps(AVPacket *pkt) {
+	if (pkt->dts == AV_NOPTS_VALUE)
+		return true;
+
+	bool unchanged = true;
+	int64_t dts = pkt->dts;
+	int64_t pts = pkt->pts;
+	if (video_last_dts != AV_NOPTS_VALUE && pkt->dts <= video_last_dts) {
+		pkt->dts = video_last_dts + 1;
+		unchanged = false;
+	}
+	if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < pkt->dts) {
+		pkt->pts = pkt->dts;
+		unchanged = false;
+	}
+	video_last_dts = pkt->dts;
+
+	if (!unchanged) {
+		// The packet is shown later than it should be
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"FFmpegWriter::fix_video_timestamps (timestamps changed)",
+			"dts", dts,
+			"pts", pts,
+			"pkt->dts", pkt->dts,
+			"pkt->pts", pkt->pts);
+	}
+	return unchanged;
+}
+
 // Write the file trailer (after all frames are written)
 void FFmpegWriter::WriteTrailer() {
+	// Encode all frames in the pipeline (if any)
+	drain_pipeline();
+
 	// Process final audio frame (if any)
 	if (info.has_audio && audio_st)
 		write_audio_packets(true, NULL);
@@ -818,6 +1383,7 @@ void FFmpegWriter::flush_encoders() {
 				}
 				av_packet_rescale_ts(pkt, video_codec_ctx->time_base, video_st->time_base);
 				pkt->stream_index = video_st->index;
+				fix_video_timestamps(pkt);
 				error_code = av_interleaved_write_frame(oc, pkt);
 			}
 #else // IS_FFMPEG_3_2
@@ -840,6 +1406,7 @@ void FFmpegWriter::flush_encoders() {
 			// set the timestamp
 			av_packet_rescale_ts(pkt, video_codec_ctx->time_base, video_st->time_base);
 			pkt->stream_index = video_st->index;
+			fix_video_timestamps(pkt);
 
 			// Write packet
 			error_code = av_interleaved_write_frame(oc, pkt);
@@ -936,13 +1503,22 @@ void FFmpegWriter::close_video(AVFormatContext *oc, AVStream *st)
 void FFmpegWriter::close_audio(AVFormatContext *oc, AVStream *st)
 {
 	// Clear buffers
-	delete[] samples;
-	delete[] audio_outbuf;
 	delete[] audio_encoder_buffer;
-	samples = NULL;
-	audio_outbuf = NULL;
 	audio_encoder_buffer = NULL;
 
+	if (audio_fifo) {
+		av_audio_fifo_free(audio_fifo);
+		audio_fifo = NULL;
+	}
+	if (audio_frame)
+		AV_FREE_FRAME(&audio_frame);
+	if (audio_converted) {
+		av_freep(&audio_converted[0]);
+		av_freep(&audio_converted);
+	}
+	audio_converted_size = 0;
+	audio_planes.clear();
+
 	// Deallocate resample buffer
 	if (avr) {
 		SWR_CLOSE(avr);
@@ -950,12 +1526,6 @@ void FFmpegWriter::close_audio(AVFormatContext *oc, AVStream *st)
 		avr = NULL;
 	}
 
-	if (avr_planar) {
-		SWR_CLOSE(avr_planar);
-		SWR_FREE(&avr_planar);
-		avr_planar = NULL;
-	}
-
 	// Free any previous memory allocations
 	if (audio_codec_ctx != nullptr) {
 		AV_FREE_CONTEXT(audio_codec_ctx);
@@ -987,6 +1557,8 @@ void FFmpegWriter::Close() {
 	// Reset frame counters
 	video_timestamp = 0;
 	audio_timestamp = 0;
+	video_last_dts = AV_NOPTS_VALUE;
+	force_keyframe = false;
 
 	// Free the context which frees the streams too
 	avformat_free_context(oc);
@@ -1393,12 +1965,22 @@ void FFmpegWriter::open_audio(AVFormatContext *oc, AVStream *st) {
 	// Set the initial frame size (since it might change during resampling)
 	initial_audio_input_frame_size = audio_input_frame_size;
 
-	// Allocate array for samples
-	samples = new int16_t[AVCODEC_MAX_AUDIO_FRAME_SIZE];
-
-	// Set audio output buffer (used to store the encoded audio)
-	audio_outbuf_size = AVCODEC_MAX_AUDIO_FRAME_SIZE;
-	audio_outbuf = new uint8_t[audio_outbuf_size];
+	// Allocate the sample FIFO (in the codec's format, which grows as needed), and the codec frame
+	audio_fifo = av_audio_fifo_alloc(audio_codec_ctx->sample_fmt, info.channels, audio_input_frame_size * 2);
+	audio_frame = AV_ALLOCATE_FRAME();
+	if (!audio_fifo || !audio_frame)
+		throw OutOfMemory("Could not allocate audio buffers", path);
+	audio_frame->nb_samples = audio_input_frame_size;
+	audio_frame->format = audio_codec_ctx->sample_fmt;
+	audio_frame->sample_rate = info.sample_rate;
+#if HAVE_CH_LAYOUT
+	av_channel_layout_from_mask(&audio_frame->ch_layout, info.channel_layout);
+#else
+	audio_frame->channels = info.channels;
+	audio_frame->channel_layout = info.channel_layout;
+#endif
+	if (av_frame_get_buffer(audio_frame, 0) < 0)
+		throw OutOfMemory("Could not allocate audio frame", path);
 
 	// Set audio packet encoding buffer
 	audio_encoder_buffer_size = AUDIO_PACKET_ENCODING_SIZE;
@@ -1413,7 +1995,7 @@ void FFmpegWriter::open_audio(AVFormatContext *oc, AVStream *st) {
 		"FFmpegWriter::open_audio",
 		"audio_codec_ctx->thread_count", audio_codec_ctx->thread_count,
 		"audio_input_frame_size", audio_input_frame_size,
-		"buffer_size", AVCODEC_MAX_AUDIO_FRAME_SIZE + MY_INPUT_BUFFER_PADDING_SIZE);
+		"sample_fmt", audio_codec_ctx->sample_fmt);
 }
 
 // open video codec
@@ -1566,459 +2148,203 @@ void FFmpegWriter::write_audio_packets(bool is_final, std::shared_ptr<openshot::
 	if (!frame && !is_final)
 		return;
 
-	// Init audio buffers / variables
-	int total_frame_samples = 0;
-	int frame_position = 0;
+	// Get the audio details from this frame
 	int channels_in_frame = 0;
 	int sample_rate_in_frame = 0;
 	int samples_in_frame = 0;
 	ChannelLayout channel_layout_in_frame = LAYOUT_MONO; // default channel layout
 
-	// Create a new array (to hold all S16 audio samples, for the current queued frames
-	unsigned int all_queued_samples_size = sizeof(int16_t) * AVCODEC_MAX_AUDIO_FRAME_SIZE;
-	int16_t *all_queued_samples = (int16_t *) av_malloc(all_queued_samples_size);
-	int16_t *all_resampled_samples = NULL;
-	int16_t *final_samples_planar = NULL;
-	int16_t *final_samples = NULL;
-
-	// Get audio sample array
-	float *frame_samples_float = NULL;
-
-	// Get the audio details from this frame
 	if (frame) {
 		sample_rate_in_frame = frame->SampleRate();
 		samples_in_frame = frame->GetAudioSamplesCount();
 		channels_in_frame = frame->GetAudioChannelsCount();
 		channel_layout_in_frame = frame->ChannelsLayout();
 
-		// Get samples interleaved together (c1 c2 c1 c2 c1 c2)
-		frame_samples_float = frame->GetInterleavedAudioSamples(&samples_in_frame);
+		// The audio of a frame is already planar float, so point at each channel (instead of copying it)
+		audio_planes.resize(channels_in_frame);
+		for (int channel = 0; channel < channels_in_frame; channel++)
+			audio_planes[channel] = reinterpret_cast<const uint8_t *>(frame->GetAudioSamples(channel));
 	}
 
-	// Calculate total samples
-	total_frame_samples = samples_in_frame * channels_in_frame;
-
-	// Translate audio sample values back to 16 bit integers with saturation
-	const int16_t max16 = 32767;
-	const int16_t min16 = -32768;
-	for (int s = 0; s < total_frame_samples; s++, frame_position++) {
-		float valF = frame_samples_float[s] * (1 << 15);
-		int16_t conv;
-		if (valF > max16) {
-			conv = max16;
-		} else if (valF < min16) {
-			conv = min16;
-		} else {
-			conv = int(valF + 32768.5) - 32768; // +0.5 is for rounding
-		}
-
-		// Copy into buffer
-		all_queued_samples[frame_position] = conv;
-	}
-
-	// Deallocate float array
-	delete[] frame_samples_float;
-
-
-	// Update total samples (since we've combined all queued frames)
-	total_frame_samples = frame_position;
-	int remaining_frame_samples = total_frame_samples;
-	int samples_position = 0;
-
-
 	ZmqLogger::Instance()->AppendDebugMethod(
 		"FFmpegWriter::write_audio_packets",
 		"is_final", is_final,
-		"total_frame_samples", total_frame_samples,
 		"channel_layout_in_frame", channel_layout_in_frame,
 		"channels_in_frame", channels_in_frame,
 		"samples_in_frame", samples_in_frame,
-		"LAYOUT_MONO", LAYOUT_MONO);
-
-	// Keep track of the original sample format
-	AVSampleFormat output_sample_fmt = audio_codec_ctx->sample_fmt;
-
-	AVFrame *audio_frame = NULL;
-	if (!is_final) {
-		// Create input frame (and allocate arrays)
-		audio_frame = AV_ALLOCATE_FRAME();
-		AV_RESET_FRAME(audio_frame);
-		audio_frame->nb_samples = total_frame_samples / channels_in_frame;
-
-		// Fill input frame with sample data
-		int error_code = avcodec_fill_audio_frame(audio_frame, channels_in_frame, AV_SAMPLE_FMT_S16, (uint8_t *) all_queued_samples, all_queued_samples_size, 0);
-		if (error_code < 0) {
-			ZmqLogger::Instance()->AppendDebugMethod(
-				"FFmpegWriter::write_audio_packets ERROR ["
-					+ av_err2string(error_code) + "]",
-				"error_code", error_code);
-		}
-
-		// Do not convert audio to planar format (yet). We need to keep everything interleaved at this point.
-		switch (audio_codec_ctx->sample_fmt) {
-			case AV_SAMPLE_FMT_FLTP: {
-				output_sample_fmt = AV_SAMPLE_FMT_FLT;
-				break;
-			}
-			case AV_SAMPLE_FMT_S32P: {
-				output_sample_fmt = AV_SAMPLE_FMT_S32;
-				break;
-			}
-			case AV_SAMPLE_FMT_S16P: {
-				output_sample_fmt = AV_SAMPLE_FMT_S16;
-				break;
-			}
-			case AV_SAMPLE_FMT_U8P: {
-				output_sample_fmt = AV_SAMPLE_FMT_U8;
-				break;
-			}
-			default: {
-				// This is only here to silence unused-enum warnings
-				break;
-			}
-		}
-
-		// Update total samples & input frame size (due to bigger or smaller data types)
-		total_frame_samples *= (float(info.sample_rate) / sample_rate_in_frame); // adjust for different byte sizes
-		total_frame_samples *= (float(info.channels) / channels_in_frame); // adjust for different # of channels
-
-		// Create output frame (and allocate arrays)
-		AVFrame *audio_converted = AV_ALLOCATE_FRAME();
-		AV_RESET_FRAME(audio_converted);
-		audio_converted->nb_samples = total_frame_samples / channels_in_frame;
-		av_samples_alloc(audio_converted->data, audio_converted->linesize, info.channels, audio_converted->nb_samples, output_sample_fmt, 0);
-
-		ZmqLogger::Instance()->AppendDebugMethod(
-			"FFmpegWriter::write_audio_packets (1st resampling)",
-			"in_sample_fmt", AV_SAMPLE_FMT_S16,
-			"out_sample_fmt", output_sample_fmt,
-			"in_sample_rate", sample_rate_in_frame,
-			"out_sample_rate", info.sample_rate,
-			"in_channels", channels_in_frame,
-			"out_channels", info.channels);
-
-		// setup resample context
-		if (!avr) {
-			avr = SWR_ALLOC();
-#if HAVE_CH_LAYOUT
-			AVChannelLayout in_chlayout;
-			AVChannelLayout out_chlayout;
-			av_channel_layout_from_mask(&in_chlayout, channel_layout_in_frame);
-			av_channel_layout_from_mask(&out_chlayout, info.channel_layout);
-			av_opt_set_chlayout(avr, "in_chlayout", &in_chlayout, 0);
-			av_opt_set_chlayout(avr, "out_chlayout", &out_chlayout, 0);
-#else
-			av_opt_set_int(avr, "in_channel_layout", channel_layout_in_frame, 0);
-			av_opt_set_int(avr, "out_channel_layout", info.channel_layout, 0);
-			av_opt_set_int(avr, "in_channels", channels_in_frame, 0);
-			av_opt_set_int(avr, "out_channels", info.channels, 0);
-#endif
-			av_opt_set_int(avr, "in_sample_fmt", AV_SAMPLE_FMT_S16, 0);
-			av_opt_set_int(avr, "out_sample_fmt", output_sample_fmt, 0); // planar not allowed here
-			av_opt_set_int(avr, "in_sample_rate", sample_rate_in_frame, 0);
-			av_opt_set_int(avr, "out_sample_rate", info.sample_rate, 0);
-			SWR_INIT(avr);
-		}
-		// Convert audio samples
-		int nb_samples = SWR_CONVERT(
-			avr,	// audio resample context
-			audio_converted->data,		   // output data pointers
-			audio_converted->linesize[0],	// output plane size, in bytes. (0 if unknown)
-			audio_converted->nb_samples,	 // maximum number of samples that the output buffer can hold
-			audio_frame->data,			   // input data pointers
-			audio_frame->linesize[0],		// input plane size, in bytes (0 if unknown)
-			audio_frame->nb_samples		// number of input samples to convert
-		);
-
-		// Set remaining samples
-		remaining_frame_samples = total_frame_samples;
-
-		// Create a new array (to hold all resampled S16 audio samples)
-		all_resampled_samples = (int16_t *) av_malloc(
-			sizeof(int16_t) * nb_samples * info.channels
-			* (av_get_bytes_per_sample(output_sample_fmt) /
-			   av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) )
-		);
-
-		// Copy audio samples over original samples
-		memcpy(all_resampled_samples, audio_converted->data[0],
-			   static_cast<size_t>(nb_samples)
-				   * info.channels
-				   * av_get_bytes_per_sample(output_sample_fmt));
-
-		// Remove converted audio
-		av_freep(&(audio_frame->data[0]));
-		AV_FREE_FRAME(&audio_frame);
-		av_freep(&audio_converted->data[0]);
-		AV_FREE_FRAME(&audio_converted);
-		all_queued_samples = NULL; // this array cleared with above call
-
-		ZmqLogger::Instance()->AppendDebugMethod(
-			"FFmpegWriter::write_audio_packets (Successfully completed 1st resampling)",
-			"nb_samples", nb_samples,
-			"remaining_frame_samples", remaining_frame_samples);
-	}
-
-	// Loop until no more samples
-	while (remaining_frame_samples > 0 || is_final) {
-		// Get remaining samples needed for this packet
-		int remaining_packet_samples = (audio_input_frame_size * info.channels) - audio_input_position;
-
-		// Determine how many samples we need
-		int diff = 0;
-		if (remaining_frame_samples >= remaining_packet_samples) {
-			diff = remaining_packet_samples;
+		"sample_rate_in_frame", sample_rate_in_frame,
+		"fifo_size", av_audio_fifo_size(audio_fifo));
+
+	if (samples_in_frame > 0 && channels_in_frame > 0 && sample_rate_in_frame > 0) {
+		if (!avr && audio_codec_ctx->sample_fmt == AV_SAMPLE_FMT_FLTP
+			&& sample_rate_in_frame == info.sample_rate
+			&& channels_in_frame == info.channels
+			&& channel_layout_in_frame == info.channel_layout) {
+			// The codec wants exactly these samples (i.e. AAC, Opus, Vorbis), so no conversion is needed
+			av_audio_fifo_write(audio_fifo, (void **) audio_planes.data(), samples_in_frame);
 		} else {
-			diff = remaining_frame_samples;
-		}
-
-		// Copy frame samples into the packet samples array
-		if (!is_final)
-			//TODO: Make this more sane
-			memcpy(
-				samples + (audio_input_position
-					* (av_get_bytes_per_sample(output_sample_fmt) /
-					   av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) )
-				),
-				all_resampled_samples + samples_position,
-				static_cast<size_t>(diff)
-					* av_get_bytes_per_sample(output_sample_fmt)
-			);
-
-		// Increment counters
-		audio_input_position += diff;
-		samples_position += diff * (av_get_bytes_per_sample(output_sample_fmt) / av_get_bytes_per_sample(AV_SAMPLE_FMT_S16));
-		remaining_frame_samples -= diff;
-
-		// Do we have enough samples to proceed?
-		if (audio_input_position < (audio_input_frame_size * info.channels) && !is_final)
-			// Not enough samples to encode... so wait until the next frame
-			break;
-
-		// Convert to planar (if needed by audio codec)
-		AVFrame *frame_final = AV_ALLOCATE_FRAME();
-		AV_RESET_FRAME(frame_final);
-		if (av_sample_fmt_is_planar(audio_codec_ctx->sample_fmt)) {
-			ZmqLogger::Instance()->AppendDebugMethod(
-				"FFmpegWriter::write_audio_packets (2nd resampling for Planar formats)",
-				"in_sample_fmt", output_sample_fmt,
-				"out_sample_fmt", audio_codec_ctx->sample_fmt,
-				"in_sample_rate", info.sample_rate,
-				"out_sample_rate", info.sample_rate,
-				"in_channels", info.channels,
-				"out_channels", info.channels
-			);
-
-			// setup resample context
-			if (!avr_planar) {
-				avr_planar = SWR_ALLOC();
+			// setup resample context (from planar float, directly to the codec's format)
+			if (!avr) {
+				ZmqLogger::Instance()->AppendDebugMethod(
+					"FFmpegWriter::write_audio_packets (init resampling)",
+					"in_sample_fmt", AV_SAMPLE_FMT_FLTP,
+					"out_sample_fmt", audio_codec_ctx->sample_fmt,
+					"in_sample_rate", sample_rate_in_frame,
+					"out_sample_rate", info.sample_rate,
+					"in_channels", channels_in_frame,
+					"out_channels", info.channels);
+
+				avr = SWR_ALLOC();
 #if HAVE_CH_LAYOUT
-				AVChannelLayout layout;
-				av_channel_layout_from_mask(&layout, info.channel_layout);
-				av_opt_set_chlayout(avr_planar, "in_chlayout", &layout, 0);
-				av_opt_set_chlayout(avr_planar, "out_chlayout", &layout, 0);
+				AVChannelLayout in_chlayout;
+				AVChannelLayout out_chlayout;
+				av_channel_layout_from_mask(&in_chlayout, channel_layout_in_frame);
+				av_channel_layout_from_mask(&out_chlayout, info.channel_layout);
+				av_opt_set_chlayout(avr, "in_chlayout", &in_chlayout, 0);
+				av_opt_set_chlayout(avr, "out_chlayout", &out_chlayout, 0);
 #else
-				av_opt_set_int(avr_planar, "in_channel_layout", info.channel_layout, 0);
-				av_opt_set_int(avr_planar, "out_channel_layout", info.channel_layout, 0);
-				av_opt_set_int(avr_planar, "in_channels", info.channels, 0);
-				av_opt_set_int(avr_planar, "out_channels", info.channels, 0);
+				av_opt_set_int(avr, "in_channel_layout", channel_layout_in_frame, 0);
+				av_opt_set_int(avr, "out_channel_layout", info.channel_layout, 0);
+				av_opt_set_int(avr, "in_channels", channels_in_frame, 0);
+				av_opt_set_int(avr, "out_channels", info.channels, 0);
 #endif
-				av_opt_set_int(avr_planar, "in_sample_fmt", output_sample_fmt, 0);
-				av_opt_set_int(avr_planar, "out_sample_fmt", audio_codec_ctx->sample_fmt, 0); // planar not allowed here
-				av_opt_set_int(avr_planar, "in_sample_rate", info.sample_rate, 0);
-				av_opt_set_int(avr_planar, "out_sample_rate", info.sample_rate, 0);
-				SWR_INIT(avr_planar);
+				av_opt_set_int(avr, "in_sample_fmt", AV_SAMPLE_FMT_FLTP, 0);
+				av_opt_set_int(avr, "out_sample_fmt", audio_codec_ctx->sample_fmt, 0); // planar allowed here
+				av_opt_set_int(avr, "in_sample_rate", sample_rate_in_frame, 0);
+				av_opt_set_int(avr, "out_sample_rate", info.sample_rate, 0);
+				SWR_INIT(avr);
 			}
 
-			// Create input frame (and allocate arrays)
-			audio_frame = AV_ALLOCATE_FRAME();
-			AV_RESET_FRAME(audio_frame);
-			audio_frame->nb_samples = audio_input_position / info.channels;
-
-			// Create a new array
-			final_samples_planar = (int16_t *) av_malloc(
-				sizeof(int16_t) * audio_frame->nb_samples * info.channels
-				* (av_get_bytes_per_sample(output_sample_fmt) /
-				   av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) )
-			);
-
-			// Copy audio into buffer for frame
-			memcpy(final_samples_planar, samples,
-				   static_cast<size_t>(audio_frame->nb_samples)
-					   * info.channels
-					   * av_get_bytes_per_sample(output_sample_fmt));
-
-			// Fill input frame with sample data
-			avcodec_fill_audio_frame(audio_frame, info.channels, output_sample_fmt,
-				(uint8_t *) final_samples_planar, audio_encoder_buffer_size, 0);
-
-			// Create output frame (and allocate arrays)
-			frame_final->nb_samples = audio_input_frame_size;
-#if HAVE_CH_LAYOUT
-			av_channel_layout_from_mask(&frame_final->ch_layout, info.channel_layout);
-#else
-			frame_final->channels = info.channels;
-			frame_final->channel_layout = info.channel_layout;
-#endif
-			frame_final->format = audio_codec_ctx->sample_fmt;
-			av_samples_alloc(frame_final->data, frame_final->linesize, info.channels,
-				frame_final->nb_samples, audio_codec_ctx->sample_fmt, 0);
+			// Grow the conversion buffer (if needed), with room for samples delayed by the resampler
+			int max_samples = av_rescale_rnd(samples_in_frame, info.sample_rate, sample_rate_in_frame, AV_ROUND_UP) + 256;
+			if (max_samples > audio_converted_size) {
+				if (audio_converted) {
+					av_freep(&audio_converted[0]);
+					av_freep(&audio_converted);
+				}
+				if (av_samples_alloc_array_and_samples(&audio_converted, NULL, info.channels, max_samples, audio_codec_ctx->sample_fmt, 0) < 0)
+					throw OutOfMemory("Could not allocate audio conversion buffer", path);
+				audio_converted_size = max_samples;
+			}
 
-			// Convert audio samples
+			// Convert audio samples (the S16 / S32 conversions of the resampler are vectorized)
 			int nb_samples = SWR_CONVERT(
-				avr_planar,				  // audio resample context
-				frame_final->data,		   // output data pointers
-				frame_final->linesize[0],	// output plane size, in bytes. (0 if unknown)
-				frame_final->nb_samples,	 // maximum number of samples that the output buffer can hold
-				audio_frame->data,		   // input data pointers
-				audio_frame->linesize[0],	// input plane size, in bytes (0 if unknown)
-				audio_frame->nb_samples	  // number of input samples to convert
+				avr,							// audio resample context
+				audio_converted,				// output data pointers
+				0,								// output plane size, in bytes. (0 if unknown)
+				audio_converted_size,			// maximum number of samples that the output buffer can hold
+				audio_planes.data(),			// input data pointers
+				samples_in_frame * sizeof(float), // input plane size, in bytes (0 if unknown)
+				samples_in_frame				// number of input samples to convert
 			);
-
-			// Copy audio samples over original samples
-			const auto copy_length = static_cast<size_t>(nb_samples)
-				* av_get_bytes_per_sample(audio_codec_ctx->sample_fmt)
-				* info.channels;
-
 			if (nb_samples > 0)
-				memcpy(samples, frame_final->data[0], copy_length);
+				av_audio_fifo_write(audio_fifo, (void **) audio_converted, nb_samples);
+		}
+	}
 
-			// deallocate AVFrame
-			av_freep(&(audio_frame->data[0]));
-			AV_FREE_FRAME(&audio_frame);
-			all_queued_samples = NULL; // this array cleared with above call
+	if (is_final && avr) {
+		// Flush the samples still delayed by the resampler
+		int nb_samples = 0;
+		while ((nb_samples = SWR_CONVERT(avr, audio_converted, 0, audio_converted_size, NULL, 0, 0)) > 0)
+			av_audio_fifo_write(audio_fifo, (void **) audio_converted, nb_samples);
+	}
 
-			ZmqLogger::Instance()->AppendDebugMethod(
-				"FFmpegWriter::write_audio_packets (Successfully completed 2nd resampling for Planar formats)",
-				"nb_samples", nb_samples);
+	// Encode each full codec frame (and the remaining samples, as a shorter last frame)
+	while (av_audio_fifo_size(audio_fifo) >= audio_input_frame_size
+		   || (is_final && av_audio_fifo_size(audio_fifo) > 0)) {
+		// Make sure the encoder is no longer referencing the frame's buffer
+		if (av_frame_make_writable(audio_frame) < 0)
+			throw OutOfMemory("Could not allocate audio frame", path);
 
-		} else {
-			// Create a new array
-			const auto buf_size = static_cast<size_t>(audio_input_position)
-				* (av_get_bytes_per_sample(audio_codec_ctx->sample_fmt) /
-				   av_get_bytes_per_sample(AV_SAMPLE_FMT_S16)
-				);
-			final_samples = reinterpret_cast<int16_t*>(
-					av_malloc(sizeof(int16_t) * buf_size));
-
-			// Copy audio into buffer for frame
-			memcpy(final_samples, samples,
-				audio_input_position * av_get_bytes_per_sample(audio_codec_ctx->sample_fmt));
-
-			// Init the nb_samples property
-			frame_final->nb_samples = audio_input_frame_size;
-
-			// Fill the final_frame AVFrame with audio (non planar)
-#if HAVE_CH_LAYOUT
-			int nb_channels = audio_codec_ctx->ch_layout.nb_channels;
-#else
-			int nb_channels = audio_codec_ctx->channels;
-#endif
-			avcodec_fill_audio_frame(frame_final, nb_channels,
-				audio_codec_ctx->sample_fmt, (uint8_t *) final_samples,
-				audio_encoder_buffer_size, 0);
-		}
+		audio_frame->nb_samples = FFMIN(av_audio_fifo_size(audio_fifo), audio_input_frame_size);
+		av_audio_fifo_read(audio_fifo, (void **) audio_frame->data, audio_frame->nb_samples);
+		encode_audio_frame(audio_frame);
+	}
+}
 
-		// Set the AVFrame's PTS
-		frame_final->pts = audio_timestamp;
+// Encode one codec frame of audio, and write its packet (if any) to the video file
+void FFmpegWriter::encode_audio_frame(AVFrame *frame_final) {
+	// Set the AVFrame's PTS
+	frame_final->pts = audio_timestamp;
 
-		// Init the packet
+	// Init the packet
 #if IS_FFMPEG_3_2
-		AVPacket* pkt = av_packet_alloc();
+	AVPacket* pkt = av_packet_alloc();
 #else
-		AVPacket* pkt;
-		av_init_packet(pkt);
+	AVPacket* pkt;
+	av_init_packet(pkt);
 #endif
-		pkt->data = audio_encoder_buffer;
-		pkt->size = audio_encoder_buffer_size;
+	pkt->data = audio_encoder_buffer;
+	pkt->size = audio_encoder_buffer_size;
 
-		// Set the packet's PTS prior to encoding
-		pkt->pts = pkt->dts = audio_timestamp;
+	// Set the packet's PTS prior to encoding
+	pkt->pts = pkt->dts = audio_timestamp;
 
-		/* encode the audio samples */
-		int got_packet_ptr = 0;
+	/* encode the audio samples */
+	int got_packet_ptr = 0;
 
 #if IS_FFMPEG_3_2
-		// Encode audio (latest version of FFmpeg)
-		int error_code;
-		int ret = 0;
-		int frame_finished = 0;
-		error_code = ret =  avcodec_send_frame(audio_codec_ctx, frame_final);
-		if (ret < 0 && ret !=  AVERROR(EINVAL) && ret != AVERROR_EOF) {
-			avcodec_send_frame(audio_codec_ctx, NULL);
-		}
-		else {
-			if (ret >= 0)
-				pkt->size = 0;
-			ret =  avcodec_receive_packet(audio_codec_ctx, pkt);
-			if (ret >= 0)
-				frame_finished = 1;
-			if(ret == AVERROR(EINVAL) || ret == AVERROR_EOF) {
-				avcodec_flush_buffers(audio_codec_ctx);
-				ret = 0;
-			}
-			if (ret >= 0) {
-				ret = frame_finished;
-			}
+	// Encode audio (latest version of FFmpeg)
+	int error_code;
+	int ret = 0;
+	int frame_finished = 0;
+	error_code = ret =  avcodec_send_frame(audio_codec_ctx, frame_final);
+	if (ret < 0 && ret !=  AVERROR(EINVAL) && ret != AVERROR_EOF) {
+		avcodec_send_frame(audio_codec_ctx, NULL);
+	}
+	else {
+		if (ret >= 0)
+			pkt->size = 0;
+		ret =  avcodec_receive_packet(audio_codec_ctx, pkt);
+		if (ret >= 0)
+			frame_finished = 1;
+		if(ret == AVERROR(EINVAL) || ret == AVERROR_EOF) {
+			avcodec_flush_buffers(audio_codec_ctx);
+			ret = 0;
 		}
-		if (!pkt->data && !frame_finished)
-		{
-			ret = -1;
+		if (ret >= 0) {
+			ret = frame_finished;
 		}
-		got_packet_ptr = ret;
+	}
+	if (!pkt->data && !frame_finished)
+	{
+		ret = -1;
+	}
+	got_packet_ptr = ret;
 #else
-		// Encode audio (older versions of FFmpeg)
-		int error_code = avcodec_encode_audio2(audio_codec_ctx, pkt, frame_final, &got_packet_ptr);
+	// Encode audio (older versions of FFmpeg)
+	int error_code = avcodec_encode_audio2(audio_codec_ctx, pkt, frame_final, &got_packet_ptr);
 #endif
-		/* if zero size, it means the image was buffered */
-		if (error_code == 0 && got_packet_ptr) {
-
-			// Since the PTS can change during encoding, set the value again.  This seems like a huge hack,
-			// but it fixes lots of PTS related issues when I do this.
-			pkt->pts = pkt->dts = audio_timestamp;
-
-			// Scale the PTS to the audio stream timebase (which is sometimes different than the codec's timebase)
-			av_packet_rescale_ts(pkt, audio_codec_ctx->time_base, audio_st->time_base);
-
-			// set stream
-			pkt->stream_index = audio_st->index;
-			pkt->flags |= AV_PKT_FLAG_KEY;
-
-			/* write the compressed frame in the media file */
-			error_code = av_interleaved_write_frame(oc, pkt);
-		}
-
-		if (error_code < 0) {
-			ZmqLogger::Instance()->AppendDebugMethod(
-				"FFmpegWriter::write_audio_packets ERROR ["
-					+ av_err2string(error_code) + "]",
-				"error_code", error_code);
-		}
+	/* if zero size, it means the image was buffered */
+	if (error_code == 0 && got_packet_ptr) {
 
-		// Increment PTS (no pkt.duration, so calculate with maths)
-		audio_timestamp += FFMIN(audio_input_frame_size, audio_input_position);
+		// Since the PTS can change during encoding, set the value again.  This seems like a huge hack,
+		// but it fixes lots of PTS related issues when I do this.
+		pkt->pts = pkt->dts = audio_timestamp;
 
-		// deallocate AVFrame
-		av_freep(&(frame_final->data[0]));
-		AV_FREE_FRAME(&frame_final);
+		// Scale the PTS to the audio stream timebase (which is sometimes different than the codec's timebase)
+		av_packet_rescale_ts(pkt, audio_codec_ctx->time_base, audio_st->time_base);
 
-		// deallocate memory for packet
-		AV_FREE_PACKET(pkt);
+		// set stream
+		pkt->stream_index = audio_st->index;
+		pkt->flags |= AV_PKT_FLAG_KEY;
 
-		// Reset position
-		audio_input_position = 0;
-		is_final = false;
+		/* write the compressed frame in the media file */
+		error_code = av_interleaved_write_frame(oc, pkt);
 	}
 
-	// Delete arrays (if needed)
-	if (all_resampled_samples) {
-		av_freep(&all_resampled_samples);
-		all_resampled_samples = NULL;
-	}
-	if (all_queued_samples) {
-		av_freep(&all_queued_samples);
-		all_queued_samples = NULL;
+	if (error_code < 0) {
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"FFmpegWriter::encode_audio_frame ERROR ["
+				+ av_err2string(error_code) + "]",
+			"error_code", error_code);
 	}
+
+	// Increment PTS (no pkt.duration, so calculate with maths)
+	audio_timestamp += frame_final->nb_samples;
+
+	// deallocate memory for packet
+	AV_FREE_PACKET(pkt);
 }
 
 // Allocate an AVFrame object
@@ -2069,6 +2395,16 @@ void FFmpegWriter::process_video_packet(std::shared_ptr<Frame> frame) {
 	if (rescaler_position == num_of_rescalers)
 		rescaler_position = 0;
 
+	// Resize & convert pixel format, and add resized AVFrame to av_frames map
+	add_avframe(frame, convert_video_frame(frame, scaler));
+}
+
+// Resize and convert the image of a frame to the output pixel format
+AVFrame *FFmpegWriter::convert_video_frame(std::shared_ptr<Frame> frame, SwsContext *scaler) {
+	// Determine the height & width of the source image
+	int source_image_width = frame->GetWidth();
+	int source_image_height = frame->GetHeight();
+
 	// Allocate an RGB frame & final output frame
 	int bytes_source = 0;
 	int bytes_final = 0;
@@ -2100,7 +2436,7 @@ void FFmpegWriter::process_video_packet(std::shared_ptr<Frame> frame) {
 	// Fill with data
 	AV_COPY_PICTURE_DATA(frame_source, (uint8_t *) pixels, PIX_FMT_RGBA, source_image_width, source_image_height);
 	ZmqLogger::Instance()->AppendDebugMethod(
-		"FFmpegWriter::process_video_packet",
+		"FFmpegWriter::convert_video_frame",
 		"frame->number", frame->number,
 		"bytes_source", bytes_source,
 		"bytes_final", bytes_final);
@@ -2109,11 +2445,10 @@ void FFmpegWriter::process_video_packet(std::shared_ptr<Frame> frame) {
 	sws_scale(scaler, frame_source->data, frame_source->linesize, 0,
 			  source_image_height, frame_final->data, frame_final->linesize);
 
-	// Add resized AVFrame to av_frames map
-	add_avframe(frame, frame_final);
-
 	// Deallocate memory
 	AV_FREE_FRAME(&frame_source);
+
+	return frame_final;
 }
 
 // write video frame
@@ -2183,6 +2518,12 @@ bool FFmpegWriter::write_video_packet(std::shared_ptr<Frame> frame, AVFrame *fra
 
 		// Assign the initial AVFrame PTS from the frame counter
 		frame_final->pts = video_timestamp;
+
+		// Start a new GOP after copied packets (see SetSmartRender)
+		if (force_keyframe) {
+			frame_final->pict_type = AV_PICTURE_TYPE_I;
+			force_keyframe = false;
+		}
 #if USE_HW_ACCEL
 		if (hw_en_on && hw_en_supported) {
 			if (!(hw_frame = av_frame_alloc())) {
@@ -2262,6 +2603,7 @@ bool FFmpegWriter::write_video_packet(std::shared_ptr<Frame> frame, AVFrame *fra
 			// set the timestamp
 			av_packet_rescale_ts(pkt, video_codec_ctx->time_base, video_st->time_base);
 			pkt->stream_index = video_st->index;
+			fix_video_timestamps(pkt);
 
 			/* write the compressed frame in the media file */
 			int result = av_interleaved_write_frame(oc, pkt);
@@ -2301,31 +2643,34 @@ void FFmpegWriter::OutputStreamInfo() {
 
 // Init a collection of software rescalers (thread safe)
 void FFmpegWriter::InitScalers(int source_width, int source_height) {
-	int scale_mode = SWS_FAST_BILINEAR;
-	if (openshot::Settings::Instance()->HIGH_QUALITY_SCALING) {
-		scale_mode = SWS_BICUBIC;
-	}
-
 	// Init software rescalers vector (many of them, one for each thread)
 	for (int x = 0; x < num_of_rescalers; x++) {
 		// Init the software scaler from FFMpeg
-#if USE_HW_ACCEL
-		if (hw_en_on && hw_en_supported) {
-			img_convert_ctx = sws_getContext(source_width, source_height, PIX_FMT_RGBA,
-				info.width, info.height, AV_PIX_FMT_NV12, scale_mode, NULL, NULL, NULL);
-		} else
-#endif // USE_HW_ACCEL
-		{
-			img_convert_ctx = sws_getContext(source_width, source_height, PIX_FMT_RGBA,
-				info.width, info.height, AV_GET_CODEC_PIXEL_FORMAT(video_st, video_st->codec),
-				scale_mode, NULL, NULL, NULL);
-		}
+		img_convert_ctx = create_scaler(source_width, source_height);
 
 		// Add rescaler to vector
 		image_rescalers.push_back(img_convert_ctx);
 	}
 }
 
+// Create a software scaler (from the RGBA source size to the output size and pixel format)
+SwsContext *FFmpegWriter::create_scaler(int source_width, int source_height) {
+	int scale_mode = SWS_FAST_BILINEAR;
+	if (openshot::Settings::Instance()->HIGH_QUALITY_SCALING) {
+		scale_mode = SWS_BICUBIC;
+	}
+
+#if USE_HW_ACCEL
+	if (hw_en_on && hw_en_supported) {
+		return sws_getContext(source_width, source_height, PIX_FMT_RGBA,
+			info.width, info.height, AV_PIX_FMT_NV12, scale_mode, NULL, NULL, NULL);
+	}
+#endif // USE_HW_ACCEL
+	return sws_getContext(source_width, source_height, PIX_FMT_RGBA,
+		info.width, info.height, AV_GET_CODEC_PIXEL_FORMAT(video_st, video_st->codec),
+		scale_mode, NULL, NULL, NULL);
+}
+
 // Set audio resample options
 void FFmpegWriter::ResampleAudio(int sample_rate, int channels) {
 	original_sample_rate = sample_rate;
@@ -19,6 +19,14 @@
 #include "ReaderBase.h"
 #include "WriterBase.h"
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 // Include FFmpeg headers and macros
 #include "FFmpegUtilities.h"
 
@@ -130,21 +138,23 @@ namespace openshot {
 		AVCodecContext *video_codec_ctx;
 		AVCodecContext *audio_codec_ctx;
 		SwsContext *img_convert_ctx;
-		int16_t *samples;
-		uint8_t *audio_outbuf;
 		uint8_t *audio_encoder_buffer;
 
 		int num_of_rescalers;
 		int rescaler_position;
 		std::vector<SwsContext *> image_rescalers;
 
-		int audio_outbuf_size;
 		int audio_input_frame_size;
 		int initial_audio_input_frame_size;
-		int audio_input_position;
 		int audio_encoder_buffer_size;
 		SWRCONTEXT *avr;
-		SWRCONTEXT *avr_planar;
+
+		/* Audio buffers (allocated once, and reused for every frame) */
+		AVAudioFifo *audio_fifo; ///< Samples in the codec's format, waiting for a full codec frame
+		AVFrame *audio_frame; ///< Codec frame passed to the encoder
+		uint8_t **audio_converted; ///< Output of the resampler (in the codec's format)
+		int audio_converted_size; ///< Max # of samples per channel in audio_converted
+		std::vector<const uint8_t *> audio_planes; ///< Channel pointers of the current frame (planar float)
 
 		/* Resample options */
 		int original_sample_rate;
@@ -153,6 +163,26 @@ namespace openshot {
 		std::shared_ptr<openshot::Frame> last_frame;
 		std::map<std::shared_ptr<openshot::Frame>, AVFrame *> av_frames;
 
+		/* Pipelined encoding (see SetPipeline) */
+		int pipeline_size; ///< Max # of frames in the pipeline (0 = write frames on the caller's thread)
+		bool pipeline_running; ///< Are the pipeline threads running
+		bool pipeline_draining; ///< Are the pipeline threads finishing the queued frames (and stopping)
+		int pipeline_frames; ///< # of frames in the pipeline (queued, being converted, or waiting to be encoded)
+		int64_t pipeline_next_input; ///< Sequence # of the next frame added to the pipeline
+		int64_t pipeline_next_output; ///< Sequence # of the next frame to encode (frames are encoded in order)
+		std::deque<std::pair<int64_t, std::shared_ptr<openshot::Frame>>> pipeline_input; ///< Frames waiting for color conversion
+		std::map<int64_t, std::pair<std::shared_ptr<openshot::Frame>, AVFrame *>> pipeline_output; ///< Converted frames (by sequence #)
+		std::vector<std::thread> pipeline_converters; ///< Color conversion threads (each with its own scaler)
+		std::thread pipeline_encoder; ///< Encoding and muxing thread
+		std::mutex pipelineMutex; ///< Mutex protecting the pipeline state above
+		std::condition_variable pipelineCondition; ///< Signaled when the pipeline state changes
+		std::exception_ptr pipeline_error; ///< First error of the pipeline threads (thrown on the caller's thread)
+
+		/* Smart rendering (see SetSmartRender) */
+		bool smart_render; ///< Copy the compressed packets of unmodified timeline ranges (instead of encoding them)
+		bool force_keyframe; ///< Encode the next video frame as a keyframe (i.e. after copied packets)
+		int64_t video_last_dts; ///< DTS of the last video packet written (in the stream's timebase)
+
 		/// Add an AVFrame to the cache
 		void add_avframe(std::shared_ptr<openshot::Frame> frame, AVFrame *av_frame);
 
@@ -168,12 +198,50 @@ namespace openshot {
 		/// Auto detect format (from path)
 		void auto_detect_format();
 
+		/// Can the encoder be reset between copied packets (and does it produce the same codec, size, pixel format, and codec parameters as a source stream)
+		bool can_copy_video(AVStream *source);
+
 		/// Close the audio codec
 		void close_audio(AVFormatContext *oc, AVStream *st);
 
 		/// Close the video codec
 		void close_video(AVFormatContext *oc, AVStream *st);
 
+		/// Create a software scaler (from the RGBA source size to the output size and pixel format)
+		SwsContext *create_scaler(int source_width, int source_height);
+
+		/// @brief Copy the video packets of a range of GOPs from a source file (and encode the audio of those frames)
+		/// @param source_path The path of the source file
+		/// @param first_frame The first frame of the source file (a keyframe)
+		/// @param last_frame The last frame of the source file (the frame before a keyframe, or the end of the file)
+		/// @param timeline_frame The timeline frame of first_frame
+		/// @param decode_delay How long the first copied packet is decoded before first_frame is shown (see find_copy_range)
+		/// @returns False if the copied packets would be decoded before the encoded packets (nothing is copied)
+		bool copy_pass_through(const std::string& source_path, int64_t first_frame, int64_t last_frame, int64_t timeline_frame, int64_t decode_delay);
+
+		/// Resize and convert the image of a frame to the output pixel format (or NULL if it has no image)
+		AVFrame *convert_video_frame(std::shared_ptr<openshot::Frame> frame, SwsContext *scaler);
+
+		/// Encode one codec frame of audio, and write its packet (if any) to the video file
+		void encode_audio_frame(AVFrame *frame);
+
+		/// Encode all queued frames, and stop the pipeline threads (throws the first pipeline error, if any)
+		void drain_pipeline();
+
+		/// @brief Find the complete GOPs of a source file inside a range of frames (the frames which can be copied)
+		/// @returns False if no GOP is complete, or the packets of the file cannot be copied
+		/// @param source_path The path of the source file
+		/// @param first_frame The first frame of the range
+		/// @param last_frame The last frame of the range
+		/// @param copy_first The first keyframe inside the range
+		/// @param copy_last The last frame before the last keyframe inside the range (or the end of the file)
+		/// @param decode_delay The DTS of the first copied packet before the PTS of copy_first (in the output stream's timebase)
+		bool find_copy_range(const std::string& source_path, int64_t first_frame, int64_t last_frame, int64_t& copy_first, int64_t& copy_last, int64_t& decode_delay);
+
+		/// @brief Keep the DTS of video packets increasing (when switching between encoded and copied packets)
+		/// @returns False if the timestamps of the packet were changed
+		bool fix_video_timestamps(AVPacket *pkt);
+
 		/// Flush encoders
 		void flush_encoders();
 
@@ -191,9 +259,18 @@ namespace openshot {
 		/// open video codec
 		void open_video(AVFormatContext *oc, AVStream *st);
 
+		/// Convert queued frames to the output pixel format (pipeline thread)
+		void pipeline_convert();
+
+		/// Encode and mux converted frames, in order (pipeline thread)
+		void pipeline_encode();
+
 		/// process video frame
 		void process_video_packet(std::shared_ptr<openshot::Frame> frame);
 
+		/// Write the packets buffered by the video encoder, and reset it (so the next frame starts a new GOP)
+		void restart_video_encoder();
+
 		/// write all queued frames' audio to the video file
 		void write_audio_packets(bool is_final, std::shared_ptr<openshot::Frame> frame);
 
@@ -203,6 +280,9 @@ namespace openshot {
 		/// write all queued frames
 		void write_frame(std::shared_ptr<Frame> frame);
 
+		/// Write a range of frames from a reader (rendered and encoded)
+		void write_frames(openshot::ReaderBase *reader, int64_t start, int64_t end);
+
 	public:
 
 		/// @brief Constructor for FFmpegWriter.
@@ -211,9 +291,18 @@ namespace openshot {
 		/// @param path The file path of the video file you want to open and read
 		FFmpegWriter(const std::string& path);
 
+		/// Destructor (stops the pipeline threads, if any)
+		virtual ~FFmpegWriter();
+
 		/// Close the writer
 		void Close();
 
+		/// Get the max # of frames in the encoding pipeline (0 = disabled)
+		int GetPipeline() { return pipeline_size; };
+
+		/// Get whether unmodified ranges of a timeline are copied instead of encoded (see SetSmartRender)
+		bool GetSmartRender() { return smart_render; };
+
 		/// Determine if writer is open or closed
 		bool IsOpen() { return is_open; };
 
@@ -260,6 +349,30 @@ namespace openshot {
 		/// \note This is an overloaded function.
 		void SetAudioOptions(std::string codec, int sample_rate, int bit_rate);
 
+		/// @brief Encode frames on background threads, so WriteFrame() returns as soon as a frame is queued
+		///
+		/// When enabled, WriteFrame() adds each frame to a bounded queue (and only waits when it is full), so the caller
+		/// can render the next frame while previous frames are encoded. Color conversion (RGBA to the output pixel format)
+		/// runs on a pool of threads, and a dedicated thread encodes and muxes the frames in order. WriteTrailer() waits for
+		/// all queued frames, and errors are thrown by the next WriteFrame() or WriteTrailer() call.
+		/// Defaults to Settings::FFMPEG_WRITER_PIPELINE_FRAMES.
+		/// @param frames The max # of frames in the pipeline (0 encodes frames on the caller's thread)
+		void SetPipeline(int frames);
+
+		/// @brief Copy the compressed video of unmodified timeline ranges, instead of rendering and encoding it
+		///
+		/// When a openshot::Timeline is written with WriteFrame(reader, start, length), the ranges which only show a
+		/// single unmodified clip (see Timeline::GetPassThroughRanges) are copied from the clip's file, one complete GOP
+		/// at a time. Only the frames around edit boundaries (before the first and after the last keyframe of each
+		/// range) are rendered and encoded. Audio is always encoded (directly from the file, for the copied frames).
+		///
+		/// Packets are only copied when the file has the codec, size, pixel format, profile, level, and identical
+		/// codec parameters (i.e. the SPS / PPS of H.264) of the video stream, and the encoder can be reset between
+		/// copied packets (FFmpeg 4.4+, i.e. libx264). Files with open GOPs, or encoded with other options, are
+		/// encoded again, since formats like MP4 only store one set of codec parameters.
+		/// @param enabled Copy unmodified ranges (false renders and encodes every frame)
+		void SetSmartRender(bool enabled) { smart_render = enabled; };
+
 		/// @brief Set video export options
 		/// @param has_video Does this file need a video stream
 		/// @param codec The codec used to encode the images in this video
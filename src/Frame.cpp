@@ -49,7 +49,7 @@ Frame::Frame(int64_t number, int width, int height, std::string color, int sampl
 	  channels(channels), channel_layout(LAYOUT_STEREO),
 	  sample_rate(44100),
 	  has_audio_data(false), has_image_data(false),
-	  max_audio_sample(0)
+	  max_audio_sample(0), render_time(0)
 {
 	// zero (fill with silence) the audio buffer
 	audio->clear();
@@ -97,6 +97,7 @@ void Frame::DeepCopy(const Frame& other)
 	pixel_ratio = Fraction(other.pixel_ratio.num, other.pixel_ratio.den);
 	color = other.color;
 	max_audio_sample = other.max_audio_sample;
+	render_time = other.render_time;
 
 	if (other.image)
 		image = std::make_shared<QImage>(*(other.image));
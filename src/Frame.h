@@ -104,6 +104,7 @@ namespace openshot
 		int sample_rate;
 		std::string color;
 		int64_t max_audio_sample; ///< The max audio sample count added to this frame
+		int64_t render_time; ///< Microseconds it took to produce this frame (0 = unknown)
 		bool audio_reversed; ///< Keep track of audio reversal (i.e. time keyframe)
 
 #ifdef USE_OPENCV
@@ -210,6 +211,9 @@ namespace openshot
 		/// Set Pixel Aspect Ratio
 		openshot::Fraction GetPixelRatio() { return pixel_ratio; };
 
+		/// Get the microseconds it took to produce this frame (0 = unknown). Used by cost-aware caches.
+		int64_t GetRenderTime() { return render_time; };
+
 		/// Get pixel data (as packets)
 		const unsigned char* GetPixels();
 
@@ -259,6 +263,10 @@ namespace openshot
 		/// Set Pixel Aspect Ratio
 		void SetPixelRatio(int num, int den);
 
+		/// @brief Set the microseconds it took to produce this frame (i.e. decoding, effects, and compositing)
+		/// @param microseconds The wall time of producing this frame
+		void SetRenderTime(int64_t microseconds) { render_time = microseconds; };
+
 		/// Thumbnail the frame image with tons of options to the specified path.  The image format is determined from the extension (i.e. image.PNG, image.JPEG).
 		/// This method allows for masks, overlays, background color, and much more accurate resizing (including padding and centering)
 		void Thumbnail(std::string path, int new_width, int new_height, std::string mask_path, std::string overlay_path,
@@ -17,6 +17,7 @@
 #include "FrameMapper.h"
 #include "Exceptions.h"
 #include "Clip.h"
+#include "FrameStream.h"
 #include "ZmqLogger.h"
 
 using namespace std;
@@ -49,6 +50,7 @@ FrameMapper::FrameMapper(ReaderBase *reader, Fraction target, PulldownType targe
 
 	// Adjust cache size based on size of frame and audio
 	final_cache.SetMaxBytesFromInfo(OPEN_MP_NUM_PROCESSORS, info.width, info.height, info.sample_rate, info.channels);
+	final_cache.SetLevel(CACHE_LEVEL_MAPPER);
 }
 
 // Destructor
@@ -386,6 +388,36 @@ MappedFrame FrameMapper::GetMappedFrame(int64_t TargetFrameNumber)
 	return frames[TargetFrameNumber - 1];
 }
 
+// Get a range of frames (in order), which are mapped ahead of the caller
+std::shared_ptr<openshot::FrameStream> FrameMapper::GetFrames(int64_t start, int64_t count)
+{
+	auto stream = std::make_shared<FrameStream>([this](int64_t number) { return GetFrame(number); }, start, count);
+
+	// Read ahead from the source reader (single images are already cached by the reader)
+	if (reader && count > 0 && !(info.has_video && !info.has_audio && info.has_single_image)) {
+		// Map target frame numbers to the nearest source frame numbers (based on the frame rates)
+		const double rate = original.ToDouble() / target.ToDouble();
+		FrameStream::FrameMapping mapping = [rate](int64_t number) {
+			return std::max(int64_t(1), int64_t(round((number - 1) * rate)) + 1);
+		};
+
+		// Include 1 extra source frame (for audio samples which overlap the next frame)
+		int64_t source_start = mapping(start);
+		int64_t source_count = mapping(start + count - 1) - source_start + 2;
+
+		ZmqLogger::Instance()->AppendDebugMethod(
+			"FrameMapper::GetFrames",
+			"start", start,
+			"count", count,
+			"source_start", source_start,
+			"source_count", source_count);
+
+		stream->AddUpstream(reader->GetFrames(source_start, source_count), mapping);
+	}
+
+	return stream;
+}
+
 // Get or generate a blank frame
 std::shared_ptr<Frame> FrameMapper::GetOrCreateFrame(int64_t number)
 {
@@ -795,6 +827,12 @@ void FrameMapper::ChangeMapping(Fraction target_fps, PulldownType target_pulldow
 		"target_channels", target_channels,
 		"target_channel_layout", target_channel_layout);
 
+	// Nothing to change (keep the mapping and cached frames)
+	if (target.num == target_fps.num && target.den == target_fps.den && pulldown == target_pulldown &&
+		info.sample_rate == target_sample_rate && info.channels == target_channels &&
+		info.channel_layout == target_channel_layout)
+		return;
+
 	// Mark as dirty
 	is_dirty = true;
 
@@ -258,6 +258,13 @@ namespace openshot
 		/// @param requested_frame The frame number that is requested.
 		std::shared_ptr<Frame> GetFrame(int64_t requested_frame) override;
 
+		/// @brief Get a range of frames (in order), which are mapped ahead of the caller
+		///
+		/// The matching range of the source reader is also read ahead (i.e. decoded), in step with this stream.
+		/// @param start The first frame number
+		/// @param count The number of frames
+		std::shared_ptr<openshot::FrameStream> GetFrames(int64_t start, int64_t count) override;
+
 		/// Determine if reader is open or closed
 		bool IsOpen() override;
 
@@ -0,0 +1,194 @@
+/**
+ * @file
+ * @brief Source file for FrameStream class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+
+#include "FrameStream.h"
+#include "Frame.h"
+#include "ZmqLogger.h"
+
+using namespace openshot;
+
+// Constructor for a stream of frames
+FrameStream::FrameStream(FrameProducer producer, int64_t start, int64_t count, int read_ahead, int workers) :
+	producer(producer), start(start), end(start + std::max(int64_t(0), count)),
+	read_ahead(std::max(1, read_ahead)), workers(std::max(1, workers)),
+	position(start), next_request(start), started(false), cancelled(false)
+{
+}
+
+// Destructor
+FrameStream::~FrameStream()
+{
+	// Stop all workers (before the upstream streams are destroyed)
+	Cancel();
+	for (auto& thread : threads) {
+		if (thread.joinable())
+			thread.join();
+	}
+}
+
+// Keep the read-ahead of an upstream stream in step with this stream
+void FrameStream::AddUpstream(std::shared_ptr<FrameStream> upstream, FrameMapping mapping)
+{
+	if (!upstream)
+		return;
+
+	// Upstream streams are only added before the workers are started
+	const std::lock_guard<std::mutex> lock(streamMutex);
+	if (started)
+		return;
+
+	upstreams.push_back(std::make_pair(upstream, mapping));
+}
+
+// Start the worker threads (if not already started)
+void FrameStream::Run()
+{
+	const std::lock_guard<std::mutex> lock(streamMutex);
+	if (started || cancelled)
+		return;
+	started = true;
+
+	// Start upstream streams first (so they can read ahead)
+	for (auto& upstream : upstreams)
+		upstream.first->Run();
+
+	// Start workers (no more than the number of frames)
+	int64_t worker_count = std::min(int64_t(workers), std::max(int64_t(1), end - start));
+	for (int64_t index = 0; index < worker_count; index++)
+		threads.emplace_back(&FrameStream::worker, this);
+}
+
+// Request frames (until the stream is finished or cancelled)
+void FrameStream::worker()
+{
+	while (true) {
+		int64_t number = 0;
+		{
+			// Wait until the next frame is inside the read-ahead window
+			std::unique_lock<std::mutex> lock(streamMutex);
+			streamCondition.wait(lock, [this] {
+				return cancelled || next_request >= end || next_request < position + read_ahead;
+			});
+			if (cancelled || next_request >= end)
+				return;
+			number = next_request++;
+		}
+
+		// Frames before this one are no longer needed by upstream streams
+		for (auto& upstream : upstreams)
+			upstream.first->Advance(upstream.second(number));
+
+		// Produce frame (without holding the lock)
+		std::shared_ptr<Frame> frame;
+		std::exception_ptr error;
+		try {
+			frame = producer(number);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		{
+			// Keep the frame (unless the caller has skipped it)
+			const std::lock_guard<std::mutex> lock(streamMutex);
+			if (number >= position) {
+				if (error)
+					errors[number] = error;
+				else
+					ready_frames[number] = frame;
+			}
+		}
+		streamCondition.notify_all();
+	}
+}
+
+// Skip all frames before a frame number
+void FrameStream::Advance(int64_t frame_number)
+{
+	{
+		const std::lock_guard<std::mutex> lock(streamMutex);
+		if (frame_number <= position)
+			return;
+
+		// Remove skipped frames
+		ready_frames.erase(ready_frames.begin(), ready_frames.lower_bound(frame_number));
+		errors.erase(errors.begin(), errors.lower_bound(frame_number));
+		position = frame_number;
+		next_request = std::max(next_request, position);
+	}
+	streamCondition.notify_all();
+}
+
+// Cancel the stream
+void FrameStream::Cancel()
+{
+	{
+		const std::lock_guard<std::mutex> lock(streamMutex);
+		cancelled = true;
+		ready_frames.clear();
+	}
+	streamCondition.notify_all();
+
+	for (auto& upstream : upstreams)
+		upstream.first->Cancel();
+}
+
+// Get the next frame of the stream
+std::shared_ptr<Frame> FrameStream::Next()
+{
+	Run();
+
+	std::shared_ptr<Frame> frame;
+	{
+		std::unique_lock<std::mutex> lock(streamMutex);
+		if (cancelled || position >= end)
+			return nullptr;
+
+		// Wait for the frame (or error)
+		const int64_t number = position;
+		streamCondition.wait(lock, [this, number] {
+			return cancelled || ready_frames.count(number) || errors.count(number);
+		});
+		if (cancelled)
+			return nullptr;
+
+		// Move to the next frame (which allows the workers to read further ahead)
+		position++;
+		auto error = errors.find(number);
+		if (error != errors.end()) {
+			std::exception_ptr frame_error = error->second;
+			errors.erase(error);
+			lock.unlock();
+			streamCondition.notify_all();
+
+			ZmqLogger::Instance()->AppendDebugMethod(
+				"FrameStream::Next (error producing frame)",
+				"number", number);
+			std::rethrow_exception(frame_error);
+		}
+
+		auto ready = ready_frames.find(number);
+		frame = ready->second;
+		ready_frames.erase(ready);
+	}
+	streamCondition.notify_all();
+
+	return frame;
+}
+
+// Get the frame number which will be returned next
+int64_t FrameStream::Position()
+{
+	const std::lock_guard<std::mutex> lock(streamMutex);
+	return position;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief Header file for FrameStream class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_FRAME_STREAM_H
+#define OPENSHOT_FRAME_STREAM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace openshot {
+	// Forward decl
+	class Frame;
+
+	/**
+	 * @brief This class returns an ordered range of frames, which are requested ahead of the caller (read-ahead).
+	 *
+	 * A FrameStream is returned by ReaderBase::GetFrames(). Background workers request frames from the reader
+	 * while the caller is still processing earlier frames (i.e. encoding), so sequential consumers are limited by
+	 * the slowest stage, instead of the sum of all stages. Frames are always returned in order, and no more than
+	 * read_ahead frames are requested ahead of the caller.
+	 *
+	 * A stream can also keep the read-ahead of an upstream stream (i.e. the reader of a clip) in step with its
+	 * own position, so nested readers (Clip, FrameMapper, FFmpegReader) decode ahead as a pipeline.
+	 *
+	 * @code
+	 * std::shared_ptr<openshot::FrameStream> stream = reader.GetFrames(1, 300);
+	 * while (std::shared_ptr<openshot::Frame> f = stream->Next()) {
+	 *     writer.WriteFrame(f);
+	 * }
+	 * @endcode
+	 *
+	 * The reader must stay open (and must not be deleted) until the stream is destroyed.
+	 */
+	class FrameStream {
+	public:
+		/// Function which produces a single frame (i.e. ReaderBase::GetFrame)
+		typedef std::function<std::shared_ptr<openshot::Frame>(int64_t)> FrameProducer;
+
+		/// Function which maps a frame number of this stream to a frame number of an upstream stream
+		typedef std::function<int64_t(int64_t)> FrameMapping;
+
+	private:
+		FrameProducer producer; ///< Function used to produce each frame
+		int64_t start; ///< First frame number of the stream
+		int64_t end; ///< Last frame number of the stream + 1
+		int read_ahead; ///< Max number of frames requested ahead of the caller
+		int workers; ///< Number of worker threads
+
+		std::mutex streamMutex; ///< Mutex protecting the state below
+		std::condition_variable streamCondition; ///< Signaled when a frame is ready (or the position changes)
+		int64_t position; ///< Next frame number returned to the caller
+		int64_t next_request; ///< Next frame number requested by a worker
+		std::map<int64_t, std::shared_ptr<openshot::Frame>> ready_frames; ///< Produced frames (not yet returned)
+		std::map<int64_t, std::exception_ptr> errors; ///< Exceptions thrown while producing frames
+		bool started; ///< Have the workers been started
+		bool cancelled; ///< Has the stream been cancelled
+
+		std::vector<std::thread> threads; ///< Worker threads
+		std::vector<std::pair<std::shared_ptr<FrameStream>, FrameMapping>> upstreams; ///< Upstream streams (kept in step)
+
+		/// Request frames (until the stream is finished or cancelled)
+		void worker();
+
+	public:
+		/// @brief Constructor for a stream of frames (workers are started by Run(), or the first request)
+		///
+		/// @param producer The function used to produce each frame
+		/// @param start The first frame number
+		/// @param count The number of frames
+		/// @param read_ahead The max number of frames requested ahead of the caller
+		/// @param workers The number of worker threads (frames are still returned in order)
+		FrameStream(FrameProducer producer, int64_t start, int64_t count, int read_ahead = 8, int workers = 1);
+
+		/// Destructor (cancels the stream, and waits for all workers to finish)
+		virtual ~FrameStream();
+
+		/// @brief Keep the read-ahead of an upstream stream in step with this stream
+		///
+		/// Before each frame is produced, the upstream stream is advanced to the mapped frame number.
+		/// Frames of the upstream stream are not returned, so it only reads ahead (i.e. decodes into a cache).
+		/// @param upstream The upstream stream (which is started and owned by this stream)
+		/// @param mapping The function used to map frame numbers of this stream to the upstream stream
+		void AddUpstream(std::shared_ptr<FrameStream> upstream, FrameMapping mapping);
+
+		/// Skip all frames before a frame number (they are no longer needed)
+		void Advance(int64_t frame_number);
+
+		/// Cancel the stream (no more frames are requested, and Next() returns nullptr)
+		void Cancel();
+
+		/// @brief Get the next frame of the stream (blocks until the frame is ready)
+		///
+		/// @returns The next frame (in order), or nullptr after the last frame. Exceptions thrown by the reader
+		/// are re-thrown when the failed frame is reached.
+		std::shared_ptr<openshot::Frame> Next();
+
+		/// Get the frame number which will be returned next
+		int64_t Position();
+
+		/// Start the worker threads (if not already started)
+		void Run();
+
+		/// Get the first frame number of the stream
+		int64_t Start() const { return start; }
+
+		/// Get the number of frames in the stream
+		int64_t Count() const { return end - start; }
+	};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file
+ * @brief Source file for ImageCodec class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cstring>
+
+#include "ImageCodec.h"
+#include "OpenMPUtilities.h"
+
+using namespace openshot;
+
+// Ops of the codec (the same as QOI)
+#define CODEC_OP_INDEX 0x00
+#define CODEC_OP_DIFF 0x40
+#define CODEC_OP_LUMA 0x80
+#define CODEC_OP_RUN 0xc0
+#define CODEC_OP_RGB 0xfe
+#define CODEC_OP_RGBA 0xff
+#define CODEC_MAX_RUN 62
+
+// Position of a pixel in the index of recently seen pixels
+#define CODEC_HASH(r, g, b, a) (((r) * 3 + (g) * 5 + (b) * 7 + (a) * 11) & 63)
+
+// Compress RGBA pixels
+static void EncodeStripe(const uint8_t* pixels, int64_t pixel_count, std::vector<uint8_t>& output)
+{
+	uint8_t index[64 * 4] = {0};
+	uint8_t pr = 0, pg = 0, pb = 0, pa = 255;
+	int run = 0;
+	output.reserve(pixel_count);
+
+	for (int64_t pixel = 0; pixel < pixel_count; pixel++) {
+		const uint8_t* p = pixels + pixel * 4;
+		const uint8_t r = p[0], g = p[1], b = p[2], a = p[3];
+
+		// Same as the previous pixel
+		if (r == pr && g == pg && b == pb && a == pa) {
+			if (++run == CODEC_MAX_RUN) {
+				output.push_back(CODEC_OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		if (run > 0) {
+			output.push_back(CODEC_OP_RUN | (run - 1));
+			run = 0;
+		}
+
+		const int hash = CODEC_HASH(r, g, b, a);
+		uint8_t* entry = index + hash * 4;
+		if (entry[0] == r && entry[1] == g && entry[2] == b && entry[3] == a) {
+			// Recently seen pixel
+			output.push_back(CODEC_OP_INDEX | hash);
+		} else {
+			entry[0] = r;
+			entry[1] = g;
+			entry[2] = b;
+			entry[3] = a;
+
+			if (a == pa) {
+				// Difference from the previous pixel (wrapping)
+				const int dr = int8_t(r - pr), dg = int8_t(g - pg), db = int8_t(b - pb);
+				const int dr_dg = dr - dg, db_dg = db - dg;
+				if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+					output.push_back(CODEC_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+				} else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+					output.push_back(CODEC_OP_LUMA | (dg + 32));
+					output.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+				} else {
+					output.push_back(CODEC_OP_RGB);
+					output.push_back(r);
+					output.push_back(g);
+					output.push_back(b);
+				}
+			} else {
+				output.push_back(CODEC_OP_RGBA);
+				output.push_back(r);
+				output.push_back(g);
+				output.push_back(b);
+				output.push_back(a);
+			}
+		}
+
+		pr = r;
+		pg = g;
+		pb = b;
+		pa = a;
+	}
+
+	if (run > 0)
+		output.push_back(CODEC_OP_RUN | (run - 1));
+}
+
+// Decompress RGBA pixels (returns false if the data is invalid)
+static bool DecodeStripe(const uint8_t* data, size_t size, uint8_t* pixels, int64_t pixel_count)
+{
+	uint8_t index[64 * 4] = {0};
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+	size_t position = 0;
+
+	for (int64_t pixel = 0; pixel < pixel_count;) {
+		if (position >= size)
+			return false;
+		const uint8_t op = data[position++];
+		int run = 1;
+
+		if (op == CODEC_OP_RGB) {
+			if (position + 3 > size)
+				return false;
+			r = data[position];
+			g = data[position + 1];
+			b = data[position + 2];
+			position += 3;
+		} else if (op == CODEC_OP_RGBA) {
+			if (position + 4 > size)
+				return false;
+			r = data[position];
+			g = data[position + 1];
+			b = data[position + 2];
+			a = data[position + 3];
+			position += 4;
+		} else if ((op & 0xc0) == CODEC_OP_INDEX) {
+			const uint8_t* entry = index + (op & 0x3f) * 4;
+			r = entry[0];
+			g = entry[1];
+			b = entry[2];
+			a = entry[3];
+		} else if ((op & 0xc0) == CODEC_OP_DIFF) {
+			r += ((op >> 4) & 0x03) - 2;
+			g += ((op >> 2) & 0x03) - 2;
+			b += (op & 0x03) - 2;
+		} else if ((op & 0xc0) == CODEC_OP_LUMA) {
+			if (position + 1 > size)
+				return false;
+			const int dg = (op & 0x3f) - 32;
+			const uint8_t deltas = data[position++];
+			r += dg - 8 + ((deltas >> 4) & 0x0f);
+			g += dg;
+			b += dg - 8 + (deltas & 0x0f);
+		} else {
+			run = (op & 0x3f) + 1;
+		}
+
+		uint8_t* entry = index + CODEC_HASH(r, g, b, a) * 4;
+		entry[0] = r;
+		entry[1] = g;
+		entry[2] = b;
+		entry[3] = a;
+
+		if (run > pixel_count - pixel)
+			return false;
+		for (int i = 0; i < run; i++, pixel++) {
+			uint8_t* p = pixels + pixel * 4;
+			p[0] = r;
+			p[1] = g;
+			p[2] = b;
+			p[3] = a;
+		}
+	}
+	return true;
+}
+
+// Compress an image (converted to premultiplied RGBA, if needed)
+ImageCodec::EncodedImage ImageCodec::Encode(const QImage& image)
+{
+	EncodedImage encoded;
+	if (image.isNull())
+		return encoded;
+
+	QImage pixels = image;
+	if (pixels.format() != QImage::Format_RGBA8888_Premultiplied)
+		pixels = pixels.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+	encoded.width = pixels.width();
+	encoded.height = pixels.height();
+
+	// Compress each stripe (in parallel)
+	const int stripe_count = (encoded.height + IMAGE_CODEC_STRIPE_ROWS - 1) / IMAGE_CODEC_STRIPE_ROWS;
+	std::vector<std::vector<uint8_t>> stripes(stripe_count);
+	#pragma omp parallel for if (stripe_count > 1) num_threads(OPEN_MP_NUM_PROCESSORS)
+	for (int stripe = 0; stripe < stripe_count; stripe++) {
+		const int row = stripe * IMAGE_CODEC_STRIPE_ROWS;
+		const int rows = std::min(IMAGE_CODEC_STRIPE_ROWS, encoded.height - row);
+		if (pixels.bytesPerLine() == encoded.width * 4) {
+			EncodeStripe(pixels.constScanLine(row), int64_t(encoded.width) * rows, stripes[stripe]);
+		} else {
+			// Copy padded rows (so the stripe is contiguous)
+			std::vector<uint8_t> rows_data(size_t(encoded.width) * rows * 4);
+			for (int y = 0; y < rows; y++)
+				memcpy(rows_data.data() + size_t(y) * encoded.width * 4, pixels.constScanLine(row + y), encoded.width * 4);
+			EncodeStripe(rows_data.data(), int64_t(encoded.width) * rows, stripes[stripe]);
+		}
+	}
+
+	// Join stripes
+	size_t size = 0;
+	encoded.stripes.reserve(stripe_count + 1);
+	for (const auto& stripe : stripes) {
+		encoded.stripes.push_back(size);
+		size += stripe.size();
+	}
+	encoded.stripes.push_back(size);
+	encoded.data.reserve(size);
+	for (const auto& stripe : stripes)
+		encoded.data.insert(encoded.data.end(), stripe.begin(), stripe.end());
+
+	return encoded;
+}
+
+// Decompress an image into premultiplied RGBA pixels
+bool ImageCodec::Decode(const EncodedImage& encoded, uint8_t* pixels)
+{
+	const int stripe_count = (encoded.height + IMAGE_CODEC_STRIPE_ROWS - 1) / IMAGE_CODEC_STRIPE_ROWS;
+	if (encoded.width <= 0 || stripe_count <= 0 || encoded.stripes.size() != size_t(stripe_count) + 1 ||
+		encoded.stripes.back() > encoded.data.size())
+		return false;
+
+	// Decompress each stripe (in parallel)
+	bool valid = true;
+	#pragma omp parallel for if (stripe_count > 1) num_threads(OPEN_MP_NUM_PROCESSORS) reduction(&&:valid)
+	for (int stripe = 0; stripe < stripe_count; stripe++) {
+		const int row = stripe * IMAGE_CODEC_STRIPE_ROWS;
+		const int rows = std::min(IMAGE_CODEC_STRIPE_ROWS, encoded.height - row);
+		const size_t start = encoded.stripes[stripe], end = encoded.stripes[stripe + 1];
+		valid = end >= start && DecodeStripe(encoded.data.data() + start, end - start,
+											 pixels + size_t(row) * encoded.width * 4, int64_t(encoded.width) * rows) && valid;
+	}
+	return valid;
+}
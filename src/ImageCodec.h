@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @brief Header file for ImageCodec class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_IMAGE_CODEC_H
+#define OPENSHOT_IMAGE_CODEC_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QImage>
+
+// Rows of each independently compressed stripe of an image (stripes are compressed in parallel)
+#define IMAGE_CODEC_STRIPE_ROWS 64
+
+namespace openshot {
+
+	/**
+	 * @brief This class is a fast lossless codec for RGBA images (used by caches which compress frames).
+	 *
+	 * Images are compressed in the style of QOI (runs, a hash index of recent pixels, and small deltas
+	 * against the previous pixel), in horizontal stripes which are compressed and decompressed in parallel.
+	 *
+	 * @code
+	 * openshot::ImageCodec::EncodedImage encoded = openshot::ImageCodec::Encode(*frame->GetImage());
+	 * std::vector<uint8_t> pixels(encoded.width * encoded.height * 4);
+	 * openshot::ImageCodec::Decode(encoded, pixels.data()); // premultiplied RGBA
+	 * @endcode
+	 */
+	class ImageCodec {
+	public:
+		/// A compressed image
+		struct EncodedImage {
+			std::vector<uint8_t> data; ///< Compressed stripes of the image
+			std::vector<size_t> stripes; ///< Offset of each stripe (and the end of the last stripe)
+			int width = 0; ///< Image width (0 = no image)
+			int height = 0; ///< Image height
+
+			/// Size of the compressed image (in bytes)
+			int64_t GetBytes() const { return data.size() + stripes.size() * sizeof(size_t); }
+		};
+
+		/// @brief Compress an image (converted to premultiplied RGBA, if needed)
+		/// @param image The image to compress
+		static EncodedImage Encode(const QImage& image);
+
+		/// @brief Decompress an image into premultiplied RGBA pixels
+		///
+		/// @returns False if the compressed data is invalid
+		/// @param encoded The compressed image
+		/// @param pixels A buffer of (width * height * 4) bytes
+		static bool Decode(const EncodedImage& encoded, uint8_t* pixels);
+	};
+
+}
+
+#endif
@@ -19,6 +19,7 @@
 #include "ImageWriter.h"
 #include "Exceptions.h"
 #include "Frame.h"
+#include "FrameStream.h"
 #include "ReaderBase.h"
 #include "ZmqLogger.h"
 
@@ -125,11 +126,10 @@ void ImageWriter::WriteFrame(ReaderBase* reader, int64_t start, int64_t length)
 		"start", start,
 		"length", length);
 
-	// Loop through each frame (and encoded it)
-	for (int64_t number = start; number <= length; number++)
+	// Loop through each frame (and encoded it), while the next frames are read ahead
+	std::shared_ptr<FrameStream> stream = reader->GetFrames(start, length - start + 1);
+	while (std::shared_ptr<Frame> f = stream->Next())
 	{
-		// Get the frame
-		std::shared_ptr<Frame> f = reader->GetFrame(number);
 
 		// Encode frame
 		WriteFrame(f);
@@ -14,11 +14,13 @@
 #include "Exceptions.h"
 
 #include <algorithm>   // For std::lower_bound, std::move_backward
+#include <atomic>	  // For std::atomic
 #include <functional>  // For std::less, std::less_equal, etc…
 #include <utility>	 // For std::swap
 #include <numeric>	 // For std::accumulate
 #include <cassert>	 // For assert()
 #include <cmath>	   // For fabs, round
+#include <cstdint>	 // For INT64_MAX
 #include <iostream>	// For std::cout
 #include <iomanip>	 // For std::setprecision
 
@@ -111,14 +113,49 @@ int64_t SearchBetweenPoints(Point const & left, Point const & right, int64_t con
 	return start;
 }
 
+// Number of edits of all keyframes
+static std::atomic<int64_t> keyframe_edits(0);
+
 // Constructor which sets the default point & coordinate at X=1
 Keyframe::Keyframe(double value) {
 	// Add initial point
-	AddPoint(Point(1, value));
+	InsertPoint(Point(1, value));
 }
 
 // Constructor which takes a vector of Points
-Keyframe::Keyframe(const std::vector<openshot::Point>& points) : Points(points) {};
+Keyframe::Keyframe(const std::vector<openshot::Point>& points) : Points(points) {
+	PointsChanged();
+};
+
+// Copy constructor
+Keyframe::Keyframe(const Keyframe& other) :
+	Points(other.Points),
+	is_constant(other.is_constant),
+	lookup_start(other.lookup_start),
+	lookup_count(other.lookup_count),
+	lookup(std::atomic_load(&other.lookup)) // Share the lookup table (which is never modified after it is built)
+{
+}
+
+// Assignment operator
+Keyframe& Keyframe::operator=(const Keyframe& other) {
+	if (this != &other) {
+		Points = other.Points;
+		is_constant = other.is_constant;
+		lookup_start = other.lookup_start;
+		lookup_count = other.lookup_count;
+
+		// Share the lookup table (which is never modified after it is built)
+		std::atomic_store(&lookup, std::atomic_load(&other.lookup));
+		keyframe_edits++;
+	}
+	return *this;
+}
+
+// Get the number of edits of all keyframes
+int64_t Keyframe::Edits() {
+	return keyframe_edits;
+}
 
 // Destructor
 Keyframe::~Keyframe() {
@@ -129,6 +166,16 @@ Keyframe::~Keyframe() {
 // Add a new point on the key-frame.  Each point has a primary coordinate,
 // a left handle, and a right handle.
 void Keyframe::AddPoint(Point p) {
+	InsertPoint(p);
+	keyframe_edits++;
+}
+
+// Add a point (without counting it as an edit)
+void Keyframe::InsertPoint(Point p) {
+	// A new point with a different value (than the existing points) makes the keyframe vary
+	if (!Points.empty() && p.co.Y != Points.front().co.Y)
+		is_constant = false;
+
 	// candidate is not less (greater or equal) than the new point in
 	// the X coordinate.
 	std::vector<Point>::iterator candidate =
@@ -141,6 +188,10 @@ void Keyframe::AddPoint(Point p) {
 		// New point is at same X coordinate as some point, overwrite
 		// point.
 		*candidate = p;
+
+		// Overwriting a point can make the keyframe constant again
+		PointsChanged();
+		return;
 	} else {
 		// New point needs to be inserted before candidate; thus move
 		// candidate and all following one to the right and insert new
@@ -150,6 +201,19 @@ void Keyframe::AddPoint(Point p) {
 		std::move_backward(begin(Points) + candidate_index, end(Points) - 1, end(Points));
 		Points[candidate_index] = p;
 	}
+	ResetLookup();
+}
+
+// Update the constant flag, and discard the lookup table (after points are changed)
+void Keyframe::PointsChanged() {
+	is_constant = true;
+	for (Point const & existing_point : Points) {
+		if (existing_point.co.Y != Points.front().co.Y) {
+			is_constant = false;
+			break;
+		}
+	}
+	ResetLookup();
 }
 
 // Add a new point on the key-frame, interpolate is optional (default: BEZIER)
@@ -259,6 +323,14 @@ double Keyframe::GetValue(int64_t index) const {
 	if (Points.empty()) {
 		return 0;
 	}
+	if (is_constant) {
+		// Same value at every frame
+		return Points.front().co.Y;
+	}
+	if (index >= lookup_start && index < lookup_start + lookup_count) {
+		// Value from the lookup table
+		return (*LookupValues())[index - lookup_start];
+	}
 	std::vector<Point>::const_iterator candidate =
 		std::lower_bound(begin(Points), end(Points), static_cast<double>(index), IsPointBeforeX);
 
@@ -278,6 +350,80 @@ double Keyframe::GetValue(int64_t index) const {
 	return InterpolateBetween(*predecessor, *candidate, index, 0.01);
 }
 
+// Get the values of a range of frames
+void Keyframe::GetValues(int64_t start, int64_t count, double* values) const {
+	if (count <= 0) {
+		return;
+	}
+	if (is_constant) {
+		// Same value at every frame
+		std::fill(values, values + count, Points.empty() ? 0.0 : Points.front().co.Y);
+		return;
+	}
+	if (start >= lookup_start && start + count <= lookup_start + lookup_count) {
+		// Values from the lookup table
+		std::shared_ptr<const std::vector<double>> table = LookupValues();
+		std::copy(table->begin() + (start - lookup_start), table->begin() + (start - lookup_start + count), values);
+		return;
+	}
+	InterpolateValues(start, count, values);
+}
+
+// Get the values of a range of frames
+std::vector<double> Keyframe::GetValues(int64_t start, int64_t count) const {
+	std::vector<double> values(std::max(count, int64_t(0)));
+	GetValues(start, count, values.data());
+	return values;
+}
+
+// Calculate a range of values (walking the points, instead of searching for each frame)
+void Keyframe::InterpolateValues(int64_t start, int64_t count, double* values) const {
+	// First point which is not before the first frame
+	std::vector<Point>::const_iterator candidate =
+		std::lower_bound(begin(Points), end(Points), static_cast<double>(start), IsPointBeforeX);
+
+	for (int64_t i = 0; i < count; i++) {
+		const int64_t index = start + i;
+		while (candidate != end(Points) && candidate->co.X < index)
+			++candidate;
+
+		// Same rules as GetValue
+		if (candidate == end(Points))
+			values[i] = Points.back().co.Y;
+		else if (candidate == begin(Points) || candidate->co.X == index)
+			values[i] = candidate->co.Y;
+		else
+			values[i] = InterpolateBetween(*(candidate - 1), *candidate, index, 0.01);
+	}
+}
+
+// Get the lookup table (and build it, if needed)
+std::shared_ptr<const std::vector<double>> Keyframe::LookupValues() const {
+	std::shared_ptr<const std::vector<double>> table = std::atomic_load(&lookup);
+	if (table)
+		return table;
+
+	// Build the table (if many threads need it at the same time, the first table is kept)
+	auto values = std::make_shared<std::vector<double>>(lookup_count);
+	InterpolateValues(lookup_start, lookup_count, values->data());
+	std::shared_ptr<const std::vector<double>> built = values;
+	if (std::atomic_compare_exchange_strong(&lookup, &table, built))
+		return built;
+	return table;
+}
+
+// Discard the lookup table
+void Keyframe::ResetLookup() {
+	std::atomic_store(&lookup, std::shared_ptr<const std::vector<double>>());
+}
+
+// Enable a dense lookup table of values for a range of frames
+void Keyframe::SetLookupRange(int64_t start, int64_t count) {
+	lookup_start = start;
+	lookup_count = std::max(count, int64_t(0));
+	ResetLookup();
+}
+
 // Get the rounded INT value at a specific index
 int Keyframe::GetInt(int64_t index) const {
 	return int(round(GetValue(index)));
@@ -373,6 +519,7 @@ void Keyframe::SetJsonValue(const Json::Value root) {
 	// Clear existing points
 	Points.clear();
 	Points.shrink_to_fit();
+	PointsChanged();
 
 	if (root.isObject() && !root["Points"].isNull()) {
         // loop through points in JSON Object
@@ -384,14 +531,14 @@ void Keyframe::SetJsonValue(const Json::Value root) {
             p.SetJsonValue(existing_point);
 
             // Add Point to Keyframe
-            AddPoint(p);
+            InsertPoint(p);
         }
     } else if (root.isNumeric()) {
         // Create Point from Numeric value
         Point p(root.asFloat());
 
         // Add Point to Keyframe
-        AddPoint(p);
+        InsertPoint(p);
 	}
 }
 
@@ -426,6 +573,44 @@ int64_t Keyframe::GetCount() const {
 	return Points.size();
 }
 
+// Check if two points are identical (coordinate, handles, and interpolation)
+static bool IsPointEqual(Point const & a, Point const & b) {
+	return a.co.X == b.co.X && a.co.Y == b.co.Y &&
+		a.handle_left.X == b.handle_left.X && a.handle_left.Y == b.handle_left.Y &&
+		a.handle_right.X == b.handle_right.X && a.handle_right.Y == b.handle_right.Y &&
+		a.interpolation == b.interpolation && a.handle_type == b.handle_type;
+}
+
+// Get the range of frames with different values in another keyframe
+bool Keyframe::ChangedRange(const Keyframe& other, int64_t& first_frame, int64_t& last_frame) const {
+	const std::vector<Point>& other_points = other.Points;
+	const size_t shortest = std::min(Points.size(), other_points.size());
+
+	// Count the identical points at the start of both keyframes
+	size_t prefix = 0;
+	while (prefix < shortest && IsPointEqual(Points[prefix], other_points[prefix]))
+		prefix++;
+	if (prefix == Points.size() && prefix == other_points.size())
+		return false; // No changes
+
+	// Count the identical points at the end of both keyframes (not overlapping the prefix)
+	size_t suffix = 0;
+	while (suffix < shortest - prefix &&
+		   IsPointEqual(Points[Points.size() - 1 - suffix], other_points[other_points.size() - 1 - suffix]))
+		suffix++;
+
+	// Values before the first point (and after the last point) are held constant, so
+	// a change to the first (or last) point affects all earlier (or later) frames.
+	first_frame = 1;
+	if (prefix > 0)
+		first_frame = std::max(int64_t(1), int64_t(floor(Points[prefix - 1].co.X)));
+	last_frame = INT64_MAX;
+	if (suffix > 0)
+		last_frame = ceil(Points[Points.size() - suffix].co.X);
+
+	return true;
+}
+
 // Remove a point by matching a coordinate
 void Keyframe::RemovePoint(Point p) {
 	// loop through points, and find a matching coordinate
@@ -437,6 +622,8 @@ void Keyframe::RemovePoint(Point p) {
 		if (p.co.X == existing_point.co.X && p.co.Y == existing_point.co.Y) {
 			// Remove the matching point, and break out of loop
 			Points.erase(Points.begin() + x);
+			PointsChanged();
+			keyframe_edits++;
 			return;
 		}
 	}
@@ -452,6 +639,8 @@ void Keyframe::RemovePoint(int64_t index) {
 	{
 		// Remove a specific point by index
 		Points.erase(Points.begin() + index);
+		PointsChanged();
+		keyframe_edits++;
 	}
 	else
 		// Invalid index
@@ -524,6 +713,8 @@ void Keyframe::ScalePoints(double scale)
 		// Scale X value
 		Points[point_index].co.X = round(Points[point_index].co.X * scale);
 	}
+	ResetLookup();
+	keyframe_edits++;
 }
 
 // Flip all the points in this openshot::Keyframe (useful for reversing an effect or transition, etc...)
@@ -535,4 +726,6 @@ void Keyframe::FlipPoints() {
 		// TODO: check that this has the desired effect even with
 		// regards to handles!
 	}
+	ResetLookup();
+	keyframe_edits++;
 }
@@ -14,6 +14,7 @@
 #define OPENSHOT_KEYFRAME_H
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "Point.h"
@@ -49,12 +50,37 @@ namespace openshot {
 	 *
 	 * kf.PrintValues();
 	 * \endcode
+	 *
+	 * Keyframes which have the same value at every point (i.e. most properties of a clip) are detected when
+	 * points are added, and return their value without any searching or interpolation. A range of values can be
+	 * calculated at once with GetValues(), and a dense lookup table of a range of frames can be enabled with
+	 * SetLookupRange() (which is rebuilt the next time a value is needed, after any point changes).
 	 */
 	class Keyframe {
 	
 
 	private:
 		std::vector<Point> Points;	///< Vector of all Points
+		bool is_constant = true; ///< All points have the same Y value (so all frames have the same value)
+		int64_t lookup_start = 0; ///< First frame of the lookup table
+		int64_t lookup_count = 0; ///< Number of frames in the lookup table (0 = disabled)
+		mutable std::shared_ptr<const std::vector<double>> lookup; ///< Lookup table of values (built when first needed, only accessed with std::atomic_load / std::atomic_store)
+
+		/// Update the constant flag, and discard the lookup table (after points are changed)
+		void PointsChanged();
+
+		/// Calculate a range of values (walking the points, instead of searching for each frame)
+		void InterpolateValues(int64_t start, int64_t count, double* values) const;
+
+		/// Get the lookup table (and build it, if needed). Callers keep the returned table, so it stays
+		/// valid even if another thread discards it.
+		std::shared_ptr<const std::vector<double>> LookupValues() const;
+
+		/// Discard the lookup table (it is rebuilt the next time a value is needed)
+		void ResetLookup();
+
+		/// Add a point (without counting it as an edit, see Edits)
+		void InsertPoint(Point p);
 
 	public:
 		/// Default constructor for the Keyframe class
@@ -66,6 +92,12 @@ namespace openshot {
 		/// Constructor which adds a supplied vector of Points
 		Keyframe(const std::vector<openshot::Point>& points);
 
+		/// Copy constructor (copies share the lookup table, until either one changes)
+		Keyframe(const Keyframe& other);
+
+		/// Assignment operator
+		Keyframe& operator=(const Keyframe& other);
+
 		/// Destructor
 		~Keyframe();
 
@@ -78,6 +110,12 @@ namespace openshot {
 		/// Does this keyframe contain a specific point
 		bool Contains(Point p) const;
 
+		/// @brief Get the number of edits of all keyframes (used to invalidate cached keys of clips)
+		///
+		/// Each call to AddPoint, RemovePoint, UpdatePoint, ScalePoints, FlipPoints, or the assignment
+		/// operator is an edit. Constructing or copying a keyframe, or loading its JSON, is not.
+		static int64_t Edits();
+
 		/// Flip all the points in this openshot::Keyframe (useful for reversing an effect or transition, etc...)
 		void FlipPoints();
 
@@ -87,6 +125,17 @@ namespace openshot {
 		/// Get the value at a specific index
 		double GetValue(int64_t index) const;
 
+		/// @brief Get the values of a range of frames (faster than calling GetValue for each frame)
+		/// @param start The first frame number
+		/// @param count The number of frames
+		/// @param values The array to fill with count values
+		void GetValues(int64_t start, int64_t count, double* values) const;
+
+		/// @brief Get the values of a range of frames (faster than calling GetValue for each frame)
+		/// @param start The first frame number
+		/// @param count The number of frames
+		std::vector<double> GetValues(int64_t start, int64_t count) const;
+
 		/// Get the rounded INT value at a specific index
 		int GetInt(int64_t index) const;
 
@@ -121,6 +170,27 @@ namespace openshot {
 		/// Get the direction of the curve at a specific index (increasing or decreasing)
 		bool IsIncreasing(int index) const;
 
+		/// Does this keyframe have the same value at every frame
+		bool IsConstant() const { return is_constant; }
+
+		/// @brief Enable a dense lookup table of values for a range of frames (i.e. the length of a clip)
+		///
+		/// The table is built the first time a value in the range is needed, and rebuilt after any points change.
+		/// Uses 8 bytes per frame, so it is best suited to keyframes which are evaluated many times per frame.
+		/// @param start The first frame number of the table
+		/// @param count The number of frames in the table (0 = disable the lookup table)
+		void SetLookupRange(int64_t start, int64_t count);
+
+		/// @brief Get the range of frames (i.e. X coordinates) with different values in another keyframe
+		///
+		/// Only the segments between the unchanged points surrounding any added, removed, or modified
+		/// points are included (since interpolation only depends on the neighbouring points).
+		/// @returns False if both keyframes are identical (the range is not set)
+		/// @param other The keyframe to compare with
+		/// @param first_frame The first frame with a different value (1 if the first point changed)
+		/// @param last_frame The last frame with a different value (INT64_MAX if the last point changed)
+		bool ChangedRange(const Keyframe& other, int64_t& first_frame, int64_t& last_frame) const;
+
 		// Get and Set JSON methods
 		std::string Json() const; ///< Generate JSON string of this object
 		Json::Value JsonValue() const; ///< Generate Json::Value for this object
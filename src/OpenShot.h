@@ -107,8 +107,11 @@
 #include "AudioLocation.h"
 #include "AudioReaderSource.h"
 #include "AudioResampler.h"
+#include "CacheCompressed.h"
 #include "CacheDisk.h"
+#include "CacheManager.h"
 #include "CacheMemory.h"
+#include "CacheTiered.h"
 #include "ChunkReader.h"
 #include "ChunkWriter.h"
 #include "Clip.h"
@@ -139,6 +142,8 @@
 #include "QtHtmlReader.h"
 #include "QtImageReader.h"
 #include "QtTextReader.h"
+#include "RenditionWriter.h"
+#include "SegmentedExporter.h"
 #include "TimelineBase.h"
 #include "Timeline.h"
 #include "Settings.h"
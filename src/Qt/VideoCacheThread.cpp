@@ -191,6 +191,11 @@ namespace openshot
                                                    reader->info.sample_rate, reader->info.channels,
                                                    reader->info.fps.ToFloat());
                 }
+                if (reader->GetCache() && reader->GetCache()->Count() > 0) {
+                    // Use the average size of the cached frames (compressed caches store
+                    // frames in fewer bytes, and can thus cache more frames ahead)
+                    bytes_per_frame = std::max(reader->GetCache()->GetBytes() / reader->GetCache()->Count(), (int64_t) 1);
+                }
 
                 // Calculate # of frames on Timeline cache (when paused)
                 if (reader->GetCache() && reader->GetCache()->GetMaxBytes() > 0) {
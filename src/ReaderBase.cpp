@@ -17,6 +17,7 @@
 #include "ReaderBase.h"
 #include "ClipBase.h"
 #include "Frame.h"
+#include "FrameStream.h"
 
 #include "Json.h"
 
@@ -250,3 +251,9 @@ openshot::ClipBase* ReaderBase::ParentClip() {
 void ReaderBase::ParentClip(openshot::ClipBase* new_clip) {
 	clip = new_clip;
 }
+
+// Get a range of frames (in order), which are requested ahead of the caller
+std::shared_ptr<openshot::FrameStream> ReaderBase::GetFrames(int64_t start, int64_t count)
+{
+	return std::make_shared<FrameStream>([this](int64_t number) { return GetFrame(number); }, start, count);
+}
@@ -29,6 +29,7 @@ namespace openshot
 	class CacheBase;
 	class ClipBase;
 	class Frame;
+	class FrameStream;
 	/**
 	 * @brief This struct contains info about a media file, such as height, width, frames per second, etc...
 	 *
@@ -110,6 +111,16 @@ namespace openshot
 		/// @param[in] number The frame number that is requested.
 		virtual std::shared_ptr<openshot::Frame> GetFrame(int64_t number) = 0;
 
+		/// @brief Get a range of frames (in order), which are requested ahead of the caller (read-ahead)
+		///
+		/// Frames are produced by background workers, while the caller processes earlier frames. The default
+		/// implementation calls GetFrame() for each frame (on a single worker). Derived readers can override this,
+		/// to read ahead from nested readers, or to produce frames in parallel.
+		/// @returns A stream of frames (see openshot::FrameStream). The reader must stay open until it is destroyed.
+		/// @param start The first frame number
+		/// @param count The number of frames
+		virtual std::shared_ptr<openshot::FrameStream> GetFrames(int64_t start, int64_t count);
+
 		/// Determine if reader is open or closed
 		virtual bool IsOpen() = 0;
 
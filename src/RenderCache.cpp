@@ -0,0 +1,447 @@
+/**
+ * @file
+ * @brief Source file for RenderCache class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "RenderCache.h"
+#include "Frame.h"
+#include "ImageCodec.h"
+#include "KeyFrame.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+using namespace openshot;
+
+// Frame file identifier and version
+#define RENDER_CACHE_MAGIC 0x4F535243
+#define RENDER_CACHE_VERSION 1
+
+// Max number of frames waiting to be saved by the background thread
+#define RENDER_CACHE_MAX_QUEUED 16
+
+namespace {
+	/// Frames waiting to be saved (by a background thread)
+	struct SaveQueue {
+		std::mutex mutex;
+		std::condition_variable condition; ///< Signaled when a frame is queued or saved
+		std::deque<std::pair<std::string, std::shared_ptr<openshot::Frame>>> frames;
+		int saving = 0; ///< Number of frames queued or being saved
+		bool started = false; ///< Has the background thread been started
+	};
+
+	/// Frames in the render cache folder (to remove the least recently used frames)
+	struct FolderIndex {
+		std::mutex mutex;
+		std::string folder; ///< Folder of the index (rescanned when the setting changes)
+		int64_t bytes = 0; ///< Total size of all frames
+		qint64 clock = 0; ///< Last use time assigned (increases, even within the same millisecond)
+		std::map<std::string, std::pair<qint64, int64_t>> files; ///< Frame path -> (last use, bytes)
+		std::set<std::pair<qint64, std::string>> ages; ///< (last use, frame path), least recently used first
+	};
+
+	// Never destroyed (the background thread may still be using them at exit)
+	SaveQueue* save_queue = new SaveQueue;
+	FolderIndex* folder_index = new FolderIndex;
+}
+
+// Add, update, or remove (bytes < 0) a frame of the index (index mutex must be held)
+static void index_frame(const std::string& frame_path, qint64 last_used, int64_t bytes)
+{
+	auto existing = folder_index->files.find(frame_path);
+	if (existing != folder_index->files.end()) {
+		folder_index->bytes -= existing->second.second;
+		folder_index->ages.erase(std::make_pair(existing->second.first, frame_path));
+		folder_index->files.erase(existing);
+	}
+	if (bytes < 0)
+		return;
+
+	folder_index->files[frame_path] = std::make_pair(last_used, bytes);
+	folder_index->ages.insert(std::make_pair(last_used, frame_path));
+	folder_index->bytes += bytes;
+}
+
+// Scan the render cache folder, if it changed since the last scan (index mutex must be held)
+static void scan_folder()
+{
+	std::string folder = Settings::Instance()->PATH_RENDER_CACHE;
+	if (folder == folder_index->folder)
+		return;
+
+	folder_index->folder = folder;
+	folder_index->bytes = 0;
+	folder_index->files.clear();
+	folder_index->ages.clear();
+	if (folder.empty())
+		return;
+
+	QDirIterator files(QString::fromStdString(folder), QStringList() << "*.frame", QDir::Files, QDirIterator::Subdirectories);
+	while (files.hasNext()) {
+		files.next();
+		QFileInfo file_info = files.fileInfo();
+		index_frame(file_info.absoluteFilePath().toStdString(), file_info.lastModified().toMSecsSinceEpoch(), file_info.size());
+	}
+}
+
+// Record the use of a frame (saved or loaded), and remove the least recently used frames over the limit
+static void use_frame(const QString& frame_path, int64_t bytes)
+{
+	const std::lock_guard<std::mutex> lock(folder_index->mutex);
+	scan_folder();
+
+	folder_index->clock = std::max(QDateTime::currentMSecsSinceEpoch(), folder_index->clock + 1);
+	index_frame(frame_path.toStdString(), folder_index->clock, bytes);
+
+	// Remove frames down to 90% of the limit
+	int64_t max_bytes = int64_t(Settings::Instance()->RENDER_CACHE_MAX_MB) * 1024 * 1024;
+	if (max_bytes <= 0 || folder_index->bytes <= max_bytes)
+		return;
+	int64_t removed = 0;
+	while (folder_index->bytes > max_bytes - max_bytes / 10 && !folder_index->ages.empty()) {
+		std::string oldest_path = folder_index->ages.begin()->second;
+		QFile::remove(QString::fromStdString(oldest_path));
+		index_frame(oldest_path, 0, -1);
+		removed++;
+	}
+
+	ZmqLogger::Instance()->AppendDebugMethod("RenderCache::use_frame (removed frames)", "removed", removed, "bytes", folder_index->bytes, "max_bytes", max_bytes);
+}
+
+// Save the queued frames (background thread)
+static void save_frames()
+{
+	while (true) {
+		std::pair<std::string, std::shared_ptr<Frame>> queued;
+		{
+			std::unique_lock<std::mutex> lock(save_queue->mutex);
+			save_queue->condition.wait(lock, [] { return !save_queue->frames.empty(); });
+			queued = save_queue->frames.front();
+			save_queue->frames.pop_front();
+		}
+
+		try {
+			RenderCache::Save(queued.first, queued.second);
+		} catch (...) {
+			// A frame which can't be saved is rendered again next time
+		}
+		queued.second.reset();
+
+		{
+			const std::lock_guard<std::mutex> lock(save_queue->mutex);
+			save_queue->saving--;
+		}
+		save_queue->condition.notify_all();
+	}
+}
+
+// Default constructor (an empty key)
+RenderCache::RenderCache() : hash(QCryptographicHash::Sha1)
+{
+	AddNumber(RENDER_CACHE_VERSION);
+}
+
+// Add the JSON of a clip, effect, or other object to the key
+void RenderCache::AddJson(const Json::Value& root, int64_t frame_number)
+{
+	std::vector<Keyframe> keyframes;
+	AddString(TemplateKey(root, keyframes));
+	AddKeyframes(keyframes, frame_number);
+}
+
+// Get the key of the JSON of an object, without the values of its keyframes
+std::string RenderCache::TemplateKey(const Json::Value& root, std::vector<Keyframe>& keyframes)
+{
+	RenderCache key;
+	key.AddValue(root, keyframes);
+	return key.Key();
+}
+
+// Add the values of keyframes at (and next to) a frame to the key
+void RenderCache::AddKeyframes(const std::vector<Keyframe>& keyframes, int64_t frame_number)
+{
+	// Audio is mixed with the values of neighbouring frames (i.e. volume), and time mapping
+	// reads neighbouring frames.
+	for (const Keyframe& keyframe : keyframes) {
+		for (int64_t number = frame_number - 1; number <= frame_number + 1; number++)
+			AddNumber(keyframe.GetValue(number));
+	}
+}
+
+// Add a JSON value to the key (recursively), with its keyframes replaced by a marker
+void RenderCache::AddValue(const Json::Value& value, std::vector<Keyframe>& keyframes)
+{
+	if (value.isObject()) {
+		if (value.isMember("Points") && value["Points"].isArray()) {
+			// Keyframe: its values are added by AddKeyframes
+			Keyframe keyframe;
+			keyframe.SetJsonValue(value);
+			keyframes.push_back(keyframe);
+			AddString("keyframe");
+			return;
+		}
+
+		// Members are sorted by name
+		AddString("{");
+		for (const std::string& name : value.getMemberNames()) {
+			const Json::Value& member = value[name];
+			AddString(name);
+			AddValue(member, keyframes);
+
+			// Identity of files (size and modification time)
+			if (member.isString() && name.find("path") != std::string::npos) {
+				QFileInfo file_info(QString::fromStdString(member.asString()));
+				if (file_info.isFile()) {
+					AddNumber(file_info.size());
+					AddNumber(file_info.lastModified().toMSecsSinceEpoch());
+				}
+			}
+		}
+		AddString("}");
+
+	} else if (value.isArray()) {
+		AddString("[");
+		for (const Json::Value& item : value)
+			AddValue(item, keyframes);
+		AddString("]");
+
+	} else if (!value.isNull()) {
+		AddString(value.asString());
+	}
+}
+
+// Add a number to the key
+void RenderCache::AddNumber(double value)
+{
+	hash.addData(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Add a string to the key
+void RenderCache::AddString(std::string value)
+{
+	// Include the length (so adjacent strings cannot be confused)
+	AddNumber(value.size());
+	hash.addData(value.data(), value.size());
+}
+
+// Get the key (a hex string of the hash)
+std::string RenderCache::Key() const
+{
+	return hash.result().toHex().toStdString();
+}
+
+// Get the path of a rendered frame
+std::string RenderCache::FramePath(std::string key)
+{
+	std::string folder = Settings::Instance()->PATH_RENDER_CACHE;
+	if (folder.empty())
+		return "";
+
+	// Group frames in sub-folders (by the first 2 characters of the key)
+	QString name = QString::fromStdString(key);
+	return QDir(QString::fromStdString(folder)).filePath(name.left(2) + "/" + name + ".frame").toStdString();
+}
+
+// Load a rendered frame
+std::shared_ptr<Frame> RenderCache::Load(std::string frame_path, int64_t frame_number)
+{
+	if (frame_path.empty())
+		return nullptr;
+
+	QFile file(QString::fromStdString(frame_path));
+	if (!file.open(QIODevice::ReadOnly))
+		return nullptr;
+
+	QDataStream stream(&file);
+	quint32 magic = 0, version = 0;
+	stream >> magic >> version;
+	if (magic != RENDER_CACHE_MAGIC || version != RENDER_CACHE_VERSION)
+		return nullptr;
+
+	// Frame properties
+	qint32 width = 0, height = 0, pixel_ratio_num = 1, pixel_ratio_den = 1;
+	qint32 sample_rate = 0, channels = 0, samples = 0, channel_layout = 0;
+	stream >> width >> height >> pixel_ratio_num >> pixel_ratio_den;
+	stream >> sample_rate >> channels >> samples >> channel_layout;
+
+	// Compressed image
+	ImageCodec::EncodedImage encoded;
+	encoded.width = width;
+	encoded.height = height;
+	quint64 stripe_count = 0, data_size = 0;
+	stream >> stripe_count;
+	if (stream.status() != QDataStream::Ok || stripe_count > quint64(height) + 1)
+		return nullptr;
+	encoded.stripes.resize(stripe_count);
+	for (size_t& offset : encoded.stripes) {
+		quint64 value = 0;
+		stream >> value;
+		offset = value;
+	}
+	stream >> data_size;
+	if (stream.status() != QDataStream::Ok || data_size > quint64(file.size()))
+		return nullptr;
+	encoded.data.resize(data_size);
+	if (stream.readRawData(reinterpret_cast<char*>(encoded.data.data()), data_size) != int(data_size))
+		return nullptr;
+
+	// Audio (planar float samples)
+	if (channels < 0 || samples < 0 || int64_t(channels) * samples * sizeof(float) > file.size())
+		return nullptr;
+	std::vector<float> audio(int64_t(channels) * samples);
+	int audio_bytes = audio.size() * sizeof(float);
+	if (stream.readRawData(reinterpret_cast<char*>(audio.data()), audio_bytes) != audio_bytes)
+		return nullptr;
+
+	// Create frame
+	auto frame = std::make_shared<Frame>(frame_number, width, height, "#000000", samples, channels);
+	frame->SampleRate(sample_rate);
+	frame->ChannelsLayout((ChannelLayout) channel_layout);
+	frame->SetPixelRatio(pixel_ratio_num, pixel_ratio_den);
+	for (int channel = 0; channel < channels && samples > 0; channel++)
+		frame->AddAudio(true, channel, 0, audio.data() + int64_t(channel) * samples, samples, 1.0);
+	if (width > 0 && height > 0) {
+		auto image = std::make_shared<QImage>(width, height, QImage::Format_RGBA8888_Premultiplied);
+		if (image->isNull() || !ImageCodec::Decode(encoded, image->bits()))
+			return nullptr;
+		frame->AddImage(image);
+	}
+
+	// Mark the frame as recently used (so it is removed last)
+	file.close();
+	QFileInfo frame_info(QString::fromStdString(frame_path));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+	if (file.open(QIODevice::ReadWrite)) {
+		file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+		file.close();
+	}
+#endif
+	use_frame(frame_info.absoluteFilePath(), frame_info.size());
+
+	ZmqLogger::Instance()->AppendDebugMethod("RenderCache::Load", "frame_number", frame_number, "bytes", frame_info.size());
+	return frame;
+}
+
+// Save a rendered frame
+bool RenderCache::Save(std::string frame_path, std::shared_ptr<Frame> frame)
+{
+	if (frame_path.empty() || !frame)
+		return false;
+
+	// Create folder (if needed)
+	QFileInfo frame_info(QString::fromStdString(frame_path));
+	if (!QDir().mkpath(frame_info.absolutePath()))
+		return false;
+
+	// Compress image
+	ImageCodec::EncodedImage encoded;
+	if (frame->has_image_data)
+		encoded = ImageCodec::Encode(*frame->GetImage());
+
+	// Write to a temporary file (unique to this frame object), and rename it
+	QString temp_path = frame_info.absoluteFilePath() + QString(".%1.tmp").arg((quintptr) frame.get(), 0, 16);
+	QFile file(temp_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	int channels = frame->has_audio_data ? frame->GetAudioChannelsCount() : 0;
+	int samples = frame->has_audio_data ? frame->GetAudioSamplesCount() : 0;
+	QDataStream stream(&file);
+	stream << quint32(RENDER_CACHE_MAGIC) << quint32(RENDER_CACHE_VERSION);
+	stream << qint32(encoded.width) << qint32(encoded.height)
+		   << qint32(frame->GetPixelRatio().num) << qint32(frame->GetPixelRatio().den);
+	stream << qint32(frame->SampleRate()) << qint32(channels) << qint32(samples) << qint32(frame->ChannelsLayout());
+	stream << quint64(encoded.stripes.size());
+	for (size_t offset : encoded.stripes)
+		stream << quint64(offset);
+	stream << quint64(encoded.data.size());
+	stream.writeRawData(reinterpret_cast<const char*>(encoded.data.data()), encoded.data.size());
+	for (int channel = 0; channel < channels; channel++)
+		stream.writeRawData(reinterpret_cast<const char*>(frame->GetAudioSamples(channel)), samples * sizeof(float));
+	file.close();
+
+	if (stream.status() != QDataStream::Ok) {
+		QFile::remove(temp_path);
+		return false;
+	}
+
+	QFile::remove(frame_info.absoluteFilePath());
+	bool saved = QFile::rename(temp_path, frame_info.absoluteFilePath());
+	if (!saved)
+		QFile::remove(temp_path);
+	else
+		use_frame(frame_info.absoluteFilePath(), QFileInfo(frame_info.absoluteFilePath()).size());
+
+	ZmqLogger::Instance()->AppendDebugMethod("RenderCache::Save", "frame_number", frame->number, "saved", saved);
+	return saved;
+}
+
+// Save a rendered frame on a background thread
+void RenderCache::SaveAsync(std::string frame_path, std::shared_ptr<Frame> frame)
+{
+	if (frame_path.empty() || !frame)
+		return;
+
+	// Save a deep copy (the caller, and the caches which return this frame, may still modify it). Images are
+	// implicitly shared by Qt, so the pixels are copied too (the background thread never reads shared pixels).
+	auto saved_frame = std::make_shared<Frame>(*frame);
+	if (frame->has_image_data)
+		saved_frame->AddImage(std::make_shared<QImage>(frame->GetImage()->copy()));
+
+	{
+		const std::lock_guard<std::mutex> lock(save_queue->mutex);
+		if (save_queue->frames.size() >= RENDER_CACHE_MAX_QUEUED) {
+			// Too many frames waiting (the disk is slower than rendering)
+			ZmqLogger::Instance()->AppendDebugMethod("RenderCache::SaveAsync (queue full, frame dropped)", "frame_number", frame->number);
+			return;
+		}
+		save_queue->frames.push_back(std::make_pair(frame_path, saved_frame));
+		save_queue->saving++;
+
+		// Start the background thread (once)
+		if (!save_queue->started) {
+			std::thread(save_frames).detach();
+			save_queue->started = true;
+		}
+	}
+	save_queue->condition.notify_all();
+}
+
+// Wait for all queued frames to be saved
+void RenderCache::Flush()
+{
+	std::unique_lock<std::mutex> lock(save_queue->mutex);
+	save_queue->condition.wait(lock, [] { return save_queue->saving == 0; });
+}
+
+// Get the total size of the frames in the render cache folder
+int64_t RenderCache::GetBytes()
+{
+	const std::lock_guard<std::mutex> lock(folder_index->mutex);
+	scan_folder();
+	return folder_index->bytes;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @brief Header file for RenderCache class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_RENDER_CACHE_H
+#define OPENSHOT_RENDER_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QCryptographicHash>
+
+#include "Json.h"
+#include "KeyFrame.h"
+
+namespace openshot {
+	class Frame;
+
+	/**
+	 * @brief This class is a persistent (cross-session) cache of rendered timeline frames, keyed by content.
+	 *
+	 * The key of a frame is a hash of everything which affects it: the JSON of the intersecting clips and
+	 * effects, and of the clips they are attached to (with each keyframe replaced by its values near the
+	 * frame), the identity (path, size, and modification time) of each file they read, and the size of the
+	 * output. Rendered frames are saved to Settings::PATH_RENDER_CACHE (with a losslessly compressed image,
+	 * see ImageCodec), so reopening a project, or exporting it again after a small edit, loads unchanged
+	 * frames from disk.
+	 *
+	 * SaveAsync() compresses and writes frames on a background thread, so rendering never waits for the
+	 * disk. The folder is limited to Settings::RENDER_CACHE_MAX_MB: once it is exceeded, the least recently
+	 * used frames (by modification time, which Load() updates) are removed, down to 90% of the limit.
+	 *
+	 * @code
+	 * openshot::RenderCache key;
+	 * key.AddNumber(frame_number);
+	 * key.AddJson(clip->JsonValue(), clip_frame_number);
+	 * std::string frame_path = openshot::RenderCache::FramePath(key.Key());
+	 * std::shared_ptr<openshot::Frame> frame = openshot::RenderCache::Load(frame_path, frame_number);
+	 * if (!frame) {
+	 *     frame = render(frame_number);
+	 *     openshot::RenderCache::Save(frame_path, frame);
+	 * }
+	 * @endcode
+	 */
+	class RenderCache {
+	private:
+		QCryptographicHash hash; ///< Hash of everything added to the key
+
+		/// Add a JSON value to the key (recursively), with its keyframes replaced by a marker
+		void AddValue(const Json::Value& value, std::vector<openshot::Keyframe>& keyframes);
+
+	public:
+		/// Default constructor (an empty key)
+		RenderCache();
+
+		/// @brief Add the JSON of a clip, effect, or other object to the key
+		///
+		/// Keyframes are replaced by their values at (and next to) the frame, so edits to other frames do
+		/// not change the key. Paths of files also add the size and modification time of the file.
+		/// @param root The JSON of the object
+		/// @param frame_number The frame number of the object (used to get the values of its keyframes)
+		void AddJson(const Json::Value& root, int64_t frame_number);
+
+		/// @brief Get the key of the JSON of an object, without the values of its keyframes
+		///
+		/// The key does not depend on the frame, so it can be cached (and combined with the values of the
+		/// keyframes at each frame, see AddKeyframes). AddJson(root, frame_number) is the same as
+		/// AddString(TemplateKey(root, keyframes)) followed by AddKeyframes(keyframes, frame_number).
+		/// @returns The key (a hex string of the hash)
+		/// @param root The JSON of the object
+		/// @param keyframes The keyframes of the object (in the order of the JSON) are appended to this vector
+		static std::string TemplateKey(const Json::Value& root, std::vector<openshot::Keyframe>& keyframes);
+
+		/// @brief Add the values of keyframes at (and next to) a frame to the key
+		/// @param keyframes The keyframes (from TemplateKey)
+		/// @param frame_number The frame number of the object
+		void AddKeyframes(const std::vector<openshot::Keyframe>& keyframes, int64_t frame_number);
+
+		/// @brief Add a number to the key
+		/// @param value The number
+		void AddNumber(double value);
+
+		/// @brief Add a string to the key
+		/// @param value The string
+		void AddString(std::string value);
+
+		/// Get the key (a hex string of the hash)
+		std::string Key() const;
+
+		/// @brief Get the path of a rendered frame (in Settings::PATH_RENDER_CACHE)
+		///
+		/// @returns The path, or an empty string if the render cache is disabled
+		/// @param key The key of the frame
+		static std::string FramePath(std::string key);
+
+		/// @brief Load a rendered frame
+		///
+		/// @returns The frame, or NULL if it is missing or invalid
+		/// @param frame_path The path of the frame (from FramePath)
+		/// @param frame_number The frame number of the loaded frame
+		static std::shared_ptr<openshot::Frame> Load(std::string frame_path, int64_t frame_number);
+
+		/// @brief Save a rendered frame (the file is replaced atomically, so other processes never load a partial file)
+		///
+		/// @returns True if the frame was saved
+		/// @param frame_path The path of the frame (from FramePath)
+		/// @param frame The rendered frame
+		static bool Save(std::string frame_path, std::shared_ptr<openshot::Frame> frame);
+
+		/// @brief Save a rendered frame on a background thread
+		///
+		/// A copy of the frame is saved, so the caller may keep modifying it. The frame is dropped if too many
+		/// frames are already waiting (it can always be rendered again).
+		/// @param frame_path The path of the frame (from FramePath)
+		/// @param frame The rendered frame
+		static void SaveAsync(std::string frame_path, std::shared_ptr<openshot::Frame> frame);
+
+		/// Wait for all frames queued by SaveAsync() to be saved
+		static void Flush();
+
+		/// Get the total size (in bytes) of the frames in the render cache folder
+		static int64_t GetBytes();
+	};
+
+}
+
+#endif
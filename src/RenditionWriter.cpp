@@ -0,0 +1,270 @@
+/**
+ * @file
+ * @brief Source file for RenditionWriter class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <utility>
+
+#include <QImage>
+
+#include "RenditionWriter.h"
+#include "Exceptions.h"
+#include "FFmpegWriter.h"
+#include "Frame.h"
+#include "FrameStream.h"
+#include "ReaderBase.h"
+#include "ZmqLogger.h"
+
+using namespace openshot;
+
+// Default constructor
+RenditionWriter::RenditionWriter() : queue_size(8), is_open(false), stopping(false)
+{
+}
+
+// Destructor (stops the encoding threads, if any)
+RenditionWriter::~RenditionWriter()
+{
+	try {
+		stop_threads();
+	} catch (...) {
+		// Errors can't be thrown from a destructor
+	}
+}
+
+// Add a rendition (before calling Open)
+void RenditionWriter::AddRendition(FFmpegWriter* writer)
+{
+	if (is_open)
+		throw WriterClosed("Renditions must be added before the RenditionWriter is opened.", "");
+
+	std::unique_ptr<Rendition> rendition(new Rendition());
+	rendition->writer = writer;
+	renditions.push_back(std::move(rendition));
+
+	// Use the info of the first (usually largest) rendition
+	if (renditions.size() == 1)
+		info = writer->info;
+}
+
+// Set the max # of frames waiting to be encoded by each rendition
+void RenditionWriter::SetQueueSize(int frames)
+{
+	const std::lock_guard<std::mutex> lock(queueMutex);
+	queue_size = std::max(1, frames);
+}
+
+// Open every rendition, and start the encoding threads
+void RenditionWriter::Open()
+{
+	if (is_open)
+		return;
+
+	for (auto& rendition : renditions) {
+		if (!rendition->writer->IsOpen())
+			rendition->writer->Open();
+	}
+
+	stopping = false;
+	error = nullptr;
+	for (auto& rendition : renditions)
+		rendition->thread = std::thread(&RenditionWriter::encode, this, rendition.get());
+	is_open = true;
+
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"RenditionWriter::Open",
+		"renditions.size()", renditions.size(),
+		"queue_size", queue_size);
+}
+
+// Encode the queued frames of a rendition (encoding thread)
+void RenditionWriter::encode(Rendition* rendition)
+{
+	while (true) {
+		std::shared_ptr<Frame> frame;
+		{
+			// Wait for a queued frame (or the end of the queue)
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this, rendition] { return !rendition->queue.empty() || stopping; });
+			if (rendition->queue.empty())
+				break;
+			frame = rendition->queue.front();
+		}
+
+		try {
+			rendition->writer->WriteFrame(frame);
+		} catch (...) {
+			const std::lock_guard<std::mutex> lock(queueMutex);
+			if (!error)
+				error = std::current_exception();
+		}
+
+		{
+			// Remove the frame (after encoding it, so the queue size includes the frame being encoded)
+			const std::lock_guard<std::mutex> lock(queueMutex);
+			rendition->queue.pop_front();
+			if (error)
+				rendition->queue.clear();
+		}
+		queueCondition.notify_all();
+	}
+}
+
+// Get a copy of a frame (sharing a scaled image), with its own audio samples
+std::shared_ptr<Frame> RenditionWriter::rendition_frame(std::shared_ptr<Frame> frame, std::shared_ptr<QImage> image)
+{
+	int channels = frame->GetAudioChannelsCount();
+	int samples = frame->GetAudioSamplesCount();
+	auto copy = std::make_shared<Frame>(frame->number, samples, channels);
+	copy->SampleRate(frame->SampleRate());
+	copy->ChannelsLayout(frame->ChannelsLayout());
+	for (int channel = 0; channel < channels; channel++)
+		copy->AddAudio(true, channel, 0, frame->GetAudioSamples(channel), samples, 1.0f);
+
+	// The image is shared (read only) by every rendition of this size
+	copy->AddImage(image);
+	return copy;
+}
+
+// Scale a frame once per rendition size, and add it to the queue of each rendition
+void RenditionWriter::WriteFrame(std::shared_ptr<Frame> frame)
+{
+	if (!is_open)
+		throw WriterClosed("The RenditionWriter is closed.  Call Open() before calling this method.", "");
+
+	// Scale the image once per distinct rendition size (largest first)
+	std::map<std::pair<int, int>, std::shared_ptr<Frame>, std::greater<std::pair<int, int>>> frames;
+	if (frame->has_image_data) {
+		for (auto& rendition : renditions) {
+			const WriterInfo& writer_info = rendition->writer->info;
+			if (writer_info.has_video)
+				frames[std::make_pair(writer_info.width, writer_info.height)] = nullptr;
+		}
+
+		// Each size is scaled from the smallest size already scaled (which contains it), i.e. a pyramid
+		std::shared_ptr<QImage> source = frame->GetImage();
+		std::vector<std::shared_ptr<QImage>> levels = { source };
+		for (auto& size : frames) {
+			int width = size.first.first;
+			int height = size.first.second;
+			if (width == source->width() && height == source->height()) {
+				// Same size as the rendered frame
+				size.second = frame;
+				continue;
+			}
+
+			std::shared_ptr<QImage> parent = source;
+			for (auto& level : levels) {
+				if (level->width() >= width && level->height() >= height)
+					parent = level;
+			}
+			auto image = std::make_shared<QImage>(parent->scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+			if (image->format() != QImage::Format_RGBA8888_Premultiplied)
+				*image = image->convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+			levels.push_back(image);
+			size.second = rendition_frame(frame, image);
+		}
+	}
+
+	// Add the frame (of the right size) to the queue of each rendition
+	bool failed = false;
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		for (auto& rendition : renditions) {
+			const WriterInfo& writer_info = rendition->writer->info;
+			std::shared_ptr<Frame> queued_frame = frame;
+			auto scaled = frames.find(std::make_pair(writer_info.width, writer_info.height));
+			if (writer_info.has_video && scaled != frames.end())
+				queued_frame = scaled->second;
+
+			// Wait while the queue of this rendition is full
+			queueCondition.wait(lock, [this, &rendition] { return (int) rendition->queue.size() < queue_size || error; });
+			if (error) {
+				failed = true;
+				break;
+			}
+			rendition->queue.push_back(queued_frame);
+			queueCondition.notify_all();
+		}
+	}
+
+	// Raise encoding exception from main thread
+	if (failed)
+		stop_threads();
+}
+
+// Write a block of frames from a reader
+void RenditionWriter::WriteFrame(ReaderBase* reader, int64_t start, int64_t length)
+{
+	// Loop through each frame (and encoded it), while the next frames are read ahead
+	std::shared_ptr<FrameStream> stream = reader->GetFrames(start, length - start + 1);
+	while (std::shared_ptr<Frame> f = stream->Next()) {
+		// Encode frame
+		WriteFrame(f);
+	}
+}
+
+// Wait for all queued frames, and stop the encoding threads (throws the first error, if any)
+void RenditionWriter::stop_threads()
+{
+	{
+		const std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& rendition : renditions) {
+		if (rendition->thread.joinable())
+			rendition->thread.join();
+	}
+	is_open = false;
+
+	std::exception_ptr thread_error;
+	{
+		const std::lock_guard<std::mutex> lock(queueMutex);
+		thread_error = error;
+		error = nullptr;
+	}
+
+	// Raise encoding exception from main thread
+	if (thread_error)
+		std::rethrow_exception(thread_error);
+}
+
+// Encode all queued frames, and close every rendition
+void RenditionWriter::Close()
+{
+	// Keep the first error (of the encoding threads, or of a writer), but close every writer anyway
+	std::exception_ptr close_error;
+	try {
+		stop_threads();
+	} catch (...) {
+		close_error = std::current_exception();
+	}
+
+	for (auto& rendition : renditions) {
+		try {
+			if (rendition->writer->IsOpen())
+				rendition->writer->Close();
+		} catch (...) {
+			if (!close_error)
+				close_error = std::current_exception();
+		}
+	}
+
+	ZmqLogger::Instance()->AppendDebugMethod("RenditionWriter::Close", "renditions.size()", renditions.size());
+
+	// Raise the first error (after every writer is closed)
+	if (close_error)
+		std::rethrow_exception(close_error);
+}
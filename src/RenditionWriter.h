@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @brief Header file for RenditionWriter class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_RENDITION_WRITER_H
+#define OPENSHOT_RENDITION_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WriterBase.h"
+
+class QImage;
+
+namespace openshot {
+	class FFmpegWriter;
+	class Frame;
+	class ReaderBase;
+
+	/**
+	 * @brief This class writes each frame to several FFmpegWriters (renditions) at once, i.e. an ABR ladder for HLS / DASH.
+	 *
+	 * Each frame is rendered once (by the caller), and then downscaled once per distinct rendition size. Each size is
+	 * scaled from the smallest larger size already scaled (a pyramid), so a 360p rendition is scaled from the 720p image,
+	 * not from the 4K source. Each rendition then receives a frame with exactly its size (so its FFmpegWriter only has to
+	 * convert the pixel format), and encodes it on its own thread, from its own bounded queue. WriteFrame() only waits
+	 * when the queue of a rendition is full.
+	 *
+	 * Errors of a rendition are thrown by the next WriteFrame() or Close() call. The writers are not deleted.
+	 *
+	 * @code
+	 * openshot::FFmpegWriter w1080("1080p.mp4"), w720("720p.mp4"), w360("360p.mp4");
+	 * w1080.SetVideoOptions(true, "libx264", openshot::Fraction(30, 1), 1920, 1080, openshot::Fraction(1, 1), false, false, 6000000);
+	 * w720.SetVideoOptions(true, "libx264", openshot::Fraction(30, 1), 1280, 720, openshot::Fraction(1, 1), false, false, 3000000);
+	 * w360.SetVideoOptions(true, "libx264", openshot::Fraction(30, 1), 640, 360, openshot::Fraction(1, 1), false, false, 800000);
+	 *
+	 * openshot::RenditionWriter ladder;
+	 * ladder.AddRendition(&w1080);
+	 * ladder.AddRendition(&w720);
+	 * ladder.AddRendition(&w360);
+	 * ladder.Open();
+	 * ladder.WriteFrame(&timeline, 1, 300);
+	 * ladder.Close();
+	 * @endcode
+	 */
+	class RenditionWriter : public WriterBase {
+	private:
+		/// A writer, and the frames waiting to be encoded by it
+		struct Rendition {
+			openshot::FFmpegWriter* writer;
+			std::deque<std::shared_ptr<openshot::Frame>> queue; ///< Frames waiting to be encoded
+			std::thread thread; ///< Encoding thread
+		};
+
+		std::vector<std::unique_ptr<Rendition>> renditions;
+		int queue_size; ///< Max # of frames waiting in each queue
+		bool is_open;
+		bool stopping; ///< Are the encoding threads finishing their queues (and stopping)
+		std::exception_ptr error; ///< First error of the encoding threads (thrown on the caller's thread)
+		std::mutex queueMutex; ///< Mutex protecting the queues, stopping, and error
+		std::condition_variable queueCondition; ///< Signaled when a queue changes
+
+		/// Encode the queued frames of a rendition (encoding thread)
+		void encode(Rendition* rendition);
+
+		/// Get a copy of a frame (sharing a scaled image), with its own audio samples
+		std::shared_ptr<openshot::Frame> rendition_frame(std::shared_ptr<openshot::Frame> frame, std::shared_ptr<QImage> image);
+
+		/// Wait for all queued frames, and stop the encoding threads (throws the first error, if any)
+		void stop_threads();
+
+	public:
+		/// Default constructor
+		RenditionWriter();
+
+		/// Destructor (stops the encoding threads, if any)
+		virtual ~RenditionWriter();
+
+		/// @brief Add a rendition (before calling Open)
+		/// @param writer An FFmpegWriter with its video options already set (its size is the size of the rendition)
+		void AddRendition(openshot::FFmpegWriter* writer);
+
+		/// Encode all queued frames, and close every rendition (which writes their trailers), even if a rendition failed
+		void Close();
+
+		/// Get the max # of frames waiting to be encoded by each rendition
+		int GetQueueSize() { return queue_size; };
+
+		/// Get the number of renditions
+		int GetRenditionCount() { return renditions.size(); };
+
+		/// Determine if writer is open or closed
+		bool IsOpen() override { return is_open; };
+
+		/// Open every rendition (which are not already open), and start the encoding threads
+		void Open() override;
+
+		/// @brief Set the max # of frames waiting to be encoded by each rendition (before WriteFrame() waits)
+		/// @param frames The queue size (at least 1, defaults to 8)
+		void SetQueueSize(int frames);
+
+		/// @brief Scale a frame once per rendition size, and add it to the queue of each rendition
+		/// @param frame The openshot::Frame object to write to every rendition
+		void WriteFrame(std::shared_ptr<openshot::Frame> frame) override;
+
+		/// @brief Write a block of frames from a reader
+		/// @param reader A openshot::ReaderBase object which will provide frames to be written
+		/// @param start The starting frame number of the reader
+		/// @param length The number of frames to write
+		void WriteFrame(openshot::ReaderBase* reader, int64_t start, int64_t length) override;
+	};
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @brief Source file for SeekIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+
+#include "SeekIndex.h"
+#include "Settings.h"
+#include "ZmqLogger.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+using namespace openshot;
+
+// Sidecar file identifier and version
+#define SEEK_INDEX_MAGIC 0x4F535849
+#define SEEK_INDEX_VERSION 1
+
+// Default constructor
+SeekIndex::SeekIndex() : is_complete(false)
+{
+}
+
+// Add a packet to the end of the index
+void SeekIndex::Add(int64_t pts, int64_t dts, int64_t pos, bool keyframe)
+{
+	// Ignore packets which are already indexed (i.e. reading the beginning of the file again)
+	if (is_complete || (!entries.empty() && dts <= entries.back().dts))
+		return;
+
+	entries.push_back({pts, dts, pos, keyframe});
+
+	// Keyframes are sorted by PTS (ignore keyframes which would be out of order)
+	if (keyframe && (keyframes.empty() || pts > entries[keyframes.back()].pts))
+		keyframes.push_back(entries.size() - 1);
+}
+
+// Remove all packets
+void SeekIndex::Clear()
+{
+	entries.clear();
+	keyframes.clear();
+	is_complete = false;
+}
+
+// Find the last keyframe at (or before) a timestamp
+bool SeekIndex::FindKeyframe(int64_t pts, Entry& keyframe) const
+{
+	// Find the first keyframe after the timestamp
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), pts,
+		[this](int64_t target, size_t index) { return target < entries[index].pts; });
+
+	// The preceding keyframe is only known if a later keyframe was indexed (or the file is complete)
+	if (next == keyframes.begin() || (next == keyframes.end() && !is_complete))
+		return false;
+
+	keyframe = entries[*(next - 1)];
+	return true;
+}
+
+// Get the path of the sidecar file for a video file
+std::string SeekIndex::IndexPath(std::string media_path)
+{
+	std::string folder = Settings::Instance()->PATH_SEEK_INDEX;
+	if (folder.empty())
+		return "";
+
+	// Name the sidecar file with a hash of the absolute path
+	QString absolute_path = QFileInfo(QString::fromStdString(media_path)).absoluteFilePath();
+	QString name = QCryptographicHash::hash(absolute_path.toUtf8(), QCryptographicHash::Sha1).toHex() + ".index";
+	return QDir(QString::fromStdString(folder)).filePath(name).toStdString();
+}
+
+// Load a complete index from a sidecar file
+bool SeekIndex::Load(std::string index_path, std::string media_path, int stream_index)
+{
+	if (index_path.empty())
+		return false;
+
+	QFile file(QString::fromStdString(index_path));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	quint32 magic = 0, version = 0;
+	stream >> magic >> version;
+	if (magic != SEEK_INDEX_MAGIC || version != SEEK_INDEX_VERSION)
+		return false;
+
+	// Verify the video file has not changed (path, size, and modification time)
+	QFileInfo media_info(QString::fromStdString(media_path));
+	QString path;
+	qint64 size = 0, modified = 0;
+	qint32 stream_number = -1;
+	stream >> path >> size >> modified >> stream_number;
+	if (path != media_info.absoluteFilePath() || size != media_info.size() ||
+		modified != media_info.lastModified().toMSecsSinceEpoch() || stream_number != stream_index)
+		return false;
+
+	// Read packets
+	quint64 count = 0;
+	stream >> count;
+	SeekIndex loaded;
+	for (quint64 index = 0; index < count && stream.status() == QDataStream::Ok; index++) {
+		qint64 pts = 0, dts = 0, pos = 0;
+		bool keyframe = false;
+		stream >> pts >> dts >> pos >> keyframe;
+		loaded.Add(pts, dts, pos, keyframe);
+	}
+	if (stream.status() != QDataStream::Ok)
+		return false;
+
+	loaded.SetComplete();
+	*this = loaded;
+
+	ZmqLogger::Instance()->AppendDebugMethod("SeekIndex::Load", "packets", Count(), "keyframes", KeyframeCount());
+	return true;
+}
+
+// Save a complete index to a sidecar file
+bool SeekIndex::Save(std::string index_path, std::string media_path, int stream_index) const
+{
+	if (index_path.empty() || !is_complete)
+		return false;
+
+	// Create folder (if needed)
+	QFileInfo index_info(QString::fromStdString(index_path));
+	if (!QDir().mkpath(index_info.absolutePath()))
+		return false;
+
+	// Write to a temporary file (and rename it), so a partial file is never loaded
+	QString temp_path = index_info.absoluteFilePath() + ".tmp";
+	QFile file(temp_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	QFileInfo media_info(QString::fromStdString(media_path));
+	QDataStream stream(&file);
+	stream << quint32(SEEK_INDEX_MAGIC) << quint32(SEEK_INDEX_VERSION);
+	stream << media_info.absoluteFilePath() << qint64(media_info.size())
+		   << qint64(media_info.lastModified().toMSecsSinceEpoch()) << qint32(stream_index);
+	stream << quint64(entries.size());
+	for (const Entry& entry : entries)
+		stream << qint64(entry.pts) << qint64(entry.dts) << qint64(entry.pos) << entry.keyframe;
+	file.close();
+
+	if (stream.status() != QDataStream::Ok) {
+		QFile::remove(temp_path);
+		return false;
+	}
+
+	QFile::remove(index_info.absoluteFilePath());
+	bool saved = QFile::rename(temp_path, index_info.absoluteFilePath());
+
+	ZmqLogger::Instance()->AppendDebugMethod("SeekIndex::Save", "packets", Count(), "keyframes", KeyframeCount(), "saved", saved);
+	return saved;
+}
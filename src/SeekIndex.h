@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief Header file for SeekIndex class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_SEEK_INDEX_H
+#define OPENSHOT_SEEK_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openshot {
+
+	/**
+	 * @brief This class contains an index of the video packets of a file (used to seek directly to a keyframe).
+	 *
+	 * Packets are added in decode order, while a file is read from the beginning (or scanned). Each entry
+	 * contains the PTS, DTS, keyframe flag, and byte offset of a packet. Once the entire file has been
+	 * indexed, the index can be saved to a sidecar file, which is only loaded again if the path, size, and
+	 * modification time of the video file still match.
+	 *
+	 * @code
+	 * openshot::SeekIndex index;
+	 * if (index.Load("/home/user/.openshot/seek-index/1234.index", "/home/user/video.mp4")) {
+	 *     openshot::SeekIndex::Entry keyframe;
+	 *     if (index.FindKeyframe(target_pts, keyframe))
+	 *         av_seek_frame(format_context, stream_index, keyframe.pts, AVSEEK_FLAG_BACKWARD);
+	 * }
+	 * @endcode
+	 */
+	class SeekIndex {
+	public:
+		/// A single video packet
+		struct Entry {
+			int64_t pts; ///< Presentation timestamp (in stream timebase)
+			int64_t dts; ///< Decoding timestamp (in stream timebase)
+			int64_t pos; ///< Byte offset in the file (or -1 if unknown)
+			bool keyframe; ///< Is this packet a keyframe
+		};
+
+	private:
+		std::vector<Entry> entries; ///< All packets (in decode order)
+		std::vector<size_t> keyframes; ///< Index of each keyframe entry (sorted by PTS)
+		bool is_complete; ///< Has the entire file been indexed
+
+	public:
+		/// Default constructor
+		SeekIndex();
+
+		/// @brief Add a packet to the end of the index (packets which are already indexed are ignored)
+		///
+		/// @param pts The presentation timestamp
+		/// @param dts The decoding timestamp
+		/// @param pos The byte offset in the file
+		/// @param keyframe Is this packet a keyframe
+		void Add(int64_t pts, int64_t dts, int64_t pos, bool keyframe);
+
+		/// Remove all packets
+		void Clear();
+
+		/// Get the number of indexed packets
+		int64_t Count() const { return entries.size(); }
+
+		/// Get the number of indexed keyframes
+		int64_t KeyframeCount() const { return keyframes.size(); }
+
+		/// @brief Find the last keyframe at (or before) a timestamp
+		///
+		/// @returns True if the keyframe is known (i.e. a later keyframe is also indexed, or the entire file is indexed)
+		/// @param pts The target presentation timestamp
+		/// @param keyframe The keyframe entry (if found)
+		bool FindKeyframe(int64_t pts, Entry& keyframe) const;
+
+		/// Has the entire file been indexed
+		bool IsComplete() const { return is_complete; }
+
+		/// Mark the index as complete (the end of the file was reached)
+		void SetComplete() { is_complete = true; }
+
+		/// @brief Get the path of the sidecar file for a video file (in Settings::PATH_SEEK_INDEX)
+		///
+		/// @returns The sidecar path, or an empty string if persistent seek indexes are disabled
+		/// @param media_path The path of the video file
+		static std::string IndexPath(std::string media_path);
+
+		/// @brief Load a complete index from a sidecar file
+		///
+		/// @returns True if the index was loaded (false if missing, invalid, or the video file was modified)
+		/// @param index_path The path of the sidecar file
+		/// @param media_path The path of the video file
+		/// @param stream_index The index of the video stream
+		bool Load(std::string index_path, std::string media_path, int stream_index);
+
+		/// @brief Save a complete index to a sidecar file
+		///
+		/// @returns True if the index was saved
+		/// @param index_path The path of the sidecar file
+		/// @param media_path The path of the video file
+		/// @param stream_index The index of the video stream
+		bool Save(std::string index_path, std::string media_path, int stream_index) const;
+	};
+
+}
+
+#endif
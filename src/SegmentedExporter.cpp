@@ -0,0 +1,459 @@
+/**
+ * @file
+ * @brief Source file for SegmentedExporter class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "SegmentedExporter.h"
+#include "Exceptions.h"
+#include "FFmpegUtilities.h"
+#include "Frame.h"
+#include "OpenMPUtilities.h"
+#include "Timeline.h"
+#include "ZmqLogger.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QString>
+#include <QTemporaryDir>
+
+using namespace openshot;
+
+// Max number of segments rendered at once by default (each segment has its own timeline, and
+// a writer with multi-threaded codecs, so more segments mostly add memory)
+#define SEGMENTED_EXPORTER_MAX_DEFAULT_THREADS 4
+
+// Open a file, and find its best stream of a type
+static AVFormatContext* open_input(const std::string& file_path, AVMediaType type, int* stream_index)
+{
+	AVFormatContext* input = NULL;
+	if (avformat_open_input(&input, file_path.c_str(), NULL, NULL) != 0)
+		throw InvalidFile("File could not be opened.", file_path);
+	if (avformat_find_stream_info(input, NULL) < 0 ||
+		(*stream_index = av_find_best_stream(input, type, -1, -1, NULL, 0)) < 0) {
+		avformat_close_input(&input);
+		throw NoStreamsFound("No streams found in file.", file_path);
+	}
+	return input;
+}
+
+// Read the next packet of a stream (false at the end of the file)
+static bool read_packet(AVFormatContext* input, int stream_index, AVPacket* packet)
+{
+	while (av_read_frame(input, packet) >= 0) {
+		if (packet->stream_index == stream_index)
+			return true;
+		av_packet_unref(packet);
+	}
+	return false;
+}
+
+// Add an output stream, with the codec parameters of an input stream (for stream copy)
+static AVStream* add_stream(AVFormatContext* output, AVStream* input_stream, const std::string& file_path)
+{
+	AVStream* stream = avformat_new_stream(output, NULL);
+	if (!stream)
+		throw OutOfMemory("Could not allocate stream.", file_path);
+	if (avcodec_parameters_copy(stream->codecpar, input_stream->codecpar) < 0)
+		throw InvalidCodec("Could not copy the codec parameters of the stream.", file_path);
+	stream->codecpar->codec_tag = 0;
+	stream->time_base = input_stream->time_base;
+	stream->avg_frame_rate = input_stream->avg_frame_rate;
+	stream->r_frame_rate = input_stream->r_frame_rate;
+	stream->sample_aspect_ratio = input_stream->sample_aspect_ratio;
+	return stream;
+}
+
+// Do two streams have the same codec parameters (so their packets can be copied into the same output stream)
+static bool same_codec_parameters(const AVCodecParameters* a, const AVCodecParameters* b)
+{
+	return a->codec_id == b->codec_id &&
+		   a->format == b->format &&
+		   a->width == b->width &&
+		   a->height == b->height &&
+		   a->sample_rate == b->sample_rate &&
+		   a->profile == b->profile &&
+		   a->level == b->level &&
+		   a->extradata_size == b->extradata_size &&
+		   (a->extradata_size == 0 || memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+// Timestamp used to interleave packets
+static int64_t packet_timestamp(const AVPacket* packet)
+{
+	return (packet->dts != AV_NOPTS_VALUE) ? packet->dts : packet->pts;
+}
+
+// Constructor
+SegmentedExporter::SegmentedExporter(Timeline* timeline, const std::string& path) :
+		timeline(timeline), path(path), has_video(false), fps(timeline->info.fps), width(0), height(0),
+		pixel_ratio(1, 1), interlaced(false), top_field_first(true), video_bit_rate(0), has_audio(false),
+		sample_rate(0), channels(0), channel_layout(LAYOUT_STEREO), audio_bit_rate(0), gop_size(0),
+		segment_length(0),
+		thread_count(std::max(1, std::min(SEGMENTED_EXPORTER_MAX_DEFAULT_THREADS, OPEN_MP_NUM_PROCESSORS / 4))) {
+}
+
+// Set video export options
+void SegmentedExporter::SetVideoOptions(bool has_video, std::string codec, Fraction fps, int width, int height,
+										Fraction pixel_ratio, bool interlaced, bool top_field_first, int bit_rate) {
+	this->has_video = has_video;
+	video_codec = codec;
+	this->fps = fps;
+	this->width = width;
+	this->height = height;
+	this->pixel_ratio = pixel_ratio;
+	this->interlaced = interlaced;
+	this->top_field_first = top_field_first;
+	video_bit_rate = bit_rate;
+}
+
+// Set audio export options
+void SegmentedExporter::SetAudioOptions(bool has_audio, std::string codec, int sample_rate, int channels,
+										ChannelLayout channel_layout, int bit_rate) {
+	this->has_audio = has_audio;
+	audio_codec = codec;
+	this->sample_rate = sample_rate;
+	this->channels = channels;
+	this->channel_layout = channel_layout;
+	audio_bit_rate = bit_rate;
+}
+
+// Set a custom codec option (applied to every writer)
+void SegmentedExporter::SetOption(StreamType stream, std::string name, std::string value) {
+	options.push_back(std::make_tuple(stream, name, value));
+}
+
+// Set the number of segments rendered at once
+void SegmentedExporter::SetThreads(int threads) {
+	thread_count = std::max(1, threads);
+}
+
+// Get the GOP size used by each segment (in frames)
+int SegmentedExporter::gop_frames() const {
+	if (gop_size > 0)
+		return gop_size;
+	return std::max(1, int(std::round(fps.ToDouble() * 2.0)));
+}
+
+// Get the segments (first and last frame numbers) of a range of frames
+std::vector<std::pair<int64_t, int64_t>> SegmentedExporter::GetSegments(int64_t start, int64_t end) const {
+	std::vector<std::pair<int64_t, int64_t>> segments;
+	int64_t length = end - start + 1;
+	if (length <= 0)
+		return segments;
+
+	// Round the segment length up to a multiple of the GOP size (so each segment starts with a keyframe)
+	int64_t gop = gop_frames();
+	int64_t frames = (segment_length > 0) ? segment_length : (length + thread_count * 4 - 1) / (thread_count * 4);
+	frames = std::max(gop, ((frames + gop - 1) / gop) * gop);
+
+	for (int64_t segment_start = start; segment_start <= end; segment_start += frames)
+		segments.push_back(std::make_pair(segment_start, std::min(end, segment_start + frames - 1)));
+	return segments;
+}
+
+// Export a range of frames
+void SegmentedExporter::Export(int64_t start, int64_t end) {
+	if (!has_video && !has_audio)
+		throw InvalidOptions("No video or audio options have been set.", path);
+
+	// Temporary files (in a new folder next to the final file, which is removed when done)
+	QFileInfo output_info(QString::fromStdString(path));
+	QString suffix = output_info.suffix();
+	QTemporaryDir temp_folder(output_info.absoluteFilePath() + ".segments-XXXXXX");
+	if (!temp_folder.isValid())
+		throw InvalidFile("Could not create the folder of temporary segments.", path);
+	QDir folder(temp_folder.path());
+
+	std::vector<Segment> segments;
+	for (auto range : GetSegments(start, end)) {
+		QString name = QString("segment-%1").arg(segments.size(), 5, 10, QChar('0'));
+		segments.push_back(Segment{range.first, range.second,
+			folder.filePath(name + "." + suffix).toStdString(), folder.filePath(name + ".audio").toStdString()});
+	}
+	std::string audio_path = folder.filePath("audio." + suffix).toStdString();
+
+	ZmqLogger::Instance()->AppendDebugMethod("SegmentedExporter::Export", "start", start, "end", end,
+		"segments", segments.size(), "thread_count", thread_count);
+
+	// Render and encode segments (in parallel, each with its own copy of the timeline)
+	const std::string timeline_json = timeline->Json();
+	std::atomic<size_t> next_segment(0);
+	std::mutex error_mutex;
+	std::exception_ptr error;
+
+	auto export_segments = [&]() {
+		for (size_t index = next_segment++; index < segments.size(); index = next_segment++) {
+			{
+				const std::lock_guard<std::mutex> lock(error_mutex);
+				if (error)
+					return;
+			}
+			try {
+				export_segment(timeline_json, segments[index]);
+			} catch (...) {
+				const std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error)
+					error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < std::min(thread_count, int(segments.size())); thread++)
+		threads.emplace_back(export_segments);
+	for (std::thread& thread : threads)
+		thread.join();
+	if (error)
+		std::rethrow_exception(error);
+
+	// Encode the audio of all segments (as one continuous stream)
+	if (has_audio)
+		encode_audio(segments, audio_path);
+
+	// Join the segments into the final file
+	concatenate(segments, audio_path, start);
+}
+
+// Render and encode one segment (with its own copy of the timeline)
+void SegmentedExporter::export_segment(const std::string& timeline_json, const Segment& segment) {
+	ZmqLogger::Instance()->AppendDebugMethod("SegmentedExporter::export_segment", "start", segment.start, "end", segment.end);
+
+	// Clone the timeline
+	Timeline clone(timeline->info);
+	clone.SetJson(timeline_json);
+	clone.Open();
+
+	// Video of this segment (every segment starts with a keyframe, and has the same GOP size)
+	FFmpegWriter writer(segment.video_path);
+	if (has_video) {
+		writer.SetVideoOptions(true, video_codec, fps, width, height, pixel_ratio, interlaced, top_field_first, video_bit_rate);
+		writer.PrepareStreams();
+		writer.SetOption(VIDEO_STREAM, "g", std::to_string(gop_frames()));
+		for (auto option : options)
+			if (std::get<0>(option) == VIDEO_STREAM)
+				writer.SetOption(VIDEO_STREAM, std::get<1>(option), std::get<2>(option));
+		writer.Open();
+	}
+
+	// Raw audio samples of this segment (the number of channels and samples, then each channel, per frame)
+	std::ofstream audio;
+	if (has_audio) {
+		audio.open(segment.audio_path, std::ios::binary | std::ios::trunc);
+		if (!audio)
+			throw InvalidFile("Could not open or write file.", segment.audio_path);
+	}
+
+	for (int64_t frame_number = segment.start; frame_number <= segment.end; frame_number++) {
+		std::shared_ptr<Frame> frame = clone.GetFrame(frame_number);
+		if (has_video)
+			writer.WriteFrame(frame);
+
+		if (has_audio) {
+			int32_t frame_channels = frame->GetAudioChannelsCount();
+			int32_t frame_samples = frame->GetAudioSamplesCount();
+			audio.write(reinterpret_cast<const char*>(&frame_channels), sizeof(frame_channels));
+			audio.write(reinterpret_cast<const char*>(&frame_samples), sizeof(frame_samples));
+			for (int channel = 0; channel < frame_channels; channel++)
+				audio.write(reinterpret_cast<const char*>(frame->GetAudioSamples(channel)), frame_samples * sizeof(float));
+		}
+	}
+
+	if (has_video)
+		writer.Close();
+	if (has_audio) {
+		audio.close();
+		if (!audio)
+			throw InvalidFile("Could not open or write file.", segment.audio_path);
+	}
+	clone.Close();
+}
+
+// Encode the saved audio samples of all segments (into a single audio file)
+void SegmentedExporter::encode_audio(const std::vector<Segment>& segments, const std::string& audio_path) {
+	FFmpegWriter writer(audio_path);
+	writer.SetAudioOptions(true, audio_codec, sample_rate, channels, channel_layout, audio_bit_rate);
+	writer.PrepareStreams();
+	for (auto option : options)
+		if (std::get<0>(option) == AUDIO_STREAM)
+			writer.SetOption(AUDIO_STREAM, std::get<1>(option), std::get<2>(option));
+	writer.Open();
+
+	std::vector<float> samples;
+	for (const Segment& segment : segments) {
+		std::ifstream audio(segment.audio_path, std::ios::binary);
+		if (!audio)
+			throw InvalidFile("File could not be opened.", segment.audio_path);
+
+		for (int64_t frame_number = segment.start; frame_number <= segment.end; frame_number++) {
+			int32_t frame_channels = 0;
+			int32_t frame_samples = 0;
+			audio.read(reinterpret_cast<char*>(&frame_channels), sizeof(frame_channels));
+			audio.read(reinterpret_cast<char*>(&frame_samples), sizeof(frame_samples));
+			if (!audio || frame_channels < 0 || frame_samples < 0)
+				throw InvalidFile("The audio samples of the segment are incomplete.", segment.audio_path);
+
+			// Recreate the frame's audio (with the sample rate and layout of the timeline)
+			auto frame = std::make_shared<Frame>(frame_number, frame_samples, frame_channels);
+			frame->SampleRate(timeline->info.sample_rate);
+			frame->ChannelsLayout(timeline->info.channel_layout);
+			samples.resize(frame_samples);
+			for (int channel = 0; channel < frame_channels; channel++) {
+				audio.read(reinterpret_cast<char*>(samples.data()), frame_samples * sizeof(float));
+				frame->AddAudio(true, channel, 0, samples.data(), frame_samples, 1.0);
+			}
+			if (!audio)
+				throw InvalidFile("The audio samples of the segment are incomplete.", segment.audio_path);
+
+			writer.WriteFrame(frame);
+		}
+	}
+
+	writer.Close();
+}
+
+// Copy the video of all segments, and the audio file, into the final file
+void SegmentedExporter::concatenate(const std::vector<Segment>& segments, const std::string& audio_path, int64_t start) {
+	AVFormatContext* output = NULL;
+	avformat_alloc_output_context2(&output, NULL, NULL, path.c_str());
+	if (!output)
+		throw InvalidFormat("Could not deduce output format from file extension.", path);
+
+	AVFormatContext* video_input = NULL;
+	AVFormatContext* audio_input = NULL;
+	AVPacket* video_packet = av_packet_alloc();
+	AVPacket* audio_packet = av_packet_alloc();
+
+	auto cleanup = [&]() {
+		if (video_input)
+			avformat_close_input(&video_input);
+		if (audio_input)
+			avformat_close_input(&audio_input);
+		av_packet_free(&video_packet);
+		av_packet_free(&audio_packet);
+		if (!(output->oformat->flags & AVFMT_NOFILE) && output->pb)
+			avio_closep(&output->pb);
+		avformat_free_context(output);
+	};
+
+	try {
+		// Output streams (with the codec parameters of the first segment, and the audio file)
+		int video_index = -1;
+		int audio_index = -1;
+		AVStream* video_out = NULL;
+		AVStream* audio_out = NULL;
+		if (has_video) {
+			video_input = open_input(segments.front().video_path, AVMEDIA_TYPE_VIDEO, &video_index);
+			video_out = add_stream(output, video_input->streams[video_index], path);
+
+			// The output stream has the parameter sets (extradata) of the first segment, so the packets
+			// of every other segment must have been encoded with the same parameters
+			for (size_t index = 1; index < segments.size(); index++) {
+				int segment_video_index = -1;
+				AVFormatContext* segment_input = open_input(segments[index].video_path, AVMEDIA_TYPE_VIDEO, &segment_video_index);
+				bool same = same_codec_parameters(segment_input->streams[segment_video_index]->codecpar, video_out->codecpar);
+				avformat_close_input(&segment_input);
+				if (!same)
+					throw InvalidCodec("The codec parameters of a segment do not match the first segment.", segments[index].video_path);
+			}
+		}
+		if (has_audio) {
+			audio_input = open_input(audio_path, AVMEDIA_TYPE_AUDIO, &audio_index);
+			audio_out = add_stream(output, audio_input->streams[audio_index], path);
+		}
+
+		if (!(output->oformat->flags & AVFMT_NOFILE) && avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE) < 0)
+			throw InvalidFile("Could not open or write file.", path);
+		if (avformat_write_header(output, NULL) < 0)
+			throw InvalidFile("Could not write header to file.", path);
+
+		// Read the next video packet (continuing with the next segment, at the end of each segment)
+		size_t segment_index = 0;
+		int64_t last_dts = AV_NOPTS_VALUE;
+		auto next_video_packet = [&]() {
+			while (video_input) {
+				if (read_packet(video_input, video_index, video_packet)) {
+					// Offset timestamps by the start of the segment
+					AVStream* video_in = video_input->streams[video_index];
+					int64_t start_time = (video_in->start_time != AV_NOPTS_VALUE) ? video_in->start_time : 0;
+					int64_t offset = av_rescale_q(segments[segment_index].start - start,
+												  av_make_q(fps.den, fps.num), video_out->time_base);
+					if (video_packet->pts != AV_NOPTS_VALUE)
+						video_packet->pts = av_rescale_q(video_packet->pts - start_time, video_in->time_base, video_out->time_base) + offset;
+					if (video_packet->dts != AV_NOPTS_VALUE)
+						video_packet->dts = av_rescale_q(video_packet->dts - start_time, video_in->time_base, video_out->time_base) + offset;
+					video_packet->duration = av_rescale_q(video_packet->duration, video_in->time_base, video_out->time_base);
+
+					// Decoding timestamps must increase (across segment boundaries)
+					if (video_packet->dts != AV_NOPTS_VALUE && last_dts != AV_NOPTS_VALUE && video_packet->dts <= last_dts)
+						video_packet->dts = last_dts + 1;
+					if (video_packet->pts != AV_NOPTS_VALUE && video_packet->dts != AV_NOPTS_VALUE && video_packet->pts < video_packet->dts)
+						video_packet->pts = video_packet->dts;
+					if (video_packet->dts != AV_NOPTS_VALUE)
+						last_dts = video_packet->dts;
+
+					video_packet->stream_index = video_out->index;
+					video_packet->pos = -1;
+					return true;
+				}
+
+				// Open the next segment
+				avformat_close_input(&video_input);
+				if (++segment_index < segments.size())
+					video_input = open_input(segments[segment_index].video_path, AVMEDIA_TYPE_VIDEO, &video_index);
+			}
+			return false;
+		};
+
+		// Read the next audio packet
+		auto next_audio_packet = [&]() {
+			if (!audio_input || !read_packet(audio_input, audio_index, audio_packet))
+				return false;
+			av_packet_rescale_ts(audio_packet, audio_input->streams[audio_index]->time_base, audio_out->time_base);
+			audio_packet->stream_index = audio_out->index;
+			audio_packet->pos = -1;
+			return true;
+		};
+
+		// Write packets in timestamp order (so the streams are interleaved)
+		bool has_video_packet = next_video_packet();
+		bool has_audio_packet = next_audio_packet();
+		while (has_video_packet || has_audio_packet) {
+			bool write_video = has_video_packet && (!has_audio_packet ||
+				av_compare_ts(packet_timestamp(video_packet), video_out->time_base,
+							  packet_timestamp(audio_packet), audio_out->time_base) <= 0);
+
+			int error_code = av_interleaved_write_frame(output, write_video ? video_packet : audio_packet);
+			if (error_code < 0)
+				throw InvalidFile("Could not write packet to file [" + av_err2string(error_code) + "].", path);
+
+			if (write_video)
+				has_video_packet = next_video_packet();
+			else
+				has_audio_packet = next_audio_packet();
+		}
+
+		av_write_trailer(output);
+	} catch (...) {
+		cleanup();
+		throw;
+	}
+
+	cleanup();
+	ZmqLogger::Instance()->AppendDebugMethod("SegmentedExporter::concatenate", "segments", segments.size());
+}
@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @brief Header file for SegmentedExporter class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_SEGMENTED_EXPORTER_H
+#define OPENSHOT_SEGMENTED_EXPORTER_H
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "ChannelLayouts.h"
+#include "FFmpegWriter.h"
+#include "Fraction.h"
+
+namespace openshot {
+	class Timeline;
+
+	/**
+	 * @brief This class exports a range of a timeline in parallel segments, which are joined into one file (without re-encoding).
+	 *
+	 * A single FFmpegWriter is limited by the frame-level parallelism of one encoder (and of one timeline). This class
+	 * splits the range into segments (a multiple of the GOP size, so each segment starts with a keyframe), and each
+	 * segment is rendered by its own copy of the timeline (cloned with Timeline::SetJson) and encoded by its own
+	 * FFmpegWriter, on a pool of threads. The video of all segments is then copied (stream copy) into the final file,
+	 * with timestamps offset by the start of each segment.
+	 *
+	 * Audio is not encoded per segment (audio encoders add priming samples to the start of each stream, which would be
+	 * heard at each segment boundary). Instead, the audio samples of each rendered frame are saved, and encoded once
+	 * (as a single continuous stream) after all segments are rendered.
+	 *
+	 * Temporary files are written to a new folder next to the output file (path + ".segments-" and a unique suffix),
+	 * which is removed when done.
+	 * Only clips with file based readers can be cloned (the timeline JSON must be able to recreate them).
+	 *
+	 * @code
+	 * openshot::SegmentedExporter exporter(&timeline, "output.mp4");
+	 * exporter.SetVideoOptions(true, "libx264", timeline.info.fps, 1920, 1080, openshot::Fraction(1, 1), false, false, 8000000);
+	 * exporter.SetAudioOptions(true, "aac", 48000, 2, openshot::LAYOUT_STEREO, 192000);
+	 * exporter.SetOption(openshot::VIDEO_STREAM, "crf", "20");
+	 * exporter.Export(1, timeline.info.video_length);
+	 * @endcode
+	 */
+	class SegmentedExporter {
+	private:
+		/// A range of frames, rendered and encoded by one timeline and writer
+		struct Segment {
+			int64_t start;
+			int64_t end;
+			std::string video_path; ///< Encoded video of the segment
+			std::string audio_path; ///< Raw audio samples of the segment
+		};
+
+		openshot::Timeline* timeline; ///< Timeline to export (which is cloned for each segment)
+		std::string path; ///< Path of the final file
+
+		// Video options
+		bool has_video;
+		std::string video_codec;
+		openshot::Fraction fps;
+		int width;
+		int height;
+		openshot::Fraction pixel_ratio;
+		bool interlaced;
+		bool top_field_first;
+		int video_bit_rate;
+
+		// Audio options
+		bool has_audio;
+		std::string audio_codec;
+		int sample_rate;
+		int channels;
+		openshot::ChannelLayout channel_layout;
+		int audio_bit_rate;
+
+		std::vector<std::tuple<openshot::StreamType, std::string, std::string>> options; ///< Custom codec options
+		int gop_size; ///< Frames between keyframes (0 = 2 seconds)
+		int64_t segment_length; ///< Frames per segment (0 = automatic)
+		int thread_count; ///< Number of segments rendered at once
+
+		/// Render and encode one segment (with its own copy of the timeline)
+		void export_segment(const std::string& timeline_json, const Segment& segment);
+
+		/// Encode the saved audio samples of all segments (into a single audio file)
+		void encode_audio(const std::vector<Segment>& segments, const std::string& audio_path);
+
+		/// Copy the video of all segments, and the audio file, into the final file
+		void concatenate(const std::vector<Segment>& segments, const std::string& audio_path, int64_t start);
+
+		/// Get the GOP size used by each segment (in frames)
+		int gop_frames() const;
+
+	public:
+		/// @brief Constructor
+		/// @param timeline The timeline to export
+		/// @param path The path of the final file (the format is detected from the extension)
+		SegmentedExporter(openshot::Timeline* timeline, const std::string& path);
+
+		/// @brief Export a range of frames (blocks until the final file is written)
+		/// @param start The first frame number to export
+		/// @param end The last frame number to export
+		void Export(int64_t start, int64_t end);
+
+		/// @brief Get the segments (first and last frame numbers) of a range of frames
+		/// @param start The first frame number to export
+		/// @param end The last frame number to export
+		std::vector<std::pair<int64_t, int64_t>> GetSegments(int64_t start, int64_t end) const;
+
+		/// @brief Set audio export options (see FFmpegWriter::SetAudioOptions)
+		/// @param has_audio Does this file need an audio stream?
+		/// @param codec The codec used to encode the audio for this file
+		/// @param sample_rate The number of audio samples needed in this file
+		/// @param channels The number of audio channels needed in this file
+		/// @param channel_layout The 'layout' of audio channels (i.e. mono, stereo, surround, etc...)
+		/// @param bit_rate The audio bit rate used during encoding
+		void SetAudioOptions(bool has_audio, std::string codec, int sample_rate, int channels, openshot::ChannelLayout channel_layout, int bit_rate);
+
+		/// @brief Set the number of frames between keyframes (segments are a multiple of this size)
+		/// @param frames The GOP size in frames (0 = 2 seconds of frames)
+		void SetGopSize(int frames) { gop_size = frames; };
+
+		/// @brief Set a custom codec option (see FFmpegWriter::SetOption), which is applied to every writer
+		/// @param stream The stream (openshot::StreamType) this option should apply to
+		/// @param name The name of the option you want to set (i.e. qmin, qmax, etc...)
+		/// @param value The new value of this option
+		void SetOption(openshot::StreamType stream, std::string name, std::string value);
+
+		/// @brief Set the number of frames per segment (rounded up to a multiple of the GOP size)
+		/// @param frames The frames per segment (0 = 4 segments per thread, so slow segments are balanced)
+		void SetSegmentLength(int64_t frames) { segment_length = frames; };
+
+		/// @brief Set the number of segments rendered at once
+		/// @param threads The number of threads (each with its own timeline and writer). Defaults to a quarter of the
+		/// processors (at most 4), since each timeline and codec also uses multiple threads.
+		void SetThreads(int threads);
+
+		/// @brief Set video export options (see FFmpegWriter::SetVideoOptions)
+		/// @param has_video Does this file need a video stream
+		/// @param codec The codec used to encode the images in this video
+		/// @param fps The number of frames per second
+		/// @param width The width in pixels of this video
+		/// @param height The height in pixels of this video
+		/// @param pixel_ratio The shape of the pixels represented as a openshot::Fraction (1x1 is most common / square pixels)
+		/// @param interlaced Does this video need to be interlaced?
+		/// @param top_field_first Which frame should be used as the top field?
+		/// @param bit_rate The video bit rate used during encoding
+		void SetVideoOptions(bool has_video, std::string codec, openshot::Fraction fps, int width, int height, openshot::Fraction pixel_ratio, bool interlaced, bool top_field_first, int bit_rate);
+	};
+
+}
+
+#endif
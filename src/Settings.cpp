@@ -40,6 +40,17 @@ Settings *Settings::Instance()
 		m_pInstance->ENABLE_PLAYBACK_CACHING = true;
 		m_pInstance->PLAYBACK_AUDIO_DEVICE_NAME = "";
 		m_pInstance->PLAYBACK_AUDIO_DEVICE_TYPE = "";
+		m_pInstance->ENABLE_SEEK_INDEX = false;
+		m_pInstance->PATH_SEEK_INDEX = "";
+		m_pInstance->FFMPEG_PREFETCH_FRAMES = 0;
+		m_pInstance->FFMPEG_WRITER_PIPELINE_FRAMES = 0;
+		m_pInstance->CACHE_DISK_WRITE_THREADS = 0;
+		m_pInstance->CACHE_DISK_MAX_PENDING_MB = 256;
+		m_pInstance->CACHE_MAX_MEMORY_MB = 0;
+		m_pInstance->CACHE_EVICTION_POLICY = 0;
+		m_pInstance->ENABLE_CACHE_STATS = false;
+		m_pInstance->PATH_RENDER_CACHE = "";
+		m_pInstance->RENDER_CACHE_MAX_MB = 4096;
 		m_pInstance->DEBUG_TO_STDERR = false;
 		auto env_debug = std::getenv("LIBOPENSHOT_DEBUG");
 		if (env_debug != nullptr)
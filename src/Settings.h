@@ -107,6 +107,39 @@ namespace openshot {
 		/// paths depend on the location of OpenShot transitions and files)
 		std::string PATH_OPENSHOT_INSTALL = "";
 
+		/// Use a packet index (built while reading a video file from the beginning) to seek directly to keyframes (disabled by default)
+		bool ENABLE_SEEK_INDEX = false;
+
+		/// Folder used to save seek indexes of video files (an empty path disables persistent seek indexes)
+		std::string PATH_SEEK_INDEX = "";
+
+		/// Max number of frames decoded ahead by each FFmpegReader on a background thread (0 = disabled)
+		int FFMPEG_PREFETCH_FRAMES = 0;
+
+		/// Max number of frames queued in each FFmpegWriter's encoding pipeline, which converts and encodes frames on background threads (0 = disabled)
+		int FFMPEG_WRITER_PIPELINE_FRAMES = 0;
+
+		/// Number of background threads each CacheDisk uses to encode and write frames (0 = write frames in Add)
+		int CACHE_DISK_WRITE_THREADS = 0;
+
+		/// Max memory (in MB) held by frames waiting to be written by CacheDisk writer threads
+		int CACHE_DISK_MAX_PENDING_MB = 256;
+
+		/// Max memory (in MB) of all memory caches combined, enforced by the CacheManager (0 = no limit)
+		int CACHE_MAX_MEMORY_MB = 0;
+
+		/// Eviction policy of new memory caches (0 = least recently used, 1 = Greedy-Dual-Size, which keeps frames with a high render time per byte longer)
+		int CACHE_EVICTION_POLICY = 0;
+
+		/// Count cache statistics (hits, misses, inserts, evictions, and lock wait time, see CacheBase::GetStats)
+		bool ENABLE_CACHE_STATS = false;
+
+		/// Folder of the persistent (cross-session) cache of rendered timeline frames (an empty path disables it)
+		std::string PATH_RENDER_CACHE = "";
+
+		/// Max size (in MB) of the persistent render cache folder. The least recently used frames are removed (0 = no limit).
+		int RENDER_CACHE_MAX_MB = 4096;
+
  		/// Whether to dump ZeroMQ debug messages to stderr
 		bool DEBUG_TO_STDERR = false;
 
@@ -17,7 +17,14 @@
 #include "CacheMemory.h"
 #include "CrashHandler.h"
 #include "FrameMapper.h"
+#include "FrameStream.h"
 #include "Exceptions.h"
+#include "RenderCache.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
 
 #include <QDir>
 #include <QFileInfo>
@@ -27,7 +34,8 @@ using namespace openshot;
 // Default Constructor for the timeline (which sets the canvas width and height)
 Timeline::Timeline(int width, int height, Fraction fps, int sample_rate, int channels, ChannelLayout channel_layout) :
 		is_open(false), auto_map_clips(true), managed_cache(true), path(""),
-		max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), max_time(0.0)
+		max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), max_time(0.0),
+		concurrent_rendering(false), renders_in_flight(0), has_audio_dirty_frames(false)
 {
 	// Create CrashHandler and Attach (incase of errors)
 	CrashHandler::Instance();
@@ -68,6 +76,7 @@ Timeline::Timeline(int width, int height, Fraction fps, int sample_rate, int cha
 	// Init cache
 	final_cache = new CacheMemory();
 	final_cache->SetMaxBytesFromInfo(max_concurrent_frames * 4, info.width, info.height, info.sample_rate, info.channels);
+	final_cache->SetLevel(CACHE_LEVEL_TIMELINE);
 }
 
 // Delegating constructor that copies parameters from a provided ReaderInfo
@@ -78,7 +87,8 @@ Timeline::Timeline(const ReaderInfo info) : Timeline::Timeline(
 // Constructor for the timeline (which loads a JSON structure from a file path, and initializes a timeline)
 Timeline::Timeline(const std::string& projectPath, bool convert_absolute_paths) :
 		is_open(false), auto_map_clips(true), managed_cache(true), path(projectPath),
-		max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), max_time(0.0) {
+		max_concurrent_frames(OPEN_MP_NUM_PROCESSORS), max_time(0.0),
+		concurrent_rendering(false), renders_in_flight(0), has_audio_dirty_frames(false) {
 
 	// Create CrashHandler and Attach (incase of errors)
 	CrashHandler::Instance();
@@ -201,6 +211,7 @@ Timeline::Timeline(const std::string& projectPath, bool convert_absolute_paths)
 	// Init cache
 	final_cache = new CacheMemory();
 	final_cache->SetMaxBytesFromInfo(max_concurrent_frames * 4, info.width, info.height, info.sample_rate, info.channels);
+	final_cache->SetLevel(CACHE_LEVEL_TIMELINE);
 }
 
 Timeline::~Timeline() {
@@ -333,6 +344,7 @@ void Timeline::AddClip(Clip* clip)
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	// Assign timeline to clip
 	clip->ParentTimeline(this);
@@ -347,8 +359,9 @@ void Timeline::AddClip(Clip* clip)
 		apply_mapper_to_clip(clip);
 	}
 
-	// Add clip to list
+	// Add clip to list (and index)
 	clips.push_back(clip);
+	clip_index.Add(clip);
 
 	// Sort clips
 	sort_clips();
@@ -357,6 +370,10 @@ void Timeline::AddClip(Clip* clip)
 // Add an effect to the timeline
 void Timeline::AddEffect(EffectBase* effect)
 {
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
+
 	// Assign timeline to effect
 	effect->ParentTimeline(this);
 
@@ -370,7 +387,15 @@ void Timeline::AddEffect(EffectBase* effect)
 // Remove an effect from the timeline
 void Timeline::RemoveEffect(EffectBase* effect)
 {
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
+
 	effects.remove(effect);
+	{
+		const std::lock_guard<std::mutex> lock(clipKeysMutex);
+		clip_keys.erase(effect);
+	}
 
 	// Delete effect object (if timeline allocated it)
 	bool allocated = allocated_effects.count(effect);
@@ -389,9 +414,15 @@ void Timeline::RemoveClip(Clip* clip)
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	clips.remove(clip);
-	
+	clip_index.Remove(clip);
+	{
+		const std::lock_guard<std::mutex> lock(clipKeysMutex);
+		clip_keys.erase(clip);
+	}
+
 	// Delete clip object (if timeline allocated it)
 	bool allocated = allocated_clips.count(clip);
 	if (allocated) {
@@ -485,6 +516,133 @@ int64_t Timeline::GetMinFrame() {
 	return std::round(min_time * fps);
 }
 
+// Get the ranges of frames which only show a single unmodified clip
+std::vector<PassThroughRange> Timeline::GetPassThroughRanges(int64_t start, int64_t end)
+{
+	// Get lock (prevent clips from changing while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+
+	std::vector<PassThroughRange> ranges;
+	if (start > end)
+		return ranges;
+
+	// Get the visible range of a clip (or effect), using the same positions as composite_frame
+	double fps = info.fps.ToDouble();
+	auto visible_range = [fps](ClipBase* item) {
+		return std::make_pair(int64_t(round(item->Position() * fps)) + 1,
+							  int64_t(round((item->Position() + item->Duration()) * fps)));
+	};
+
+	std::vector<Clip*> nearby_clips = clip_index.Intersecting(start, end);
+	for (auto clip : nearby_clips) {
+		std::string source_path;
+		if (!is_pass_through_clip(clip, source_path))
+			continue;
+
+		// Limit the range of the clip to the requested frames
+		std::pair<int64_t, int64_t> clip_range = visible_range(clip);
+		std::vector<std::pair<int64_t, int64_t>> pieces = {
+			std::make_pair(std::max(start, clip_range.first), std::min(end, clip_range.second)) };
+
+		// Remove the frames of any other clip (on any layer), and of any timeline effect
+		std::vector<std::pair<int64_t, int64_t>> overlaps;
+		for (auto other_clip : nearby_clips)
+			if (other_clip != clip)
+				overlaps.push_back(visible_range(other_clip));
+		for (auto effect : effects)
+			overlaps.push_back(visible_range(effect));
+
+		for (const auto& overlap : overlaps) {
+			std::vector<std::pair<int64_t, int64_t>> remaining;
+			for (const auto& piece : pieces) {
+				if (overlap.second < piece.first || overlap.first > piece.second) {
+					remaining.push_back(piece);
+					continue;
+				}
+				if (piece.first < overlap.first)
+					remaining.push_back(std::make_pair(piece.first, overlap.first - 1));
+				if (overlap.second < piece.second)
+					remaining.push_back(std::make_pair(overlap.second + 1, piece.second));
+			}
+			pieces.swap(remaining);
+		}
+
+		// Convert the remaining frames into ranges of the source file
+		int64_t clip_start_frame = (clip->Start() * fps) + 1;
+		for (const auto& piece : pieces) {
+			if (piece.first > piece.second)
+				continue;
+			PassThroughRange range;
+			range.start = piece.first;
+			range.end = piece.second;
+			range.source_start = piece.first - clip_range.first + clip_start_frame;
+			range.path = source_path;
+			range.clip = clip;
+			ranges.push_back(range);
+		}
+	}
+
+	// Sort ranges by timeline position
+	std::sort(ranges.begin(), ranges.end(), [](const PassThroughRange& a, const PassThroughRange& b) {
+		return a.start < b.start;
+	});
+
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"Timeline::GetPassThroughRanges",
+		"start", start,
+		"end", end,
+		"nearby_clips.size()", nearby_clips.size(),
+		"ranges.size()", ranges.size());
+
+	return ranges;
+}
+
+// Does a clip show its source file unmodified, and get the path of the file
+bool Timeline::is_pass_through_clip(Clip* clip, std::string& source_path)
+{
+	// Find the file reader (which may be wrapped by a FrameMapper)
+	ReaderBase* reader = clip->Reader();
+	if (reader && reader->Name() == "FrameMapper")
+		reader = ((FrameMapper*) reader)->Reader();
+	if (!reader || reader->Name() != "FFmpegReader")
+		return false;
+
+	// The file must match the size and frame rate of the timeline
+	if (!reader->info.has_video || reader->info.has_single_image ||
+		reader->info.width != info.width || reader->info.height != info.height ||
+		reader->info.fps.num * info.fps.den != info.fps.num * reader->info.fps.den ||
+		reader->info.pixel_ratio.num * info.pixel_ratio.den != info.pixel_ratio.num * reader->info.pixel_ratio.den)
+		return false;
+
+	// No effects, waveforms, frame numbers, attached objects, or time mapping
+	if (!clip->Effects().empty() || clip->Waveform() || clip->display != FRAME_DISPLAY_NONE ||
+		clip->GetAttachedObject() || clip->GetAttachedClip() || clip->time.GetLength() > 1)
+		return false;
+
+	// All properties must be constant, with their default values
+	auto is_default = [this](const Keyframe& keyframe, double value) {
+		return keyframe.IsConstant() && isEqual(keyframe.GetValue(1), value);
+	};
+	if (!is_default(clip->scale_x, 1.0) || !is_default(clip->scale_y, 1.0) ||
+		!is_default(clip->location_x, 0.0) || !is_default(clip->location_y, 0.0) ||
+		!is_default(clip->alpha, 1.0) || !is_default(clip->rotation, 0.0) ||
+		!is_default(clip->shear_x, 0.0) || !is_default(clip->shear_y, 0.0) ||
+		!is_default(clip->volume, 1.0) || !is_default(clip->channel_filter, -1.0) ||
+		!is_default(clip->perspective_c1_x, -1.0) || !is_default(clip->perspective_c1_y, -1.0) ||
+		!is_default(clip->perspective_c2_x, -1.0) || !is_default(clip->perspective_c2_y, -1.0) ||
+		!is_default(clip->perspective_c3_x, -1.0) || !is_default(clip->perspective_c3_y, -1.0) ||
+		!is_default(clip->perspective_c4_x, -1.0) || !is_default(clip->perspective_c4_y, -1.0))
+		return false;
+
+	// The clip must show its video (and play its audio)
+	if (!clip->has_video.IsConstant() || clip->has_video.GetInt(1) == 0 ||
+		!clip->has_audio.IsConstant() || clip->has_audio.GetInt(1) == 0)
+		return false;
+
+	source_path = reader->JsonValue()["path"].asString();
+	return !source_path.empty();
+}
+
 // Apply a FrameMapper to a clip which matches the settings of this timeline
 void Timeline::apply_mapper_to_clip(Clip* clip)
 {
@@ -514,14 +672,34 @@ void Timeline::apply_mapper_to_clip(Clip* clip)
 // Apply the timeline's framerate and samplerate to all clips
 void Timeline::ApplyMapperToClips()
 {
-	// Clear all cached frames
-	ClearAllCache();
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	// Loop through all clips
+	bool mapping_changed = false;
 	for (auto clip : clips)
 	{
+		// Only clips with a different mapping are impacted (FrameMapper::ChangeMapping clears its own cache)
+		ReaderBase* clip_reader = clip->Reader();
+		if (clip_reader->Name() == "FrameMapper" &&
+			clip_reader->info.fps.num == info.fps.num && clip_reader->info.fps.den == info.fps.den &&
+			clip_reader->info.sample_rate == info.sample_rate && clip_reader->info.channels == info.channels &&
+			clip_reader->info.channel_layout == info.channel_layout)
+			continue;
+
 		// Apply framemapper (or update existing framemapper)
 		apply_mapper_to_clip(clip);
+
+		// Clear clip cache
+		clip->GetCache()->Clear();
+		mapping_changed = true;
+	}
+
+	// Clear all cached timeline frames
+	if (mapping_changed) {
+		final_cache->Clear();
+		clear_audio_dirty();
 	}
 }
 
@@ -573,8 +751,8 @@ std::shared_ptr<Frame> Timeline::apply_effects(std::shared_ptr<Frame> frame, int
 				"effect_frame_number", effect_frame_number,
 				"does_effect_intersect", does_effect_intersect);
 
-			// Apply the effect to this frame
-			frame = effect->GetFrame(frame, effect_frame_number);
+			// Apply the effect to this frame (one frame at a time, even with concurrent rendering)
+			frame = effect->ProcessFrame(frame, effect_frame_number);
 		}
 
 	} // end effect loop
@@ -584,8 +762,13 @@ std::shared_ptr<Frame> Timeline::apply_effects(std::shared_ptr<Frame> frame, int
 }
 
 // Get or generate a blank frame
-std::shared_ptr<Frame> Timeline::GetOrCreateFrame(std::shared_ptr<Frame> background_frame, Clip* clip, int64_t number, openshot::TimelineInfoStruct* options)
+std::shared_ptr<Frame> Timeline::GetOrCreateFrame(std::shared_ptr<Frame> background_frame, Clip* clip, int64_t number, bool is_top_clip)
 {
+	// Create timeline options (with details about this current frame request)
+	TimelineInfoStruct options;
+	options.is_top_clip = is_top_clip;
+	options.is_before_clip_keyframes = true;
+
 	std::shared_ptr<Frame> new_frame;
 
 	// Init some basic properties about this frame
@@ -599,7 +782,7 @@ std::shared_ptr<Frame> Timeline::GetOrCreateFrame(std::shared_ptr<Frame> backgro
 			"samples_in_frame", samples_in_frame);
 
 		// Attempt to get a frame (but this could fail if a reader has just been closed)
-		new_frame = std::shared_ptr<Frame>(clip->GetFrame(background_frame, number, options));
+		new_frame = std::shared_ptr<Frame>(clip->GetLayerFrame(background_frame, number, &options));
 
 		// Return real frame
 		return new_frame;
@@ -621,22 +804,16 @@ std::shared_ptr<Frame> Timeline::GetOrCreateFrame(std::shared_ptr<Frame> backgro
 }
 
 // Process a new layer of video or audio
-void Timeline::add_layer(std::shared_ptr<Frame> new_frame, Clip* source_clip, int64_t clip_frame_number, bool is_top_clip, float max_volume)
+void Timeline::add_layer(std::shared_ptr<Frame> new_frame, Clip* source_clip, std::shared_ptr<Frame> source_frame, int64_t clip_frame_number, float max_volume, bool mix_image)
 {
-	// Create timeline options (with details about this current frame request)
-	TimelineInfoStruct* options = new TimelineInfoStruct();
-	options->is_top_clip = is_top_clip;
-	options->is_before_clip_keyframes = true;
-
-	// Get the clip's frame, composited on top of the current timeline frame
-	std::shared_ptr<Frame> source_frame;
-	source_frame = GetOrCreateFrame(new_frame, source_clip, clip_frame_number, options);
-	delete options;
-
 	// No frame found... so bail
 	if (!source_frame)
 		return;
 
+	// Composite the clip's frame on top of the current timeline frame
+	if (mix_image)
+		source_clip->FlattenLayer(source_frame, new_frame);
+
 	// Debug output
 	ZmqLogger::Instance()->AppendDebugMethod(
 		"Timeline::add_layer",
@@ -686,10 +863,6 @@ void Timeline::add_layer(std::shared_ptr<Frame> new_frame, Clip* source_clip, in
 				if (channel_mapping == -1)
 					channel_mapping = channel;
 
-				// Apply ramp to source frame (if needed)
-				if (!isEqual(previous_volume, 1.0) || !isEqual(volume, 1.0))
-					source_frame->ApplyGainRamp(channel_mapping, 0, source_frame->GetAudioSamplesCount(), previous_volume, volume);
-
 				// TODO: Improve FrameMapper (or Timeline) to always get the correct number of samples per frame.
 				// Currently, the ResampleContext sometimes leaves behind a few samples for the next call, and the
 				// number of samples returned is variable... and does not match the number expected.
@@ -700,7 +873,22 @@ void Timeline::add_layer(std::shared_ptr<Frame> new_frame, Clip* source_clip, in
 				}
 				// Copy audio samples (and set initial volume).  Mix samples with existing audio samples.  The gains are added together, to
 				// be sure to set the gain's correctly, so the sum does not exceed 1.0 (of audio distortion will happen).
-				new_frame->AddAudio(false, channel_mapping, 0, source_frame->GetAudioSamples(channel), source_frame->GetAudioSamplesCount(), 1.0);
+				// The gain ramp is applied to a copy of the samples, since the source frame may be cached by the clip
+				// (and is mixed again if the volume changes).
+				int sample_count = source_frame->GetAudioSamplesCount();
+				const float* source_samples = source_frame->GetAudioSamples(channel);
+				if (!isEqual(previous_volume, 1.0) || !isEqual(volume, 1.0)) {
+					std::vector<float> ramp_samples(source_samples, source_samples + sample_count);
+					float gain = previous_volume;
+					const float gain_increment = (volume - previous_volume) / std::max(1, sample_count);
+					for (auto& sample : ramp_samples) {
+						sample *= gain;
+						gain += gain_increment;
+					}
+					new_frame->AddAudio(false, channel_mapping, 0, ramp_samples.data(), sample_count, 1.0);
+				} else {
+					new_frame->AddAudio(false, channel_mapping, 0, source_samples, sample_count, 1.0);
+				}
 			}
 		else
 			// Debug output
@@ -737,7 +925,15 @@ void Timeline::update_open_clips(Clip *clip, bool does_clip_intersect)
 	// is clip already in list?
 	bool clip_found = open_clips.count(clip);
 
-	if (clip_found && !does_clip_intersect)
+	// Concurrent renders (in progress) may still be using this clip, so don't close it yet. It
+	// stays in the 'opened' list, and is closed by a later call (once no render uses it).
+	bool clip_in_use = false;
+	if (concurrent_rendering) {
+		const std::lock_guard<std::mutex> render_lock(renderMutex);
+		clip_in_use = clips_in_use.count(clip) > 0;
+	}
+
+	if (clip_found && !does_clip_intersect && !clip_in_use)
 	{
 		// Remove clip from 'opened' list, because it's closed now
 		open_clips.erase(clip);
@@ -821,6 +1017,7 @@ void Timeline::sort_clips()
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	// Debug output
 	ZmqLogger::Instance()->AppendDebugMethod(
@@ -830,6 +1027,10 @@ void Timeline::sort_clips()
 	// sort clips
 	clips.sort(CompareClips());
 
+	// re-index clips (only layers with changed clips are rebuilt)
+	for (auto clip : clips)
+		clip_index.Update(clip);
+
 	// calculate max timeline duration
 	calculate_max_duration();
 }
@@ -839,6 +1040,7 @@ void Timeline::sort_effects()
 {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	// sort clips
 	effects.sort(CompareEffects());
@@ -854,6 +1056,7 @@ void Timeline::Clear()
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	// Close all open clips
 	for (auto clip : clips)
@@ -868,6 +1071,7 @@ void Timeline::Clear()
 	}
 	// Clear all clips
 	clips.clear();
+	clip_index.Clear();
 	allocated_clips.clear();
 
 	// Close all effects
@@ -882,6 +1086,7 @@ void Timeline::Clear()
 	// Clear all effects
 	effects.clear();
 	allocated_effects.clear();
+	clear_clip_keys();
 
 	// Delete all FrameMappers
 	for (auto mapper : allocated_frame_mappers)
@@ -900,6 +1105,7 @@ void Timeline::Close()
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
 
 	// Close all open clips
 	for (auto clip : clips)
@@ -937,7 +1143,7 @@ std::shared_ptr<Frame> Timeline::GetFrame(int64_t requested_frame)
 	// Check cache
 	std::shared_ptr<Frame> frame;
 	frame = final_cache->GetFrame(requested_frame);
-	if (frame) {
+	if (frame && !is_audio_dirty(requested_frame)) {
 		// Debug output
 		ZmqLogger::Instance()->AppendDebugMethod(
 			"Timeline::GetFrame (Cached frame found)",
@@ -946,15 +1152,22 @@ std::shared_ptr<Frame> Timeline::GetFrame(int64_t requested_frame)
 		// Return cached frame
 		return frame;
 	}
-	else
+
+	std::vector<Clip *> nearby_clips;
+	std::shared_ptr<Frame> cached_frame;
+	bool use_render_cache = false;
+	int width = 0;
+	int height = 0;
 	{
 		// Prevent async calls to the following code
 		const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
 
+		// Is the audio of this frame out of date (i.e. a volume change)
+		bool audio_dirty = take_audio_dirty(requested_frame);
+
 		// Check cache 2nd time
-		std::shared_ptr<Frame> frame;
 		frame = final_cache->GetFrame(requested_frame);
-		if (frame) {
+		if (frame && !audio_dirty) {
 			// Debug output
 			ZmqLogger::Instance()->AppendDebugMethod(
 					"Timeline::GetFrame (Cached frame found on 2nd check)",
@@ -962,175 +1175,447 @@ std::shared_ptr<Frame> Timeline::GetFrame(int64_t requested_frame)
 
 			// Return cached frame
 			return frame;
-		} else {
-			// Get a list of clips that intersect with the requested section of timeline
-			// This also opens the readers for intersecting clips, and marks non-intersecting clips as 'needs closing'
-			std::vector<Clip *> nearby_clips;
-			nearby_clips = find_intersecting_clips(requested_frame, 1, true);
-
-			// Debug output
+		}
+		if (frame) {
+			// Keep the cached image, and only mix the audio again
 			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (processing frame)",
-					"requested_frame", requested_frame,
-					"omp_get_thread_num()", omp_get_thread_num());
+					"Timeline::GetFrame (Cached frame needs audio)",
+					"requested_frame", requested_frame);
 
-			// Init some basic properties about this frame
-			int samples_in_frame = Frame::GetSamplesPerFrame(requested_frame, info.fps, info.sample_rate, info.channels);
+			cached_frame = frame;
+			final_cache->Remove(requested_frame);
+		}
 
-			// Create blank frame (which will become the requested frame)
-			std::shared_ptr<Frame> new_frame(std::make_shared<Frame>(requested_frame, preview_width, preview_height, "#000000", samples_in_frame, info.channels));
-			new_frame->AddAudioSilence(samples_in_frame);
-			new_frame->SampleRate(info.sample_rate);
-			new_frame->ChannelsLayout(info.channel_layout);
+		// Get a list of clips that intersect with the requested section of timeline
+		// This also opens the readers for intersecting clips, and marks non-intersecting clips as 'needs closing'
+		nearby_clips = find_intersecting_clips(requested_frame, 1, true);
 
-			// Debug output
-			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (Adding solid color)",
-					"requested_frame", requested_frame,
-					"info.width", info.width,
-					"info.height", info.height);
+		// Snapshot the canvas size
+		width = preview_width;
+		height = preview_height;
+
+		// Find this frame in the persistent render cache (if enabled)
+		use_render_cache = !cached_frame && !Settings::Instance()->PATH_RENDER_CACHE.empty();
+
+		if (!concurrent_rendering) {
+			// Composite while holding the lock (serial rendering)
+			std::shared_ptr<Frame> new_frame = render_frame(requested_frame, nearby_clips, width, height, cached_frame, use_render_cache);
+
+			// Add final frame to cache
+			final_cache->Add(new_frame);
+
+			// Return frame (or blank frame)
+			return new_frame;
+		}
+
+		// Register this render, so any changes to the timeline wait for it to finish (and
+		// its clips are not closed until it finishes)
+		const std::lock_guard<std::mutex> render_lock(renderMutex);
+		renders_in_flight++;
+		for (auto clip : nearby_clips)
+			clips_in_use[clip]++;
+	}
+
+	// Composite without holding the lock (concurrent rendering). The timeline
+	// cannot be modified until this render completes (see wait_for_renders).
+	std::shared_ptr<Frame> new_frame;
+	try {
+		new_frame = render_frame(requested_frame, nearby_clips, width, height, cached_frame, use_render_cache);
+
+		// Add final frame to cache
+		final_cache->Add(new_frame);
+
+	} catch (...) {
+		finish_render(nearby_clips);
+		throw;
+	}
+	finish_render(nearby_clips);
+
+	// Return frame (or blank frame)
+	return new_frame;
+}
+
+// Get a range of frames (in order) of this timeline, which are rendered ahead of the caller
+std::shared_ptr<FrameStream> Timeline::GetFrames(int64_t start, int64_t count)
+{
+	// Distinct frames are only rendered in parallel with concurrent rendering
+	int workers = 1;
+	{
+		const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+		if (concurrent_rendering)
+			workers = std::max(1, max_concurrent_frames);
+	}
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"Timeline::GetFrames",
+		"start", start,
+		"count", count,
+		"workers", workers);
+
+	return std::make_shared<FrameStream>([this](int64_t number) { return GetFrame(number); }, start, count, std::max(8, workers * 2), workers);
+}
+
+// Get the key of a frame in the persistent render cache
+std::string Timeline::render_cache_key(int64_t requested_frame, const std::vector<Clip*>& nearby_clips, int width, int height)
+{
+	// Output size and format
+	RenderCache key;
+	key.AddNumber(requested_frame);
+	key.AddNumber(width);
+	key.AddNumber(height);
+	key.AddNumber(info.fps.num);
+	key.AddNumber(info.fps.den);
+	key.AddNumber(info.sample_rate);
+	key.AddNumber(info.channels);
+	key.AddNumber(info.channel_layout);
+	key.AddNumber(Settings::Instance()->HIGH_QUALITY_SCALING);
+	key.AddJson(color.JsonValue(), requested_frame);
+
+	// Add a clip (and its effects and reader) to the key. The JSON of a clip includes its effects.
+	auto add_clip = [this, &key](Clip* clip, int64_t clip_frame_number) {
+		std::vector<int64_t> versions = { clip->Version() };
+		for (auto effect : clip->Effects())
+			versions.push_back(effect->Version());
+		std::shared_ptr<const ClipKey> cached_key = clip_key(clip, versions);
+		key.AddString(cached_key->key);
+		key.AddKeyframes(cached_key->keyframes, clip_frame_number);
+	};
+
+	// Intersecting clips
+	for (auto clip : nearby_clips) {
+		long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
+		long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble());
+		if (clip_start_position > requested_frame || clip_end_position < requested_frame)
+			continue;
+		long clip_start_frame = (clip->Start() * info.fps.ToDouble()) + 1;
+		long clip_frame_number = requested_frame - clip_start_position + clip_start_frame;
+		add_clip(clip, clip_frame_number);
+
+		// The clip or tracked object this clip is attached to (which may not intersect this frame). The
+		// keyframes of a tracked object are in the JSON of its effect, so the key adds the clip of the effect.
+		Clip* parent_clip = clip->GetParentClip();
+		std::shared_ptr<TrackedObjectBase> parent_object = clip->GetParentTrackedObject();
+		if (parent_object)
+			parent_clip = static_cast<Clip*>(parent_object->ParentClip());
+		if (parent_clip) {
+			// Same frame number as Clip::apply_keyframes
+			long parent_start_offset = parent_clip->Start() * clip->info.fps.ToDouble();
+			key.AddString(parent_object ? parent_object->Id() : parent_clip->Id());
+			add_clip(parent_clip, clip_frame_number + parent_start_offset);
+		}
+	}
+
+	// Intersecting timeline effects
+	for (auto effect : effects) {
+		long effect_start_position = round(effect->Position() * info.fps.ToDouble()) + 1;
+		long effect_end_position = round((effect->Position() + effect->Duration()) * info.fps.ToDouble());
+		if (effect_start_position > requested_frame || effect_end_position < requested_frame)
+			continue;
+		long effect_start_frame = (effect->Start() * info.fps.ToDouble()) + 1;
+		std::shared_ptr<const ClipKey> cached_key = clip_key(effect, { effect->Version() });
+		key.AddString(cached_key->key);
+		key.AddKeyframes(cached_key->keyframes, requested_frame - effect_start_position + effect_start_frame);
+	}
 
-			// Add Background Color to 1st layer (if animated or not black)
-			if ((color.red.GetCount() > 1 || color.green.GetCount() > 1 || color.blue.GetCount() > 1) ||
-				(color.red.GetValue(requested_frame) != 0.0 || color.green.GetValue(requested_frame) != 0.0 ||
-				 color.blue.GetValue(requested_frame) != 0.0))
-				new_frame->AddColor(preview_width, preview_height, color.GetColorHex(requested_frame));
+	return key.Key();
+}
+
+// Get the cached key of the JSON of a clip or effect (made again if the clip, its effects, or any keyframe changed)
+std::shared_ptr<const Timeline::ClipKey> Timeline::clip_key(ClipBase* clip, const std::vector<int64_t>& versions)
+{
+	// Read the keyframe edits before the JSON (so an edit while making the key makes it again next time)
+	int64_t keyframe_edits = Keyframe::Edits();
+	{
+		const std::lock_guard<std::mutex> lock(clipKeysMutex);
+		auto existing = clip_keys.find(clip);
+		if (existing != clip_keys.end() && existing->second->versions == versions && existing->second->keyframe_edits == keyframe_edits)
+			return existing->second;
+	}
+
+	// Make the key without holding the lock (concurrent renders make keys of other clips in parallel)
+	auto new_key = std::make_shared<ClipKey>();
+	new_key->versions = versions;
+	new_key->keyframe_edits = keyframe_edits;
+	new_key->key = RenderCache::TemplateKey(clip->JsonValue(), new_key->keyframes);
+
+	const std::lock_guard<std::mutex> lock(clipKeysMutex);
+	clip_keys[clip] = new_key;
+	return new_key;
+}
+
+// Discard the cached keys of clips and effects
+void Timeline::clear_clip_keys()
+{
+	const std::lock_guard<std::mutex> lock(clipKeysMutex);
+	clip_keys.clear();
+}
 
+// Load a frame from the persistent render cache, or composite it (and save it)
+std::shared_ptr<Frame> Timeline::render_frame(int64_t requested_frame, const std::vector<Clip*>& nearby_clips, int width, int height, std::shared_ptr<Frame> cached_frame, bool use_render_cache)
+{
+	// Measure the render time of this frame (used by cost-aware caches)
+	auto start_time = std::chrono::steady_clock::now();
+	auto elapsed = [&start_time]() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+	};
+
+	// Find this frame in the persistent render cache. With concurrent rendering, the key is made
+	// without holding getFrameMutex (the timeline can't change until this render completes).
+	std::string render_path;
+	if (use_render_cache)
+		render_path = RenderCache::FramePath(render_cache_key(requested_frame, nearby_clips, width, height));
+	if (!render_path.empty()) {
+		std::shared_ptr<Frame> stored_frame = RenderCache::Load(render_path, requested_frame);
+		if (stored_frame) {
 			// Debug output
 			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (Loop through clips)",
-					"requested_frame", requested_frame,
-					"clips.size()", clips.size(),
-					"nearby_clips.size()", nearby_clips.size());
-
-			// Find Clips near this time
-			for (auto clip : nearby_clips) {
-				long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
-				long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble());
-				bool does_clip_intersect = (clip_start_position <= requested_frame && clip_end_position >= requested_frame);
-
-				// Debug output
-				ZmqLogger::Instance()->AppendDebugMethod(
-						"Timeline::GetFrame (Does clip intersect)",
-						"requested_frame", requested_frame,
-						"clip->Position()", clip->Position(),
-						"clip->Duration()", clip->Duration(),
-						"does_clip_intersect", does_clip_intersect);
-
-				// Clip is visible
-				if (does_clip_intersect) {
-					// Determine if clip is "top" clip on this layer (only happens when multiple clips are overlapping)
-					bool is_top_clip = true;
-					float max_volume = 0.0;
-					for (auto nearby_clip : nearby_clips) {
-						long nearby_clip_start_position = round(nearby_clip->Position() * info.fps.ToDouble()) + 1;
-						long nearby_clip_end_position = round((nearby_clip->Position() + nearby_clip->Duration()) * info.fps.ToDouble()) + 1;
-						long nearby_clip_start_frame = (nearby_clip->Start() * info.fps.ToDouble()) + 1;
-						long nearby_clip_frame_number = requested_frame - nearby_clip_start_position + nearby_clip_start_frame;
-
-						// Determine if top clip
-						if (clip->Id() != nearby_clip->Id() && clip->Layer() == nearby_clip->Layer() &&
-							nearby_clip_start_position <= requested_frame && nearby_clip_end_position >= requested_frame &&
-							nearby_clip_start_position > clip_start_position && is_top_clip == true) {
-							is_top_clip = false;
-						}
-
-						// Determine max volume of overlapping clips
-						if (nearby_clip->Reader() && nearby_clip->Reader()->info.has_audio &&
-							nearby_clip->has_audio.GetInt(nearby_clip_frame_number) != 0 &&
-							nearby_clip_start_position <= requested_frame && nearby_clip_end_position >= requested_frame) {
-							max_volume += nearby_clip->volume.GetValue(nearby_clip_frame_number);
-						}
-					}
+					"Timeline::render_frame (Frame found in render cache)",
+					"requested_frame", requested_frame);
+			stored_frame->SetRenderTime(elapsed());
+			return stored_frame;
+		}
+	}
+
+	std::shared_ptr<Frame> new_frame = composite_frame(requested_frame, nearby_clips, width, height, cached_frame);
+	new_frame->SetRenderTime(elapsed());
+	if (!render_path.empty())
+		RenderCache::SaveAsync(render_path, new_frame);
+	return new_frame;
+}
+
+// Composite all intersecting clips into a new frame
+std::shared_ptr<Frame> Timeline::composite_frame(int64_t requested_frame, const std::vector<Clip*>& nearby_clips, int width, int height, std::shared_ptr<Frame> cached_frame)
+{
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+			"Timeline::composite_frame (processing frame)",
+			"requested_frame", requested_frame,
+			"omp_get_thread_num()", omp_get_thread_num());
 
-					// Determine the frame needed for this clip (based on the position on the timeline)
-					long clip_start_frame = (clip->Start() * info.fps.ToDouble()) + 1;
-					long clip_frame_number = requested_frame - clip_start_position + clip_start_frame;
+	// Init some basic properties about this frame
+	int samples_in_frame = Frame::GetSamplesPerFrame(requested_frame, info.fps, info.sample_rate, info.channels);
 
-					// Debug output
-					ZmqLogger::Instance()->AppendDebugMethod(
-							"Timeline::GetFrame (Calculate clip's frame #)",
-							"clip->Position()", clip->Position(),
-							"clip->Start()", clip->Start(),
-							"info.fps.ToFloat()", info.fps.ToFloat(),
-							"clip_frame_number", clip_frame_number);
+	// Create blank frame (which will become the requested frame)
+	std::shared_ptr<Frame> new_frame;
+	if (cached_frame) {
+		// Copy the cached image (only the audio is mixed again)
+		new_frame = std::make_shared<Frame>(*cached_frame);
+	} else {
+		new_frame = std::make_shared<Frame>(requested_frame, width, height, "#000000", samples_in_frame, info.channels);
+	}
+	new_frame->AddAudioSilence(samples_in_frame);
+	new_frame->SampleRate(info.sample_rate);
+	new_frame->ChannelsLayout(info.channel_layout);
 
-					// Add clip's frame as layer
-					add_layer(new_frame, clip, clip_frame_number, is_top_clip, max_volume);
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+			"Timeline::composite_frame (Adding solid color)",
+			"requested_frame", requested_frame,
+			"width", width,
+			"height", height,
+			"cached_frame", (bool) cached_frame);
 
-				} else {
-					// Debug output
-					ZmqLogger::Instance()->AppendDebugMethod(
-							"Timeline::GetFrame (clip does not intersect)",
-							"requested_frame", requested_frame,
-							"does_clip_intersect", does_clip_intersect);
-				}
+	// Add Background Color to 1st layer (if animated or not black)
+	if (!cached_frame &&
+		((color.red.GetCount() > 1 || color.green.GetCount() > 1 || color.blue.GetCount() > 1) ||
+		 (color.red.GetValue(requested_frame) != 0.0 || color.green.GetValue(requested_frame) != 0.0 ||
+		  color.blue.GetValue(requested_frame) != 0.0)))
+		new_frame->AddColor(width, height, color.GetColorHex(requested_frame));
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+			"Timeline::composite_frame (Loop through clips)",
+			"requested_frame", requested_frame,
+			"clips.size()", clips.size(),
+			"nearby_clips.size()", nearby_clips.size());
+
+	// Calculate the top clip of each layer, and the combined volume of all overlapping clips
+	// (once per frame, since this is the same for every clip)
+	std::map<int, long> top_clip_positions;
+	float max_volume = 0.0;
+	for (auto nearby_clip : nearby_clips) {
+		long nearby_clip_start_position = round(nearby_clip->Position() * info.fps.ToDouble()) + 1;
+		long nearby_clip_end_position = round((nearby_clip->Position() + nearby_clip->Duration()) * info.fps.ToDouble()) + 1;
+		if (nearby_clip_start_position > requested_frame || nearby_clip_end_position < requested_frame)
+			continue;
+
+		// Track the latest starting clip on each layer (which is on top)
+		auto top_position = top_clip_positions.find(nearby_clip->Layer());
+		if (top_position == top_clip_positions.end())
+			top_clip_positions[nearby_clip->Layer()] = nearby_clip_start_position;
+		else if (nearby_clip_start_position > top_position->second)
+			top_position->second = nearby_clip_start_position;
+
+		// Determine max volume of overlapping clips
+		long nearby_clip_start_frame = (nearby_clip->Start() * info.fps.ToDouble()) + 1;
+		long nearby_clip_frame_number = requested_frame - nearby_clip_start_position + nearby_clip_start_frame;
+		if (nearby_clip->Reader() && nearby_clip->Reader()->info.has_audio &&
+			nearby_clip->has_audio.GetInt(nearby_clip_frame_number) != 0) {
+			max_volume += nearby_clip->volume.GetValue(nearby_clip_frame_number);
+		}
+	}
+
+	// Find Clips near this time
+	std::vector<TimelineLayer> layers;
+	for (auto clip : nearby_clips) {
+		long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
+		long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble());
+		bool does_clip_intersect = (clip_start_position <= requested_frame && clip_end_position >= requested_frame);
 
-			} // end clip loop
+		// Debug output
+		ZmqLogger::Instance()->AppendDebugMethod(
+				"Timeline::composite_frame (Does clip intersect)",
+				"requested_frame", requested_frame,
+				"clip->Position()", clip->Position(),
+				"clip->Duration()", clip->Duration(),
+				"does_clip_intersect", does_clip_intersect);
+
+		// Clip is visible
+		if (does_clip_intersect) {
+			TimelineLayer layer;
+			layer.clip = clip;
+
+			// Determine if clip is "top" clip on this layer (only happens when multiple clips are overlapping)
+			layer.is_top_clip = clip_start_position >= top_clip_positions[clip->Layer()];
+
+			// Determine the frame needed for this clip (based on the position on the timeline)
+			long clip_start_frame = (clip->Start() * info.fps.ToDouble()) + 1;
+			layer.clip_frame_number = requested_frame - clip_start_position + clip_start_frame;
 
 			// Debug output
 			ZmqLogger::Instance()->AppendDebugMethod(
-					"Timeline::GetFrame (Add frame to cache)",
+					"Timeline::composite_frame (Calculate clip's frame #)",
+					"clip->Position()", clip->Position(),
+					"clip->Start()", clip->Start(),
+					"info.fps.ToFloat()", info.fps.ToFloat(),
+					"clip_frame_number", layer.clip_frame_number);
+
+			layers.push_back(layer);
+
+		} else {
+			// Debug output
+			ZmqLogger::Instance()->AppendDebugMethod(
+					"Timeline::composite_frame (clip does not intersect)",
 					"requested_frame", requested_frame,
-					"info.width", info.width,
-					"info.height", info.height);
+					"does_clip_intersect", does_clip_intersect);
+		}
 
-			// Set frame # on mapped frame
-			new_frame->SetFrameNumber(requested_frame);
+	} // end clip loop
 
-			// Add final frame to cache
-			final_cache->Add(new_frame);
+	// Phase 1: Get the frame of each visible clip (decode, time mapping, effects, and keyframes).
+	// Each clip has its own reader, so these are processed concurrently.
+	std::exception_ptr layer_exception;
+	const int layer_count = layers.size();
+	#pragma omp parallel for schedule(dynamic) num_threads(std::max(1, std::min(layer_count, OPEN_MP_NUM_PROCESSORS))) if (layer_count > 1)
+	for (int layer_index = 0; layer_index < layer_count; layer_index++) {
+		TimelineLayer& layer = layers[layer_index];
+		try {
+			layer.frame = GetOrCreateFrame(new_frame, layer.clip, layer.clip_frame_number, layer.is_top_clip);
+		} catch (...) {
+			#pragma omp critical (timeline_layer_exception)
+			layer_exception = std::current_exception();
+		}
+	}
+	if (layer_exception)
+		std::rethrow_exception(layer_exception);
 
-			// Return frame (or blank frame)
-			return new_frame;
+	// Phase 2: Composite each clip's frame (in layer order)
+	for (auto& layer : layers) {
+		// Add clip's frame as layer
+		add_layer(new_frame, layer.clip, layer.frame, layer.clip_frame_number, max_volume, !cached_frame);
+	}
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+			"Timeline::composite_frame (Finished compositing)",
+			"requested_frame", requested_frame,
+			"width", width,
+			"height", height);
+
+	// Set frame # on mapped frame
+	new_frame->SetFrameNumber(requested_frame);
+
+	return new_frame;
+}
+
+// Mark a concurrent render (of the nearby clips) as completed
+void Timeline::finish_render(const std::vector<Clip*>& nearby_clips)
+{
+	{
+		const std::lock_guard<std::mutex> render_lock(renderMutex);
+		renders_in_flight--;
+		for (auto clip : nearby_clips) {
+			auto in_use = clips_in_use.find(clip);
+			if (in_use != clips_in_use.end() && --in_use->second <= 0)
+				clips_in_use.erase(in_use);
 		}
 	}
+	renderCondition.notify_all();
+}
+
+// Block until all in-flight concurrent renders have completed
+void Timeline::wait_for_renders()
+{
+	std::unique_lock<std::mutex> render_lock(renderMutex);
+	renderCondition.wait(render_lock, [this] { return renders_in_flight == 0; });
+}
+
+// Enable or disable concurrent rendering of distinct frames
+void Timeline::ConcurrentRendering(bool value)
+{
+	// Get lock (prevent getting frames while this happens)
+	const std::lock_guard<std::recursive_mutex> guard(getFrameMutex);
+	wait_for_renders();
+
+	concurrent_rendering = value;
 }
 
 
 // Find intersecting clips (or non intersecting clips)
 std::vector<Clip*> Timeline::find_intersecting_clips(int64_t requested_frame, int number_of_frames, bool include)
 {
-	// Find matching clips
-	std::vector<Clip*> matching_clips;
-
 	// Calculate time of frame
-	float min_requested_frame = requested_frame;
-	float max_requested_frame = requested_frame + (number_of_frames - 1);
+	int64_t min_requested_frame = requested_frame;
+	int64_t max_requested_frame = requested_frame + (number_of_frames - 1);
 
-	// Find Clips at this time
-	for (auto clip : clips)
-	{
-		// Does clip intersect the current requested time
-		long clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
-		long clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble()) + 1;
+	// Find Clips at this time (using the interval index)
+	clip_index.FPS(info.fps);
+	std::vector<Clip*> intersecting_clips = clip_index.Intersecting(min_requested_frame, max_requested_frame);
+	std::set<Clip*> intersecting_set(intersecting_clips.begin(), intersecting_clips.end());
 
-		bool does_clip_intersect =
-				(clip_start_position <= min_requested_frame || clip_start_position <= max_requested_frame) &&
-				(clip_end_position >= min_requested_frame || clip_end_position >= max_requested_frame);
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"Timeline::find_intersecting_clips",
+		"requested_frame", requested_frame,
+		"min_requested_frame", min_requested_frame,
+		"max_requested_frame", max_requested_frame,
+		"intersecting_clips.size()", intersecting_clips.size(),
+		"open_clips.size()", open_clips.size());
 
-		// Debug output
-		ZmqLogger::Instance()->AppendDebugMethod(
-			"Timeline::find_intersecting_clips (Is clip near or intersecting)",
-			"requested_frame", requested_frame,
-			"min_requested_frame", min_requested_frame,
-			"max_requested_frame", max_requested_frame,
-			"clip->Position()", clip->Position(),
-			"does_clip_intersect", does_clip_intersect);
+	// Close any opened clips which no longer intersect
+	std::vector<Clip*> opened_clips;
+	for (const auto& open_clip : open_clips)
+		opened_clips.push_back(open_clip.first);
+	for (auto clip : opened_clips) {
+		if (!intersecting_set.count(clip))
+			update_open_clips(clip, false);
+	}
 
-		// Open (or schedule for closing) this clip, based on if it's intersecting or not
-		update_open_clips(clip, does_clip_intersect);
+	// Open intersecting clips
+	for (auto clip : intersecting_clips)
+		update_open_clips(clip, true);
 
-		// Clip is visible
-		if (does_clip_intersect && include)
-			// Add the intersecting clip
-			matching_clips.push_back(clip);
+	if (include)
+		// Return the intersecting clips
+		return intersecting_clips;
 
-		else if (!does_clip_intersect && !include)
-			// Add the non-intersecting clip
+	// Find the non-intersecting clips
+	std::vector<Clip*> matching_clips;
+	for (auto clip : clips) {
+		if (!intersecting_set.count(clip))
 			matching_clips.push_back(clip);
-
-	} // end clip loop
+	}
 
 	// return list
 	return matching_clips;
@@ -1140,6 +1625,7 @@ std::vector<Clip*> Timeline::find_intersecting_clips(int64_t requested_frame, in
 void Timeline::SetCache(CacheBase* new_cache) {
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_renders();
 
 	// Destroy previous cache (if managed by timeline)
 	if (managed_cache && final_cache) {
@@ -1148,8 +1634,87 @@ void Timeline::SetCache(CacheBase* new_cache) {
 		managed_cache = false;
 	}
 
-	// Set new cache
+	// Set new cache (timeline frames are kept longest, when over the global memory limit)
 	final_cache = new_cache;
+	if (final_cache)
+		final_cache->SetLevel(CACHE_LEVEL_TIMELINE);
+	clear_audio_dirty();
+}
+
+// Get the caches of a clip (and of its readers)
+static std::vector<CacheBase*> clip_caches(Clip* clip)
+{
+	std::vector<CacheBase*> caches = { clip->GetCache() };
+	try {
+		ReaderBase* reader = clip->Reader();
+		while (reader) {
+			if (reader->GetCache())
+				caches.push_back(reader->GetCache());
+
+			// Follow the reader of a FrameMapper
+			FrameMapper* mapper = dynamic_cast<FrameMapper*>(reader);
+			reader = mapper ? mapper->Reader() : NULL;
+		}
+	} catch (const ReaderClosed& e) {
+		// No reader
+	}
+	return caches;
+}
+
+// Get the statistics of the timeline cache, and of the caches of all clips (and their readers)
+Json::Value Timeline::CacheStats() {
+	// Get lock (prevent clips from being added or removed)
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+
+	Json::Value root;
+	Json::Value totals;
+	const char* level_names[] = { "unmanaged", "reader", "mapper", "clip", "timeline" };
+
+	// Add the statistics of a cache to the totals of its level
+	auto add_totals = [&](const Json::Value& stats) {
+		Json::Value& level = totals[level_names[stats["level"].asInt()]];
+		for (const char* name : { "hits", "misses", "inserts", "evictions", "evicted_bytes" }) {
+			int64_t total = level[name].isNull() ? 0 : std::stoll(level[name].asString());
+			level[name] = std::to_string(total + std::stoll(stats[name].asString()));
+		}
+		level["lock_wait_ms"] = level["lock_wait_ms"].asDouble() + stats["lock_wait_ms"].asDouble();
+		int64_t hits = std::stoll(level["hits"].asString());
+		int64_t misses = std::stoll(level["misses"].asString());
+		level["hit_rate"] = (hits + misses > 0) ? double(hits) / (hits + misses) : 0.0;
+	};
+
+	if (final_cache) {
+		root["timeline"] = final_cache->GetStats();
+		add_totals(root["timeline"]);
+	}
+
+	root["clips"] = Json::Value(Json::arrayValue);
+	for (Clip* clip : clips) {
+		Json::Value clip_stats;
+		clip_stats["id"] = clip->Id();
+		clip_stats["caches"] = Json::Value(Json::arrayValue);
+		for (CacheBase* cache : clip_caches(clip)) {
+			Json::Value stats = cache->GetStats();
+			clip_stats["caches"].append(stats);
+			add_totals(stats);
+		}
+		root["clips"].append(clip_stats);
+	}
+	root["totals"] = totals;
+
+	return root;
+}
+
+// Reset the statistics of the timeline cache, and of the caches of all clips (and their readers)
+void Timeline::ResetCacheStats() {
+	// Get lock (prevent clips from being added or removed)
+	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+
+	if (final_cache)
+		final_cache->ResetStats();
+	for (Clip* clip : clips)
+		for (CacheBase* cache : clip_caches(clip))
+			cache->ResetStats();
 }
 
 // Generate JSON string of this object
@@ -1218,6 +1783,7 @@ void Timeline::SetJsonValue(const Json::Value root) {
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_renders();
 
 	// Close timeline before we do anything (this closes all clips)
 	bool was_open = is_open;
@@ -1233,6 +1799,7 @@ void Timeline::SetJsonValue(const Json::Value root) {
 	if (!root["clips"].isNull()) {
 		// Clear existing clips
 		clips.clear();
+		clip_index.Clear();
 
 		// loop through clips
 		for (const Json::Value existing_clip : root["clips"]) {
@@ -1317,6 +1884,7 @@ void Timeline::ApplyJsonDiff(std::string value) {
 
 	// Get lock (prevent getting frames while this happens)
 	const std::lock_guard<std::recursive_mutex> lock(getFrameMutex);
+	wait_for_renders();
 
 	// Parse JSON string into JSON objects
 	try
@@ -1397,13 +1965,8 @@ void Timeline::apply_json_to_clips(Json::Value change) {
 				for (auto e : effect_list)
 				{
 					if (e->Id() == effect_id) {
-						// Apply the change to the effect directly
-						apply_json_to_effects(change, e);
-
-						// Calculate start and end frames that this impacts, and remove those frames from the cache
-						int64_t new_starting_frame = (existing_clip->Position() * info.fps.ToDouble()) + 1;
-						int64_t new_ending_frame = ((existing_clip->Position() + existing_clip->Duration()) * info.fps.ToDouble()) + 1;
-						final_cache->Remove(new_starting_frame - 8, new_ending_frame + 8);
+						// Apply the change to the effect directly (and remove the impacted frames from the cache)
+						apply_json_to_effects(change, e, existing_clip);
 
 						return; // effect found, don't update clip
 					}
@@ -1413,7 +1976,8 @@ void Timeline::apply_json_to_clips(Json::Value change) {
 	}
 
 	// Calculate start and end frames that this impacts, and remove those frames from the cache
-	if (!change["value"].isArray() && !change["value"]["position"].isNull()) {
+	// (updates only remove the frames which actually change, see below)
+	if (change_type != "update" && !change["value"].isArray() && !change["value"]["position"].isNull()) {
 		int64_t new_starting_frame = (change["value"]["position"].asDouble() * info.fps.ToDouble()) + 1;
 		int64_t new_ending_frame = ((change["value"]["position"].asDouble() + change["value"]["end"].asDouble() - change["value"]["start"].asDouble()) * info.fps.ToDouble()) + 1;
 		final_cache->Remove(new_starting_frame - 8, new_ending_frame + 8);
@@ -1439,17 +2003,47 @@ void Timeline::apply_json_to_clips(Json::Value change) {
 		// Update existing clip
 		if (existing_clip) {
 
-			// Calculate start and end frames that this impacts, and remove those frames from the cache
-			int64_t old_starting_frame = (existing_clip->Position() * info.fps.ToDouble()) + 1;
-			int64_t old_ending_frame = ((existing_clip->Position() + existing_clip->Duration()) * info.fps.ToDouble()) + 1;
-			final_cache->Remove(old_starting_frame - 8, old_ending_frame + 8);
+			// Find the changed properties, and the range of frames they impact
+			int64_t first_frame = 0;
+			int64_t last_frame = 0;
+			bool audio_only = false;
+			Json::Value changes;
+			bool narrowed = json_changed_range(existing_clip->JsonValue(), change["value"], true, first_frame, last_frame, audio_only, changes);
 
-			// Remove cache on clip's Reader (if found)
-			if (existing_clip->Reader() && existing_clip->Reader()->GetCache())
-				existing_clip->Reader()->GetCache()->Remove(old_starting_frame - 8, old_ending_frame + 8);
+			if (narrowed) {
+				// Only remove the changed frames from the cache (the clip's reader is not impacted)
+				invalidate_frames(existing_clip, first_frame, last_frame, audio_only);
 
-			// Update clip properties from JSON
-			existing_clip->SetJsonValue(change["value"]);
+			} else {
+				// Calculate start and end frames that this impacts, and remove those frames from the cache
+				int64_t old_starting_frame = (existing_clip->Position() * info.fps.ToDouble()) + 1;
+				int64_t old_ending_frame = ((existing_clip->Position() + existing_clip->Duration()) * info.fps.ToDouble()) + 1;
+				final_cache->Remove(old_starting_frame - 8, old_ending_frame + 8);
+
+				// Remove cache on clip's Reader (if found)
+				if (existing_clip->Reader() && existing_clip->Reader()->GetCache())
+					existing_clip->Reader()->GetCache()->Remove(old_starting_frame - 8, old_ending_frame + 8);
+
+				// Remove the new position of the clip from the cache
+				if (!change["value"]["position"].isNull()) {
+					int64_t new_starting_frame = (change["value"]["position"].asDouble() * info.fps.ToDouble()) + 1;
+					int64_t new_ending_frame = ((change["value"]["position"].asDouble() + change["value"]["end"].asDouble() - change["value"]["start"].asDouble()) * info.fps.ToDouble()) + 1;
+					final_cache->Remove(new_starting_frame - 8, new_ending_frame + 8);
+				}
+			}
+
+			// Clips attached to this clip (i.e. using its keyframes) are also impacted
+			if (!narrowed || first_frame <= last_frame) {
+				for (auto clip : clips) {
+					if (clip != existing_clip && clip->GetAttachedId() == existing_clip->Id())
+						invalidate_frames(clip, 1, INT64_MAX, false);
+				}
+			}
+
+			// Update clip properties from JSON (and re-index clip). Only the changed properties are set, so an
+			// unchanged reader (and its cache) or unchanged effects are not re-created.
+			existing_clip->SetJsonValue(changes);
+			clip_index.Update(existing_clip);
 
 			// Apply framemapper (or update existing framemapper)
 			if (auto_map_clips) {
@@ -1515,13 +2109,14 @@ void Timeline::apply_json_to_effects(Json::Value change) {
 }
 
 // Apply JSON diff to effects (if you already know which effect needs to be updated)
-void Timeline::apply_json_to_effects(Json::Value change, EffectBase* existing_effect) {
+void Timeline::apply_json_to_effects(Json::Value change, EffectBase* existing_effect, Clip* parent_clip) {
 
 	// Get key and type of change
 	std::string change_type = change["type"].asString();
 
 	// Calculate start and end frames that this impacts, and remove those frames from the cache
-	if (!change["value"].isArray() && !change["value"]["position"].isNull()) {
+	// (updates only remove the frames which actually change, see below)
+	if (change_type != "update" && !change["value"].isArray() && !change["value"]["position"].isNull()) {
 		int64_t new_starting_frame = (change["value"]["position"].asDouble() * info.fps.ToDouble()) + 1;
 		int64_t new_ending_frame = ((change["value"]["position"].asDouble() + change["value"]["end"].asDouble() - change["value"]["start"].asDouble()) * info.fps.ToDouble()) + 1;
 		final_cache->Remove(new_starting_frame - 8, new_ending_frame + 8);
@@ -1554,15 +2149,53 @@ void Timeline::apply_json_to_effects(Json::Value change, EffectBase* existing_ef
 		// Update existing effect
 		if (existing_effect) {
 
-			// Calculate start and end frames that this impacts, and remove those frames from the cache
-			int64_t old_starting_frame = (existing_effect->Position() * info.fps.ToDouble()) + 1;
-			int64_t old_ending_frame = ((existing_effect->Position() + existing_effect->Duration()) * info.fps.ToDouble()) + 1;
-			final_cache->Remove(old_starting_frame - 8, old_ending_frame + 8);
+			// Find the changed properties, and the range of frames they impact
+			int64_t first_frame = 0;
+			int64_t last_frame = 0;
+			bool audio_only = false;
+			Json::Value changes;
+			bool narrowed = json_changed_range(existing_effect->JsonValue(), change["value"], false, first_frame, last_frame, audio_only, changes);
+
+			// Linked effects (which copy the properties of this effect) are also updated
+			bool has_linked_effects = false;
+			for (auto effect : ClipEffects()) {
+				if (effect != existing_effect && effect->info.parent_effect_id == existing_effect->Id())
+					has_linked_effects = true;
+			}
 
-			// Update effect properties from JSON
-			existing_effect->SetJsonValue(change["value"]);
-		}
+			if (has_linked_effects) {
+				// Linked effects can be on any clip, so clear the entire cache
+				final_cache->Clear();
 
+			} else if (parent_clip) {
+				// Effects on a clip use the clip's frame numbers (and position)
+				if (!narrowed) {
+					first_frame = 1;
+					last_frame = INT64_MAX;
+				}
+				invalidate_frames(parent_clip, first_frame, last_frame, false);
+
+			} else if (narrowed) {
+				// Only remove the changed frames from the cache
+				invalidate_frames(existing_effect, first_frame, last_frame, false);
+
+			} else {
+				// Calculate start and end frames that this impacts, and remove those frames from the cache
+				int64_t old_starting_frame = (existing_effect->Position() * info.fps.ToDouble()) + 1;
+				int64_t old_ending_frame = ((existing_effect->Position() + existing_effect->Duration()) * info.fps.ToDouble()) + 1;
+				final_cache->Remove(old_starting_frame - 8, old_ending_frame + 8);
+
+				// Remove the new position of the effect from the cache
+				if (!change["value"]["position"].isNull()) {
+					int64_t new_starting_frame = (change["value"]["position"].asDouble() * info.fps.ToDouble()) + 1;
+					int64_t new_ending_frame = ((change["value"]["position"].asDouble() + change["value"]["end"].asDouble() - change["value"]["start"].asDouble()) * info.fps.ToDouble()) + 1;
+					final_cache->Remove(new_starting_frame - 8, new_ending_frame + 8);
+				}
+			}
+
+			// Update effect properties from JSON (only the changed properties)
+			existing_effect->SetJsonValue(changes);
+		}
 	} else if (change_type == "delete") {
 
 		// Remove existing effect
@@ -1579,6 +2212,10 @@ void Timeline::apply_json_to_effects(Json::Value change, EffectBase* existing_ef
 
 	}
 
+	// Inserted or deleted effects on a clip impact all frames of the clip
+	if (parent_clip && change_type != "update")
+		invalidate_frames(parent_clip, 1, INT64_MAX, false);
+
 	// Re-Sort Effects (since they likely changed)
 	sort_effects();
 }
@@ -1599,18 +2236,39 @@ void Timeline::apply_json_to_timeline(Json::Value change) {
 
 		// INSERT / UPDATE
 		// Check for valid property
-		if (root_key == "color")
+		if (root_key == "color") {
 			// Set color
+			Color previous_color = color;
 			color.SetJsonValue(change["value"]);
-		else if (root_key == "viewport_scale")
-			// Set viewport scale
+
+			// The background color is only added to the timeline frames, so
+			// only remove the frames with a different color from the cache
+			const std::vector<std::pair<const Keyframe*, const Keyframe*>> color_curves = {
+				{&previous_color.red, &color.red}, {&previous_color.green, &color.green},
+				{&previous_color.blue, &color.blue}, {&previous_color.alpha, &color.alpha}};
+			for (const auto& curves : color_curves) {
+				int64_t first_frame = 0;
+				int64_t last_frame = 0;
+				if (curves.first->ChangedRange(*curves.second, first_frame, last_frame))
+					final_cache->Remove(first_frame, last_frame);
+			}
+			cache_dirty = false;
+		}
+		else if (root_key == "viewport_scale") {
+			// Set viewport scale (not used for rendering, so the cache is not cleared)
 			viewport_scale.SetJsonValue(change["value"]);
-		else if (root_key == "viewport_x")
+			cache_dirty = false;
+		}
+		else if (root_key == "viewport_x") {
 			// Set viewport x offset
 			viewport_x.SetJsonValue(change["value"]);
-		else if (root_key == "viewport_y")
+			cache_dirty = false;
+		}
+		else if (root_key == "viewport_y") {
 			// Set viewport y offset
 			viewport_y.SetJsonValue(change["value"]);
+			cache_dirty = false;
+		}
 		else if (root_key == "duration") {
 			// Update duration of timeline
 			info.duration = change["value"].asDouble();
@@ -1711,6 +2369,262 @@ void Timeline::apply_json_to_timeline(Json::Value change) {
 	}
 }
 
+// Is a JSON value a keyframe (i.e. an object with a list of points)
+static bool is_keyframe_json(const Json::Value& value) {
+	return value.isObject() && value.isMember("Points") && value["Points"].isArray();
+}
+
+// Is a JSON value a color (i.e. an object which only contains keyframes)
+static bool is_color_json(const Json::Value& value) {
+	if (!value.isObject() || value.empty())
+		return false;
+	for (const auto& name : value.getMemberNames()) {
+		if (!is_keyframe_json(value[name]))
+			return false;
+	}
+	return true;
+}
+
+// Compare JSON values (numbers are compared by value, i.e. 1 is equal to 1.0)
+static bool is_json_equal(const Json::Value& a, const Json::Value& b) {
+	if (a.isNumeric() && b.isNumeric() && !a.isBool() && !b.isBool())
+		return a.asDouble() == b.asDouble();
+	if (a.isObject() && b.isObject()) {
+		if (a.size() != b.size())
+			return false;
+		for (const auto& name : a.getMemberNames()) {
+			if (!b.isMember(name) || !is_json_equal(a[name], b[name]))
+				return false;
+		}
+		return true;
+	}
+	if (a.isArray() && b.isArray()) {
+		if (a.size() != b.size())
+			return false;
+		for (Json::ArrayIndex index = 0; index < a.size(); index++) {
+			if (!is_json_equal(a[index], b[index]))
+				return false;
+		}
+		return true;
+	}
+	return a == b;
+}
+
+// Compare the JSON of a clip (or effect) with a JSON update, and find the frames it changes
+bool Timeline::json_changed_range(const Json::Value& existing_json, const Json::Value& new_json, bool is_clip,
+								  int64_t& first_frame, int64_t& last_frame, bool& audio_only, Json::Value& changes)
+{
+	// Properties which move the clip (or effect), or change which frames of the reader are used
+	static const std::set<std::string> structural_keys = {"position", "start", "end", "layer", "reader", "time", "parentObjectId"};
+
+	// Properties which only impact the audio mixed into the timeline frames (has_audio is not included,
+	// since it silences the clip's own frames)
+	static const std::set<std::string> audio_keys = {"volume", "mixing", "channel_filter", "channel_mapping"};
+
+	bool narrowed = true;
+	first_frame = INT64_MAX;
+	last_frame = 0;
+	audio_only = true;
+	changes = Json::Value(Json::objectValue);
+
+	// Loop through updated properties
+	for (const auto& name : new_json.getMemberNames()) {
+		const Json::Value& new_value = new_json[name];
+		if (!existing_json.isMember(name)) {
+			// Unknown properties are passed along (but are not used for rendering)
+			changes[name] = new_value;
+			continue;
+		}
+		const Json::Value& existing_value = existing_json[name];
+
+		if (name == "reader") {
+			// The reader is unchanged if it has the same properties (the existing reader may be wrapped by
+			// a FrameMapper, which is only kept if clips are automatically mapped)
+			const Json::Value& existing_reader = (auto_map_clips && existing_value["type"].asString() == "FrameMapper" && existing_value.isMember("reader")) ?
+				existing_value["reader"] : existing_value;
+			bool reader_changed = !new_value.isObject() || new_value["type"] != existing_reader["type"];
+			for (const auto& reader_key : new_value.getMemberNames()) {
+				if (existing_reader.isMember(reader_key) && !is_json_equal(new_value[reader_key], existing_reader[reader_key]))
+					reader_changed = true;
+			}
+			if (!reader_changed)
+				continue;
+		}
+		else if (name == "duration" || is_json_equal(existing_value, new_value)) {
+			// Unchanged (the duration is calculated from the start and end)
+			continue;
+		}
+		changes[name] = new_value;
+
+		// Audio properties do not change the image (unless the clip displays its waveform)
+		bool is_audio = is_clip && audio_keys.count(name) && !(name == "has_audio" && existing_json["waveform"].asBool());
+		if (!is_audio)
+			audio_only = false;
+
+		if (structural_keys.count(name)) {
+			// The whole clip (and its previous and new position) is impacted
+			narrowed = false;
+		}
+		else if ((is_keyframe_json(existing_value) && is_keyframe_json(new_value)) ||
+				 (is_color_json(existing_value) && is_color_json(new_value))) {
+			// Only the changed segments of keyframes (and colors, which are made of keyframes) are impacted
+			const std::vector<std::string> curve_names = is_keyframe_json(new_value) ?
+				std::vector<std::string>{""} : new_value.getMemberNames();
+			for (const auto& curve_name : curve_names) {
+				Keyframe existing_curve;
+				Keyframe new_curve;
+				existing_curve.SetJsonValue(curve_name.empty() ? existing_value : existing_value[curve_name]);
+				new_curve.SetJsonValue(curve_name.empty() ? new_value : new_value[curve_name]);
+
+				int64_t curve_first = 0;
+				int64_t curve_last = 0;
+				if (existing_curve.ChangedRange(new_curve, curve_first, curve_last)) {
+					first_frame = std::min(first_frame, curve_first);
+					last_frame = std::max(last_frame, curve_last);
+				}
+			}
+		}
+		else {
+			// Any other property (i.e. gravity, scale, effects) impacts all frames
+			first_frame = 1;
+			last_frame = INT64_MAX;
+		}
+	}
+
+	// Nothing was changed
+	if (changes.empty() || first_frame > last_frame)
+		audio_only = false;
+
+	return narrowed;
+}
+
+// Remove a range of a clip's (or effect's) frames from the timeline cache
+void Timeline::invalidate_frames(ClipBase* clip, int64_t first_frame, int64_t last_frame, bool audio_only)
+{
+	if (first_frame > last_frame)
+		return;
+
+	// Convert the range into timeline frames (limited to the position of the clip). The range
+	// is padded by 1 frame, since the volume is ramped from the previous frame.
+	int64_t clip_start_position = round(clip->Position() * info.fps.ToDouble()) + 1;
+	int64_t clip_end_position = round((clip->Position() + clip->Duration()) * info.fps.ToDouble()) + 1;
+	int64_t clip_start_frame = (clip->Start() * info.fps.ToDouble()) + 1;
+	int64_t offset = clip_start_position - clip_start_frame;
+	int64_t first_timeline_frame = std::max(clip_start_position, first_frame + offset - 1);
+	int64_t last_timeline_frame = clip_end_position;
+	if (last_frame < clip_end_position - offset)
+		last_timeline_frame = std::max(first_timeline_frame, last_frame + offset + 1);
+
+	// Debug output
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"Timeline::invalidate_frames",
+		"first_frame", first_frame,
+		"last_frame", last_frame,
+		"first_timeline_frame", first_timeline_frame,
+		"last_timeline_frame", last_timeline_frame,
+		"audio_only", audio_only);
+
+	if (audio_only) {
+		// Keep the cached images, and mix the audio again when requested (frames which are
+		// not cached are rendered anyway, so the whole range is marked without checking the cache)
+		mark_audio_dirty(first_timeline_frame, last_timeline_frame + 1);
+		// The processed frames of the clips don't include the timeline's audio mixing, and are kept
+		return;
+	}
+	final_cache->Remove(first_timeline_frame, last_timeline_frame);
+
+	// Remove the processed frames of this clip (or the clips on the same layer as this effect)
+	Clip* changed_clip = dynamic_cast<Clip*>(clip);
+	for (auto layer_clip : clips) {
+		if (layer_clip != changed_clip && (changed_clip || layer_clip->Layer() != clip->Layer()))
+			continue;
+
+		int64_t layer_clip_start_position = round(layer_clip->Position() * info.fps.ToDouble()) + 1;
+		int64_t layer_clip_start_frame = (layer_clip->Start() * info.fps.ToDouble()) + 1;
+		int64_t layer_clip_offset = layer_clip_start_position - layer_clip_start_frame;
+		layer_clip->GetCache()->Remove(first_timeline_frame - layer_clip_offset, last_timeline_frame - layer_clip_offset);
+	}
+}
+
+// Mark a range of frames for audio re-mixing
+void Timeline::mark_audio_dirty(int64_t first_frame, int64_t end_frame)
+{
+	if (first_frame >= end_frame)
+		return;
+
+	const std::lock_guard<std::mutex> lock(audioDirtyMutex);
+
+	// Merge with the previous range (if it overlaps or touches this range)
+	auto range = audio_dirty_ranges.upper_bound(first_frame);
+	if (range != audio_dirty_ranges.begin()) {
+		auto previous = std::prev(range);
+		if (previous->second >= first_frame) {
+			first_frame = previous->first;
+			end_frame = std::max(end_frame, previous->second);
+			range = audio_dirty_ranges.erase(previous);
+		}
+	}
+
+	// Merge with the following ranges
+	while (range != audio_dirty_ranges.end() && range->first <= end_frame) {
+		end_frame = std::max(end_frame, range->second);
+		range = audio_dirty_ranges.erase(range);
+	}
+
+	audio_dirty_ranges[first_frame] = end_frame;
+	has_audio_dirty_frames = true;
+}
+
+// Is the audio of a frame marked for re-mixing
+bool Timeline::is_audio_dirty(int64_t frame_number) const
+{
+	// Skip the lock when no frames are marked (the common case)
+	if (!has_audio_dirty_frames)
+		return false;
+
+	const std::lock_guard<std::mutex> lock(audioDirtyMutex);
+	auto range = audio_dirty_ranges.upper_bound(frame_number);
+	if (range == audio_dirty_ranges.begin())
+		return false;
+	--range;
+	return frame_number < range->second;
+}
+
+// Remove a frame from the audio dirty ranges
+bool Timeline::take_audio_dirty(int64_t frame_number)
+{
+	if (!has_audio_dirty_frames)
+		return false;
+
+	const std::lock_guard<std::mutex> lock(audioDirtyMutex);
+	auto range = audio_dirty_ranges.upper_bound(frame_number);
+	if (range == audio_dirty_ranges.begin())
+		return false;
+	--range;
+	if (frame_number >= range->second)
+		return false;
+
+	// Split the range around the frame
+	int64_t first_frame = range->first;
+	int64_t end_frame = range->second;
+	audio_dirty_ranges.erase(range);
+	if (first_frame < frame_number)
+		audio_dirty_ranges[first_frame] = frame_number;
+	if (frame_number + 1 < end_frame)
+		audio_dirty_ranges[frame_number + 1] = end_frame;
+
+	has_audio_dirty_frames = !audio_dirty_ranges.empty();
+	return true;
+}
+
+// Remove all frames from the audio dirty ranges
+void Timeline::clear_audio_dirty()
+{
+	const std::lock_guard<std::mutex> lock(audioDirtyMutex);
+	audio_dirty_ranges.clear();
+	has_audio_dirty_frames = false;
+}
+
 // Clear all caches
 void Timeline::ClearAllCache(bool deep) {
 
@@ -1718,6 +2632,10 @@ void Timeline::ClearAllCache(bool deep) {
 	if (final_cache) {
 		final_cache->Clear();
 	}
+	clear_audio_dirty();
+
+	// Make the render cache keys again (i.e. after properties were changed directly, or files on disk)
+	clear_clip_keys();
 
 	// Loop through all clips
 	try {
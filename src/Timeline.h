@@ -13,10 +13,15 @@
 #ifndef OPENSHOT_TIMELINE_H
 #define OPENSHOT_TIMELINE_H
 
+#include <atomic>
+#include <condition_variable>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <string>
+#include <vector>
 #include <QtGui/QImage>
 #include <QtGui/QPainter>
 #include <QtCore/QRegularExpression>
@@ -26,6 +31,7 @@
 
 #include "Color.h"
 #include "Clip.h"
+#include "ClipIndex.h"
 #include "EffectBase.h"
 #include "Fraction.h"
 #include "Frame.h"
@@ -43,6 +49,23 @@ namespace openshot {
 	class FrameMapper;
 	class CacheBase;
 
+	/// A visible clip (and its processed frame) on a single timeline frame
+	struct TimelineLayer {
+		openshot::Clip* clip; ///< Pointer to the clip
+		int64_t clip_frame_number; ///< Frame number of the clip
+		bool is_top_clip; ///< Is clip on top (if overlapping another clip)
+		std::shared_ptr<openshot::Frame> frame; ///< The processed frame of this clip
+	};
+
+	/// A range of timeline frames which only shows a single unmodified clip (see Timeline::GetPassThroughRanges)
+	struct PassThroughRange {
+		int64_t start; ///< The first timeline frame of the range
+		int64_t end; ///< The last timeline frame of the range
+		int64_t source_start; ///< The frame of the source file shown on the first timeline frame
+		std::string path; ///< The path of the source file (read by an FFmpegReader)
+		openshot::Clip* clip; ///< The clip showing the source file
+	};
+
 	/// Comparison method for sorting clip pointers (by Layer and then Position). Clips are sorted
 	/// from lowest layer to top layer (since that is the sequence they need to be combined), and then
 	/// by position (left to right).
@@ -152,6 +175,7 @@ namespace openshot {
 		std::list<openshot::Clip*> clips; ///<List of clips on this timeline
 		std::list<openshot::Clip*> closing_clips; ///<List of clips that need to be closed
 		std::map<openshot::Clip*, openshot::Clip*> open_clips; ///<List of 'opened' clips on this timeline
+		openshot::ClipIndex clip_index; ///< Interval index of clip frame ranges (per layer)
 		std::set<openshot::Clip*> allocated_clips; ///<List of clips that were allocated by this timeline
 		std::list<openshot::EffectBase*> effects; ///<List of clips on this timeline
 		std::set<openshot::EffectBase*> allocated_effects; ///<List of effects that were allocated by this timeline
@@ -162,11 +186,53 @@ namespace openshot {
 		int max_concurrent_frames; ///< Max concurrent frames to process at one time
 		double max_time; ///> The max duration (in seconds) of the timeline, based on the furthest clip (right edge)
 		double min_time; ///> The min duration (in seconds) of the timeline, based on the position of the first clip (left edge)
+		bool concurrent_rendering; ///< Render distinct frames in parallel (getFrameMutex is only held while snapshotting clips)
+		int renders_in_flight; ///< Number of concurrent renders currently compositing (guarded by renderMutex)
+		std::map<openshot::Clip*, int> clips_in_use; ///< Number of concurrent renders using each clip, which can't be closed until it is unused (guarded by renderMutex)
+		std::mutex renderMutex; ///< Mutex protecting renders_in_flight and clips_in_use
+		std::condition_variable renderCondition; ///< Signaled when a concurrent render completes
+		std::map<int64_t, int64_t> audio_dirty_ranges; ///< Frames with out of date audio (first frame -> end frame, exclusive), which are re-mixed by GetFrame (guarded by audioDirtyMutex)
+		std::atomic<bool> has_audio_dirty_frames; ///< Is audio_dirty_ranges non-empty (checked before locking)
+		mutable std::mutex audioDirtyMutex; ///< Mutex protecting audio_dirty_ranges (checked by GetFrame without getFrameMutex)
 
 		std::map<std::string, std::shared_ptr<openshot::TrackedObjectBase>> tracked_objects; ///< map of TrackedObjectBBoxes and their IDs
 
-		/// Process a new layer of video or audio
-		void add_layer(std::shared_ptr<openshot::Frame> new_frame, openshot::Clip* source_clip, int64_t clip_frame_number, bool is_top_clip, float max_volume);
+		/// Cached key of the JSON of a clip or effect, without its keyframe values (see RenderCache::TemplateKey)
+		struct ClipKey {
+			std::vector<int64_t> versions; ///< Versions of the clip and its effects when the key was made (see ClipBase::Version)
+			int64_t keyframe_edits; ///< Keyframe::Edits() when the key was made
+			std::string key; ///< Key of the JSON
+			std::vector<openshot::Keyframe> keyframes; ///< Keyframes of the JSON (in order)
+		};
+		std::map<openshot::ClipBase*, std::shared_ptr<const ClipKey>> clip_keys; ///< Cached keys of clips and effects (guarded by clipKeysMutex)
+		std::mutex clipKeysMutex; ///< Mutex protecting clip_keys (keys are made by concurrent renders)
+
+		/// Get the cached key of the JSON of a clip or effect (made again if the clip, its effects, or any keyframe changed)
+		std::shared_ptr<const ClipKey> clip_key(openshot::ClipBase* clip, const std::vector<int64_t>& versions);
+
+		/// Discard the cached keys of clips and effects
+		void clear_clip_keys();
+
+		/// Composite all intersecting clips into a new frame (does not check or update the cache).
+		/// If a cached_frame is passed, its image is kept, and only the audio is mixed again.
+		std::shared_ptr<openshot::Frame> composite_frame(int64_t requested_frame, const std::vector<openshot::Clip*>& nearby_clips, int width, int height, std::shared_ptr<openshot::Frame> cached_frame = nullptr);
+
+		/// Mark a concurrent render (of the nearby clips) as completed, and wake any waiting writers
+		void finish_render(const std::vector<openshot::Clip*>& nearby_clips);
+
+		/// Get the key of a frame in the persistent render cache (a hash of everything which affects the frame).
+		/// Must be called while the timeline can't change (holding getFrameMutex, or during a concurrent render).
+		std::string render_cache_key(int64_t requested_frame, const std::vector<openshot::Clip*>& nearby_clips, int width, int height);
+
+		/// Load a frame from the persistent render cache (if use_render_cache is true), or composite it (and save it)
+		std::shared_ptr<openshot::Frame> render_frame(int64_t requested_frame, const std::vector<openshot::Clip*>& nearby_clips, int width, int height, std::shared_ptr<openshot::Frame> cached_frame, bool use_render_cache);
+
+		/// Block until all in-flight concurrent renders have completed. Must be called while
+		/// holding getFrameMutex, before modifying any clips, effects, or timeline properties.
+		void wait_for_renders();
+
+		/// Process a new layer of video or audio (the image is not composited if mix_image is false)
+		void add_layer(std::shared_ptr<openshot::Frame> new_frame, openshot::Clip* source_clip, std::shared_ptr<openshot::Frame> source_frame, int64_t clip_frame_number, float max_volume, bool mix_image = true);
 
 		/// Apply a FrameMapper to a clip which matches the settings of this timeline
 		void apply_mapper_to_clip(openshot::Clip* clip);
@@ -174,9 +240,39 @@ namespace openshot {
 		// Apply JSON Diffs to various objects contained in this timeline
 		void apply_json_to_clips(Json::Value change); ///<Apply JSON diff to clips
 		void apply_json_to_effects(Json::Value change); ///< Apply JSON diff to effects
-		void apply_json_to_effects(Json::Value change, openshot::EffectBase* existing_effect); ///<Apply JSON diff to a specific effect
+		void apply_json_to_effects(Json::Value change, openshot::EffectBase* existing_effect, openshot::Clip* parent_clip = NULL); ///<Apply JSON diff to a specific effect (optionally on a clip)
 		void apply_json_to_timeline(Json::Value change); ///<Apply JSON diff to timeline properties
 
+		/// @brief Compare the JSON of a clip (or effect) with a JSON update, and find the frames it changes
+		///
+		/// @returns False if the position, duration, layer, reader, or time mapping changed (i.e. the
+		/// change cannot be narrowed down to a range of frames)
+		/// @param existing_json The current JSON of the clip or effect
+		/// @param new_json The updated JSON properties
+		/// @param is_clip Is this a clip (audio properties are only checked for clips)
+		/// @param first_frame The first changed frame of the clip or effect (not the timeline)
+		/// @param last_frame The last changed frame of the clip or effect (not the timeline)
+		/// @param audio_only Are only audio properties changed (volume, mixing, channels)
+		/// @param changes The changed properties (unknown properties are also included)
+		bool json_changed_range(const Json::Value& existing_json, const Json::Value& new_json, bool is_clip,
+								int64_t& first_frame, int64_t& last_frame, bool& audio_only, Json::Value& changes);
+
+		/// Remove a range of a clip's (or effect's) frames from the timeline cache. Audio only changes
+		/// keep the cached images (the frames are just marked for audio re-mixing).
+		void invalidate_frames(openshot::ClipBase* clip, int64_t first_frame, int64_t last_frame, bool audio_only);
+
+		/// Mark a range of frames [first_frame, end_frame) for audio re-mixing (merged with overlapping ranges)
+		void mark_audio_dirty(int64_t first_frame, int64_t end_frame);
+
+		/// Is the audio of a frame marked for re-mixing
+		bool is_audio_dirty(int64_t frame_number) const;
+
+		/// Remove a frame from the audio dirty ranges (returns true if it was marked)
+		bool take_audio_dirty(int64_t frame_number);
+
+		/// Remove all frames from the audio dirty ranges
+		void clear_audio_dirty();
+
 		/// Calculate the max duration (in seconds) of the timeline, based on all the clips, and cache the value
 		void calculate_max_duration();
 
@@ -192,11 +288,14 @@ namespace openshot {
 		std::vector<openshot::Clip*> find_intersecting_clips(int64_t requested_frame, int number_of_frames, bool include);
 
 		/// Get a clip's frame or generate a blank frame
-		std::shared_ptr<openshot::Frame> GetOrCreateFrame(std::shared_ptr<Frame> background_frame, openshot::Clip* clip, int64_t number, openshot::TimelineInfoStruct* options);
+		std::shared_ptr<openshot::Frame> GetOrCreateFrame(std::shared_ptr<Frame> background_frame, openshot::Clip* clip, int64_t number, bool is_top_clip);
 
 		/// Compare 2 floating point numbers for equality
 		bool isEqual(double a, double b);
 
+		/// Does a clip show its source file unmodified (i.e. no effects, animation, or scaling), and get the path of the file
+		bool is_pass_through_clip(openshot::Clip* clip, std::string& source_path);
+
 		/// Sort clips by position on the timeline
 		void sort_clips();
 
@@ -266,6 +365,17 @@ namespace openshot {
 		/// Clear all clips, effects, and frame mappers from timeline (and free memory)
 		void Clear();
 
+		/// Determine if distinct frames are rendered concurrently
+		bool ConcurrentRendering() { return concurrent_rendering; };
+
+		/// @brief Enable or disable concurrent rendering of distinct frames
+		///
+		/// When enabled, GetFrame() only holds the timeline lock while it snapshots the intersecting
+		/// clips, and then composites the frame without the lock. Changes to the timeline (such as
+		/// ApplyJsonDiff, AddClip, or RemoveClip) wait for in-flight renders to finish before they are applied.
+		/// @param value Enable or disable concurrent rendering
+		void ConcurrentRendering(bool value);
+
 		/// Clear all cache for this timeline instance, including all clips' cache
 		/// @param deep If True, clear all FrameMappers and nested Readers (QtImageReader, FFmpegReader, etc...)
 		void ClearAllCache(bool deep=false);
@@ -287,6 +397,17 @@ namespace openshot {
 		/// Look up the end frame number of the latest element on the timeline
 		int64_t GetMaxFrame();
 
+		/// @brief Get the ranges of frames which only show a single unmodified clip
+		///
+		/// The frames of these ranges are identical to the frames of the clip's source file, so a writer can copy
+		/// the compressed packets of the file, instead of rendering and encoding them (see FFmpegWriter::SetSmartRender).
+		/// A clip is unmodified if it has no effects, no time mapping, no animated or non-default transform, alpha,
+		/// volume, or channel properties, and its file (read by an FFmpegReader) has the size and frame rate of the
+		/// timeline. Frames overlapped by any other clip, or by a timeline effect, are never included.
+		/// @param start The first frame number
+		/// @param end The last frame number
+		std::vector<openshot::PassThroughRange> GetPassThroughRanges(int64_t start, int64_t end);
+
 		/// Look up the position/start time of the first timeline element
 		double GetMinTime();
 		/// Look up the start frame number of the first element on the timeline
@@ -301,9 +422,18 @@ namespace openshot {
 		/// Return the list of effects on all clips
 		std::list<openshot::EffectBase*> ClipEffects() const;
 
+		/// @brief Get the statistics of the timeline cache, and of the caches of all clips (and their readers)
+		///
+		/// Includes the totals of each cache level (timeline, clip, mapper, and reader), to find which level
+		/// a slow preview misses at. Statistics are only counted when Settings::ENABLE_CACHE_STATS is true.
+		Json::Value CacheStats();
+
 		/// Get the cache object used by this reader
 		openshot::CacheBase* GetCache() override { return final_cache; };
 
+		/// Reset the statistics of the timeline cache, and of the caches of all clips (and their readers)
+		void ResetCacheStats();
+
 		/// Set the cache object used by this reader. You must now manage the lifecycle
 		/// of this cache object though (Timeline will not delete it for you).
 		void SetCache(openshot::CacheBase* new_cache);
@@ -314,6 +444,15 @@ namespace openshot {
 		/// @param requested_frame The frame number that is requested.
 		std::shared_ptr<openshot::Frame> GetFrame(int64_t requested_frame) override;
 
+		/// @brief Get a range of frames (in order) of this timeline, which are rendered ahead of the caller
+		///
+		/// With concurrent rendering, several frames are rendered in parallel (see ConcurrentRendering()).
+		/// Otherwise, a single worker renders the next frames, while the caller processes earlier frames.
+		/// The timeline can still be modified, since each frame is rendered with GetFrame().
+		/// @param start The first frame number
+		/// @param count The number of frames
+		std::shared_ptr<openshot::FrameStream> GetFrames(int64_t start, int64_t count) override;
+
 		// Curves for the viewport
 		openshot::Keyframe viewport_scale; ///<Curve representing the scale of the viewport (0 to 100)
 		openshot::Keyframe viewport_x; ///<Curve representing the x coordinate for the viewport
@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @brief Source file for VideoScaler class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "VideoScaler.h"
+#include "OpenMPUtilities.h"
+#include "ZmqLogger.h"
+
+using namespace openshot;
+
+// Extra bytes allocated after each image (some swscale kernels write past the last pixel)
+#define VIDEO_SCALER_BUFFER_PADDING 128
+
+// Compare scaler keys (for std::map)
+bool VideoScaler::ScalerKey::operator<(const ScalerKey& other) const
+{
+	return std::tie(source_format, source_width, source_height, width, height, flags) <
+		std::tie(other.source_format, other.source_width, other.source_height, other.width, other.height, other.flags);
+}
+
+// Constructor
+VideoScaler::VideoScaler(int max_scalers, int max_idle_buffers) :
+	buffers(std::make_shared<BufferPool>(std::max(0, max_idle_buffers))),
+	use_count(0), max_scalers(std::max(1, max_scalers))
+{
+}
+
+// Destructor
+VideoScaler::~VideoScaler()
+{
+	for (auto& scaler : scalers)
+		FreeScaler(scaler.second);
+	scalers.clear();
+}
+
+// Remove all cached scalers and unused pixel buffers
+void VideoScaler::Clear()
+{
+	for (auto& scaler : scalers)
+		FreeScaler(scaler.second);
+	scalers.clear();
+	buffers->Clear();
+}
+
+// Free the contexts of a scaler
+void VideoScaler::FreeScaler(Scaler& scaler)
+{
+	for (SwsContext* context : scaler.contexts)
+		sws_freeContext(context);
+	scaler.contexts.clear();
+}
+
+// Get (or create) the scaler for a key
+VideoScaler::Scaler* VideoScaler::GetScaler(const ScalerKey& key)
+{
+	auto existing = scalers.find(key);
+	if (existing != scalers.end()) {
+		existing->second.last_used = ++use_count;
+		return &existing->second;
+	}
+
+	// Remove the least recently used scaler (i.e. an old preview size)
+	if (scalers.size() >= max_scalers) {
+		auto oldest = std::min_element(scalers.begin(), scalers.end(),
+			[](const std::pair<const ScalerKey, Scaler>& a, const std::pair<const ScalerKey, Scaler>& b) {
+				return a.second.last_used < b.second.last_used;
+			});
+		FreeScaler(oldest->second);
+		scalers.erase(oldest);
+	}
+
+	// Determine # of slices. Slices are filtered separately (the edges of each slice do not use rows
+	// of the next slice), so images which are scaled vertically are never sliced (even the fast bilinear
+	// filter reads the row after each slice, and would leave a seam at each slice edge).
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((PixelFormat) key.source_format);
+	int slices = std::min(OPEN_MP_NUM_PROCESSORS, key.height / VIDEO_SCALER_SLICE_ROWS);
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)))
+		slices = 1;
+	if (key.source_height != key.height)
+		slices = 1;
+	slices = std::max(1, slices);
+
+	// Slices start on a row of the chroma planes (i.e. an even row for 4:2:0 formats)
+	const int alignment = desc ? (1 << desc->log2_chroma_h) : 1;
+
+	Scaler scaler;
+	scaler.last_used = ++use_count;
+	scaler.source_rows.push_back(0);
+	scaler.rows.push_back(0);
+	for (int slice = 1; slice < slices; slice++) {
+		int source_row = int(int64_t(slice) * key.source_height / slices) / alignment * alignment;
+		int row = int(round(double(source_row) * key.height / key.source_height));
+		if (source_row > scaler.source_rows.back() && row > scaler.rows.back() && row < key.height) {
+			scaler.source_rows.push_back(source_row);
+			scaler.rows.push_back(row);
+		}
+	}
+	scaler.source_rows.push_back(key.source_height);
+	scaler.rows.push_back(key.height);
+
+	// Create a context for each slice
+	for (size_t slice = 0; slice + 1 < scaler.rows.size(); slice++) {
+		SwsContext* context = sws_getContext(
+			key.source_width, scaler.source_rows[slice + 1] - scaler.source_rows[slice], (PixelFormat) key.source_format,
+			key.width, scaler.rows[slice + 1] - scaler.rows[slice], PIX_FMT_RGBA,
+			key.flags, NULL, NULL, NULL);
+		if (!context) {
+			FreeScaler(scaler);
+			return nullptr;
+		}
+		scaler.contexts.push_back(context);
+	}
+
+	ZmqLogger::Instance()->AppendDebugMethod(
+		"VideoScaler::GetScaler (create scaler)",
+		"source_width", key.source_width,
+		"source_height", key.source_height,
+		"width", key.width,
+		"height", key.height,
+		"slices", scaler.contexts.size());
+
+	auto inserted = scalers.insert(std::make_pair(key, scaler));
+	return &inserted.first->second;
+}
+
+// Convert (and scale) a decoded video frame into a new RGBA image
+std::shared_ptr<QImage> VideoScaler::Convert(AVFrame* source, PixelFormat source_format, int source_width, int source_height,
+											 int width, int height, int flags, bool has_alpha)
+{
+	if (!source || source_width <= 0 || source_height <= 0 || width <= 0 || height <= 0)
+		return nullptr;
+
+	ScalerKey key = {source_format, source_width, source_height, width, height, flags};
+	Scaler* scaler = GetScaler(key);
+	if (!scaler)
+		return nullptr;
+
+	// Get a pooled buffer (not zero-filled)
+	const int bytes_per_line = width * 4;
+	const size_t buffer_size = size_t(bytes_per_line) * height + VIDEO_SCALER_BUFFER_PADDING;
+	uint8_t* buffer = buffers->Acquire(buffer_size);
+
+	// Source planes (chroma planes of planar formats are subsampled)
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(source_format);
+	const int planes = std::max(1, std::min(av_pix_fmt_count_planes(source_format), 4));
+	const int chroma_shift = desc ? desc->log2_chroma_h : 0;
+
+	// Convert each slice (in parallel)
+	const int slices = scaler->contexts.size();
+	#pragma omp parallel for if (slices > 1) num_threads(slices)
+	for (int slice = 0; slice < slices; slice++) {
+		const int source_row = scaler->source_rows[slice];
+		const uint8_t* source_data[4] = {NULL, NULL, NULL, NULL};
+		int source_linesize[4] = {0, 0, 0, 0};
+		for (int plane = 0; plane < planes; plane++) {
+			const int shift = (plane == 1 || plane == 2) ? chroma_shift : 0;
+			source_data[plane] = source->data[plane] + int64_t(source_row >> shift) * source->linesize[plane];
+			source_linesize[plane] = source->linesize[plane];
+		}
+
+		uint8_t* destination_data[4] = {buffer + int64_t(scaler->rows[slice]) * bytes_per_line, NULL, NULL, NULL};
+		int destination_linesize[4] = {bytes_per_line, 0, 0, 0};
+
+		sws_scale(scaler->contexts[slice], source_data, source_linesize, 0,
+				  scaler->source_rows[slice + 1] - source_row, destination_data, destination_linesize);
+	}
+
+	// Wrap buffer (which is returned to the pool when the image is destroyed)
+	return buffers->WrapImage(buffer, buffer_size, width, height, bytes_per_line,
+							  has_alpha ? QImage::Format_RGBA8888 : QImage::Format_RGBA8888_Premultiplied);
+}
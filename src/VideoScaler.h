@@ -0,0 +1,111 @@
+/**
+ * @file
+ * @brief Header file for VideoScaler class
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef OPENSHOT_VIDEO_SCALER_H
+#define OPENSHOT_VIDEO_SCALER_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QImage>
+
+#include "BufferPool.h"
+#include "FFmpegUtilities.h"
+
+// Min # of destination rows per slice (smaller images are converted by a single thread)
+#define VIDEO_SCALER_SLICE_ROWS 64
+
+namespace openshot {
+
+	/**
+	 * @brief This class converts (and scales) decoded video frames into RGBA images, reusing scaling contexts and pixel buffers.
+	 *
+	 * Scaling contexts are cached by their source format, source size, destination size, and flags, so
+	 * a new context is only created when one of them changes (i.e. the preview size). Large images which
+	 * are not scaled vertically are split into horizontal slices, which are converted in parallel (each
+	 * slice has its own context).
+	 *
+	 * Pixel buffers are not zero-filled, and are returned to a pool when the QImage which wraps them is
+	 * destroyed, so decoding a clip does not allocate a new buffer for each frame.
+	 *
+	 * @code
+	 * openshot::VideoScaler scaler;
+	 * std::shared_ptr<QImage> image = scaler.Convert(pFrame, AV_PIX_FMT_YUV420P, 3840, 2160, 1920, 1080, SWS_FAST_BILINEAR, false);
+	 * @endcode
+	 */
+	class VideoScaler {
+	private:
+		/// Key of a cached scaler
+		struct ScalerKey {
+			int source_format;
+			int source_width;
+			int source_height;
+			int width;
+			int height;
+			int flags;
+			bool operator<(const ScalerKey& other) const;
+		};
+
+		/// Scaling contexts of each slice (and the row ranges of each slice)
+		struct Scaler {
+			std::vector<SwsContext*> contexts;
+			std::vector<int> source_rows; ///< First source row of each slice (and the source height)
+			std::vector<int> rows; ///< First destination row of each slice (and the destination height)
+			int64_t last_used;
+		};
+
+		std::map<ScalerKey, Scaler> scalers;
+		std::shared_ptr<BufferPool> buffers;
+		int64_t use_count;
+		size_t max_scalers;
+
+		/// Get (or create) the scaler for a key
+		Scaler* GetScaler(const ScalerKey& key);
+
+		/// Free the contexts of a scaler
+		static void FreeScaler(Scaler& scaler);
+
+	public:
+		/// @brief Constructor
+		///
+		/// @param max_scalers The max # of cached scalers (i.e. different sizes), before the oldest is removed
+		/// @param max_idle_buffers The max # of unused pixel buffers to keep
+		VideoScaler(int max_scalers = 4, int max_idle_buffers = 8);
+
+		/// Destructor (images returned by Convert() are still valid)
+		virtual ~VideoScaler();
+
+		/// Remove all cached scalers and unused pixel buffers
+		void Clear();
+
+		/// @brief Convert (and scale) a decoded video frame into a new RGBA image
+		///
+		/// @returns The converted image (always QImage::Format_RGBA8888_Premultiplied or QImage::Format_RGBA8888),
+		/// or nullptr if the conversion is not supported
+		/// @param source The decoded frame
+		/// @param source_format The pixel format of the decoded frame
+		/// @param source_width The width of the decoded frame
+		/// @param source_height The height of the decoded frame
+		/// @param width The width of the new image
+		/// @param height The height of the new image
+		/// @param flags The swscale flags (i.e. SWS_FAST_BILINEAR or SWS_BICUBIC)
+		/// @param has_alpha Does the source contain an alpha channel (the image is not premultiplied in this case)
+		std::shared_ptr<QImage> Convert(AVFrame* source, PixelFormat source_format, int source_width, int source_height,
+										int width, int height, int flags, bool has_alpha);
+	};
+
+}
+
+#endif
@@ -11,8 +11,11 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "Brightness.h"
+#include "ColorChain.h"
 #include "Exceptions.h"
 
+#include <algorithm>
+
 using namespace openshot;
 
 /// Blank constructor, useful when using Json to load the effect properties
@@ -46,50 +49,32 @@ void Brightness::init_effect_details()
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Brightness::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
 {
-	// Get the frame's image
-	std::shared_ptr<QImage> frame_image = frame->GetImage();
+	// Adjust the frame's image (in a single pass)
+	ColorChain::Apply(frame->GetImage().get(), {GetColorOperator(frame_number)});
+
+	// return the modified frame
+	return frame;
+}
 
+// Get the color operation of this effect, for a specific frame
+ColorOperator Brightness::GetColorOperator(int64_t frame_number) const
+{
 	// Get keyframe values for this frame
-	float brightness_value = brightness.GetValue(frame_number);
-	float contrast_value = contrast.GetValue(frame_number);
+	const float brightness_value = brightness.GetValue(frame_number);
+	const float contrast_value = contrast.GetValue(frame_number);
 
-	// Loop through pixels
-	unsigned char *pixels = (unsigned char *) frame_image->bits();
-	int pixel_count = frame_image->width() * frame_image->height();
+	// Compute contrast adjustment factor
+	const float factor = (259 * (contrast_value + 255)) / (255 * (259 - contrast_value));
 
-	#pragma omp parallel for
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
-	{
-		// Compute contrast adjustment factor
-		float factor = (259 * (contrast_value + 255)) / (255 * (259 - contrast_value));
-
-		// Calculate alpha % (to be used for removing pre-multiplied alpha value)
-		int A = pixels[pixel * 4 + 3];
-		float alpha_percent = A / 255.0;
-
-		// Get RGB values, and remove pre-multiplied alpha
-		unsigned char R = pixels[pixel * 4 + 0] / alpha_percent;
-		unsigned char G = pixels[pixel * 4 + 1] / alpha_percent;
-		unsigned char B = pixels[pixel * 4 + 2] / alpha_percent;
-
-		// Apply constrained contrast adjustment
-		R = constrain((factor * (R - 128)) + 128);
-		G = constrain((factor * (G - 128)) + 128);
-		B = constrain((factor * (B - 128)) + 128);
-
-		// Adjust brightness and write constrained values back to image
-		pixels[pixel * 4 + 0] = constrain(R + (255 * brightness_value));
-		pixels[pixel * 4 + 1] = constrain(G + (255 * brightness_value));
-		pixels[pixel * 4 + 2] = constrain(B + (255 * brightness_value));
-
-		// Pre-multiply the alpha back into the color channels
-		pixels[pixel * 4 + 0] *= alpha_percent;
-		pixels[pixel * 4 + 1] *= alpha_percent;
-		pixels[pixel * 4 + 2] *= alpha_percent;
-	}
+	return [brightness_value, factor](float* colors, int count) {
+		for (int value = 0; value < count * 3; ++value) {
+			// Apply constrained contrast adjustment
+			float color = std::min(std::max((factor * (colors[value] - 128)) + 128, 0.0f), 255.0f);
 
-	// return the modified frame
-	return frame;
+			// Adjust brightness
+			colors[value] = color + (255 * brightness_value);
+		}
+	};
 }
 
 // Generate JSON string of this object
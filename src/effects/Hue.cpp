@@ -11,6 +11,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "Hue.h"
+#include "ColorChain.h"
 #include "Exceptions.h"
 
 using namespace openshot;
@@ -46,51 +47,38 @@ void Hue::init_effect_details()
 // modified openshot::Frame object
 std::shared_ptr<openshot::Frame> Hue::GetFrame(std::shared_ptr<openshot::Frame> frame, int64_t frame_number)
 {
-	// Get the frame's image
-	std::shared_ptr<QImage> frame_image = frame->GetImage();
+	// Adjust the frame's image (in a single pass)
+	ColorChain::Apply(frame->GetImage().get(), {GetColorOperator(frame_number)});
 
-	int pixel_count = frame_image->width() * frame_image->height();
+	// return the modified frame
+	return frame;
+}
 
+// Get the color operation of this effect, for a specific frame
+ColorOperator Hue::GetColorOperator(int64_t frame_number) const
+{
 	// Get the current hue percentage shift amount, and convert to degrees
 	double degrees = 360.0 * hue.GetValue(frame_number);
 	float cosA = cos(degrees*3.14159265f/180);
 	float sinA = sin(degrees*3.14159265f/180);
 
 	// Calculate a rotation matrix for the RGB colorspace (based on the current hue shift keyframe value)
-	float matrix[3] = {
-		cosA + (1.0f - cosA) / 3.0f,
-		1.0f/3.0f * (1.0f - cosA) - sqrtf(1.0f/3.0f) * sinA,
-		1.0f/3.0f * (1.0f - cosA) + sqrtf(1.0f/3.0f) * sinA
+	const float m0 = cosA + (1.0f - cosA) / 3.0f;
+	const float m1 = 1.0f/3.0f * (1.0f - cosA) - sqrtf(1.0f/3.0f) * sinA;
+	const float m2 = 1.0f/3.0f * (1.0f - cosA) + sqrtf(1.0f/3.0f) * sinA;
+
+	return [m0, m1, m2](float* colors, int count) {
+		for (int pixel = 0; pixel < count; ++pixel) {
+			float R = colors[pixel * 3 + 0];
+			float G = colors[pixel * 3 + 1];
+			float B = colors[pixel * 3 + 2];
+
+			// Multiply each color by the hue rotation matrix
+			colors[pixel * 3 + 0] = R * m0 + G * m1 + B * m2;
+			colors[pixel * 3 + 1] = R * m2 + G * m0 + B * m1;
+			colors[pixel * 3 + 2] = R * m1 + G * m2 + B * m0;
+		}
 	};
-
-	// Loop through pixels
-	unsigned char *pixels = (unsigned char *) frame_image->bits();
-
-	#pragma omp parallel for shared (pixels)
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
-	{
-		// Calculate alpha % (to be used for removing pre-multiplied alpha value)
-		int A = pixels[pixel * 4 + 3];
-		float alpha_percent = A / 255.0;
-
-		// Get RGB values, and remove pre-multiplied alpha
-		int R = pixels[pixel * 4 + 0] / alpha_percent;
-		int G = pixels[pixel * 4 + 1] / alpha_percent;
-		int B = pixels[pixel * 4 + 2] / alpha_percent;
-
-		// Multiply each color by the hue rotation matrix
-		pixels[pixel * 4] = constrain(R * matrix[0] + G * matrix[1] + B * matrix[2]);
-		pixels[pixel * 4 + 1] = constrain(R * matrix[2] + G * matrix[0] + B * matrix[1]);
-		pixels[pixel * 4 + 2] = constrain(R * matrix[1] + G * matrix[2] + B * matrix[0]);
-
-		// Pre-multiply the alpha back into the color channels
-		pixels[pixel * 4 + 0] *= alpha_percent;
-		pixels[pixel * 4 + 1] *= alpha_percent;
-		pixels[pixel * 4 + 2] *= alpha_percent;
-	}
-
-	// return the modified frame
-	return frame;
 }
 
 // Generate JSON string of this object
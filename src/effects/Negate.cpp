@@ -40,6 +40,15 @@ std::shared_ptr<openshot::Frame> Negate::GetFrame(std::shared_ptr<openshot::Fram
 	return frame;
 }
 
+// Get the color operation of this effect, for a specific frame
+ColorOperator Negate::GetColorOperator(int64_t frame_number) const
+{
+	return [](float* colors, int count) {
+		for (int value = 0; value < count * 3; ++value)
+			colors[value] = 255.0f - colors[value];
+	};
+}
+
 // Generate JSON string of this object
 std::string Negate::Json() const {
 
@@ -11,8 +11,11 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "Saturation.h"
+#include "ColorChain.h"
 #include "Exceptions.h"
 
+#include <algorithm>
+
 using namespace openshot;
 
 /// Blank constructor, useful when using Json to load the effect properties
@@ -53,100 +56,69 @@ std::shared_ptr<openshot::Frame> Saturation::GetFrame(std::shared_ptr<openshot::
 	if (!frame_image)
 		return frame;
 
-	int pixel_count = frame_image->width() * frame_image->height();
-
-	// Get keyframe values for this frame
-	float saturation_value = saturation.GetValue(frame_number);
-	float saturation_value_R = saturation_R.GetValue(frame_number);
-	float saturation_value_G = saturation_G.GetValue(frame_number);
-	float saturation_value_B = saturation_B.GetValue(frame_number);
-
-	// Constants used for color saturation formula
-	const double pR = .299;
-	const double pG = .587;
-	const double pB = .114;
-
-	// Loop through pixels
-	unsigned char *pixels = (unsigned char *) frame_image->bits();
-
-	#pragma omp parallel for shared (pixels)
-	for (int pixel = 0; pixel < pixel_count; ++pixel)
-	{
-		// Calculate alpha % (to be used for removing pre-multiplied alpha value)
-		int A = pixels[pixel * 4 + 3];
-		float alpha_percent = A / 255.0;
-
-		// Get RGB values, and remove pre-multiplied alpha
-		int R = pixels[pixel * 4 + 0] / alpha_percent;
-		int G = pixels[pixel * 4 + 1] / alpha_percent;
-		int B = pixels[pixel * 4 + 2] / alpha_percent;
-
-		/*
-		 * Common saturation adjustment
-		 */
-
-		// Calculate the saturation multiplier
-		double p = sqrt( (R * R * pR) +
-						 (G * G * pG) +
-						 (B * B * pB) );
-
-		// Adjust the saturation
-		R = constrain(p + (R - p) * saturation_value);
-		G = constrain(p + (G - p) * saturation_value);
-		B = constrain(p + (B - p) * saturation_value);
-
-		/*
-		 * Color-separated saturation adjustment
-		 *
-		 * Splitting each of the three subpixels (R, G and B) into three distincs sub-subpixels (R, G and B in turn)
-		 * which in their optical sum reproduce the original subpixel's color OR produce white light in the brightness
-		 * of the original subpixel (dependening on the color channel's slider value).
-		 */
-
-		// Compute the brightness ("saturation multiplier") of the replaced subpixels
-		// Actually mathematical no-ops mostly, verbosity is kept just for clarification
-		const double p_r = sqrt(R * R * pR);
-		const double p_g = sqrt(G * G * pG);
-		const double p_b = sqrt(B * B * pB);
-
-		// Adjust the saturation
-		const int Rr = p_r + (R - p_r) * saturation_value_R;
-		const int Gr = p_r + (0 - p_r) * saturation_value_R;
-		const int Br = p_r + (0 - p_r) * saturation_value_R;
-
-		const int Rg = p_g + (0 - p_g) * saturation_value_G;
-		const int Gg = p_g + (G - p_g) * saturation_value_G;
-		const int Bg = p_g + (0 - p_g) * saturation_value_G;
-
-		const int Rb = p_b + (0 - p_b) * saturation_value_B;
-		const int Gb = p_b + (0 - p_b) * saturation_value_B;
-		const int Bb = p_b + (B - p_b) * saturation_value_B;
-
-		// Recombine brightness of sub-subpixels (Rx, Gx and Bx) into sub-pixels (R, G and B) again
-		R = Rr + Rg + Rb;
-		G = Gr + Gg + Gb;
-		B = Br + Bg + Bb;
-
-		// Constrain the value from 0 to 255
-		R = constrain(R);
-		G = constrain(G);
-		B = constrain(B);
-
-		// Set all pixels to new value
-		pixels[pixel * 4 + 0] = R;
-		pixels[pixel * 4 + 1] = G;
-		pixels[pixel * 4 + 2] = B;
-
-		// Pre-multiply the alpha back into the color channels
-		pixels[pixel * 4 + 0] *= alpha_percent;
-		pixels[pixel * 4 + 1] *= alpha_percent;
-		pixels[pixel * 4 + 2] *= alpha_percent;
-	}
+	// Adjust the frame's image (in a single pass)
+	ColorChain::Apply(frame_image.get(), {GetColorOperator(frame_number)});
 
 	// return the modified frame
 	return frame;
 }
 
+// Get the color operation of this effect, for a specific frame
+ColorOperator Saturation::GetColorOperator(int64_t frame_number) const
+{
+	// Get keyframe values for this frame
+	const float saturation_value = saturation.GetValue(frame_number);
+	const float saturation_value_R = saturation_R.GetValue(frame_number);
+	const float saturation_value_G = saturation_G.GetValue(frame_number);
+	const float saturation_value_B = saturation_B.GetValue(frame_number);
+
+	return [saturation_value, saturation_value_R, saturation_value_G, saturation_value_B](float* colors, int count) {
+		// Constants used for color saturation formula
+		const float pR = .299f;
+		const float pG = .587f;
+		const float pB = .114f;
+
+		for (int pixel = 0; pixel < count; ++pixel)
+		{
+			float R = colors[pixel * 3 + 0];
+			float G = colors[pixel * 3 + 1];
+			float B = colors[pixel * 3 + 2];
+
+			/*
+			 * Common saturation adjustment
+			 */
+
+			// Calculate the saturation multiplier
+			float p = sqrtf( (R * R * pR) +
+							 (G * G * pG) +
+							 (B * B * pB) );
+
+			// Adjust the saturation
+			R = std::min(std::max(p + (R - p) * saturation_value, 0.0f), 255.0f);
+			G = std::min(std::max(p + (G - p) * saturation_value, 0.0f), 255.0f);
+			B = std::min(std::max(p + (B - p) * saturation_value, 0.0f), 255.0f);
+
+			/*
+			 * Color-separated saturation adjustment
+			 *
+			 * Splitting each of the three subpixels (R, G and B) into three distincs sub-subpixels (R, G and B in turn)
+			 * which in their optical sum reproduce the original subpixel's color OR produce white light in the brightness
+			 * of the original subpixel (dependening on the color channel's slider value).
+			 */
+
+			// Compute the brightness ("saturation multiplier") of the replaced subpixels
+			const float p_r = sqrtf(R * R * pR);
+			const float p_g = sqrtf(G * G * pG);
+			const float p_b = sqrtf(B * B * pB);
+
+			// Adjust the saturation, and recombine brightness of sub-subpixels into sub-pixels (R, G and B) again
+			colors[pixel * 3 + 0] = (p_r + (R - p_r) * saturation_value_R) + (p_g - p_g * saturation_value_G) + (p_b - p_b * saturation_value_B);
+			colors[pixel * 3 + 1] = (p_r - p_r * saturation_value_R) + (p_g + (G - p_g) * saturation_value_G) + (p_b - p_b * saturation_value_B);
+			colors[pixel * 3 + 2] = (p_r - p_r * saturation_value_R) + (p_g - p_g * saturation_value_G) + (p_b + (B - p_b) * saturation_value_B);
+		}
+	};
+}
+
 // Generate JSON string of this object
 std::string Saturation::Json() const {
 
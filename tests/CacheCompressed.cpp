@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::CacheCompressed
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstring>
+#include <memory>
+#include <QPainter>
+
+#include "openshot_catch.h"
+
+#include "CacheCompressed.h"
+#include "Frame.h"
+#include "Json.h"
+
+using namespace openshot;
+
+// Create a frame with a gradient, some noise, and a transparent area
+static std::shared_ptr<Frame> create_frame(int64_t number, int width, int height)
+{
+	auto f = std::make_shared<Frame>(number, width, height, "#000000", 500, 2);
+	auto image = std::make_shared<QImage>(width, height, QImage::Format_RGBA8888_Premultiplied);
+	image->fill(QColor(0, 0, 0, 0));
+	QPainter painter(image.get());
+	QLinearGradient gradient(0, 0, width, height);
+	gradient.setColorAt(0, QColor(number % 255, 40, 200));
+	gradient.setColorAt(1, QColor(10, 220, 30));
+	painter.fillRect(0, 0, width, height * 3 / 4, gradient);
+	painter.end();
+	for (int i = 0; i < width; i += 7)
+		image->setPixelColor(i, (i * 13) % height, QColor(i % 256, (i * 3) % 256, (i * 5) % 256, 128));
+	f->AddImage(image);
+
+	float samples[500];
+	for (int s = 0; s < 500; s++)
+		samples[s] = (s % 100) / 100.0f;
+	f->AddAudio(true, 0, 0, samples, 500, 1.0);
+	f->AddAudio(true, 1, 0, samples, 500, 0.5);
+	return f;
+}
+
+TEST_CASE( "lossless round trip", "[libopenshot][cachecompressed]" )
+{
+	CacheCompressed c;
+
+	// Stripes of a (non-multiple) height are compressed separately
+	auto f = create_frame(1, 320, 150);
+	c.Add(f);
+	CHECK(c.Count() == 1);
+	CHECK(c.Contains(1));
+
+	auto cached = c.GetFrame(1);
+	REQUIRE(cached != nullptr);
+	CHECK(cached != f);
+	CHECK(cached->number == 1);
+	CHECK(cached->GetWidth() == 320);
+	CHECK(cached->GetHeight() == 150);
+
+	// Pixels are identical
+	QImage original = f->GetImage()->convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+	std::shared_ptr<QImage> decompressed = cached->GetImage();
+	REQUIRE(decompressed->format() == QImage::Format_RGBA8888_Premultiplied);
+	bool identical = true;
+	for (int y = 0; y < 150; y++)
+		identical = identical && memcmp(original.constScanLine(y), decompressed->constScanLine(y), 320 * 4) == 0;
+	CHECK(identical);
+
+	// Audio is preserved
+	REQUIRE(cached->GetAudioChannelsCount() == 2);
+	REQUIRE(cached->GetAudioSamplesCount() == 500);
+	CHECK(cached->GetAudioSamples(0)[50] == Approx(0.5f));
+	CHECK(cached->GetAudioSamples(1)[50] == Approx(0.25f));
+
+	// Images are compressed
+	CHECK(c.GetBytes() > 0);
+	CHECK(c.GetBytes() < f->GetBytes());
+}
+
+TEST_CASE( "max bytes", "[libopenshot][cachecompressed]" )
+{
+	// Measure the compressed size of a frame
+	int64_t frame_bytes = 0;
+	{
+		CacheCompressed measure;
+		measure.Add(create_frame(1, 160, 120));
+		frame_bytes = measure.GetBytes();
+	}
+
+	// Room for about 30 frames
+	CacheCompressed c(frame_bytes * 30);
+	for (int i = 1; i <= 50; i++)
+		c.Add(create_frame(i, 160, 120));
+
+	CHECK(c.Count() <= 31);
+	CHECK(c.Count() >= 29);
+	CHECK_FALSE(c.Contains(1));
+	CHECK(c.Contains(50));
+
+	// Remove a range
+	c.Remove(40, 45);
+	CHECK_FALSE(c.Contains(42));
+	CHECK(c.GetFrames().size() == (size_t)c.Count());
+	CHECK(c.GetSmallestFrame()->number == 50 - c.Count() - 5);
+
+	c.Clear();
+	CHECK(c.Count() == 0);
+	CHECK(c.GetBytes() == 0);
+}
+
+TEST_CASE( "CacheCompressed JSON", "[libopenshot][cachecompressed]" )
+{
+	CacheCompressed c;
+
+	for (int i = 1; i <= 5; i++)
+		c.Add(create_frame(i, 32, 24));
+	for (int i = 10; i <= 12; i++)
+		c.Add(create_frame(i, 32, 24));
+
+	Json::Value root = c.JsonValue();
+	CHECK(root["type"].asString() == "CacheCompressed");
+	CHECK((int)root["ranges"].size() == 2);
+	CHECK(root["ranges"][0]["start"].asString() == "1");
+	CHECK(root["ranges"][1]["end"].asString() == "12");
+
+	CHECK_THROWS_AS(c.SetJson("{invalid"), InvalidJSON);
+}
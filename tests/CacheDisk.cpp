@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <QDir>
+#include <QFile>
 
 #include "openshot_catch.h"
 
@@ -241,3 +242,123 @@ TEST_CASE( "JSON", "[libopenshot][cachedisk]" )
 	c.Clear();
 	temp_path.removeRecursively();
 }
+
+TEST_CASE( "raw segment files", "[libopenshot][cachedisk]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/raw-segments/");
+
+	// Create cache object
+	CacheDisk c(temp_path.path().toStdString(), "RAW", 1.0, 1.0);
+
+	for (int i = 1; i <= 10; i++)
+	{
+		// Add frame (with image and audio) to the cache
+		auto f = std::make_shared<openshot::Frame>(i, 64, 48, "#ff0000", 500, 2);
+		f->AddColor(64, 48, "#ff0000");
+		float samples[500];
+		for (int s = 0; s < 500; s++)
+			samples[s] = i * 0.01f + s * 0.0001f;
+		f->AddAudio(true, 0, 0, samples, 500, 1.0);
+		f->AddAudio(true, 1, 0, samples, 500, -1.0);
+		c.Add(f);
+	}
+
+	CHECK(c.Count() == 10);
+	CHECK(c.GetBytes() == 10 * (64 * 48 * 4 + 2 * 500 * 4));
+
+	// Frames are read back from the segment file
+	auto f5 = c.GetFrame(5);
+	REQUIRE(f5 != nullptr);
+	CHECK(f5->number == 5);
+	CHECK(f5->GetWidth() == 64);
+	CHECK(f5->GetHeight() == 48);
+	CHECK(f5->GetImage()->pixel(10, 10) == qRgb(255, 0, 0));
+	CHECK(f5->GetAudioChannelsCount() == 2);
+	CHECK(f5->GetAudioSamplesCount() == 500);
+	CHECK(f5->GetAudioSamples(0)[100] == Approx(0.06f));
+	CHECK(f5->GetAudioSamples(1)[100] == Approx(-0.06f));
+
+	// Modifying a cached image does not modify the segment file
+	f5->GetImage()->fill(QColor("#0000ff"));
+	CHECK(c.GetFrame(5)->GetImage()->pixel(10, 10) == qRgb(255, 0, 0));
+
+	// Removed frames (and ranges) are no longer found
+	c.Remove(2, 4);
+	CHECK(c.Count() == 7);
+	CHECK(c.GetFrame(3) == nullptr);
+	CHECK(c.JsonValue()["ranges"].size() == 2);
+
+	// Frames are still valid after the cache is cleared
+	c.Clear();
+	CHECK(c.Count() == 0);
+	CHECK(f5->GetImage()->pixel(10, 10) == qRgb(0, 0, 255));
+	CHECK(f5->GetAudioSamples(0)[100] == Approx(0.06f));
+
+	// Clean up
+	temp_path.removeRecursively();
+}
+
+TEST_CASE( "writer threads", "[libopenshot][cachedisk]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/writer-threads/");
+
+	// Create cache object (with 2 writer threads)
+	CacheDisk c(temp_path.path().toStdString(), "PPM", 1.0, 0.25);
+	c.SetWriteThreads(2);
+	CHECK(c.GetWriteThreads() == 2);
+
+	for (int i = 1; i <= 20; i++)
+	{
+		// Add frame to the cache
+		auto f = std::make_shared<openshot::Frame>(i, 1280, 720, "Blue", 500, 2);
+		f->AddColor(1280, 720, "Blue");
+		c.Add(f);
+
+		// Pending (or written) frames are found immediately
+		CHECK(c.Contains(i));
+		CHECK(c.GetFrame(i) != nullptr);
+	}
+	CHECK(c.Count() == 20);
+
+	// Pending frames are counted (by their size in memory) before they are written
+	CHECK(c.GetBytes() > 0);
+
+	// Removed frames are never written
+	c.Remove(11, 20);
+	CHECK(c.Count() == 10);
+
+	// Written frames are read back from disk (scaled)
+	c.Flush();
+	auto f = c.GetFrame(5);
+	REQUIRE(f != nullptr);
+	CHECK(f->GetWidth() == 320);
+	CHECK(f->GetHeight() == 180);
+	CHECK(c.GetFrame(15) == nullptr);
+	CHECK_FALSE(QFile::exists(temp_path.filePath("15.ppm")));
+
+	// Frames are written by Add without writer threads
+	c.SetWriteThreads(0);
+	CHECK(c.GetWriteThreads() == 0);
+	auto f21 = std::make_shared<openshot::Frame>(21, 1280, 720, "Blue", 500, 2);
+	f21->AddColor(1280, 720, "Blue");
+	c.Add(f21);
+	CHECK(c.GetFrame(21)->GetWidth() == 320);
+
+	// Clearing waits for frames being written (and discards queued frames)
+	c.SetWriteThreads(2);
+	for (int i = 30; i <= 40; i++)
+	{
+		auto f = std::make_shared<openshot::Frame>(i, 1280, 720, "Blue", 500, 2);
+		f->AddColor(1280, 720, "Blue");
+		c.Add(f);
+	}
+	c.Clear();
+	c.Flush();
+	CHECK(c.Count() == 0);
+	CHECK(c.GetBytes() == 0);
+	CHECK(QDir(temp_path.path()).entryList(QDir::Files).isEmpty());
+
+	// Clean up
+	c.Clear();
+	temp_path.removeRecursively();
+}
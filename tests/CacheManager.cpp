@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::CacheManager
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "openshot_catch.h"
+
+#include "CacheManager.h"
+#include "CacheMemory.h"
+#include "Frame.h"
+#include "Json.h"
+#include "Settings.h"
+
+using namespace openshot;
+
+// Create a 720p frame (about 3.5 MB)
+static std::shared_ptr<Frame> create_frame(int64_t number)
+{
+	auto f = std::make_shared<Frame>(number, 1280, 720, "#000000");
+	f->AddColor(1280, 720, "#ff0000");
+	return f;
+}
+
+TEST_CASE( "memory usage", "[libopenshot][cachemanager]" )
+{
+	CacheManager* manager = CacheManager::Instance();
+	int64_t start_bytes = manager->GetBytes();
+	{
+		CacheMemory c;
+		c.Add(create_frame(1));
+		c.Add(create_frame(2));
+		CHECK(c.GetMemoryUsage() == c.GetBytes());
+		CHECK(manager->GetBytes() == start_bytes + c.GetBytes());
+
+		c.Remove(1);
+		CHECK(manager->GetBytes() == start_bytes + c.GetBytes());
+
+		// Usage of each cache
+		Json::Value root = manager->JsonValue();
+		REQUIRE(root["caches"].size() > 0);
+		CHECK(root["caches"][root["caches"].size() - 1]["type"].asString() == "CacheMemory");
+		CHECK(root["caches"][root["caches"].size() - 1]["bytes"].asString() == std::to_string(c.GetBytes()));
+	}
+
+	// Destroyed caches are removed from the total
+	CHECK(manager->GetBytes() == start_bytes);
+}
+
+TEST_CASE( "global memory limit", "[libopenshot][cachemanager]" )
+{
+	CacheManager* manager = CacheManager::Instance();
+	int64_t evicted_frames = manager->GetEvictedFrames();
+
+	CacheMemory timeline_cache;
+	timeline_cache.SetLevel(CACHE_LEVEL_TIMELINE);
+	CacheMemory reader_cache;
+	CacheMemory working_cache;
+	working_cache.SetLevel(CACHE_LEVEL_UNMANAGED);
+
+	// 40 MB for all caches (no limit per cache)
+	Settings::Instance()->CACHE_MAX_MEMORY_MB = 40;
+
+	working_cache.Add(create_frame(1));
+	working_cache.Add(create_frame(2));
+	for (int i = 1; i <= 3; i++)
+		timeline_cache.Add(create_frame(i));
+	for (int i = 1; i <= 30; i++)
+		reader_cache.Add(create_frame(i));
+
+	// Reader frames are evicted first (and unmanaged frames are never evicted)
+	CHECK(manager->GetBytes() <= manager->GetMaxBytes());
+	CHECK(working_cache.Count() == 2);
+	CHECK(timeline_cache.Count() == 3);
+	CHECK(reader_cache.Count() < 30);
+	CHECK(reader_cache.Contains(30));
+	CHECK_FALSE(reader_cache.Contains(1));
+	CHECK(manager->GetEvictedFrames() > evicted_frames);
+
+	Settings::Instance()->CACHE_MAX_MEMORY_MB = 0;
+}
+
+TEST_CASE( "concurrent eviction", "[libopenshot][cachemanager]" )
+{
+	CacheManager* manager = CacheManager::Instance();
+
+	// 40 MB for all caches (no limit per cache)
+	Settings::Instance()->CACHE_MAX_MEMORY_MB = 40;
+
+	// Threads add frames (and create / destroy caches) while frames are evicted
+	std::vector<std::thread> threads;
+	CacheMemory shared_cache;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&shared_cache, t]() {
+			for (int i = 1; i <= 10; i++) {
+				shared_cache.Add(create_frame(t * 100 + i));
+				CacheMemory local_cache;
+				local_cache.Add(create_frame(i));
+				local_cache.Add(create_frame(i + 1));
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	// The total is within the limit
+	CHECK(manager->GetBytes() <= manager->GetMaxBytes());
+	CHECK(shared_cache.Count() < 40);
+	CHECK(shared_cache.Count() > 0);
+
+	Settings::Instance()->CACHE_MAX_MEMORY_MB = 0;
+}
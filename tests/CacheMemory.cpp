@@ -11,6 +11,7 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include <memory>
+#include <vector>
 #include <QDir>
 
 #include "openshot_catch.h"
@@ -18,9 +19,16 @@
 #include "CacheMemory.h"
 #include "Frame.h"
 #include "Json.h"
+#include "Settings.h"
 
 using namespace openshot;
 
+// Restore the cache statistics setting when a test ends (even if a check fails)
+struct CacheStatsGuard {
+	const bool previous = Settings::Instance()->ENABLE_CACHE_STATS;
+	~CacheStatsGuard() { Settings::Instance()->ENABLE_CACHE_STATS = previous; }
+};
+
 TEST_CASE( "default constructor", "[libopenshot][cachememory]" )
 {
 	// Create cache object
@@ -332,3 +340,132 @@ TEST_CASE( "JSON", "[libopenshot][cachememory]" )
 	CHECK(c.JsonValue()["version"].asString() == "5");
 
 }
+
+TEST_CASE( "Greedy-Dual-Size eviction", "[libopenshot][cachememory]" )
+{
+	// Create frames (10 expensive frames, and 40 cheap frames)
+	std::vector<std::shared_ptr<Frame>> frames;
+	for (int64_t i = 1; i <= 50; i++) {
+		auto f = std::make_shared<Frame>(i, 320, 240, "#000000");
+		f->AddColor(320, 240, "#0000ff");
+		f->SetRenderTime(i <= 10 ? 400000 : 3000);
+		frames.push_back(f);
+	}
+	int64_t frame_bytes = frames.front()->GetBytes();
+
+	// Least recently used frames are evicted first
+	CacheMemory lru(frame_bytes * 30);
+	CHECK(lru.GetEvictionPolicy() == CACHE_EVICTION_LRU);
+	for (auto& f : frames)
+		lru.Add(f);
+	CHECK(lru.Count() == 30);
+	CHECK_FALSE(lru.Contains(1));
+	CHECK_FALSE(lru.Contains(10));
+
+	// Cheap frames are evicted first
+	CacheMemory cost_aware(frame_bytes * 30);
+	cost_aware.SetEvictionPolicy(CACHE_EVICTION_GREEDY_DUAL_SIZE);
+	for (auto& f : frames)
+		cost_aware.Add(f);
+	CHECK(cost_aware.Count() == 30);
+	CHECK(cost_aware.Contains(1));
+	CHECK(cost_aware.Contains(10));
+	CHECK_FALSE(cost_aware.Contains(11));
+	CHECK(cost_aware.Contains(50));
+
+	// Render time is copied with frames
+	Frame copy(*frames.front());
+	CHECK(copy.GetRenderTime() == 400000);
+}
+
+TEST_CASE( "statistics", "[libopenshot][cachememory]" )
+{
+	CacheMemory c;
+	auto f = std::make_shared<Frame>(1, 320, 240, "#000000");
+	f->AddColor(320, 240, "#0000ff");
+
+	// Not counted (by default)
+	c.Add(f);
+	c.GetFrame(1);
+	CHECK(c.GetStats()["hits"].asString() == "0");
+
+	CacheStatsGuard stats_guard;
+	Settings::Instance()->ENABLE_CACHE_STATS = true;
+	c.Add(std::make_shared<Frame>(*f));
+	c.GetFrame(1);
+	c.GetFrame(1);
+	c.GetFrame(2);
+	c.Add(std::make_shared<Frame>(2, 320, 240, "#000000"));
+
+	Json::Value stats = c.GetStats();
+	CHECK(stats["type"].asString() == "CacheMemory");
+	CHECK(stats["hits"].asString() == "2");
+	CHECK(stats["misses"].asString() == "1");
+	CHECK(stats["hit_rate"].asDouble() == Approx(2.0 / 3.0));
+	CHECK(stats["inserts"].asString() == "1");
+	CHECK(stats["evictions"].asString() == "0");
+	CHECK(stats["frames"].asString() == "2");
+
+	// Enumerating the cache is not counted as a lookup
+	CHECK(c.GetFrames().size() == 2);
+	CHECK(c.GetSmallestFrame()->number == 1);
+	CHECK(c.GetStats()["hits"].asString() == "2");
+	CHECK(c.GetStats()["misses"].asString() == "1");
+
+	// Evictions (to stay under the max bytes)
+	CacheMemory small(f->GetBytes() * 20);
+	for (int64_t i = 1; i <= 25; i++) {
+		auto added = std::make_shared<Frame>(i, 320, 240, "#000000");
+		added->AddColor(320, 240, "#0000ff");
+		small.Add(added);
+	}
+	CHECK(small.GetStats()["evictions"].asString() == "5");
+	CHECK(small.GetStats()["evicted_bytes"].asString() == std::to_string(f->GetBytes() * 5));
+
+	c.ResetStats();
+	CHECK(c.GetStats()["hits"].asString() == "0");
+	CHECK(c.GetStats()["inserts"].asString() == "0");
+}
+
+TEST_CASE( "Add, GetFrame, and Remove 100k frames", "[libopenshot][cachememory]" )
+{
+	const int64_t frame_count = 100000;
+
+	// Create blank frames
+	std::vector<std::shared_ptr<Frame>> frames;
+	frames.reserve(frame_count);
+	for (int64_t i = 1; i <= frame_count; i++)
+	{
+		auto f = std::make_shared<Frame>();
+		f->number = i;
+		frames.push_back(f);
+	}
+
+	// Limit the cache to half of the frames
+	int64_t frame_bytes = frames.front()->GetBytes();
+	CacheMemory c(frame_bytes * frame_count / 2);
+
+	for (auto& f : frames)
+		c.Add(f);
+
+	// Only the newest half of the frames remain
+	CHECK(c.Count() == frame_count / 2);
+	CHECK(c.GetBytes() == frame_bytes * frame_count / 2);
+	CHECK(c.GetSmallestFrame()->number == frame_count / 2 + 1);
+
+	int64_t found = 0;
+	for (int64_t i = 1; i <= frame_count; i++)
+		if (c.GetFrame(i))
+			found++;
+	CHECK(found == frame_count / 2);
+
+	// Remove every other frame (one at a time), and then the rest (as a range)
+	for (int64_t i = frame_count / 2 + 1; i <= frame_count; i += 2)
+		c.Remove(i);
+	CHECK(c.Count() == frame_count / 4);
+	CHECK((int)c.JsonValue()["ranges"].size() == frame_count / 4);
+	c.Remove(1, frame_count);
+
+	CHECK(c.Count() == 0);
+	CHECK(c.GetBytes() == 0);
+}
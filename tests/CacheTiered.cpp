@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::CacheTiered
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <memory>
+#include <QDir>
+
+#include "openshot_catch.h"
+
+#include "CacheTiered.h"
+#include "Frame.h"
+#include "Json.h"
+
+using namespace openshot;
+
+// Create a small frame with a solid color
+static std::shared_ptr<Frame> create_frame(int64_t number)
+{
+	auto f = std::make_shared<Frame>(number, 64, 48, "#000000");
+	f->AddColor(64, 48, QColor(number, 0, 0).name().toStdString());
+	return f;
+}
+
+TEST_CASE( "demote and promote frames", "[libopenshot][cachetiered]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/tiered-demote/");
+
+	// Create cache object (with room for 30 frames in memory)
+	int64_t frame_bytes = create_frame(1)->GetBytes();
+	CacheTiered c(temp_path.path().toStdString(), frame_bytes * 30, 0);
+
+	for (int i = 1; i <= 50; i++)
+		c.Add(create_frame(i));
+
+	// Oldest frames are demoted (not removed)
+	CHECK(c.Count() == 50);
+	CHECK(c.CountOnDisk() == 20);
+	CHECK(c.Contains(1));
+	CHECK(c.GetBytes() == frame_bytes * 30 + c.GetDiskBytes());
+	CHECK((int)c.JsonValue()["ranges"].size() == 1);
+
+	// Frames found on disk are promoted (and the oldest frame in memory is demoted)
+	auto f1 = c.GetFrame(1);
+	REQUIRE(f1 != nullptr);
+	CHECK(f1->number == 1);
+	CHECK(f1->GetWidth() == 64);
+	CHECK(qRed(f1->GetImage()->pixel(10, 10)) == 1);
+	CHECK(c.Count() == 50);
+	CHECK(c.CountOnDisk() == 20);
+
+	// All frames are returned in order (without promoting them)
+	auto frames = c.GetFrames();
+	REQUIRE(frames.size() == 50);
+	CHECK(frames[20]->number == 21);
+	CHECK(qRed(frames[20]->GetImage()->pixel(10, 10)) == 21);
+	CHECK(c.CountOnDisk() == 20);
+
+	// Remove a range from both tiers
+	c.Remove(15, 35);
+	CHECK(c.Count() == 29);
+	CHECK(c.GetFrame(20) == nullptr);
+	CHECK((int)c.JsonValue()["ranges"].size() == 2);
+
+	c.Clear();
+	CHECK(c.Count() == 0);
+	CHECK(c.GetBytes() == 0);
+	temp_path.removeRecursively();
+}
+
+TEST_CASE( "max disk bytes", "[libopenshot][cachetiered]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/tiered-max-disk/");
+
+	// Create cache object (with room for 30 frames in memory, and 10 frames on disk)
+	int64_t frame_bytes = create_frame(1)->GetBytes();
+	CacheTiered c(temp_path.path().toStdString(), frame_bytes * 30, 64 * 48 * 4 * 10);
+	CHECK(c.GetMaxDiskBytes() == 64 * 48 * 4 * 10);
+
+	for (int i = 1; i <= 50; i++)
+		c.Add(create_frame(i));
+
+	// Oldest frames on disk are removed
+	CHECK(c.Count() == 40);
+	CHECK(c.CountOnDisk() == 10);
+	CHECK_FALSE(c.Contains(10));
+	CHECK(c.Contains(11));
+
+	// JSON
+	Json::Value json = c.JsonValue();
+	CHECK(json["type"].asString() == "CacheTiered");
+	CHECK(json["max_disk_bytes"].asString() == std::to_string(64 * 48 * 4 * 10));
+	CHECK((int)json["ranges"].size() == 1);
+	CHECK(json["ranges"][0]["start"].asString() == "11");
+
+	c.Clear();
+	temp_path.removeRecursively();
+}
@@ -82,6 +82,7 @@ TEST_CASE( "basic getters and setters", "[libopenshot][clip]" )
 	CHECK(c1.End() == Approx(0.0f).margin(0.00001));
 
 	// Change some properties
+	int64_t version = c1.Version();
 	c1.Layer(1);
 	c1.Position(5.0);
 	c1.Start(3.5);
@@ -91,6 +92,14 @@ TEST_CASE( "basic getters and setters", "[libopenshot][clip]" )
 	CHECK(c1.Position() == Approx(5.0f).margin(0.00001));
 	CHECK(c1.Start() == Approx(3.5f).margin(0.00001));
 	CHECK(c1.End() == Approx(10.5f).margin(0.00001));
+
+	// Each change (and each new clip) has a new version
+	CHECK(c1.Version() > version);
+	Clip c2;
+	CHECK(c2.Version() > c1.Version());
+	version = c1.Version();
+	c1.SetJsonValue(c2.JsonValue());
+	CHECK(c1.Version() > c2.Version());
 }
 
 TEST_CASE( "properties", "[libopenshot][clip]" )
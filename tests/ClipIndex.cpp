@@ -0,0 +1,176 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::ClipIndex
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "openshot_catch.h"
+
+#include "Clip.h"
+#include "ClipIndex.h"
+#include "Fraction.h"
+
+using namespace openshot;
+
+// Find intersecting clips by checking every clip (the same rules as the index)
+static std::vector<Clip*> brute_force(std::vector<std::unique_ptr<Clip>>& clips, Fraction fps, int64_t first_frame, int64_t last_frame)
+{
+	std::vector<Clip*> matches;
+	for (auto& clip : clips) {
+		int64_t start_position = round(clip->Position() * fps.ToDouble()) + 1;
+		int64_t end_position = round((clip->Position() + clip->Duration()) * fps.ToDouble()) + 1;
+		if (start_position <= last_frame && end_position >= first_frame)
+			matches.push_back(clip.get());
+	}
+	return matches;
+}
+
+TEST_CASE( "Intersecting clips", "[libopenshot][clipindex]" )
+{
+	ClipIndex index;
+	index.FPS(Fraction(30, 1));
+
+	Clip c1;
+	c1.Layer(1);
+	c1.Position(0.0);
+	c1.End(2.0);
+
+	Clip c2;
+	c2.Layer(1);
+	c2.Position(1.0);
+	c2.End(2.0);
+
+	Clip c3;
+	c3.Layer(0);
+	c3.Position(5.0);
+	c3.End(1.0);
+
+	index.Add(&c1);
+	index.Add(&c2);
+	index.Add(&c3);
+	CHECK(index.Count() == 3);
+
+	// Frame 1 only overlaps the 1st clip
+	std::vector<Clip*> matches = index.Intersecting(1, 1);
+	REQUIRE(matches.size() == 1);
+	CHECK(matches[0] == &c1);
+
+	// Frame 40 overlaps the 1st and 2nd clips (in position order)
+	matches = index.Intersecting(40, 40);
+	REQUIRE(matches.size() == 2);
+	CHECK(matches[0] == &c1);
+	CHECK(matches[1] == &c2);
+
+	// Range overlapping all clips (sorted by layer)
+	matches = index.Intersecting(50, 160);
+	REQUIRE(matches.size() == 3);
+	CHECK(matches[0] == &c3);
+	CHECK(matches[1] == &c1);
+	CHECK(matches[2] == &c2);
+
+	// Nothing at frame 1000
+	CHECK(index.Intersecting(1000, 1000).empty());
+
+	// Move clip 3 to layer 2, and to the start of the timeline
+	c3.Layer(2);
+	c3.Position(0.0);
+	index.Update(&c3);
+	matches = index.Intersecting(1, 1);
+	REQUIRE(matches.size() == 2);
+	CHECK(matches[0] == &c1);
+	CHECK(matches[1] == &c3);
+
+	// Remove clip 1
+	index.Remove(&c1);
+	CHECK(index.Count() == 2);
+	matches = index.Intersecting(1, 1);
+	REQUIRE(matches.size() == 1);
+	CHECK(matches[0] == &c3);
+
+	// Changing the frame rate recalculates frame ranges
+	index.FPS(Fraction(60, 1));
+	matches = index.Intersecting(100, 100);
+	REQUIRE(matches.size() == 1);
+	CHECK(matches[0] == &c2);
+
+	index.Clear();
+	CHECK(index.Count() == 0);
+	CHECK(index.Intersecting(1, 1000).empty());
+}
+
+TEST_CASE( "Intersecting clips match brute force", "[libopenshot][clipindex]" )
+{
+	Fraction fps(24, 1);
+	ClipIndex index;
+	index.FPS(fps);
+
+	// Create many overlapping clips (on a single layer)
+	std::vector<std::unique_ptr<Clip>> clips;
+	for (int i = 0; i < 500; i++) {
+		std::unique_ptr<Clip> clip(new Clip());
+		clip->Layer(0);
+		clip->Position((i * 37 % 500) * 0.5);
+		clip->End(1.0 + (i * 13 % 20));
+		index.Add(clip.get());
+		clips.push_back(std::move(clip));
+	}
+
+	// Compare ranges of frames (the brute force list is in insertion order)
+	for (int64_t frame = 1; frame <= 6500; frame += 97) {
+		std::vector<Clip*> expected = brute_force(clips, fps, frame, frame + 10);
+		std::vector<Clip*> matches = index.Intersecting(frame, frame + 10);
+		CHECK(matches.size() == expected.size());
+		for (auto clip : expected)
+			CHECK(std::find(matches.begin(), matches.end(), clip) != matches.end());
+	}
+}
+
+TEST_CASE( "Clips with the same position", "[libopenshot][clipindex]" )
+{
+	ClipIndex index;
+	index.FPS(Fraction(30, 1));
+
+	// Clips at the same position are in the order they were added (not by address)
+	std::vector<std::unique_ptr<Clip>> clips;
+	for (int i = 0; i < 20; i++) {
+		std::unique_ptr<Clip> clip(new Clip());
+		clip->Position(1.0);
+		clip->End(2.0);
+		clips.push_back(std::move(clip));
+	}
+	std::vector<Clip*> expected;
+	for (int i = 19; i >= 0; i--) {
+		index.Add(clips[i].get());
+		expected.push_back(clips[i].get());
+	}
+	CHECK(index.Intersecting(40, 40) == expected);
+
+	// Moving a clip (and back) keeps its order
+	Clip* first = expected.front();
+	first->Position(3.0);
+	index.Update(first);
+	CHECK(index.Intersecting(40, 40) == std::vector<Clip*>(expected.begin() + 1, expected.end()));
+	first->Layer(1);
+	index.Update(first);
+	first->Layer(0);
+	first->Position(1.0);
+	index.Update(first);
+	CHECK(index.Intersecting(40, 40) == expected);
+
+	// Changing only the length keeps the order
+	first->End(1.5);
+	index.Update(first);
+	CHECK(index.Intersecting(40, 40) == expected);
+	CHECK(index.Intersecting(50, 50) == std::vector<Clip*>(expected.begin() + 1, expected.end()));
+}
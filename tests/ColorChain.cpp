@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::ColorChain
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "openshot_catch.h"
+
+#include <QColor>
+#include <QImage>
+
+#include "ColorChain.h"
+#include "Frame.h"
+#include "KeyFrame.h"
+#include "effects/Brightness.h"
+#include "effects/Hue.h"
+#include "effects/Negate.h"
+#include "effects/Saturation.h"
+
+using namespace openshot;
+
+// Create a frame with a gradient (including transparent and semi-transparent pixels)
+static std::shared_ptr<Frame> gradient_frame()
+{
+	auto frame = std::make_shared<Frame>(1, 64, 48, "#000000");
+	auto image = std::make_shared<QImage>(64, 48, QImage::Format_RGBA8888_Premultiplied);
+	for (int y = 0; y < image->height(); y++)
+		for (int x = 0; x < image->width(); x++)
+			image->setPixelColor(x, y, QColor(x * 4, y * 5, (x + y) * 2, (y < 8) ? 0 : 255 - x));
+	frame->AddImage(image);
+	return frame;
+}
+
+// Create a frame with a few opaque colors (1 pixel each)
+static std::shared_ptr<Frame> opaque_frame()
+{
+	auto frame = std::make_shared<Frame>(1, 4, 1, "#000000");
+	auto image = std::make_shared<QImage>(4, 1, QImage::Format_RGBA8888_Premultiplied);
+	image->setPixelColor(0, 0, QColor(200, 40, 90));
+	image->setPixelColor(1, 0, QColor(30, 160, 220));
+	image->setPixelColor(2, 0, QColor(128, 128, 128));
+	image->setPixelColor(3, 0, QColor(250, 250, 10));
+	frame->AddImage(image);
+	return frame;
+}
+
+// Get the largest difference of any channel, between the pixels of an opaque image and the expected colors
+static int max_difference(const QImage& image, const std::vector<QColor>& expected)
+{
+	int difference = 0;
+	for (int x = 0; x < int(expected.size()); x++) {
+		QColor color = image.pixelColor(x, 0);
+		difference = std::max(difference, std::abs(color.red() - expected[x].red()));
+		difference = std::max(difference, std::abs(color.green() - expected[x].green()));
+		difference = std::max(difference, std::abs(color.blue() - expected[x].blue()));
+	}
+	return difference;
+}
+
+// Get the largest difference of any channel
+static int max_difference(const QImage& a, const QImage& b)
+{
+	int difference = 0;
+	for (int y = 0; y < a.height(); y++) {
+		const uchar* a_row = a.constScanLine(y);
+		const uchar* b_row = b.constScanLine(y);
+		for (int x = 0; x < a.width() * 4; x++)
+			difference = std::max(difference, std::abs(int(a_row[x]) - int(b_row[x])));
+	}
+	return difference;
+}
+
+TEST_CASE( "identity", "[libopenshot][colorchain]" )
+{
+	auto frame = gradient_frame();
+	QImage original = frame->GetImage()->copy();
+
+	// No contrast or brightness change
+	Brightness brightness(Keyframe(0.0), Keyframe(0.0));
+	ColorChain::Apply(frame->GetImage().get(), { brightness.GetColorOperator(1) });
+	CHECK(max_difference(*frame->GetImage(), original) <= 1);
+
+	// Transparent pixels stay transparent, and alpha is not changed
+	Negate negate;
+	ColorChain::Apply(frame->GetImage().get(), { negate.GetColorOperator(1) });
+	CHECK(frame->GetImage()->pixelColor(10, 2) == QColor(0, 0, 0, 0));
+	CHECK(frame->GetImage()->pixelColor(10, 20).alpha() == original.pixelColor(10, 20).alpha());
+}
+
+TEST_CASE( "negate", "[libopenshot][colorchain]" )
+{
+	auto frame = gradient_frame();
+	QImage inverted = frame->GetImage()->copy();
+	inverted.invertPixels();
+
+	Negate negate;
+	ColorChain::Apply(frame->GetImage().get(), { negate.GetColorOperator(1) });
+	CHECK(max_difference(*frame->GetImage(), inverted) <= 2);
+}
+
+TEST_CASE( "golden pixels", "[libopenshot][colorchain]" )
+{
+	// Expected colors of opaque_frame(), calculated with the per-pixel formulas used by these effects
+	// before color operations (which truncated each effect's result, instead of rounding)
+	Brightness brightness(Keyframe(0.1), Keyframe(20.0));
+	auto frame = opaque_frame();
+	brightness.GetFrame(frame, 1);
+	CHECK(max_difference(*frame->GetImage(), {
+		QColor(237, 50, 108), QColor(38, 190, 255), QColor(153, 153, 153), QColor(255, 255, 25) }) <= 2);
+
+	Saturation saturation(Keyframe(1.5), Keyframe(1.0), Keyframe(1.2), Keyframe(1.0));
+	frame = opaque_frame();
+	saturation.GetFrame(frame, 1);
+	CHECK(max_difference(*frame->GetImage(), {
+		QColor(241, 1, 76), QColor(0, 174, 230), QColor(109, 133, 109), QColor(216, 255, 0) }) <= 2);
+
+	Hue hue(Keyframe(0.3));
+	frame = opaque_frame();
+	hue.GetFrame(frame, 1);
+	CHECK(max_difference(*frame->GetImage(), {
+		QColor(109, 192, 28), QColor(202, 25, 182), QColor(128, 128, 128), QColor(13, 255, 219) }) <= 2);
+
+	// All effects (a single pass)
+	Negate negate;
+	frame = opaque_frame();
+	ColorChain::Apply(frame->GetImage().get(), {
+		brightness.GetColorOperator(1), saturation.GetColorOperator(1), hue.GetColorOperator(1), negate.GetColorOperator(1) });
+	CHECK(max_difference(*frame->GetImage(), {
+		QColor(133, 14, 255), QColor(57, 254, 22), QColor(129, 122, 96), QColor(255, 10, 29) }) <= 3);
+}
+
+TEST_CASE( "fused vs sequential effects", "[libopenshot][colorchain]" )
+{
+	Brightness brightness(Keyframe(0.1), Keyframe(20.0));
+	Saturation saturation(Keyframe(1.5), Keyframe(1.0), Keyframe(1.2), Keyframe(1.0));
+	Hue hue(Keyframe(0.3));
+	Negate negate;
+	std::vector<EffectBase*> effects = { &brightness, &saturation, &hue, &negate };
+
+	// Each effect (one pass each)
+	auto sequential = gradient_frame();
+	for (EffectBase* effect : effects)
+		effect->GetFrame(sequential, 1);
+
+	// All effects (a single pass)
+	auto fused = gradient_frame();
+	std::vector<ColorOperator> operators;
+	for (EffectBase* effect : effects) {
+		ColorOperator color_operator = effect->GetColorOperator(1);
+		REQUIRE(color_operator);
+		operators.push_back(color_operator);
+	}
+	ColorChain::Apply(fused->GetImage().get(), operators);
+
+	// Only rounding differs (sequential effects round after each effect)
+	CHECK(max_difference(*fused->GetImage(), *sequential->GetImage()) <= 4);
+}
@@ -0,0 +1,227 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::Compositor
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "openshot_catch.h"
+
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+#include "Compositor.h"
+
+using namespace openshot;
+
+// Load a test image (as premultiplied RGBA)
+static QImage load_image(std::string name)
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << name;
+	return QImage(QString::fromStdString(path.str())).convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+}
+
+// Composite an image with QPainter (the reference implementation)
+static QImage painter_composite(const QImage& background, const QImage& source, const QTransform& transform)
+{
+	QImage canvas = background.copy();
+	QPainter painter(&canvas);
+	painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform, true);
+	painter.setTransform(transform);
+	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	painter.drawImage(0, 0, source);
+	painter.end();
+	return canvas;
+}
+
+// Get a channel of a source pixel (transparent outside of the image)
+static double source_channel(const QImage& source, int x, int y, int channel)
+{
+	if (x < 0 || y < 0 || x >= source.width() || y >= source.height())
+		return 0.0;
+	return source.constScanLine(y)[x * 4 + channel];
+}
+
+// Composite an image in double precision (the reference for the bilinear sampling of Compositor, which maps
+// each destination pixel center back to the source image). Axis-aligned images clamp samples to the edges of
+// the image, and rotated images fade to transparent (anti-aliasing their edges).
+static QImage reference_composite(const QImage& background, const QImage& source, const QTransform& transform)
+{
+	QImage canvas = background.copy();
+	const QTransform inverse = transform.inverted();
+	const bool rotated = transform.type() > QTransform::TxScale;
+	for (int y = 0; y < canvas.height(); y++) {
+		uchar* row = canvas.scanLine(y);
+		for (int x = 0; x < canvas.width(); x++) {
+			QPointF position = inverse.map(QPointF(x + 0.5, y + 0.5));
+			double sample_x = position.x() - 0.5;
+			double sample_y = position.y() - 0.5;
+			if (rotated) {
+				if (sample_x <= -1.0 || sample_y <= -1.0 || sample_x >= source.width() || sample_y >= source.height())
+					continue;
+			} else {
+				if (position.x() < 0.0 || position.y() < 0.0 || position.x() >= source.width() || position.y() >= source.height())
+					continue;
+				sample_x = std::min(std::max(0.0, sample_x), source.width() - 1.0);
+				sample_y = std::min(std::max(0.0, sample_y), source.height() - 1.0);
+			}
+
+			int x1 = std::floor(sample_x);
+			int y1 = std::floor(sample_y);
+			double weight_x = sample_x - x1;
+			double weight_y = sample_y - y1;
+			int x2 = rotated ? x1 + 1 : std::min(x1 + 1, source.width() - 1);
+			int y2 = rotated ? y1 + 1 : std::min(y1 + 1, source.height() - 1);
+
+			double pixel[4];
+			for (int channel = 0; channel < 4; channel++) {
+				double top = source_channel(source, x1, y1, channel) * (1.0 - weight_x) + source_channel(source, x2, y1, channel) * weight_x;
+				double bottom = source_channel(source, x1, y2, channel) * (1.0 - weight_x) + source_channel(source, x2, y2, channel) * weight_x;
+				pixel[channel] = top * (1.0 - weight_y) + bottom * weight_y;
+			}
+
+			// Source-over (premultiplied)
+			for (int channel = 0; channel < 4; channel++)
+				row[x * 4 + channel] = std::round(pixel[channel] + row[x * 4 + channel] * (1.0 - pixel[3] / 255.0));
+		}
+	}
+	return canvas;
+}
+
+// Get the largest difference of any channel (ignoring a border around the edges)
+static int max_difference(const QImage& a, const QImage& b, int border)
+{
+	int difference = 0;
+	for (int y = border; y < a.height() - border; y++) {
+		const uchar* a_row = a.constScanLine(y);
+		const uchar* b_row = b.constScanLine(y);
+		for (int x = border * 4; x < (a.width() - border) * 4; x++)
+			difference = std::max(difference, std::abs(int(a_row[x]) - int(b_row[x])));
+	}
+	return difference;
+}
+
+TEST_CASE( "BlendRow", "[libopenshot][compositor]" )
+{
+	// Opaque, transparent, and semi-transparent source pixels (premultiplied RGBA)
+	std::vector<uint8_t> source = {
+		255, 0, 0, 255,
+		0, 0, 0, 0,
+		0, 64, 0, 128,
+		10, 20, 30, 40,
+		200, 100, 50, 255 };
+	std::vector<uint8_t> destination(source.size());
+	for (size_t pixel = 0; pixel < destination.size() / 4; pixel++) {
+		destination[pixel * 4 + 0] = 0;
+		destination[pixel * 4 + 1] = 0;
+		destination[pixel * 4 + 2] = 200;
+		destination[pixel * 4 + 3] = 255;
+	}
+
+	Compositor::BlendRow(destination.data(), source.data(), source.size() / 4);
+
+	// Opaque source replaces destination
+	CHECK(destination[0] == 255);
+	CHECK(destination[2] == 0);
+	CHECK(destination[3] == 255);
+
+	// Transparent source leaves destination unchanged
+	CHECK(destination[4] == 0);
+	CHECK(destination[6] == 200);
+
+	// Semi-transparent source is blended (source + destination * (1 - alpha))
+	CHECK(destination[9] == 64);
+	CHECK((int)destination[10] == Approx(200 * 127 / 255.0).margin(1));
+	CHECK(destination[11] == 255);
+
+	// At zero opacity, nothing changes
+	std::vector<uint8_t> unchanged(destination);
+	Compositor::BlendRow(destination.data(), source.data(), source.size() / 4, 0);
+	CHECK(destination == unchanged);
+
+	CHECK(!Compositor::InstructionSet().empty());
+}
+
+TEST_CASE( "Composite matches reference", "[libopenshot][compositor]" )
+{
+	QImage source = load_image("front3.png");
+	QImage background(640, 360, QImage::Format_RGBA8888_Premultiplied);
+	background.fill(QColor(20, 40, 200, 255));
+
+	std::vector<QTransform> transforms;
+	transforms.push_back(QTransform());
+	transforms.push_back(QTransform().translate(-40, 25));
+	transforms.push_back(QTransform().translate(100, 50).scale(0.5, 0.5));
+	transforms.push_back(QTransform().translate(10.5, 20.25).scale(1.5, 1.25));
+
+	for (auto transform : transforms) {
+		QImage canvas = background.copy();
+		REQUIRE(Compositor::Composite(&canvas, &source, transform));
+
+		// Only the rounding of the fixed-point weights and blending differs
+		CHECK(max_difference(reference_composite(background, source, transform), canvas, 0) <= 3);
+	}
+
+	// Integer translations match exactly
+	QImage canvas = background.copy();
+	QTransform translate = QTransform().translate(30, -12);
+	REQUIRE(Compositor::Composite(&canvas, &source, translate));
+	CHECK(max_difference(painter_composite(background, source, translate), canvas, 0) <= 1);
+}
+
+TEST_CASE( "Composite rotation", "[libopenshot][compositor]" )
+{
+	QImage source = load_image("front3.png");
+	QImage background(640, 360, QImage::Format_RGBA8888_Premultiplied);
+	background.fill(Qt::transparent);
+
+	QImage canvas = background.copy();
+	QTransform transform = QTransform().translate(320, 180).rotate(30).translate(-100, -100);
+	REQUIRE(Compositor::Composite(&canvas, &source, transform));
+
+	// The whole image matches the reference (including the anti-aliased edges)
+	CHECK(max_difference(reference_composite(background, source, transform), canvas, 0) <= 4);
+
+	// The center of the rotated image is drawn (like QPainter), and the corners of the canvas are not
+	QPointF center = transform.map(QPointF(source.width() / 2.0, source.height() / 2.0));
+	QColor expected = painter_composite(background, source, transform).pixelColor(center.x(), center.y());
+	QColor actual = canvas.pixelColor(center.x(), center.y());
+	CHECK(actual.red() == Approx(expected.red()).margin(2));
+	CHECK(actual.green() == Approx(expected.green()).margin(2));
+	CHECK(actual.blue() == Approx(expected.blue()).margin(2));
+	CHECK(actual.alpha() == Approx(expected.alpha()).margin(2));
+	CHECK(canvas.pixelColor(0, 0).alpha() == 0);
+}
+
+TEST_CASE( "Composite fallback", "[libopenshot][compositor]" )
+{
+	QImage source = load_image("front3.png");
+	QImage canvas(640, 360, QImage::Format_RGBA8888_Premultiplied);
+	canvas.fill(Qt::transparent);
+
+	// Shear and perspective are not supported
+	CHECK_FALSE(Compositor::Composite(&canvas, &source, QTransform().shear(0.5, 0.0)));
+	QTransform perspective(1.0, 0.0, 0.001, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0);
+	CHECK_FALSE(Compositor::Composite(&canvas, &source, perspective));
+
+	// Other image formats are not supported
+	QImage rgb32 = source.convertToFormat(QImage::Format_RGB32);
+	CHECK_FALSE(Compositor::Composite(&canvas, &rgb32, QTransform()));
+
+	// Nothing is drawn when not supported
+	CHECK(canvas.pixelColor(10, 10).alpha() == 0);
+}
@@ -12,6 +12,7 @@
 
 #include <sstream>
 #include <memory>
+#include <vector>
 
 #include "openshot_catch.h"
 
@@ -20,6 +21,7 @@
 #include "Frame.h"
 #include "Timeline.h"
 #include "Json.h"
+#include "Settings.h"
 
 using namespace openshot;
 
@@ -173,6 +175,91 @@ TEST_CASE( "Seek", "[libopenshot][ffmpegreader]" )
 
 }
 
+TEST_CASE( "Seek with seek index", "[libopenshot][ffmpegreader]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Reader without a seek index
+	Settings::Instance()->ENABLE_SEEK_INDEX = false;
+	FFmpegReader r1(path.str());
+	r1.Open();
+	CHECK_FALSE(r1.HasSeekIndex());
+
+	// Reader with a complete (scanned) seek index
+	Settings::Instance()->ENABLE_SEEK_INDEX = true;
+	FFmpegReader r2(path.str());
+	CHECK(r2.BuildSeekIndex());
+	CHECK(r2.HasSeekIndex());
+	r2.Open();
+
+	// Random seeks return the same frames
+	for (int64_t number : {500, 300, 301, 700, 100, 275}) {
+		Settings::Instance()->ENABLE_SEEK_INDEX = false;
+		std::shared_ptr<Frame> f1 = r1.GetFrame(number);
+		Settings::Instance()->ENABLE_SEEK_INDEX = true;
+		std::shared_ptr<Frame> f2 = r2.GetFrame(number);
+
+		CHECK(f2->number == number);
+		CHECK((int) f2->GetPixels(200)[400] == Approx((int) f1->GetPixels(200)[400]).margin(5));
+		CHECK(f2->GetAudioSamplesCount() == f1->GetAudioSamplesCount());
+	}
+
+	r1.Close();
+	r2.Close();
+	Settings::Instance()->ENABLE_SEEK_INDEX = false;
+}
+
+TEST_CASE( "Prefetch thread", "[libopenshot][ffmpegreader]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	FFmpegReader r1(path.str());
+	r1.Open();
+
+	FFmpegReader r2(path.str());
+	CHECK(r2.GetPrefetch() == 0);
+	r2.SetPrefetch(8);
+	CHECK(r2.GetPrefetch() == 8);
+	r2.Open();
+
+	// Sequential reads, then a seek backwards, and a seek forwards
+	std::vector<int64_t> frames;
+	for (int64_t number = 1; number <= 40; number++)
+		frames.push_back(number);
+	for (int64_t number = 10; number <= 20; number++)
+		frames.push_back(number);
+	for (int64_t number = 500; number <= 520; number++)
+		frames.push_back(number);
+
+	for (int64_t number : frames) {
+		std::shared_ptr<Frame> f1 = r1.GetFrame(number);
+		std::shared_ptr<Frame> f2 = r2.GetFrame(number);
+		CHECK(f2->number == number);
+		CHECK((int) f2->GetPixels(200)[400] == Approx((int) f1->GetPixels(200)[400]).margin(5));
+		CHECK(f2->GetAudioSamplesCount() == f1->GetAudioSamplesCount());
+	}
+
+	// Closing stops the thread, and opening starts it again
+	r2.Close();
+	CHECK(r2.GetPrefetch() == 8);
+	r2.Open();
+	for (int64_t number = 1; number <= 20; number++) {
+		std::shared_ptr<Frame> f1 = r1.GetFrame(number);
+		std::shared_ptr<Frame> f2 = r2.GetFrame(number);
+		CHECK(f2->number == number);
+		CHECK((int) f2->GetPixels(200)[400] == Approx((int) f1->GetPixels(200)[400]).margin(5));
+	}
+
+	// Disable prefetching (stops the thread)
+	r2.SetPrefetch(0);
+	CHECK(r2.GetFrame(521)->number == 521);
+
+	r1.Close();
+	r2.Close();
+}
+
 TEST_CASE( "Frame_Rate", "[libopenshot][ffmpegreader]" )
 {
 	// Create a reader
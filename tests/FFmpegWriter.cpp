@@ -10,8 +10,10 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <cmath>
 #include <sstream>
 #include <memory>
+#include <vector>
 
 #include "openshot_catch.h"
 
@@ -233,3 +235,167 @@ TEST_CASE( "Gif", "[libopenshot][ffmpegwriter]" )
     // Close reader
     r1.Close();
 }
+
+TEST_CASE( "Pipeline", "[libopenshot][ffmpegwriter]" )
+{
+	// Reader
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	FFmpegReader r(path.str());
+	r.Open();
+
+	/* WRITER ---------------- */
+	FFmpegWriter w("Pipeline-output1.webm");
+	CHECK(w.GetPipeline() == 0);
+	w.SetPipeline(8);
+	CHECK(w.GetPipeline() == 8);
+
+	// Set options
+	w.SetAudioOptions(true, "libvorbis", 44100, 2, LAYOUT_STEREO, 188000);
+	w.SetVideoOptions(true, "libvpx", Fraction(24,1), 1280, 720, Fraction(1,1), false, false, 30000000);
+
+	// Open writer
+	w.Open();
+
+	// Write some frames (which are encoded on the pipeline threads)
+	w.WriteFrame(&r, 24, 50);
+
+	// Close writer & reader (which encodes the queued frames)
+	w.Close();
+	r.Close();
+
+	FFmpegReader r1("Pipeline-output1.webm");
+	r1.Open();
+
+	// Verify various settings on new file
+	CHECK(r1.GetFrame(1)->GetAudioChannelsCount() == 2);
+	CHECK(r1.info.fps.num == 24);
+
+	// Get the image data for row 500 (same as the Webm test, which encodes on the caller's thread)
+	std::shared_ptr<Frame> f = r1.GetFrame(8);
+	const unsigned char* pixels = f->GetPixels(500);
+	int pixel_index = 112 * 4; // pixel 112 (4 bytes per pixel)
+
+	CHECK((int)pixels[pixel_index] == Approx(23).margin(7));
+	CHECK((int)pixels[pixel_index + 1] == Approx(23).margin(7));
+	CHECK((int)pixels[pixel_index + 2] == Approx(23).margin(7));
+	CHECK((int)pixels[pixel_index + 3] == Approx(255).margin(7));
+}
+
+TEST_CASE( "Audio_S16", "[libopenshot][ffmpegwriter]" )
+{
+	// A codec which needs interleaved S16 samples (converted by the resampler)
+	FFmpegWriter w("Audio-output1.wav");
+	w.SetAudioOptions(true, "pcm_s16le", 44100, 2, LAYOUT_STEREO, 705600);
+	w.Open();
+
+	// Write 10 frames of a sine wave (with the right channel inverted)
+	const int samples_per_frame = 1470;
+	std::vector<float> left(samples_per_frame);
+	std::vector<float> right(samples_per_frame);
+	for (int64_t number = 1; number <= 10; number++) {
+		for (int s = 0; s < samples_per_frame; s++) {
+			int64_t sample = (number - 1) * samples_per_frame + s;
+			left[s] = 0.5f * sin(2.0 * M_PI * 440.0 * sample / 44100.0);
+			right[s] = -left[s];
+		}
+		auto f = std::make_shared<Frame>(number, samples_per_frame, 2);
+		f->SampleRate(44100);
+		f->ChannelsLayout(LAYOUT_STEREO);
+		f->AddAudio(true, 0, 0, left.data(), samples_per_frame, 1.0f);
+		f->AddAudio(true, 1, 0, right.data(), samples_per_frame, 1.0f);
+		w.WriteFrame(f);
+	}
+	w.Close();
+
+	FFmpegReader r1("Audio-output1.wav");
+	r1.Open();
+
+	// All samples are written (including the last partial codec frame)
+	CHECK(r1.info.channels == 2);
+	CHECK(r1.info.sample_rate == 44100);
+	CHECK(r1.info.duration == Approx(10.0 * samples_per_frame / 44100.0).margin(0.01));
+
+	// Samples survive the conversion to S16 (and stay in the right channel)
+	std::shared_ptr<Frame> f = r1.GetFrame(1);
+	float expected = 0.5f * sin(2.0 * M_PI * 440.0 * 100 / 44100.0);
+	CHECK(f->GetAudioSamples(0)[100] == Approx(expected).margin(0.001));
+	CHECK(f->GetAudioSamples(1)[100] == Approx(-expected).margin(0.001));
+	r1.Close();
+}
+
+TEST_CASE( "SmartRender", "[libopenshot][ffmpegwriter]" )
+{
+	// Encoder options of the source (and output), with a keyframe every second. Packets are only
+	// copied when the codec parameters (i.e. the SPS / PPS of H.264) of both files are identical.
+	auto set_options = [](FFmpegWriter& writer) {
+		writer.SetAudioOptions(true, "aac", 48000, 2, LAYOUT_STEREO, 128000);
+		writer.SetVideoOptions(true, "libx264", Fraction(24,1), 1280, 720, Fraction(1,1), false, false, 3000000);
+		writer.PrepareStreams();
+		writer.SetOption(VIDEO_STREAM, "x264-params", "keyint=24:min-keyint=24:scenecut=0");
+	};
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	FFmpegReader sintel(path.str());
+	sintel.Open();
+	FFmpegWriter source_writer("SmartRender-source.mp4");
+	set_options(source_writer);
+	source_writer.Open();
+	source_writer.WriteFrame(&sintel, 1, 192);
+	source_writer.Close();
+	sintel.Close();
+
+	// A trimmed clip (source frames 37 to 156), which is copied from its first keyframe inside the
+	// range (source frame 49) to the frame before its last keyframe inside the range (source frame 145)
+	Timeline t(1280, 720, Fraction(24, 1), 48000, 2, LAYOUT_STEREO);
+	Clip c("SmartRender-source.mp4");
+	c.Start(1.5);
+	c.End(6.5);
+	t.AddClip(&c);
+	t.Open();
+
+	FFmpegWriter w("SmartRender-output1.mp4");
+	CHECK_FALSE(w.GetSmartRender());
+	w.SetSmartRender(true);
+	CHECK(w.GetSmartRender());
+
+	set_options(w);
+	w.Open();
+	w.WriteFrame(&t, 1, 120);
+	w.Close();
+	t.Close();
+
+	FFmpegReader r1("SmartRender-output1.mp4");
+	r1.Open();
+	CHECK(r1.info.width == 1280);
+	CHECK(r1.info.height == 720);
+	CHECK(r1.info.video_length == Approx(120).margin(2));
+	CHECK(r1.GetFrame(1)->GetAudioChannelsCount() == 2);
+
+	// Every frame is close to the source frame (whether copied or encoded)
+	FFmpegReader r2("SmartRender-source.mp4");
+	r2.Open();
+	const int64_t copy_first = 13;
+	const int64_t copy_last = 108;
+	int64_t copied_mismatches = 0;
+	for (int64_t number = 1; number <= 120; number++) {
+		std::shared_ptr<Frame> output = r1.GetFrame(number);
+		std::shared_ptr<Frame> source = r2.GetFrame(number + 36);
+		const unsigned char* output_pixels = output->GetPixels(360);
+		const unsigned char* source_pixels = source->GetPixels(360);
+		int pixel_index = 640 * 4;
+		CHECK((int)output_pixels[pixel_index] == Approx((int)source_pixels[pixel_index]).margin(12));
+		CHECK((int)output_pixels[pixel_index + 1] == Approx((int)source_pixels[pixel_index + 1]).margin(12));
+		CHECK((int)output_pixels[pixel_index + 2] == Approx((int)source_pixels[pixel_index + 2]).margin(12));
+
+		if (number >= copy_first && number <= copy_last && *output->GetImage() != *source->GetImage())
+			copied_mismatches++;
+	}
+#if IS_FFMPEG_3_2 && defined(AV_CODEC_CAP_ENCODER_FLUSH)
+	// Copied frames decode to exactly the source frames (encoders which can't be reset never copy)
+	CHECK(copied_mismatches == 0);
+#endif
+	r1.Close();
+	r2.Close();
+}
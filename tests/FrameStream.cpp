@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::FrameStream
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "openshot_catch.h"
+
+#include "Clip.h"
+#include "DummyReader.h"
+#include "Exceptions.h"
+#include "FFmpegReader.h"
+#include "Frame.h"
+#include "FrameStream.h"
+
+using namespace openshot;
+
+TEST_CASE( "Frames are returned in order", "[libopenshot][framestream]" )
+{
+	// Produce frames out of order (later frames are faster)
+	FrameStream stream([](int64_t number) {
+		std::this_thread::sleep_for(std::chrono::milliseconds((10 - number % 10) * 2));
+		return std::make_shared<Frame>(number, 10, 10, "#000000");
+	}, 5, 30, 8, 4);
+
+	CHECK(stream.Start() == 5);
+	CHECK(stream.Count() == 30);
+
+	int64_t expected = 5;
+	while (std::shared_ptr<Frame> f = stream.Next()) {
+		CHECK(f->number == expected);
+		expected++;
+	}
+	CHECK(expected == 35);
+	CHECK(stream.Position() == 35);
+
+	// Stream is finished
+	CHECK(stream.Next() == nullptr);
+}
+
+TEST_CASE( "Read-ahead is limited", "[libopenshot][framestream]" )
+{
+	std::atomic<int64_t> max_requested(0);
+	FrameStream stream([&max_requested](int64_t number) {
+		int64_t previous = max_requested.load();
+		while (number > previous && !max_requested.compare_exchange_weak(previous, number)) {}
+		return std::make_shared<Frame>(number, 10, 10, "#000000");
+	}, 1, 100, 4, 2);
+
+	// Start workers, and wait for them to fill the read-ahead window
+	stream.Run();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(max_requested.load() == 4);
+
+	// Each returned frame allows 1 more frame to be requested
+	CHECK(stream.Next()->number == 1);
+	CHECK(stream.Next()->number == 2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(max_requested.load() == 6);
+
+	// Skipping frames moves the window
+	stream.Advance(50);
+	CHECK(stream.Next()->number == 50);
+	CHECK(max_requested.load() <= 54);
+
+	// Cancelled streams return no frames
+	stream.Cancel();
+	CHECK(stream.Next() == nullptr);
+}
+
+TEST_CASE( "Exceptions are thrown in order", "[libopenshot][framestream]" )
+{
+	FrameStream stream([](int64_t number) -> std::shared_ptr<Frame> {
+		if (number == 3)
+			throw OutOfBoundsFrame("Invalid frame", number, 10);
+		return std::make_shared<Frame>(number, 10, 10, "#000000");
+	}, 1, 5, 8, 2);
+
+	CHECK(stream.Next()->number == 1);
+	CHECK(stream.Next()->number == 2);
+	CHECK_THROWS_AS(stream.Next(), OutOfBoundsFrame);
+
+	// Frames after the error are still returned
+	CHECK(stream.Next()->number == 4);
+	CHECK(stream.Next()->number == 5);
+	CHECK(stream.Next() == nullptr);
+}
+
+TEST_CASE( "ReaderBase GetFrames", "[libopenshot][framestream]" )
+{
+	DummyReader r(Fraction(30, 1), 64, 36, 44100, 2, 2.0);
+	r.Open();
+
+	std::shared_ptr<FrameStream> stream = r.GetFrames(10, 20);
+	int64_t expected = 10;
+	while (std::shared_ptr<Frame> f = stream->Next()) {
+		CHECK(f->number == expected);
+		expected++;
+	}
+	CHECK(expected == 30);
+
+	// Empty range
+	CHECK(r.GetFrames(1, 0)->Next() == nullptr);
+}
+
+TEST_CASE( "Clip GetFrames matches GetFrame", "[libopenshot][framestream]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "test.mp4";
+	Clip c(path.str());
+	c.Open();
+
+	Clip c2(path.str());
+	c2.Open();
+
+	// Frames from a stream (with the reader decoding ahead) match individual frames
+	std::shared_ptr<FrameStream> stream = c.GetFrames(1, 24);
+	int64_t expected = 1;
+	while (std::shared_ptr<Frame> f = stream->Next()) {
+		std::shared_ptr<Frame> f2 = c2.GetFrame(expected);
+		CHECK(f->number == expected);
+		CHECK(f->GetAudioSamplesCount() == f2->GetAudioSamplesCount());
+		CHECK(f->GetPixels(100)[400] == Approx(f2->GetPixels(100)[400]).margin(1));
+		expected++;
+	}
+	CHECK(expected == 25);
+
+	// The stream must be destroyed before the clip is closed
+	stream.reset();
+	c.Close();
+	c2.Close();
+}
@@ -14,6 +14,8 @@
 
 #include <sstream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "KeyFrame.h"
 #include "Coordinate.h"
@@ -569,6 +571,146 @@ R"(│Frame# (X) │     Y Value │ Delta Y │ Increasing?│
 	CHECK(output.str().substr(0, expected.size()) == expected);
 }
 
+TEST_CASE( "Constant keyframes", "[libopenshot][keyframe]" )
+{
+	Keyframe kf;
+	CHECK(kf.IsConstant());
+	kf.AddPoint(1, 2.5);
+	kf.AddPoint(100, 2.5, LINEAR);
+	CHECK(kf.IsConstant());
+	CHECK(kf.GetValue(50) == Approx(2.5));
+
+	// A different value makes the keyframe vary
+	kf.AddPoint(50, 5.0);
+	CHECK_FALSE(kf.IsConstant());
+	CHECK(kf.GetValue(50) == Approx(5.0));
+
+	// Overwriting (or removing) the different value makes it constant again
+	kf.AddPoint(50, 2.5);
+	CHECK(kf.IsConstant());
+	kf.AddPoint(75, 1.0);
+	kf.RemovePoint(Point(75, 1.0));
+	CHECK(kf.IsConstant());
+
+	kf.SetJson("{\"Points\": [{\"co\": {\"X\": 1, \"Y\": 0}}, {\"co\": {\"X\": 10, \"Y\": 1}}]}");
+	CHECK_FALSE(kf.IsConstant());
+}
+
+TEST_CASE( "GetValues", "[libopenshot][keyframe]" )
+{
+	Keyframe kf;
+	kf.AddPoint(1, 0.0);
+	kf.AddPoint(30, 100.0, LINEAR);
+	kf.AddPoint(60, -50.0, BEZIER);
+	kf.AddPoint(90, 25.0, CONSTANT);
+
+	// Same values as GetValue (including before the first point, and after the last point)
+	std::vector<double> values = kf.GetValues(-10, 120);
+	REQUIRE(values.size() == 120);
+	for (int64_t i = 0; i < 120; i++)
+		CHECK(values[i] == kf.GetValue(i - 10));
+
+	// Constant keyframes
+	Keyframe constant(3.0);
+	double constant_values[5];
+	constant.GetValues(1, 5, constant_values);
+	CHECK(constant_values[4] == Approx(3.0));
+	CHECK(Keyframe().GetValues(1, 3)[2] == Approx(0.0));
+}
+
+TEST_CASE( "Points added in descending order", "[libopenshot][keyframe]" )
+{
+	// A point inserted before the first point makes the keyframe vary
+	Keyframe kf;
+	kf.AddPoint(10, 5.0, LINEAR);
+	kf.AddPoint(1, 0.0, LINEAR);
+	CHECK_FALSE(kf.IsConstant());
+	CHECK(kf.GetValue(1) == Approx(0.0));
+	CHECK(kf.GetValue(10) == Approx(5.0));
+	CHECK(kf.GetValues(1, 10)[9] == Approx(5.0));
+
+	// Same for JSON with unsorted points
+	Keyframe loaded;
+	loaded.SetJson(R"json({"Points": [
+		{"co": {"X": 20.0, "Y": 8.0}, "interpolation": 1},
+		{"co": {"X": 10.0, "Y": 8.0}, "interpolation": 1},
+		{"co": {"X": 1.0, "Y": 2.0}, "interpolation": 1}
+	]})json");
+	CHECK_FALSE(loaded.IsConstant());
+	CHECK(loaded.GetValue(1) == Approx(2.0));
+	CHECK(loaded.GetValue(20) == Approx(8.0));
+
+	// Equal values (in any order) are still constant
+	Keyframe constant;
+	constant.AddPoint(10, 3.0);
+	constant.AddPoint(1, 3.0);
+	CHECK(constant.IsConstant());
+	CHECK(constant.GetValue(5) == Approx(3.0));
+}
+
+TEST_CASE( "Lookup table", "[libopenshot][keyframe]" )
+{
+	Keyframe kf;
+	kf.AddPoint(1, 0.0);
+	kf.AddPoint(50, 100.0);
+	kf.AddPoint(100, 0.0, LINEAR);
+	Keyframe expected = kf;
+
+	kf.SetLookupRange(1, 100);
+	for (int64_t i = -5; i <= 110; i++)
+		CHECK(kf.GetValue(i) == expected.GetValue(i));
+	CHECK(kf.GetValues(10, 20) == expected.GetValues(10, 20));
+
+	// The table is rebuilt after points change
+	kf.AddPoint(75, -20.0, LINEAR);
+	expected.AddPoint(75, -20.0, LINEAR);
+	for (int64_t i = 1; i <= 100; i++)
+		CHECK(kf.GetValue(i) == expected.GetValue(i));
+
+	// Copies share the table (until either one changes)
+	Keyframe copy = kf;
+	copy.AddPoint(25, 10.0);
+	CHECK(kf.GetValue(25) == expected.GetValue(25));
+	CHECK(copy.GetValue(25) == Approx(10.0));
+
+	// Many threads build (and copy) the table at the same time
+	kf.SetLookupRange(1, 100);
+	std::vector<std::thread> threads;
+	std::vector<int> mismatches(4, 0);
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&kf, &expected, &mismatches, t]() {
+			for (int64_t i = 1; i <= 100; i++) {
+				Keyframe shared = kf;
+				if (kf.GetValue(i) != expected.GetValue(i) || shared.GetValue(i) != expected.GetValue(i))
+					mismatches[t]++;
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	CHECK(mismatches == std::vector<int>(4, 0));
+}
+
+TEST_CASE( "edits", "[libopenshot][keyframe]" )
+{
+	// Constructing, copying, and loading keyframes are not edits
+	int64_t edits = Keyframe::Edits();
+	Keyframe kf(1.0);
+	Keyframe copy = kf;
+	Keyframe loaded;
+	loaded.SetJsonValue(kf.JsonValue());
+	CHECK(Keyframe::Edits() == edits);
+
+	// Changing points is
+	kf.AddPoint(50, 2.0);
+	CHECK(Keyframe::Edits() == edits + 1);
+	kf.RemovePoint(1);
+	kf.ScalePoints(2.0);
+	kf.FlipPoints();
+	copy = kf;
+	CHECK(Keyframe::Edits() == edits + 5);
+}
+
 #ifdef USE_OPENCV
 TEST_CASE( "TrackedObjectBBox init", "[libopenshot][keyframe]" )
 {
@@ -599,6 +741,49 @@ TEST_CASE( "TrackedObjectBBox init", "[libopenshot][keyframe]" )
 	CHECK(kfb.background.alpha.GetInt(1) == 212);
 }
 
+TEST_CASE( "ChangedRange", "[libopenshot][keyframe]" )
+{
+	Keyframe kf1;
+	kf1.AddPoint(1, 0.0);
+	kf1.AddPoint(50, 100.0);
+	kf1.AddPoint(100, 0.0);
+	kf1.AddPoint(150, 50.0);
+
+	int64_t first_frame = 0;
+	int64_t last_frame = 0;
+
+	// Identical keyframes
+	Keyframe kf2 = kf1;
+	CHECK_FALSE(kf1.ChangedRange(kf2, first_frame, last_frame));
+
+	// Modify a middle point (only the segments next to it change)
+	kf2.UpdatePoint(2, Point(100, 25.0));
+	CHECK(kf1.ChangedRange(kf2, first_frame, last_frame));
+	CHECK(first_frame == 50);
+	CHECK(last_frame == 150);
+
+	// Modify the first point (all earlier frames change)
+	Keyframe kf3 = kf1;
+	kf3.UpdatePoint(0, Point(1, 10.0));
+	CHECK(kf1.ChangedRange(kf3, first_frame, last_frame));
+	CHECK(first_frame == 1);
+	CHECK(last_frame == 50);
+
+	// Add a point after the last point (all later frames change)
+	Keyframe kf4 = kf1;
+	kf4.AddPoint(200, 0.0);
+	CHECK(kf1.ChangedRange(kf4, first_frame, last_frame));
+	CHECK(first_frame == 150);
+	CHECK(last_frame == INT64_MAX);
+
+	// Insert a point between 2 points
+	Keyframe kf5 = kf1;
+	kf5.AddPoint(75, 80.0);
+	CHECK(kf1.ChangedRange(kf5, first_frame, last_frame));
+	CHECK(first_frame == 50);
+	CHECK(last_frame == 100);
+}
+
 TEST_CASE( "TrackedObjectBBox AddBox and RemoveBox", "[libopenshot][keyframe]" )
 {
 	TrackedObjectBBox kfb;
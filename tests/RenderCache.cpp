@@ -0,0 +1,248 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::RenderCache
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <QDir>
+#include <QDirIterator>
+
+#include "openshot_catch.h"
+
+#include "Clip.h"
+#include "Frame.h"
+#include "KeyFrame.h"
+#include "RenderCache.h"
+#include "Settings.h"
+#include "Timeline.h"
+
+using namespace openshot;
+
+TEST_CASE( "keys", "[libopenshot][rendercache]" )
+{
+	Keyframe alpha;
+	alpha.AddPoint(1, 1.0, LINEAR);
+	alpha.AddPoint(100, 0.0, LINEAR);
+	Json::Value root;
+	root["id"] = "clip";
+	root["alpha"] = alpha.JsonValue();
+
+	RenderCache key1;
+	key1.AddJson(root, 10);
+	RenderCache key2;
+	key2.AddJson(root, 10);
+	CHECK(key1.Key() == key2.Key());
+	CHECK(key1.Key().size() == 40);
+
+	// Keyframe values at other frames do not change the key
+	Keyframe extended = alpha;
+	extended.AddPoint(200, 0.0, LINEAR);
+	Json::Value extended_root = root;
+	extended_root["alpha"] = extended.JsonValue();
+	RenderCache key3;
+	key3.AddJson(extended_root, 10);
+	CHECK(key3.Key() == key1.Key());
+
+	// Keyframe values at the frame change the key
+	Keyframe edited = alpha;
+	edited.AddPoint(20, 0.1, LINEAR);
+	Json::Value edited_root = root;
+	edited_root["alpha"] = edited.JsonValue();
+	RenderCache key4;
+	key4.AddJson(edited_root, 10);
+	CHECK(key4.Key() != key1.Key());
+
+	// Other properties change the key
+	Json::Value renamed_root = root;
+	renamed_root["id"] = "other";
+	RenderCache key5;
+	key5.AddJson(renamed_root, 10);
+	CHECK(key5.Key() != key1.Key());
+
+	// A cached template key (and its keyframes) makes the same key
+	std::vector<Keyframe> keyframes;
+	std::string template_key = RenderCache::TemplateKey(root, keyframes);
+	REQUIRE(keyframes.size() == 1);
+	RenderCache key6;
+	key6.AddString(template_key);
+	key6.AddKeyframes(keyframes, 10);
+	CHECK(key6.Key() == key1.Key());
+}
+
+TEST_CASE( "save and load frames", "[libopenshot][rendercache]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/render-cache-frames/");
+	Settings::Instance()->PATH_RENDER_CACHE = temp_path.path().toStdString();
+
+	auto f = std::make_shared<Frame>(5, 160, 90, "#000000", 800, 2);
+	f->AddColor(160, 90, "#2080c0");
+	float samples[800];
+	for (int s = 0; s < 800; s++)
+		samples[s] = (s % 50) / 50.0f;
+	f->AddAudio(true, 0, 0, samples, 800, 1.0);
+	f->AddAudio(true, 1, 0, samples, 800, -1.0);
+
+	std::string frame_path = RenderCache::FramePath("0123456789abcdef");
+	CHECK(RenderCache::Load(frame_path, 5) == nullptr);
+	REQUIRE(RenderCache::Save(frame_path, f));
+
+	auto loaded = RenderCache::Load(frame_path, 7);
+	REQUIRE(loaded != nullptr);
+	CHECK(loaded->number == 7);
+	CHECK(loaded->GetWidth() == 160);
+	CHECK(loaded->GetHeight() == 90);
+	CHECK(loaded->GetImage()->pixelColor(80, 45) == f->GetImage()->pixelColor(80, 45));
+	REQUIRE(loaded->GetAudioChannelsCount() == 2);
+	REQUIRE(loaded->GetAudioSamplesCount() == 800);
+	CHECK(loaded->GetAudioSamples(0)[25] == Approx(0.5f));
+	CHECK(loaded->GetAudioSamples(1)[25] == Approx(-0.5f));
+
+	// Frames saved on a background thread are copied (so the caller may modify them)
+	std::string async_path = RenderCache::FramePath("0123456789abcdee");
+	RenderCache::SaveAsync(async_path, f);
+	f->AddColor(160, 90, "#ff0000");
+	f->AddAudio(true, 0, 0, samples, 800, 0.0);
+	RenderCache::Flush();
+	loaded = RenderCache::Load(async_path, 5);
+	REQUIRE(loaded != nullptr);
+	CHECK(loaded->GetImage()->pixelColor(80, 45) == QColor("#2080c0"));
+	CHECK(loaded->GetAudioSamples(0)[25] == Approx(0.5f));
+
+	// Disabled
+	Settings::Instance()->PATH_RENDER_CACHE = "";
+	CHECK(RenderCache::FramePath("0123456789abcdef").empty());
+	temp_path.removeRecursively();
+}
+
+TEST_CASE( "timeline frames", "[libopenshot][rendercache]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/render-cache-timeline/");
+	temp_path.removeRecursively();
+	Settings::Instance()->PATH_RENDER_CACHE = temp_path.path().toStdString();
+
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "test.mp4";
+
+	// Count frames in the render cache
+	auto count_frames = [&]() {
+		int count = 0;
+		QDirIterator files(temp_path.path(), QStringList() << "*.frame", QDir::Files, QDirIterator::Subdirectories);
+		while (files.hasNext()) {
+			files.next();
+			count++;
+		}
+		return count;
+	};
+
+	std::shared_ptr<Frame> rendered;
+	{
+		Timeline t(320, 180, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+		Clip clip(path.str());
+		t.AddClip(&clip);
+		t.Open();
+		rendered = t.GetFrame(10);
+		t.GetFrame(11);
+		t.Close();
+	}
+	RenderCache::Flush();
+	CHECK(count_frames() == 2);
+
+	// The same project (in a new timeline) loads frames from the render cache
+	{
+		Timeline t(320, 180, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+		Clip clip(path.str());
+		t.AddClip(&clip);
+		t.Open();
+		auto loaded = t.GetFrame(10);
+		CHECK(count_frames() == 2);
+		CHECK(loaded->GetImage()->pixelColor(160, 90) == rendered->GetImage()->pixelColor(160, 90));
+		CHECK(loaded->GetAudioSamplesCount() == rendered->GetAudioSamplesCount());
+
+		// Changed clips are rendered again
+		clip.alpha.AddPoint(1, 0.5);
+		t.GetCache()->Clear();
+		t.GetFrame(10);
+		RenderCache::Flush();
+		CHECK(count_frames() == 3);
+
+		// Changed JSON is rendered again (i.e. edits applied by the UI)
+		Json::Value changed = clip.JsonValue();
+		changed["gravity"] = GRAVITY_TOP_LEFT;
+		clip.SetJsonValue(changed);
+		t.GetCache()->Clear();
+		t.GetFrame(10);
+		RenderCache::Flush();
+		CHECK(count_frames() == 4);
+
+		// Changed parent clips are rendered again (even if they don't intersect the frame)
+		Clip parent(path.str());
+		parent.Id("parent");
+		parent.Position(100.0);
+		t.AddClip(&parent);
+		clip.AttachToObject("parent");
+		t.GetCache()->Clear();
+		t.GetFrame(10);
+		RenderCache::Flush();
+		CHECK(count_frames() == 5);
+		parent.location_x.AddPoint(1, 0.25);
+		t.GetCache()->Clear();
+		t.GetFrame(10);
+		RenderCache::Flush();
+		CHECK(count_frames() == 6);
+		t.Close();
+	}
+
+	Settings::Instance()->PATH_RENDER_CACHE = "";
+	temp_path.removeRecursively();
+}
+
+TEST_CASE( "max size", "[libopenshot][rendercache]" )
+{
+	QDir temp_path = QDir::tempPath() + QString("/render-cache-size/");
+	temp_path.removeRecursively();
+	Settings::Instance()->PATH_RENDER_CACHE = temp_path.path().toStdString();
+	Settings::Instance()->RENDER_CACHE_MAX_MB = 1;
+
+	// Frames of noise (which don't compress), about 225 KB each
+	std::vector<std::string> frame_paths;
+	for (int number = 1; number <= 10; number++) {
+		auto f = std::make_shared<Frame>(number, 320, 180, "#000000");
+		std::shared_ptr<QImage> image = f->GetImage();
+		for (int y = 0; y < image->height(); y++) {
+			for (int x = 0; x < image->width(); x++)
+				image->setPixel(x, y, qRgba((x * 7 + y * 13 + number) % 256, (x * y + number * 31) % 256, (x ^ y) % 256, 255));
+		}
+
+		std::stringstream key;
+		key << "size" << number;
+		frame_paths.push_back(RenderCache::FramePath(key.str()));
+		RenderCache::SaveAsync(frame_paths.back(), f);
+		RenderCache::Flush();
+
+		// Use the first frame (so it is removed last)
+		if (number > 1)
+			CHECK(RenderCache::Load(frame_paths.front(), 1) != nullptr);
+	}
+
+	// The least recently used frames are removed
+	CHECK(RenderCache::GetBytes() <= 1024 * 1024);
+	CHECK(RenderCache::Load(frame_paths.back(), 10) != nullptr);
+	CHECK(RenderCache::Load(frame_paths.front(), 1) != nullptr);
+	CHECK(RenderCache::Load(frame_paths[1], 2) == nullptr);
+
+	Settings::Instance()->RENDER_CACHE_MAX_MB = 4096;
+	Settings::Instance()->PATH_RENDER_CACHE = "";
+	temp_path.removeRecursively();
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::RenditionWriter
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <memory>
+#include <sstream>
+
+#include <QColor>
+
+#include "openshot_catch.h"
+
+#include "Exceptions.h"
+#include "FFmpegReader.h"
+#include "FFmpegWriter.h"
+#include "Frame.h"
+#include "RenditionWriter.h"
+
+using namespace openshot;
+
+TEST_CASE( "Default constructor", "[libopenshot][renditionwriter]" )
+{
+	RenditionWriter w;
+	CHECK(w.GetRenditionCount() == 0);
+	CHECK(w.GetQueueSize() == 8);
+	CHECK_FALSE(w.IsOpen());
+
+	// Queue size is at least 1
+	w.SetQueueSize(0);
+	CHECK(w.GetQueueSize() == 1);
+	w.SetQueueSize(24);
+	CHECK(w.GetQueueSize() == 24);
+
+	// Frames can't be written before opening
+	auto f = std::make_shared<Frame>(1, 640, 360, "#000000", 1470, 2);
+	CHECK_THROWS_AS(w.WriteFrame(f), WriterClosed);
+}
+
+TEST_CASE( "Write renditions", "[libopenshot][renditionwriter]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	FFmpegReader r(path.str());
+	r.Open();
+
+	// An ABR ladder of 3 sizes
+	FFmpegWriter w720("Rendition-720.webm");
+	w720.SetAudioOptions(true, "libvorbis", 44100, 2, LAYOUT_STEREO, 128000);
+	w720.SetVideoOptions(true, "libvpx", Fraction(24, 1), 1280, 720, Fraction(1, 1), false, false, 3000000);
+	FFmpegWriter w360("Rendition-360.webm");
+	w360.SetAudioOptions(true, "libvorbis", 44100, 2, LAYOUT_STEREO, 128000);
+	w360.SetVideoOptions(true, "libvpx", Fraction(24, 1), 640, 360, Fraction(1, 1), false, false, 1000000);
+	FFmpegWriter w180("Rendition-180.webm");
+	w180.SetAudioOptions(true, "libvorbis", 44100, 2, LAYOUT_STEREO, 128000);
+	w180.SetVideoOptions(true, "libvpx", Fraction(24, 1), 320, 180, Fraction(1, 1), false, false, 300000);
+
+	RenditionWriter w;
+	w.AddRendition(&w720);
+	w.AddRendition(&w360);
+	w.AddRendition(&w180);
+	w.SetQueueSize(4);
+	CHECK(w.GetRenditionCount() == 3);
+	CHECK(w.info.width == 1280);
+
+	w.Open();
+	CHECK(w.IsOpen());
+	CHECK(w720.IsOpen());
+	CHECK_THROWS_AS(w.AddRendition(&w180), WriterClosed);
+
+	w.WriteFrame(&r, 24, 71);
+	w.Close();
+	CHECK_FALSE(w.IsOpen());
+
+	// Every rendition has the same frames (with its own size)
+	std::shared_ptr<QImage> source = r.GetFrame(48)->GetImage();
+	QColor source_color = source->pixelColor(source->width() / 2, source->height() / 2);
+	for (auto size : { 720, 360, 180 }) {
+		std::stringstream output;
+		output << "Rendition-" << size << ".webm";
+		FFmpegReader rendition(output.str());
+		rendition.Open();
+
+		CHECK(rendition.info.height == size);
+		CHECK(rendition.info.width == size * 16 / 9);
+		CHECK(rendition.info.has_audio);
+		CHECK(rendition.info.video_length == Approx(48).margin(1));
+
+		std::shared_ptr<QImage> image = rendition.GetFrame(25)->GetImage();
+		QColor color = image->pixelColor(image->width() / 2, image->height() / 2);
+		CHECK(color.red() == Approx(source_color.red()).margin(30));
+		CHECK(color.green() == Approx(source_color.green()).margin(30));
+		CHECK(color.blue() == Approx(source_color.blue()).margin(30));
+
+		rendition.Close();
+	}
+
+	r.Close();
+}
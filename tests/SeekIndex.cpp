@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::SeekIndex
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <sstream>
+
+#include "openshot_catch.h"
+
+#include "SeekIndex.h"
+#include "Settings.h"
+
+#include <QDir>
+
+using namespace openshot;
+
+TEST_CASE( "FindKeyframe", "[libopenshot][seekindex]" )
+{
+	// 3 GOPs of 10 packets (keyframes at pts 0, 1000, 2000)
+	SeekIndex index;
+	for (int64_t packet = 0; packet < 30; packet++)
+		index.Add(packet * 100, packet * 100 - 200, packet * 5000, packet % 10 == 0);
+
+	CHECK(index.Count() == 30);
+	CHECK(index.KeyframeCount() == 3);
+
+	// Packets which are already indexed are ignored
+	index.Add(500, 300, 25000, false);
+	CHECK(index.Count() == 30);
+
+	SeekIndex::Entry keyframe;
+	CHECK(index.FindKeyframe(0, keyframe));
+	CHECK(keyframe.pts == 0);
+	CHECK(index.FindKeyframe(1500, keyframe));
+	CHECK(keyframe.pts == 1000);
+	CHECK(keyframe.pos == 50000);
+	CHECK(index.FindKeyframe(1000, keyframe));
+	CHECK(keyframe.pts == 1000);
+
+	// Before the first keyframe
+	CHECK_FALSE(index.FindKeyframe(-100, keyframe));
+
+	// The last GOP is only known once the index is complete
+	CHECK_FALSE(index.FindKeyframe(2500, keyframe));
+	index.SetComplete();
+	CHECK(index.FindKeyframe(2500, keyframe));
+	CHECK(keyframe.pts == 2000);
+}
+
+TEST_CASE( "Save and Load", "[libopenshot][seekindex]" )
+{
+	std::stringstream media_path;
+	media_path << TEST_MEDIA_PATH << "test.mp4";
+	std::string index_path = QDir::tempPath().toStdString() + "/openshot-test-seek-index/test.index";
+
+	SeekIndex index;
+	index.Add(0, -100, 48, true);
+	index.Add(200, 0, 1000, false);
+	index.Add(100, 100, 2000, false);
+	index.Add(300, 200, 3000, true);
+
+	// Incomplete indexes are not saved
+	CHECK_FALSE(index.Save(index_path, media_path.str(), 0));
+	index.SetComplete();
+	CHECK(index.Save(index_path, media_path.str(), 0));
+
+	SeekIndex loaded;
+	CHECK(loaded.Load(index_path, media_path.str(), 0));
+	CHECK(loaded.IsComplete());
+	CHECK(loaded.Count() == 4);
+	CHECK(loaded.KeyframeCount() == 2);
+
+	SeekIndex::Entry keyframe;
+	CHECK(loaded.FindKeyframe(350, keyframe));
+	CHECK(keyframe.pts == 300);
+	CHECK(keyframe.dts == 200);
+	CHECK(keyframe.pos == 3000);
+
+	// Index does not match a different file (or stream)
+	std::stringstream other_path;
+	other_path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+	SeekIndex other;
+	CHECK_FALSE(other.Load(index_path, other_path.str(), 0));
+	CHECK_FALSE(other.Load(index_path, media_path.str(), 1));
+	CHECK(other.Count() == 0);
+
+	QDir(QDir::tempPath() + "/openshot-test-seek-index").removeRecursively();
+}
+
+TEST_CASE( "IndexPath", "[libopenshot][seekindex]" )
+{
+	// Disabled by default
+	Settings::Instance()->PATH_SEEK_INDEX = "";
+	CHECK(SeekIndex::IndexPath("video.mp4") == "");
+
+	Settings::Instance()->PATH_SEEK_INDEX = "/tmp/seek-index";
+	std::string path1 = SeekIndex::IndexPath("video1.mp4");
+	std::string path2 = SeekIndex::IndexPath("video2.mp4");
+	CHECK(path1.find("/tmp/seek-index/") == 0);
+	CHECK(path1 != path2);
+	CHECK(path1 == SeekIndex::IndexPath("video1.mp4"));
+	Settings::Instance()->PATH_SEEK_INDEX = "";
+}
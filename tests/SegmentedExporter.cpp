@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::SegmentedExporter
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <memory>
+#include <sstream>
+
+#include <QColor>
+#include <QDir>
+
+#include "openshot_catch.h"
+
+#include "Clip.h"
+#include "FFmpegReader.h"
+#include "Frame.h"
+#include "SegmentedExporter.h"
+#include "Timeline.h"
+
+using namespace openshot;
+
+TEST_CASE( "GOP aligned segments", "[libopenshot][segmentedexporter]" )
+{
+	Timeline t(640, 360, Fraction(24, 1), 44100, 2, LAYOUT_STEREO);
+	SegmentedExporter exporter(&t, "Segments-output.webm");
+	exporter.SetGopSize(12);
+	exporter.SetSegmentLength(12);
+
+	auto segments = exporter.GetSegments(1, 48);
+	REQUIRE(segments.size() == 4);
+	CHECK(segments[0] == std::make_pair(int64_t(1), int64_t(12)));
+	CHECK(segments[3] == std::make_pair(int64_t(37), int64_t(48)));
+
+	// Segments are rounded up to a multiple of the GOP size (and the last segment is shorter)
+	exporter.SetSegmentLength(20);
+	segments = exporter.GetSegments(1, 50);
+	REQUIRE(segments.size() == 3);
+	CHECK(segments[1] == std::make_pair(int64_t(25), int64_t(48)));
+	CHECK(segments[2] == std::make_pair(int64_t(49), int64_t(50)));
+
+	// Automatic segments (4 per thread)
+	exporter.SetSegmentLength(0);
+	exporter.SetThreads(2);
+	CHECK(exporter.GetSegments(1, 96).size() == 8);
+	CHECK(exporter.GetSegments(10, 9).empty());
+}
+
+TEST_CASE( "Export segments", "[libopenshot][segmentedexporter]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	Timeline t(640, 360, Fraction(24, 1), 44100, 2, LAYOUT_STEREO);
+	Clip clip(path.str());
+	t.AddClip(&clip);
+	t.Open();
+
+	// An existing folder (with the name of older temporary folders) is not touched
+	QDir().mkpath("Segments-output.webm.segments");
+
+	SegmentedExporter exporter(&t, "Segments-output.webm");
+	exporter.SetVideoOptions(true, "libvpx", Fraction(24, 1), 640, 360, Fraction(1, 1), false, false, 15000000);
+	exporter.SetAudioOptions(true, "libvorbis", 44100, 2, LAYOUT_STEREO, 128000);
+	exporter.SetGopSize(12);
+	exporter.SetSegmentLength(12);
+	exporter.SetThreads(2);
+	exporter.Export(1, 48);
+
+	// Temporary segments are removed
+	CHECK(QDir().entryList({"Segments-output.webm.segments-*"}, QDir::Dirs).isEmpty());
+	CHECK(QDir("Segments-output.webm.segments").exists());
+	QDir("Segments-output.webm.segments").removeRecursively();
+
+	FFmpegReader r("Segments-output.webm");
+	r.Open();
+	CHECK(r.info.has_video);
+	CHECK(r.info.has_audio);
+	CHECK(r.info.fps.num == 24);
+	CHECK(r.GetFrame(1)->GetAudioChannelsCount() == 2);
+
+	// Frames of every segment are in order (and match the timeline)
+	for (int64_t frame_number : { 6, 18, 30, 42 }) {
+		std::shared_ptr<Frame> exported = r.GetFrame(frame_number);
+		std::shared_ptr<Frame> rendered = t.GetFrame(frame_number);
+		QColor exported_color = exported->GetImage()->pixelColor(320, 180);
+		QColor rendered_color = rendered->GetImage()->pixelColor(320, 180);
+		CHECK(exported_color.red() == Approx(rendered_color.red()).margin(20));
+		CHECK(exported_color.green() == Approx(rendered_color.green()).margin(20));
+		CHECK(exported_color.blue() == Approx(rendered_color.blue()).margin(20));
+	}
+
+	r.Close();
+	t.Close();
+}
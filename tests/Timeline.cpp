@@ -14,20 +14,30 @@
 #include <sstream>
 #include <memory>
 #include <list>
+#include <vector>
 #include <omp.h>
 
 #include "openshot_catch.h"
 
 #include "FrameMapper.h"
+#include "FrameStream.h"
 #include "Timeline.h"
 #include "Clip.h"
 #include "Frame.h"
 #include "Fraction.h"
 #include "effects/Blur.h"
+#include "effects/Brightness.h"
 #include "effects/Negate.h"
+#include "Settings.h"
 
 using namespace openshot;
 
+// Restore the cache statistics setting when a test ends (even if a check fails)
+struct CacheStatsGuard {
+	const bool previous = Settings::Instance()->ENABLE_CACHE_STATS;
+	~CacheStatsGuard() { Settings::Instance()->ENABLE_CACHE_STATS = previous; }
+};
+
 TEST_CASE( "constructor", "[libopenshot][timeline]" )
 {
 	Fraction fps(30000,1000);
@@ -805,6 +815,160 @@ TEST_CASE( "Multi-threaded Timeline Add/Remove Clip", "[libopenshot][timeline]"
 	t = NULL;
 }
 
+TEST_CASE( "Concurrent Timeline GetFrame matches serial", "[libopenshot][timeline]" )
+{
+	// Create two image clips, with animated keyframes
+	std::stringstream path1;
+	path1 << TEST_MEDIA_PATH << "front3.png";
+	Clip clip1(path1.str());
+	clip1.Layer(1);
+	clip1.Position(0.0);
+	clip1.End(2.0);
+	clip1.alpha.AddPoint(1, 1.0);
+	clip1.alpha.AddPoint(60, 0.0);
+
+	std::stringstream path2;
+	path2 << TEST_MEDIA_PATH << "interlaced.png";
+	Clip clip2(path2.str());
+	clip2.Layer(2);
+	clip2.Position(0.5);
+	clip2.End(1.5);
+	clip2.scale = SCALE_NONE;
+	clip2.location_x.AddPoint(1, -0.5);
+	clip2.location_x.AddPoint(60, 0.5);
+
+	// Create a timeline (with an animated background color)
+	Timeline t(640, 360, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	t.color.red.AddPoint(1, 0.0);
+	t.color.red.AddPoint(60, 255.0);
+	t.AddClip(&clip1);
+	t.AddClip(&clip2);
+	t.Open();
+
+	// Render all frames serially
+	const int64_t frame_count = 60;
+	std::vector<std::shared_ptr<Frame>> serial_frames(frame_count);
+	for (int64_t frame = 1; frame <= frame_count; frame++)
+		serial_frames[frame - 1] = t.GetFrame(frame);
+
+	// Render all frames again, concurrently
+	t.ClearAllCache(true);
+	t.ConcurrentRendering(true);
+	CHECK(t.ConcurrentRendering() == true);
+
+	std::vector<std::shared_ptr<Frame>> concurrent_frames(frame_count);
+#pragma omp parallel for
+	for (int64_t frame = 1; frame <= frame_count; frame++)
+		concurrent_frames[frame - 1] = t.GetFrame(frame);
+
+	// Verify images are identical
+	for (int64_t frame = 1; frame <= frame_count; frame++) {
+		std::shared_ptr<Frame> f1 = serial_frames[frame - 1];
+		std::shared_ptr<Frame> f2 = concurrent_frames[frame - 1];
+		REQUIRE(f2);
+		CHECK(f2->number == frame);
+		CHECK(*f1->GetImage() == *f2->GetImage());
+	}
+
+	t.Close();
+}
+
+TEST_CASE( "Concurrent Timeline GetFrame with effects matches serial", "[libopenshot][timeline]" )
+{
+	std::stringstream path1;
+	path1 << TEST_MEDIA_PATH << "front3.png";
+	Clip clip1(path1.str());
+	clip1.Layer(1);
+	clip1.End(2.0);
+
+	std::stringstream path2;
+	path2 << TEST_MEDIA_PATH << "interlaced.png";
+	Clip clip2(path2.str());
+	clip2.Layer(2);
+	clip2.Position(0.5);
+	clip2.End(1.5);
+	clip2.scale = SCALE_NONE;
+
+	// Clip effects (a color effect, and an effect with per-instance state)
+	Keyframe brightness;
+	brightness.AddPoint(1, -0.5);
+	brightness.AddPoint(60, 0.5);
+	Brightness clip_brightness(brightness, Keyframe(3.0));
+	clip1.AddEffect(&clip_brightness);
+	Keyframe sigma;
+	sigma.AddPoint(1, 1.0);
+	sigma.AddPoint(60, 5.0);
+	Blur clip_blur(Keyframe(3.0), Keyframe(3.0), sigma, Keyframe(2.0));
+	clip2.AddEffect(&clip_blur);
+
+	// A timeline effect (shared by the frames of every clip on its layer)
+	Blur timeline_blur(Keyframe(2.0), Keyframe(2.0), Keyframe(2.0), Keyframe(1.0));
+	timeline_blur.Layer(1);
+	timeline_blur.End(2.0);
+
+	Timeline t(640, 360, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	t.AddClip(&clip1);
+	t.AddClip(&clip2);
+	t.AddEffect(&timeline_blur);
+	t.Open();
+
+	// Render all frames serially, and then concurrently
+	const int64_t frame_count = 60;
+	std::vector<std::shared_ptr<Frame>> serial_frames(frame_count);
+	for (int64_t frame = 1; frame <= frame_count; frame++)
+		serial_frames[frame - 1] = t.GetFrame(frame);
+
+	t.ClearAllCache(true);
+	t.ConcurrentRendering(true);
+	std::vector<std::shared_ptr<Frame>> concurrent_frames(frame_count);
+#pragma omp parallel for
+	for (int64_t frame = 1; frame <= frame_count; frame++)
+		concurrent_frames[frame - 1] = t.GetFrame(frame);
+
+	for (int64_t frame = 1; frame <= frame_count; frame++) {
+		REQUIRE(concurrent_frames[frame - 1]);
+		CHECK(*serial_frames[frame - 1]->GetImage() == *concurrent_frames[frame - 1]->GetImage());
+	}
+
+	t.Close();
+}
+
+TEST_CASE( "Concurrent rendering closes clips which are no longer used", "[libopenshot][timeline]" )
+{
+	std::stringstream path1;
+	path1 << TEST_MEDIA_PATH << "front3.png";
+	Clip clip1(path1.str());
+	clip1.Position(0.0);
+	clip1.End(1.0);
+
+	std::stringstream path2;
+	path2 << TEST_MEDIA_PATH << "interlaced.png";
+	Clip clip2(path2.str());
+	clip2.Position(2.0);
+	clip2.End(2.0);
+
+	Timeline t(320, 180, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	t.AddClip(&clip1);
+	t.AddClip(&clip2);
+	t.ConcurrentRendering(true);
+	t.Open();
+
+	// While frames are still rendered (ahead of this loop), the 1st clip is closed once
+	// the renders using it have finished
+	std::shared_ptr<FrameStream> stream = t.GetFrames(1, 120);
+	bool closed_during_export = false;
+	while (std::shared_ptr<Frame> f = stream->Next()) {
+		if (f->number == 1)
+			CHECK(clip1.IsOpen());
+		if (f->number == 100)
+			closed_during_export = !clip1.IsOpen();
+	}
+	CHECK(closed_during_export);
+	CHECK(clip2.IsOpen());
+
+	t.Close();
+}
+
 TEST_CASE( "ApplyJSONDiff and FrameMappers", "[libopenshot][timeline]" )
 {
 	// Create a timeline
@@ -932,3 +1096,153 @@ TEST_CASE( "ApplyJSONDiff Update Reader Info", "[libopenshot][timeline]" )
 	CHECK(mapper->Reader()->info.duration == Approx(20.77867).margin(0.00001));
 
 }
+
+TEST_CASE( "ApplyJSONDiff only removes changed frames from cache", "[libopenshot][timeline]" )
+{
+	// Create a timeline
+	Timeline t(640, 480, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	t.GetCache()->SetMaxBytes(0);
+	t.Open();
+
+	// Add clip (with an alpha keyframe)
+	std::stringstream path1;
+	path1 << TEST_MEDIA_PATH << "interlaced.png";
+	Clip clip1(path1.str());
+	clip1.Id("ABC");
+	clip1.Layer(1);
+	clip1.Position(0);
+	clip1.End(10);
+	clip1.alpha = Keyframe();
+	clip1.alpha.AddPoint(1, 1.0);
+	clip1.alpha.AddPoint(20, 1.0);
+	t.AddClip(&clip1);
+
+	// Render (and cache) the first 60 frames
+	for (int64_t frame = 1; frame <= 60; frame++)
+		t.GetFrame(frame);
+	CHECK(t.GetCache()->Count() == 60);
+
+	// Add a keyframe point after frame 20 (which only changes frames after 20)
+	Keyframe alpha = clip1.alpha;
+	alpha.AddPoint(40, 0.5);
+	Json::Value change(Json::arrayValue);
+	Json::Value update;
+	update["type"] = "update";
+	update["key"].append("clips");
+	update["key"].append(Json::Value(Json::objectValue));
+	update["key"][1]["id"] = clip1.Id();
+	update["value"]["id"] = clip1.Id();
+	update["value"]["alpha"] = alpha.JsonValue();
+	change.append(update);
+	t.ApplyJsonDiff(change.toStyledString());
+
+	CHECK(t.GetCache()->Contains(1));
+	CHECK(t.GetCache()->Contains(18));
+	CHECK_FALSE(t.GetCache()->Contains(21));
+	CHECK_FALSE(t.GetCache()->Contains(60));
+
+	// Changing the volume keeps the cached images (only the audio is mixed again)
+	std::shared_ptr<Frame> cached_frame = t.GetFrame(10);
+	update["value"] = Json::Value(Json::objectValue);
+	update["value"]["id"] = clip1.Id();
+	update["value"]["volume"] = Keyframe(0.5).JsonValue();
+	change[0] = update;
+	t.ApplyJsonDiff(change.toStyledString());
+
+	CHECK(t.GetCache()->Contains(10));
+	std::shared_ptr<Frame> remixed_frame = t.GetFrame(10);
+	CHECK(remixed_frame != cached_frame);
+	CHECK(remixed_frame->GetImage()->pixelColor(320, 240) == cached_frame->GetImage()->pixelColor(320, 240));
+
+	// Only the requested frame is removed from the dirty range (its neighbours are still mixed again)
+	CHECK(t.GetFrame(10) == remixed_frame);
+	std::shared_ptr<Frame> cached_neighbour = t.GetCache()->GetFrame(11);
+	REQUIRE(cached_neighbour);
+	CHECK(t.GetFrame(11) != cached_neighbour);
+	CHECK(t.GetFrame(11) == t.GetFrame(11));
+}
+
+TEST_CASE( "Cache statistics", "[libopenshot][timeline]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "test.mp4";
+
+	Timeline t(640, 480, Fraction(30, 1), 44100, 2, LAYOUT_STEREO);
+	Clip clip1(path.str());
+	t.AddClip(&clip1);
+	t.Open();
+
+	CacheStatsGuard stats_guard;
+	Settings::Instance()->ENABLE_CACHE_STATS = true;
+	t.ResetCacheStats();
+	t.GetFrame(1);
+	t.GetFrame(2);
+	t.GetFrame(1);
+
+	Json::Value stats = t.CacheStats();
+	CHECK(stats["timeline"]["hits"].asString() == "1");
+	CHECK(stats["timeline"]["inserts"].asString() == "2");
+	REQUIRE(stats["clips"].size() == 1);
+	CHECK(stats["clips"][0]["id"].asString() == clip1.Id());
+	CHECK(stats["clips"][0]["caches"].size() >= 2);
+
+	// Totals of each level
+	CHECK(stats["totals"]["timeline"]["hits"].asString() == "1");
+	CHECK(stats["totals"]["clip"]["inserts"].asString() != "0");
+	CHECK(stats["totals"]["reader"]["inserts"].asString() != "0");
+
+	t.ResetCacheStats();
+	CHECK(t.CacheStats()["totals"]["timeline"]["hits"].asString() == "0");
+	t.Close();
+}
+
+TEST_CASE( "Pass-through ranges", "[libopenshot][timeline]" )
+{
+	std::stringstream path;
+	path << TEST_MEDIA_PATH << "sintel_trailer-720p.mp4";
+
+	// Timeline with the size and frame rate of the file
+	Timeline t(1280, 720, Fraction(24, 1), 48000, 2, LAYOUT_STEREO);
+	Clip clip1(path.str());
+	clip1.Position(0.0);
+	clip1.Start(1.0);
+	clip1.End(5.0);
+	t.AddClip(&clip1);
+
+	// An unmodified clip is passed through (frames 1 to 96, from frame 25 of the file)
+	std::vector<PassThroughRange> ranges = t.GetPassThroughRanges(1, 200);
+	REQUIRE(ranges.size() == 1);
+	CHECK(ranges[0].start == 1);
+	CHECK(ranges[0].end == 96);
+	CHECK(ranges[0].source_start == 25);
+	CHECK(ranges[0].clip == &clip1);
+	CHECK(ranges[0].path == path.str());
+
+	// Ranges are limited to the requested frames
+	ranges = t.GetPassThroughRanges(10, 20);
+	REQUIRE(ranges.size() == 1);
+	CHECK(ranges[0].start == 10);
+	CHECK(ranges[0].end == 20);
+	CHECK(ranges[0].source_start == 34);
+
+	// Frames overlapped by another clip (frames 49 to 72) are not passed through
+	Clip clip2(path.str());
+	clip2.Layer(1);
+	clip2.Position(2.0);
+	clip2.End(1.0);
+	clip2.alpha = Keyframe(0.5);
+	t.AddClip(&clip2);
+
+	ranges = t.GetPassThroughRanges(1, 200);
+	REQUIRE(ranges.size() == 2);
+	CHECK(ranges[0].start == 1);
+	CHECK(ranges[0].end == 48);
+	CHECK(ranges[1].start == 73);
+	CHECK(ranges[1].end == 96);
+	CHECK(ranges[1].source_start == 97);
+
+	// Animated clips are not passed through
+	t.RemoveClip(&clip2);
+	clip1.scale_x.AddPoint(50, 0.5);
+	CHECK(t.GetPassThroughRanges(1, 200).empty());
+}
@@ -0,0 +1,135 @@
+/**
+ * @file
+ * @brief Unit tests for openshot::VideoScaler
+ * @author Jonathan Thomas <jonathan@openshot.org>
+ *
+ * @ref License
+ */
+
+// Copyright (c) 2008-2019 OpenShot Studios, LLC
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "openshot_catch.h"
+
+#include "VideoScaler.h"
+
+using namespace openshot;
+
+// Create a YUV 4:2:0 frame (luma changes on each row, and chroma changes on each column)
+static AVFrame* create_yuv_frame(int width, int height)
+{
+	AVFrame* frame = av_frame_alloc();
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = width;
+	frame->height = height;
+	av_frame_get_buffer(frame, 0);
+
+	for (int y = 0; y < height; y++)
+		memset(frame->data[0] + y * frame->linesize[0], 16 + (y % 220), width);
+	for (int y = 0; y < height / 2; y++) {
+		for (int x = 0; x < width / 2; x++) {
+			frame->data[1][y * frame->linesize[1] + x] = 64 + (x % 128);
+			frame->data[2][y * frame->linesize[2] + x] = 192 - (x % 128);
+		}
+	}
+	return frame;
+}
+
+TEST_CASE( "Sliced conversion matches a single conversion", "[libopenshot][videoscaler]" )
+{
+	const int width = 640;
+	const int height = 480;
+	AVFrame* frame = create_yuv_frame(width, height);
+
+	// Convert with a single context
+	SwsContext* context = sws_getContext(width, height, AV_PIX_FMT_YUV420P, width, height, AV_PIX_FMT_RGBA,
+										 SWS_FAST_BILINEAR, NULL, NULL, NULL);
+	std::vector<uint8_t> expected(width * height * 4 + 128);
+	uint8_t* expected_data[4] = {expected.data(), NULL, NULL, NULL};
+	int expected_linesize[4] = {width * 4, 0, 0, 0};
+	sws_scale(context, frame->data, frame->linesize, 0, height, expected_data, expected_linesize);
+	sws_freeContext(context);
+
+	// Convert with slices
+	VideoScaler scaler;
+	std::shared_ptr<QImage> image = scaler.Convert(frame, AV_PIX_FMT_YUV420P, width, height, width, height,
+												   SWS_FAST_BILINEAR, false);
+	REQUIRE(image != nullptr);
+	CHECK(image->width() == width);
+	CHECK(image->height() == height);
+	CHECK(image->format() == QImage::Format_RGBA8888_Premultiplied);
+	CHECK(memcmp(image->constBits(), expected.data(), width * height * 4) == 0);
+
+	av_frame_free(&frame);
+}
+
+TEST_CASE( "Scaled conversion", "[libopenshot][videoscaler]" )
+{
+	AVFrame* frame = create_yuv_frame(640, 480);
+
+	VideoScaler scaler;
+	std::shared_ptr<QImage> image = scaler.Convert(frame, AV_PIX_FMT_YUV420P, 640, 480, 320, 240,
+												   SWS_BICUBIC, true);
+	REQUIRE(image != nullptr);
+	CHECK(image->width() == 320);
+	CHECK(image->height() == 240);
+	CHECK(image->format() == QImage::Format_RGBA8888);
+
+	// Opaque (no alpha in source)
+	CHECK(qAlpha(image->pixel(10, 200)) == 255);
+
+	av_frame_free(&frame);
+}
+
+TEST_CASE( "Vertically scaled conversion matches a single conversion", "[libopenshot][videoscaler]" )
+{
+	AVFrame* frame = create_yuv_frame(1280, 960);
+
+	// Convert with a single context (slices would leave seams between them)
+	SwsContext* context = sws_getContext(1280, 960, AV_PIX_FMT_YUV420P, 640, 480, AV_PIX_FMT_RGBA,
+										 SWS_FAST_BILINEAR, NULL, NULL, NULL);
+	std::vector<uint8_t> expected(640 * 480 * 4 + 128);
+	uint8_t* expected_data[4] = {expected.data(), NULL, NULL, NULL};
+	int expected_linesize[4] = {640 * 4, 0, 0, 0};
+	sws_scale(context, frame->data, frame->linesize, 0, 960, expected_data, expected_linesize);
+	sws_freeContext(context);
+
+	VideoScaler scaler;
+	std::shared_ptr<QImage> image = scaler.Convert(frame, AV_PIX_FMT_YUV420P, 1280, 960, 640, 480,
+												   SWS_FAST_BILINEAR, false);
+	REQUIRE(image != nullptr);
+	CHECK(memcmp(image->constBits(), expected.data(), 640 * 480 * 4) == 0);
+
+	av_frame_free(&frame);
+}
+
+TEST_CASE( "Pixel buffers are reused", "[libopenshot][videoscaler]" )
+{
+	AVFrame* frame = create_yuv_frame(320, 240);
+
+	VideoScaler scaler;
+	std::shared_ptr<QImage> image = scaler.Convert(frame, AV_PIX_FMT_YUV420P, 320, 240, 320, 240,
+												   SWS_FAST_BILINEAR, false);
+	const uchar* first_buffer = image->constBits();
+	image.reset();
+
+	// Released buffer is used for the next image
+	image = scaler.Convert(frame, AV_PIX_FMT_YUV420P, 320, 240, 320, 240, SWS_FAST_BILINEAR, false);
+	CHECK(image->constBits() == first_buffer);
+
+	// Images are still valid after the scaler is destroyed
+	std::shared_ptr<QImage> image2;
+	{
+		VideoScaler scaler2;
+		image2 = scaler2.Convert(frame, AV_PIX_FMT_YUV420P, 320, 240, 160, 120, SWS_FAST_BILINEAR, false);
+	}
+	CHECK(image2->width() == 160);
+	CHECK(qAlpha(image2->pixel(80, 60)) == 255);
+
+	av_frame_free(&frame);
+}